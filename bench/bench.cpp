@@ -2,22 +2,37 @@
 
 #include <shadowmocap/channel.hpp>
 
-#include <random>
+#include "support.hpp"
+
 #include <vector>
 
-std::vector<int> make_random_masks(std::size_t n)
+// Loop over the channel list for every mask.
+void BM_ChannelLoop(benchmark::State& state)
 {
-    std::random_device rd;
-    std::mt19937 gen(rd());
+    using namespace shadowmocap;
 
-    std::uniform_int_distribution<int> dis(1, shadowmocap::kAllChannelMask);
+    auto data = make_random_masks(state.range(0));
 
-    std::vector<int> buf(n);
-    std::generate(std::begin(buf), std::end(buf), [&]() { return dis(gen); });
+    for (auto _ : state) {
+        int v = 0;
+        for (auto item : data) {
+            int dim = 0;
+            for (auto c : kChannelList) {
+                if (item & c) {
+                    dim += get_channel_dimension(c);
+                }
+            }
+
+            v |= dim;
+        }
 
-    return buf;
+        benchmark::DoNotOptimize(v);
+    }
 }
 
+BENCHMARK(BM_ChannelLoop)->Range(1 << 8, 1 << 9);
+
+// Popcount weighted sum of the constant dimension masks.
 void BM_Channel(benchmark::State& state)
 {
     using namespace shadowmocap;
@@ -0,0 +1,174 @@
+#include <benchmark/benchmark.h>
+
+#include <shadowmocap/batch_writer.hpp>
+
+#include <asio.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr int kNumFrame = 1000;
+
+// Size of one frame with 60 nodes and Lq and c channels.
+constexpr std::size_t kFrameSize = 60 * (2 + 8) * sizeof(float);
+
+// Connected pairs of sockets on the loopback interface.
+struct connections {
+    connections(asio::io_context& ioc, int n)
+    {
+        using namespace shadowmocap;
+
+        tcp::acceptor acceptor{
+            ioc, tcp::endpoint{asio::ip::make_address("127.0.0.1"), 0}};
+
+        for (int i = 0; i < n; ++i) {
+            clients.emplace_back(ioc);
+            clients.back().connect(acceptor.local_endpoint());
+            servers.push_back(acceptor.accept());
+            servers.back().set_option(tcp::no_delay{true});
+        }
+    }
+
+    std::vector<shadowmocap::tcp::socket> clients;
+    std::vector<shadowmocap::tcp::socket> servers;
+};
+
+// Read and discard all frames as fast as possible.
+asio::awaitable<void> drain(shadowmocap::tcp::socket& socket)
+{
+    std::vector<char> buffer(1 << 16);
+
+    std::size_t n = kNumFrame * (4 + kFrameSize);
+    while (n > 0) {
+        n -= co_await socket.async_read_some(
+            asio::buffer(buffer.data(), std::min(n, buffer.size())),
+            asio::use_awaitable);
+    }
+}
+
+asio::awaitable<void>
+send_each(shadowmocap::tcp::socket& socket, const std::string& frame)
+{
+    for (int i = 0; i < kNumFrame; ++i) {
+        co_await shadowmocap::write_message(socket, frame);
+    }
+}
+
+// Encode each frame once and queue it on every writer. Yield after every
+// frame, as if it just arrived from upstream.
+asio::awaitable<void> send_all(
+    std::vector<std::unique_ptr<shadowmocap::batch_writer>>& writers,
+    const std::string& frame)
+{
+    for (int i = 0; i < kNumFrame; ++i) {
+        const auto message = shadowmocap::make_shared_message(frame);
+        for (auto& writer : writers) {
+            writer->write(message);
+        }
+
+        co_await asio::post(
+            co_await asio::this_coro::executor, asio::use_awaitable);
+    }
+
+    for (auto& writer : writers) {
+        writer->close();
+    }
+}
+
+void rethrow(std::exception_ptr ptr)
+{
+    if (ptr) {
+        std::rethrow_exception(ptr);
+    }
+}
+
+} // namespace
+
+// One write_message call per frame per client.
+void BM_WriteMessage(benchmark::State& state)
+{
+    const auto num_client = static_cast<int>(state.range(0));
+
+    asio::io_context ioc;
+    connections sockets(ioc, num_client);
+
+    const std::string frame(kFrameSize, 0);
+
+    for (auto _ : state) {
+        for (int i = 0; i < num_client; ++i) {
+            co_spawn(ioc, drain(sockets.clients[i]), rethrow);
+            co_spawn(ioc, send_each(sockets.servers[i], frame), rethrow);
+        }
+
+        ioc.run();
+        ioc.restart();
+    }
+
+    state.counters["frames_per_second"] = benchmark::Counter(
+        static_cast<double>(state.iterations() * kNumFrame * num_client),
+        benchmark::Counter::kIsRate);
+    state.counters["writes_per_frame"] = 1;
+}
+
+BENCHMARK(BM_WriteMessage)
+    ->Arg(1)
+    ->Arg(16)
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+
+// Shared frames fanned out to a batch_writer per client. The second argument
+// is the flush interval in microseconds.
+void BM_BatchWriter(benchmark::State& state)
+{
+    using namespace shadowmocap;
+
+    const auto num_client = static_cast<int>(state.range(0));
+
+    batch_options options;
+    options.flush_interval = std::chrono::microseconds{state.range(1)};
+
+    asio::io_context ioc;
+    connections sockets(ioc, num_client);
+
+    const std::string frame(kFrameSize, 0);
+
+    std::uint64_t num_write = 0;
+    for (auto _ : state) {
+        std::vector<std::unique_ptr<batch_writer>> writers;
+        for (int i = 0; i < num_client; ++i) {
+            writers.push_back(
+                std::make_unique<batch_writer>(sockets.servers[i], options));
+
+            co_spawn(ioc, drain(sockets.clients[i]), rethrow);
+            co_spawn(ioc, writers.back()->run(), rethrow);
+        }
+
+        co_spawn(ioc, send_all(writers, frame), rethrow);
+
+        ioc.run();
+        ioc.restart();
+
+        for (const auto& writer : writers) {
+            num_write += writer->num_write();
+        }
+    }
+
+    const auto num_frame =
+        static_cast<double>(state.iterations() * kNumFrame * num_client);
+
+    state.counters["frames_per_second"] =
+        benchmark::Counter(num_frame, benchmark::Counter::kIsRate);
+    state.counters["writes_per_frame"] =
+        static_cast<double>(num_write) / num_frame;
+}
+
+BENCHMARK(BM_BatchWriter)
+    ->ArgsProduct({{1, 16}, {0, 1000}})
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
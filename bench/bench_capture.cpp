@@ -0,0 +1,90 @@
+#include <benchmark/benchmark.h>
+
+#include <shadowmocap/capture.hpp>
+
+#include "support.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+// Record frames in memory. This is the work done on the network thread for
+// every frame, the file write happens in the background.
+void BM_CaptureEncode(benchmark::State& state)
+{
+    using namespace shadowmocap;
+
+    // Frame with N nodes and Lq and c channels.
+    const std::string message(state.range(0) * (2 + 8) * sizeof(float), 0);
+
+    capture_encoder encoder;
+    encoder.channel_request(
+        make_channel_message(channel::Lq | channel::c),
+        capture_encoder::clock_type::now());
+
+    for (auto _ : state) {
+        encoder.frame(message, capture_encoder::clock_type::now());
+
+        // Discard full chunks like a writer would after the file write.
+        if (encoder.ready()) {
+            benchmark::DoNotOptimize(encoder.take());
+        }
+    }
+
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * message.size());
+}
+
+BENCHMARK(BM_CaptureEncode)->Arg(32)->Arg(64)->Arg(256);
+
+// Map a capture and decode every frame, like an offline analysis job.
+void BM_CaptureRead(benchmark::State& state)
+{
+    using namespace shadowmocap;
+
+    constexpr int kNumFrame = 10000;
+
+    // Frame with 64 nodes and Lq and c channels.
+    constexpr std::size_t kDim = 8;
+    constexpr std::size_t kNumNode = 64;
+
+    const auto message = make_message_bytes(kNumNode, kDim);
+
+    const auto path =
+        (std::filesystem::temp_directory_path() / "shadowmocap_bench.cap")
+            .string();
+    {
+        capture_encoder encoder;
+        for (int i = 0; i < kNumFrame; ++i) {
+            encoder.frame(message, capture_encoder::clock_type::now());
+        }
+
+        encoder.finish();
+
+        std::ofstream out(path, std::ios::binary);
+        for (const auto& block : encoder.take()) {
+            out.write(block.data(), block.size());
+        }
+    }
+
+    capture_reader reader(path);
+    for (auto _ : state) {
+        float sum = 0;
+        for (const auto frame : reader) {
+            for (auto item : make_message_view<kDim>(frame.message)) {
+                sum += item.data[0];
+            }
+        }
+
+        benchmark::DoNotOptimize(sum);
+    }
+
+    state.SetItemsProcessed(state.iterations() * kNumFrame);
+    state.SetBytesProcessed(state.iterations() * kNumFrame * message.size());
+
+    std::remove(path.c_str());
+}
+
+BENCHMARK(BM_CaptureRead)->Unit(benchmark::kMillisecond);
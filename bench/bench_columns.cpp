@@ -0,0 +1,136 @@
+#include <benchmark/benchmark.h>
+
+#include <shadowmocap/columns.hpp>
+#include <shadowmocap/csv.hpp>
+
+#include "support.hpp"
+
+#include <cmath>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr int kMask = shadowmocap::channel::Lq | shadowmocap::channel::c;
+constexpr int kDim = shadowmocap::get_channel_mask_dimension(kMask);
+constexpr int kNumNode = 60;
+
+// Frame with 60 nodes of slowly varying values, i.e. a 100 Hz stream of a
+// subject moving at a normal pace.
+std::string make_frame(int frame)
+{
+    std::string message;
+    float values[kDim];
+    for (int i = 0; i < kNumNode; ++i) {
+        for (int j = 0; j < kDim; ++j) {
+            values[j] = static_cast<float>(std::sin(0.01 * frame + i + j));
+        }
+
+        append_item(message, i + 1, values);
+    }
+
+    return message;
+}
+
+std::vector<shadowmocap::metadata_node> make_nodes()
+{
+    std::vector<shadowmocap::metadata_node> nodes;
+    for (int i = 0; i < kNumNode; ++i) {
+        nodes.push_back({"Node" + std::to_string(i), i + 1});
+    }
+
+    return nodes;
+}
+
+} // namespace
+
+// Encode frames into row groups. Reports the size of the column file
+// compared to the same frames formatted by csv_formatter. The argument is the
+// precision, -1 is lossless.
+void BM_ColumnEncode(benchmark::State& state)
+{
+    using namespace shadowmocap;
+
+    column_options options;
+    options.precision = static_cast<int>(state.range(0));
+
+    constexpr int kNumFrame = 1000;
+
+    std::vector<std::string> frames;
+    for (int i = 0; i < kNumFrame; ++i) {
+        frames.push_back(make_frame(i));
+    }
+
+    const node_map nodes{make_nodes()};
+
+    std::size_t csv_bytes = 0;
+    {
+        csv_formatter csv(kMask);
+        for (const auto& frame : frames) {
+            csv.row(frame);
+        }
+
+        csv_bytes = csv.size();
+    }
+
+    std::size_t bytes = 0;
+    for (auto _ : state) {
+        column_encoder columns(kMask, nodes, options);
+        for (int i = 0; i < kNumFrame; ++i) {
+            columns.frame(frames[i], std::int64_t{i} * 10'000'000);
+        }
+
+        columns.finish();
+
+        bytes = 0;
+        for (const auto& block : columns.take()) {
+            bytes += block.size();
+        }
+
+        benchmark::DoNotOptimize(bytes);
+    }
+
+    const auto raw_bytes = kNumFrame * kNumNode * kDim * sizeof(float);
+
+    state.counters["csv_ratio"] = static_cast<double>(csv_bytes) / bytes;
+    state.counters["raw_ratio"] = static_cast<double>(raw_bytes) / bytes;
+    state.SetItemsProcessed(state.iterations() * kNumFrame);
+}
+
+BENCHMARK(BM_ColumnEncode)->Arg(-1)->Arg(3)->Unit(benchmark::kMillisecond);
+
+// Decode one column of every row group, rounded to 3 digits.
+void BM_ColumnRead(benchmark::State& state)
+{
+    using namespace shadowmocap;
+
+    constexpr int kNumFrame = 10000;
+
+    column_options options;
+    options.precision = 3;
+
+    column_encoder columns(kMask, node_map{make_nodes()}, options);
+    for (int i = 0; i < kNumFrame; ++i) {
+        columns.frame(make_frame(i), std::int64_t{i} * 10'000'000);
+    }
+
+    columns.finish();
+
+    std::string data;
+    for (const auto& block : columns.take()) {
+        data.append(block);
+    }
+
+    const column_reader reader(data);
+    const auto column = reader.find("Node30.Lqw");
+
+    std::vector<float> values(reader.num_row());
+    for (auto _ : state) {
+        reader.read(column, values);
+        benchmark::DoNotOptimize(values.data());
+    }
+
+    state.SetItemsProcessed(state.iterations() * kNumFrame);
+}
+
+BENCHMARK(BM_ColumnRead);
@@ -0,0 +1,84 @@
+#include <benchmark/benchmark.h>
+
+#include <shadowmocap/csv.hpp>
+
+#include "support.hpp"
+
+#include <sstream>
+#include <string>
+
+namespace {
+
+constexpr int kMask = shadowmocap::channel::Lq | shadowmocap::channel::c;
+constexpr int kDim = shadowmocap::get_channel_mask_dimension(kMask);
+
+} // namespace
+
+// Format one row per frame the way examples/stream_to_csv.cpp used to, with
+// an ostringstream and a copy of every row.
+void BM_CsvOstringstream(benchmark::State& state)
+{
+    using namespace shadowmocap;
+
+    const auto message = make_message_bytes(60, kDim);
+
+    std::ostringstream line;
+    line.setf(std::ios_base::fixed, std::ios_base::floatfield);
+    line.precision(3);
+
+    std::size_t bytes = 0;
+    for (auto _ : state) {
+        int column = 0;
+        for (auto& item : make_message_list<kDim>(message)) {
+            for (auto& value : item.data) {
+                if (column++ > 0) {
+                    line << ",";
+                }
+
+                line << value;
+            }
+        }
+
+        line << "\n";
+
+        auto str = line.str();
+        line.str("");
+
+        bytes += str.size();
+        benchmark::DoNotOptimize(str.data());
+    }
+
+    state.SetBytesProcessed(static_cast<std::int64_t>(bytes));
+    state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK(BM_CsvOstringstream);
+
+// Format rows into the reusable buffer of a csv_formatter and hand off one
+// batch at a time.
+void BM_CsvFormatter(benchmark::State& state)
+{
+    using namespace shadowmocap;
+
+    const auto message = make_message_bytes(60, kDim);
+
+    csv_formatter csv(kMask);
+
+    std::size_t bytes = 0;
+    for (auto _ : state) {
+        csv.row(message);
+
+        if (csv.ready()) {
+            bytes += csv.size();
+            benchmark::DoNotOptimize(csv.data().data());
+            csv.clear();
+        }
+    }
+
+    bytes += csv.size();
+
+    state.SetBytesProcessed(static_cast<std::int64_t>(bytes));
+    state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK(BM_CsvFormatter);
@@ -2,23 +2,77 @@
 
 #include <shadowmocap/datastream.hpp>
 
-#include <asio/experimental/as_tuple.hpp>
-#include <asio/experimental/awaitable_operators.hpp>
 #include <asio.hpp>
 
+#include <cstdlib>
+#include <exception>
+#include <new>
+#include <thread>
+
+// Count heap allocations so we can report the number of allocations per
+// frame on the read path. Only counts on the thread of a client while it is
+// in its read loop. Every other allocation in the process pays one check of
+// a thread local flag.
+thread_local bool t_count_allocation = false;
+thread_local std::size_t t_num_allocation = 0;
+
+void* operator new(std::size_t size)
+{
+    if (t_count_allocation) {
+        ++t_num_allocation;
+    }
+
+    if (void* ptr = std::malloc(size == 0 ? 1 : size)) {
+        return ptr;
+    }
+
+    throw std::bad_alloc{};
+}
+
+void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
+
+// Count allocations on this thread for the lifetime of the scope.
+struct count_allocations {
+    count_allocations()
+    {
+        t_count_allocation = true;
+    }
+
+    ~count_allocations()
+    {
+        t_count_allocation = false;
+    }
+
+    count_allocations(const count_allocations&) = delete;
+    count_allocations& operator=(const count_allocations&) = delete;
+};
+
 asio::awaitable<void>
-server(asio::ip::tcp::endpoint endpoint, std::size_t num_bytes)
+server(asio::ip::tcp::acceptor acceptor, std::size_t num_bytes)
 {
     using namespace shadowmocap;
 
-    tcp::acceptor acceptor{co_await asio::this_coro::executor, endpoint};
     for (;;) {
         auto socket = co_await acceptor.async_accept(asio::use_awaitable);
-        co_await write_message(socket, "<?xml version=\"1.0\"?><server/>");
 
-        std::string message(num_bytes, 0);
-        for (;;) {
-            co_await write_message(socket, message);
+        // Write until the client has read all of its frames and hangs up.
+        try {
+            co_await write_message(
+                socket, "<?xml version=\"1.0\"?><server/>");
+
+            std::string message(num_bytes, 0);
+            for (;;) {
+                co_await write_message(socket, message);
+            }
+        } catch (const std::exception&) {
         }
     }
 }
@@ -29,19 +83,50 @@ client(asio::ip::tcp::endpoint endpoint, std::size_t num_frame)
     using namespace shadowmocap;
 
     auto stream = co_await open_connection(endpoint);
+
+    count_allocations scope;
     for (std::size_t i = 0; i < num_frame; ++i) {
         auto message = co_await read_message(stream);
     }
 }
 
 asio::awaitable<void>
-run(asio::ip::tcp::endpoint endpoint, std::size_t m, std::size_t n)
+client_buffer(asio::ip::tcp::endpoint endpoint, std::size_t num_frame)
+{
+    using namespace shadowmocap;
+
+    auto stream = co_await open_connection(endpoint);
+
+    std::string buffer;
+
+    count_allocations scope;
+    for (std::size_t i = 0; i < num_frame; ++i) {
+        auto message = co_await read_message(stream, buffer);
+    }
+}
+
+// Same as client_buffer with metrics attached to the stream.
+asio::awaitable<void>
+client_metrics(asio::ip::tcp::endpoint endpoint, std::size_t num_frame)
 {
-    using namespace asio::experimental::awaitable_operators;
+    using namespace shadowmocap;
+
+    auto stream = co_await open_connection(endpoint);
+
+    stream_metrics metrics;
+    stream.metrics_ = &metrics;
+
+    std::string buffer;
 
-    co_await (server(endpoint, m) || client(endpoint, n));
+    count_allocations scope;
+    for (std::size_t i = 0; i < num_frame; ++i) {
+        co_await read_message(stream, buffer);
+    }
+
+    benchmark::DoNotOptimize(metrics.snapshot().num_frame);
 }
 
+template <auto Client>
 void BM_DataStream(benchmark::State& state)
 {
     using tcp = shadowmocap::tcp;
@@ -49,28 +134,75 @@ void BM_DataStream(benchmark::State& state)
     constexpr std::string_view kHost = "127.0.0.1";
     constexpr std::string_view kService = "32081";
 
-    asio::io_context ioc;
+    // Server on its own thread so its writes are not counted with the reads
+    // of the client.
+    asio::io_context server_ioc;
+
+    const auto endpoint = *tcp::resolver(server_ioc)
+                               .resolve(kHost, kService, tcp::resolver::passive);
+
+    co_spawn(
+        server_ioc, server(tcp::acceptor{server_ioc, endpoint}, state.range(0)),
+        asio::detached);
+
+    std::thread server_thread([&server_ioc]() { server_ioc.run(); });
 
-    const auto endpoint =
-        *tcp::resolver(ioc).resolve(kHost, kService, tcp::resolver::passive);
+    asio::io_context ioc;
 
+    t_num_allocation = 0;
     for (auto _ : state) {
-        co_spawn(
-            ioc, run(endpoint, state.range(0), state.range(1)), [](auto ptr) {
-                // Propagate exception from the coroutine
-                if (ptr) {
-                    std::rethrow_exception(ptr);
-                }
-            });
+        co_spawn(ioc, Client(endpoint, state.range(1)), [](auto ptr) {
+            // Propagate exception from the coroutine
+            if (ptr) {
+                std::rethrow_exception(ptr);
+            }
+        });
 
         ioc.run();
+        ioc.restart();
     }
 
+    const auto num_allocation = t_num_allocation;
+
+    server_ioc.stop();
+    server_thread.join();
+
     state.SetComplexityN(state.range(0) * state.range(1));
 
     state.SetBytesProcessed(
         static_cast<int64_t>(state.iterations()) * state.range(0) *
         state.range(1));
+
+    // Read loop of the client only, not the connection setup.
+    state.counters["allocs_per_frame"] = benchmark::Counter(
+        static_cast<double>(num_allocation) /
+        static_cast<double>(state.iterations() * state.range(1)));
+}
+
+BENCHMARK_TEMPLATE(BM_DataStream, client)
+    ->Ranges({{1 << 10, 1 << 12}, {1 << 15, 1 << 16}});
+BENCHMARK_TEMPLATE(BM_DataStream, client_buffer)
+    ->Ranges({{1 << 10, 1 << 12}, {1 << 15, 1 << 16}});
+BENCHMARK_TEMPLATE(BM_DataStream, client_metrics)
+    ->Ranges({{1 << 10, 1 << 12}, {1 << 15, 1 << 16}});
+
+// Cost of recording one frame into the metrics of a stream.
+void BM_StreamMetrics(benchmark::State& state)
+{
+    using namespace shadowmocap;
+
+    stream_metrics metrics;
+
+    auto now = stream_metrics::clock_type::now();
+    for (auto _ : state) {
+        now += std::chrono::microseconds{16667};
+
+        metrics.add_bytes(1024);
+        metrics.add_frame(now);
+        metrics.add_read(std::chrono::microseconds{10});
+    }
+
+    benchmark::DoNotOptimize(metrics.snapshot().num_frame);
 }
 
-BENCHMARK(BM_DataStream)->Ranges({{1 << 10, 1 << 12}, {1 << 15, 1 << 16}});
+BENCHMARK(BM_StreamMetrics);
@@ -0,0 +1,113 @@
+#include <benchmark/benchmark.h>
+
+#include <shadowmocap/datastream.hpp>
+#include <shadowmocap/frame_ring.hpp>
+
+#include <asio.hpp>
+
+#include <chrono>
+#include <string>
+#include <thread>
+
+namespace {
+
+constexpr unsigned short kPort = 32090;
+
+// Size of one frame with 60 nodes and Lq and c channels.
+constexpr std::size_t kFrameSize = 60 * (2 + 8) * sizeof(float);
+
+// Send a frame every 100 microseconds. Pace the server so the consumer is
+// waiting on the ring, not reading a backlog.
+asio::awaitable<void> session(shadowmocap::tcp::socket socket)
+{
+    using namespace shadowmocap;
+    using namespace std::chrono_literals;
+
+    co_await write_message(socket, "<?xml version=\"1.0\"?><service/>");
+
+    asio::steady_timer timer{socket.get_executor()};
+
+    const std::string message(kFrameSize, 0);
+    for (;;) {
+        timer.expires_after(100us);
+        co_await timer.async_wait(asio::use_awaitable);
+
+        co_await write_message(socket, message);
+    }
+}
+
+asio::awaitable<void> server(shadowmocap::tcp::acceptor& acceptor)
+{
+    for (;;) {
+        auto socket = co_await acceptor.async_accept(asio::use_awaitable);
+
+        co_spawn(
+            acceptor.get_executor(), session(std::move(socket)),
+            asio::detached);
+    }
+}
+
+asio::awaitable<void> client(shadowmocap::frame_ring& ring)
+{
+    using namespace shadowmocap;
+
+    auto stream = co_await open_connection(
+        tcp::endpoint{asio::ip::make_address("127.0.0.1"), kPort});
+
+    co_await read_frames(stream, ring);
+}
+
+} // namespace
+
+// Time from the network thread reading a frame off the socket to the
+// consumer thread seeing it in the ring.
+void BM_FrameRingLatency(benchmark::State& state)
+{
+    using namespace shadowmocap;
+    using clock_type = std::chrono::steady_clock;
+
+    const auto policy = static_cast<overflow_policy>(state.range(0));
+
+    frame_ring ring(16, policy, kFrameSize);
+
+    asio::io_context ioc;
+    tcp::acceptor acceptor{
+        ioc, tcp::endpoint{asio::ip::make_address("127.0.0.1"), kPort}};
+
+    co_spawn(ioc, server(acceptor), asio::detached);
+    co_spawn(ioc, client(ring), asio::detached);
+
+    std::thread network([&ioc] { ioc.run(); });
+
+    // Wait for the first frame so connection setup is not part of the
+    // measurement.
+    while (ring.latest() == nullptr) {
+    }
+
+    clock_type::duration total{};
+    for (auto _ : state) {
+        const frame_slot* slot = nullptr;
+        while ((slot = ring.latest()) == nullptr) {
+        }
+
+        total += clock_type::now() - slot->time;
+
+        benchmark::DoNotOptimize(slot->message.data());
+    }
+
+    ioc.stop();
+    network.join();
+
+    state.counters["latency_ns"] = benchmark::Counter(
+        static_cast<double>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(total)
+                .count()),
+        benchmark::Counter::kAvgIterations);
+    state.counters["dropped"] = static_cast<double>(ring.dropped());
+}
+
+BENCHMARK(BM_FrameRingLatency)
+    ->Arg(static_cast<int>(shadowmocap::overflow_policy::drop_oldest))
+    ->Arg(static_cast<int>(shadowmocap::overflow_policy::block_producer))
+    ->UseRealTime()
+    ->Unit(benchmark::kMicrosecond);
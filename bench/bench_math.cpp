@@ -0,0 +1,333 @@
+#include <benchmark/benchmark.h>
+
+#include <shadowmocap/math.hpp>
+
+#include <random>
+#include <vector>
+
+namespace {
+
+// Unit quaternions and vectors for n nodes, one array per component.
+struct node_data {
+    explicit node_data(std::size_t n) : n{n}, data(16 * n)
+    {
+        std::mt19937 gen(static_cast<unsigned>(n));
+        std::normal_distribution<float> dis;
+
+        for (auto& value : data) {
+            value = dis(gen);
+        }
+
+        shadowmocap::detail::normalize_scalar(lhs(), n);
+        shadowmocap::detail::normalize_scalar(rhs(), n);
+    }
+
+    float* get(std::size_t j)
+    {
+        return data.data() + j * n;
+    }
+
+    shadowmocap::quaternion_array<float> lhs()
+    {
+        return {get(0), get(1), get(2), get(3)};
+    }
+
+    shadowmocap::quaternion_array<float> rhs()
+    {
+        return {get(4), get(5), get(6), get(7)};
+    }
+
+    shadowmocap::vector_array<float> v()
+    {
+        return {get(8), get(9), get(10)};
+    }
+
+    shadowmocap::vector_array<float> t()
+    {
+        return {get(11), get(12), get(13)};
+    }
+
+    std::size_t n;
+    std::vector<float> data;
+};
+
+template <bool Scalar>
+void BM_MathNormalize(benchmark::State& state)
+{
+    using namespace shadowmocap;
+
+    const auto n = static_cast<std::size_t>(state.range(0));
+    node_data nodes(n);
+
+    // Same work on every pass even once the input is unit length.
+    for (auto _ : state) {
+        if constexpr (Scalar) {
+            detail::normalize_scalar(nodes.lhs(), n);
+        } else {
+            normalize(nodes.lhs(), n);
+        }
+
+        benchmark::DoNotOptimize(nodes.data.data());
+        benchmark::ClobberMemory();
+    }
+
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    state.SetLabel(Scalar ? "scalar" : detail::get_simd_name());
+}
+
+template <bool Scalar>
+void BM_MathMultiply(benchmark::State& state)
+{
+    using namespace shadowmocap;
+
+    const auto n = static_cast<std::size_t>(state.range(0));
+    node_data nodes(n);
+    std::vector<float> out(4 * n);
+    const quaternion_array<float> q{
+        out.data(), out.data() + n, out.data() + 2 * n, out.data() + 3 * n};
+
+    for (auto _ : state) {
+        if constexpr (Scalar) {
+            detail::multiply_scalar(nodes.lhs(), nodes.rhs(), q, n);
+        } else {
+            multiply(nodes.lhs(), nodes.rhs(), q, n);
+        }
+
+        benchmark::DoNotOptimize(out.data());
+        benchmark::ClobberMemory();
+    }
+
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    state.SetLabel(Scalar ? "scalar" : detail::get_simd_name());
+}
+
+template <bool Scalar>
+void BM_MathToEuler(benchmark::State& state)
+{
+    using namespace shadowmocap;
+
+    const auto n = static_cast<std::size_t>(state.range(0));
+    node_data nodes(n);
+    std::vector<float> out(3 * n);
+    const vector_array<float> v{out.data(), out.data() + n, out.data() + 2 * n};
+
+    for (auto _ : state) {
+        if constexpr (Scalar) {
+            detail::to_euler_scalar(nodes.lhs(), v, n);
+        } else {
+            to_euler(nodes.lhs(), v, n);
+        }
+
+        benchmark::DoNotOptimize(out.data());
+        benchmark::ClobberMemory();
+    }
+
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    state.SetLabel(Scalar ? "scalar" : detail::get_simd_name());
+}
+
+template <bool Scalar>
+void BM_MathToMatrix(benchmark::State& state)
+{
+    using namespace shadowmocap;
+
+    const auto n = static_cast<std::size_t>(state.range(0));
+    node_data nodes(n);
+    std::vector<float> out(9 * n);
+    matrix_array<float> m;
+    for (std::size_t j = 0; j < m.m.size(); ++j) {
+        m.m[j] = out.data() + j * n;
+    }
+
+    for (auto _ : state) {
+        if constexpr (Scalar) {
+            detail::to_matrix_scalar(nodes.lhs(), m, n);
+        } else {
+            to_matrix(nodes.lhs(), m, n);
+        }
+
+        benchmark::DoNotOptimize(out.data());
+        benchmark::ClobberMemory();
+    }
+
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    state.SetLabel(Scalar ? "scalar" : detail::get_simd_name());
+}
+
+template <bool Scalar>
+void BM_MathTransform(benchmark::State& state)
+{
+    using namespace shadowmocap;
+
+    const auto n = static_cast<std::size_t>(state.range(0));
+    node_data nodes(n);
+    std::vector<float> out(3 * n);
+    const vector_array<float> v{out.data(), out.data() + n, out.data() + 2 * n};
+
+    for (auto _ : state) {
+        if constexpr (Scalar) {
+            detail::transform_scalar(nodes.lhs(), nodes.t(), nodes.v(), v, n);
+        } else {
+            transform(nodes.lhs(), nodes.t(), nodes.v(), v, n);
+        }
+
+        benchmark::DoNotOptimize(out.data());
+        benchmark::ClobberMemory();
+    }
+
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    state.SetLabel(Scalar ? "scalar" : detail::get_simd_name());
+}
+
+// Skeleton shaped tree of chains four bones long that branch off of earlier
+// joints, like limbs and fingers off of a spine.
+std::vector<int> make_skeleton(std::size_t n)
+{
+    std::mt19937 gen(static_cast<unsigned>(n));
+
+    std::vector<int> parent(n, -1);
+    for (std::size_t i = 1; i < n; ++i) {
+        if (i % 4 == 0) {
+            parent[i] = std::uniform_int_distribution<int>(
+                0, static_cast<int>(i) - 1)(gen);
+        } else {
+            parent[i] = static_cast<int>(i) - 1;
+        }
+    }
+
+    return parent;
+}
+
+struct fk_data {
+    explicit fk_data(std::size_t n)
+        : nodes(n), parent(make_skeleton(n)), out(7 * n)
+    {
+    }
+
+    shadowmocap::quaternion_array<float> rotation()
+    {
+        const auto n = nodes.n;
+        return {
+            out.data(), out.data() + n, out.data() + 2 * n,
+            out.data() + 3 * n};
+    }
+
+    shadowmocap::vector_array<float> position()
+    {
+        const auto n = nodes.n;
+        return {out.data() + 4 * n, out.data() + 5 * n, out.data() + 6 * n};
+    }
+
+    node_data nodes;
+    std::vector<int> parent;
+    std::vector<float> out;
+};
+
+// Baseline that walks the tree down from each root through lists of
+// children, the way a solver does it by hand from a nested node tree.
+void solve_children(
+    fk_data& data, const std::vector<std::vector<int>>& children,
+    std::size_t i)
+{
+    using namespace shadowmocap;
+
+    const auto rotation = data.rotation();
+    const auto position = data.position();
+
+    for (int child : children[i]) {
+        const auto c = static_cast<std::size_t>(child);
+
+        const quaternion_array<float> parent_rotation{
+            rotation.w + i, rotation.x + i, rotation.y + i, rotation.z + i};
+        const quaternion_array<float> child_rotation{
+            rotation.w + c, rotation.x + c, rotation.y + c, rotation.z + c};
+
+        const auto local = data.nodes.lhs();
+        const auto offset = data.nodes.v();
+
+        detail::transform_scalar(
+            parent_rotation, {position.x + i, position.y + i, position.z + i},
+            {offset.x + c, offset.y + c, offset.z + c},
+            {position.x + c, position.y + c, position.z + c}, 1);
+        detail::multiply_scalar(
+            parent_rotation,
+            {local.w + c, local.x + c, local.y + c, local.z + c},
+            child_rotation, 1);
+
+        solve_children(data, children, c);
+    }
+}
+
+void BM_ForwardKinematicsTree(benchmark::State& state)
+{
+    const auto n = static_cast<std::size_t>(state.range(0));
+    fk_data data(n);
+
+    std::vector<std::vector<int>> children(n);
+    std::vector<std::size_t> roots;
+    for (std::size_t i = 0; i < n; ++i) {
+        if (data.parent[i] < 0) {
+            roots.push_back(i);
+        } else {
+            children[data.parent[i]].push_back(static_cast<int>(i));
+        }
+    }
+
+    for (auto _ : state) {
+        const auto local = data.nodes.lhs();
+        const auto offset = data.nodes.v();
+        const auto rotation = data.rotation();
+        const auto position = data.position();
+
+        for (auto i : roots) {
+            rotation.w[i] = local.w[i];
+            rotation.x[i] = local.x[i];
+            rotation.y[i] = local.y[i];
+            rotation.z[i] = local.z[i];
+            position.x[i] = offset.x[i];
+            position.y[i] = offset.y[i];
+            position.z[i] = offset.z[i];
+
+            solve_children(data, children, i);
+        }
+
+        benchmark::DoNotOptimize(data.out.data());
+        benchmark::ClobberMemory();
+    }
+
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+void BM_ForwardKinematics(benchmark::State& state)
+{
+    using namespace shadowmocap;
+
+    const auto n = static_cast<std::size_t>(state.range(0));
+    fk_data data(n);
+
+    for (auto _ : state) {
+        forward_kinematics(
+            data.parent, data.nodes.lhs(), data.nodes.v(), data.rotation(),
+            data.position(), n);
+
+        benchmark::DoNotOptimize(data.out.data());
+        benchmark::ClobberMemory();
+    }
+
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+} // namespace
+
+BENCHMARK(BM_MathNormalize<true>)->RangeMultiplier(2)->Range(16, 256);
+BENCHMARK(BM_MathNormalize<false>)->RangeMultiplier(2)->Range(16, 256);
+BENCHMARK(BM_MathMultiply<true>)->RangeMultiplier(2)->Range(16, 256);
+BENCHMARK(BM_MathMultiply<false>)->RangeMultiplier(2)->Range(16, 256);
+BENCHMARK(BM_MathToEuler<true>)->RangeMultiplier(2)->Range(16, 256);
+BENCHMARK(BM_MathToEuler<false>)->RangeMultiplier(2)->Range(16, 256);
+BENCHMARK(BM_MathToMatrix<true>)->RangeMultiplier(2)->Range(16, 256);
+BENCHMARK(BM_MathToMatrix<false>)->RangeMultiplier(2)->Range(16, 256);
+BENCHMARK(BM_MathTransform<true>)->RangeMultiplier(2)->Range(16, 256);
+BENCHMARK(BM_MathTransform<false>)->RangeMultiplier(2)->Range(16, 256);
+BENCHMARK(BM_ForwardKinematicsTree)->RangeMultiplier(2)->Range(16, 256);
+BENCHMARK(BM_ForwardKinematics)->RangeMultiplier(2)->Range(16, 256);
@@ -2,9 +2,16 @@
 
 #include <shadowmocap/message.hpp>
 
+#include "support.hpp"
+
 #include <algorithm>
+#include <bit>
+#include <cstring>
 #include <random>
+#include <regex>
 #include <string>
+#include <string_view>
+#include <vector>
 
 std::string make_random_bytes(std::size_t n)
 {
@@ -41,3 +48,178 @@ BENCHMARK_TEMPLATE(BM_MessageViewCreation, 8)->Range(1 << 3, 1 << 7);
 BENCHMARK_TEMPLATE(BM_MessageViewCreation, 16)->Range(1 << 2, 1 << 8);
 BENCHMARK_TEMPLATE(BM_MessageViewCreation, 32)->Range(1 << 1, 1 << 9);
 BENCHMARK_TEMPLATE(BM_MessageViewCreation, 64)->Range(1 << 0, 1 << 10);
+
+// Decode with the channel layout known at compile time.
+template <int Mask>
+void BM_MessageViewDecode(benchmark::State& state)
+{
+    using namespace shadowmocap;
+
+    constexpr auto N = get_channel_mask_dimension(Mask);
+    using item_type = message_list_item<N>;
+
+    auto data = make_message_bytes(state.range(0), N);
+
+    for (auto _ : state) {
+        float v = 0;
+        for (const auto& item : make_message_view<N>(data)) {
+            if (item.length == N) {
+                v += item.data[N - 1];
+            }
+        }
+
+        benchmark::DoNotOptimize(v);
+    }
+
+    state.SetBytesProcessed(
+        static_cast<int64_t>(state.iterations()) * state.range(0) *
+        sizeof(item_type));
+}
+
+// Decode with the channel layout defined at runtime.
+template <int Mask>
+void BM_MessageLayoutDecode(benchmark::State& state)
+{
+    using namespace shadowmocap;
+
+    const message_layout layout(Mask);
+    const auto N = layout.dimension();
+
+    auto data = make_message_bytes(state.range(0), N);
+
+    // Last scalar value in the item, same as the compile time benchmark.
+    const auto c = static_cast<channel>(std::bit_floor(
+        static_cast<unsigned>(Mask)));
+    const auto axis = get_channel_dimension(c) - 1;
+
+    for (auto _ : state) {
+        float v = 0;
+        for (auto item : make_message_view(data, layout)) {
+            v += item.value(c, axis);
+        }
+
+        benchmark::DoNotOptimize(v);
+    }
+
+    state.SetBytesProcessed(
+        static_cast<int64_t>(state.iterations()) * state.range(0) *
+        layout.item_size());
+}
+
+constexpr int kMask8 = shadowmocap::channel::Lq | shadowmocap::channel::c;
+constexpr int kMaskAll = shadowmocap::kAllChannelMask;
+
+BENCHMARK_TEMPLATE(BM_MessageViewDecode, kMask8)->Range(1 << 3, 1 << 7);
+BENCHMARK_TEMPLATE(BM_MessageLayoutDecode, kMask8)->Range(1 << 3, 1 << 7);
+BENCHMARK_TEMPLATE(BM_MessageViewDecode, kMaskAll)->Range(1 << 0, 1 << 8);
+BENCHMARK_TEMPLATE(BM_MessageLayoutDecode, kMaskAll)->Range(1 << 0, 1 << 8);
+
+template <int N>
+void BM_MessageListIteration(benchmark::State& state)
+{
+    using namespace shadowmocap;
+    using item_type = message_list_item<N>;
+
+    auto data = make_random_bytes(state.range(0) * sizeof(item_type));
+
+    for (auto _ : state) {
+        int v = 0;
+        for (const auto& item : make_message_list<N>(data)) {
+            v += item.key;
+        }
+
+        benchmark::DoNotOptimize(v);
+    }
+
+    state.SetBytesProcessed(
+        static_cast<int64_t>(state.iterations()) * state.range(0) *
+        sizeof(item_type));
+}
+
+template <int N>
+void BM_MessageViewIteration(benchmark::State& state)
+{
+    using namespace shadowmocap;
+    using item_type = message_list_item<N>;
+
+    auto data = make_random_bytes(state.range(0) * sizeof(item_type));
+
+    for (auto _ : state) {
+        int v = 0;
+        for (const auto& item : make_message_view<N>(data)) {
+            v += item.key;
+        }
+
+        benchmark::DoNotOptimize(v);
+    }
+
+    state.SetBytesProcessed(
+        static_cast<int64_t>(state.iterations()) * state.range(0) *
+        sizeof(item_type));
+}
+
+BENCHMARK_TEMPLATE(BM_MessageListIteration, 8)->Range(1 << 3, 1 << 7);
+BENCHMARK_TEMPLATE(BM_MessageViewIteration, 8)->Range(1 << 3, 1 << 7);
+BENCHMARK_TEMPLATE(BM_MessageListIteration, 32)->Range(1 << 1, 1 << 9);
+BENCHMARK_TEMPLATE(BM_MessageViewIteration, 32)->Range(1 << 1, 1 << 9);
+
+// Previous implementation of parse_metadata, kept as the baseline.
+std::vector<std::string> parse_metadata_regex(std::string_view message)
+{
+    const std::regex re{"<node\\s+id=\"([^\"]+)\"\\s+key=\"(\\d+)\""};
+
+    auto first = std::regex_iterator{message.begin(), message.end(), re};
+    auto last = decltype(first){};
+
+    if (first == last) {
+        return {};
+    }
+
+    ++first;
+
+    std::vector<std::string> name_list;
+    for (; first != last; ++first) {
+        name_list.push_back(first->str(1));
+    }
+
+    return name_list;
+}
+
+std::string make_metadata(std::size_t num_node)
+{
+    std::string xml = "<?xml version=\"1.0\" encoding=\"utf-8\"?>"
+                      "<node id=\"default\" key=\"0\" tracking=\"1\">";
+
+    for (std::size_t i = 0; i < num_node; ++i) {
+        xml.append("<node id=\"Node")
+            .append(std::to_string(i))
+            .append("\" key=\"")
+            .append(std::to_string(i + 1))
+            .append("\" active=\"1\"/>");
+    }
+
+    xml.append("</node>");
+
+    return xml;
+}
+
+template <auto Parse>
+void BM_ParseMetadata(benchmark::State& state)
+{
+    const auto xml = make_metadata(state.range(0));
+
+    for (auto _ : state) {
+        auto v = Parse(xml);
+        benchmark::DoNotOptimize(v);
+    }
+
+    state.SetBytesProcessed(
+        static_cast<int64_t>(state.iterations()) * xml.size());
+}
+
+BENCHMARK_TEMPLATE(BM_ParseMetadata, parse_metadata_regex)
+    ->Range(1 << 2, 1 << 7);
+BENCHMARK_TEMPLATE(BM_ParseMetadata, shadowmocap::parse_metadata)
+    ->Range(1 << 2, 1 << 7);
+BENCHMARK_TEMPLATE(BM_ParseMetadata, shadowmocap::parse_metadata_nodes)
+    ->Range(1 << 2, 1 << 7);
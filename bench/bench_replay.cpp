@@ -0,0 +1,126 @@
+#include <benchmark/benchmark.h>
+
+#include <shadowmocap/datastream.hpp>
+#include <shadowmocap/replay.hpp>
+
+#include <asio.hpp>
+
+#include <atomic>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr int kNumFrame = 1000;
+
+// Size of one frame with 60 nodes and Lq and c channels.
+constexpr std::size_t kFrameSize = 60 * (2 + 8) * sizeof(float);
+
+// Capture with 1000 frames and a replay server on its own threads for the
+// lifetime of the benchmark process.
+struct replay_fixture {
+    replay_fixture()
+        : path{(std::filesystem::temp_directory_path() /
+                "shadowmocap_bench_replay.cap")
+                   .string()},
+          reader{make_capture(path)}, pool(std::thread::hardware_concurrency()),
+          acceptor{pool, shadowmocap::tcp::endpoint{
+                             asio::ip::make_address("127.0.0.1"), 0}}
+    {
+        shadowmocap::replay_options options;
+        options.rate = 0;
+
+        co_spawn(
+            pool, shadowmocap::replay_server(acceptor, reader, options),
+            asio::detached);
+    }
+
+    ~replay_fixture()
+    {
+        pool.stop();
+        pool.join();
+        std::remove(path.c_str());
+    }
+
+    static const std::string& make_capture(const std::string& path)
+    {
+        using namespace shadowmocap;
+
+        capture_encoder encoder;
+        encoder.metadata(
+            "<?xml version=\"1.0\"?><node id=\"default\" key=\"0\"/>",
+            capture_encoder::clock_type::now());
+
+        const std::string message(kFrameSize, 0);
+        for (int i = 0; i < kNumFrame; ++i) {
+            encoder.frame(message, capture_encoder::clock_type::now());
+        }
+
+        encoder.finish();
+
+        std::ofstream out(path, std::ios::binary);
+        for (const auto& block : encoder.take()) {
+            out.write(block.data(), block.size());
+        }
+
+        return path;
+    }
+
+    std::string path;
+    shadowmocap::capture_reader reader;
+    asio::thread_pool pool;
+    shadowmocap::tcp::acceptor acceptor;
+};
+
+asio::awaitable<void>
+client(shadowmocap::tcp::endpoint endpoint, std::atomic<int>& count)
+{
+    using namespace shadowmocap;
+
+    auto stream = co_await open_connection(endpoint);
+
+    co_await write_message(
+        stream, make_channel_message(channel::Lq | channel::c));
+
+    std::string buffer;
+    for (int i = 0; i < kNumFrame; ++i) {
+        co_await read_message(stream, buffer);
+    }
+
+    count.fetch_add(kNumFrame, std::memory_order_relaxed);
+}
+
+} // namespace
+
+// Many clients read the whole capture as fast as the server can send it.
+void BM_ReplayServer(benchmark::State& state)
+{
+    static replay_fixture fixture;
+
+    const auto num_client = static_cast<int>(state.range(0));
+    const auto endpoint = fixture.acceptor.local_endpoint();
+
+    std::atomic<int> count{0};
+    for (auto _ : state) {
+        asio::thread_pool clients(2);
+        for (int i = 0; i < num_client; ++i) {
+            co_spawn(clients, client(endpoint, count), asio::detached);
+        }
+
+        clients.join();
+    }
+
+    state.counters["frames_per_second"] = benchmark::Counter(
+        static_cast<double>(count.load()), benchmark::Counter::kIsRate);
+}
+
+BENCHMARK(BM_ReplayServer)
+    ->Arg(1)
+    ->Arg(16)
+    ->Arg(128)
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
@@ -0,0 +1,80 @@
+#include <benchmark/benchmark.h>
+
+#include <shadowmocap/soa.hpp>
+
+#include "support.hpp"
+
+#include <cmath>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr int kMask = shadowmocap::channel::Lq | shadowmocap::channel::c;
+constexpr int kDim = shadowmocap::get_channel_mask_dimension(kMask);
+
+} // namespace
+
+// Decode to array of structs and normalize every Lq one node at a time.
+void BM_AoSNormalize(benchmark::State& state)
+{
+    using namespace shadowmocap;
+
+    const auto data = make_message_bytes(state.range(0), kDim);
+
+    std::vector<float> out(4 * state.range(0));
+    for (auto _ : state) {
+        float* dst = out.data();
+        for (const auto& item : make_message_view<kDim>(data)) {
+            const float* q = item.data;
+            const float s =
+                1 / std::sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] +
+                              q[3] * q[3]);
+            for (int j = 0; j < 4; ++j) {
+                *dst++ = q[j] * s;
+            }
+        }
+
+        benchmark::DoNotOptimize(out.data());
+        benchmark::ClobberMemory();
+    }
+
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// Decode to structure of arrays and normalize every Lq in one vector loop.
+void BM_SoANormalize(benchmark::State& state)
+{
+    using namespace shadowmocap;
+
+    const auto data = make_message_bytes(state.range(0), kDim);
+
+    soa_frame frame(kMask);
+    for (auto _ : state) {
+        frame.decode(data);
+
+        auto w = frame.values(channel::Lq, 0);
+        auto x = frame.values(channel::Lq, 1);
+        auto y = frame.values(channel::Lq, 2);
+        auto z = frame.values(channel::Lq, 3);
+
+        const auto n = frame.size();
+        for (std::size_t i = 0; i < n; ++i) {
+            const float s = 1 / std::sqrt(
+                                    w[i] * w[i] + x[i] * x[i] + y[i] * y[i] +
+                                    z[i] * z[i]);
+            w[i] *= s;
+            x[i] *= s;
+            y[i] *= s;
+            z[i] *= s;
+        }
+
+        benchmark::DoNotOptimize(w.data());
+        benchmark::ClobberMemory();
+    }
+
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+BENCHMARK(BM_AoSNormalize)->RangeMultiplier(2)->Range(32, 256);
+BENCHMARK(BM_SoANormalize)->RangeMultiplier(2)->Range(32, 256);
@@ -0,0 +1,126 @@
+#include <benchmark/benchmark.h>
+
+#include <shadowmocap/datastream.hpp>
+#include <shadowmocap/stream_group.hpp>
+
+#include <asio.hpp>
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr unsigned short kFirstPort = 32100;
+constexpr std::size_t kMaxStream = 64;
+
+// Size of one frame with 60 nodes and Lq and c channels.
+constexpr std::size_t kFrameSize = 60 * (2 + 8) * sizeof(float);
+
+asio::awaitable<void> session(shadowmocap::tcp::socket socket)
+{
+    using namespace shadowmocap;
+
+    co_await write_message(socket, "<?xml version=\"1.0\"?><service/>");
+
+    // Channel request from the client.
+    co_await read_message(socket);
+
+    co_await write_message(
+        socket, "<?xml version=\"1.0\"?><node id=\"default\" key=\"0\">"
+                "<node id=\"Node\" key=\"1\"/></node>");
+
+    const std::string message(kFrameSize, 0);
+    for (;;) {
+        co_await write_message(socket, message);
+    }
+}
+
+asio::awaitable<void> server(shadowmocap::tcp::endpoint endpoint)
+{
+    using namespace shadowmocap;
+
+    tcp::acceptor acceptor{co_await asio::this_coro::executor, endpoint};
+    for (;;) {
+        auto socket = co_await acceptor.async_accept(asio::use_awaitable);
+
+        co_spawn(
+            acceptor.get_executor(), session(std::move(socket)),
+            asio::detached);
+    }
+}
+
+// Local mock servers that stream frames as fast as possible. Run on their own
+// threads for the lifetime of the benchmark process.
+struct mock_servers {
+    mock_servers() : pool(std::thread::hardware_concurrency())
+    {
+        const auto address = asio::ip::make_address("127.0.0.1");
+
+        for (std::size_t i = 0; i < kMaxStream; ++i) {
+            const shadowmocap::tcp::endpoint endpoint{
+                address, static_cast<unsigned short>(kFirstPort + i)};
+
+            co_spawn(pool, server(endpoint), asio::detached);
+        }
+    }
+
+    ~mock_servers()
+    {
+        pool.stop();
+        pool.join();
+    }
+
+    asio::thread_pool pool;
+};
+
+} // namespace
+
+void BM_StreamGroup(benchmark::State& state)
+{
+    using namespace shadowmocap;
+
+    static mock_servers servers;
+
+    const auto num_thread = static_cast<std::size_t>(state.range(0));
+    const auto num_stream = static_cast<std::size_t>(state.range(1));
+    const std::size_t num_frame = 1000 * num_stream;
+
+    const auto address = asio::ip::make_address("127.0.0.1");
+
+    std::size_t total = 0;
+    for (auto _ : state) {
+        stream_group group(num_thread);
+        for (std::size_t i = 0; i < num_stream; ++i) {
+            group.add(
+                tcp::endpoint{
+                    address, static_cast<unsigned short>(kFirstPort + i)},
+                channel::Lq | channel::c);
+        }
+
+        std::atomic<std::size_t> count{0};
+        group.start(
+            [&](std::size_t, std::string_view message, const node_map&) {
+                benchmark::DoNotOptimize(message.data());
+
+                if (count.fetch_add(1, std::memory_order_relaxed) + 1 ==
+                    num_frame) {
+                    group.stop();
+                }
+            },
+            [&](std::size_t, std::exception_ptr) { group.stop(); });
+
+        group.join();
+
+        total += count.load();
+    }
+
+    state.counters["frames_per_second"] = benchmark::Counter(
+        static_cast<double>(total), benchmark::Counter::kIsRate);
+}
+
+BENCHMARK(BM_StreamGroup)
+    ->ArgsProduct({{1, 2, 4, 8}, {8, 64}})
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
@@ -0,0 +1,119 @@
+#include <benchmark/benchmark.h>
+
+#include <shadowmocap/message.hpp>
+#include <shadowmocap/subset.hpp>
+
+#include "support.hpp"
+
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr std::size_t kNumMask = 64;
+constexpr std::size_t kNumItem = 60;
+
+struct mask_pair {
+    int from;
+    int to;
+    std::string message;
+};
+
+// Random input masks, each with a random subset of its channels.
+std::vector<mask_pair> make_random_pairs()
+{
+    using namespace shadowmocap;
+
+    std::random_device rd;
+    std::mt19937 gen(rd());
+
+    std::uniform_int_distribution<int> dis(0, kAllChannelMask);
+
+    std::vector<mask_pair> result;
+    for (auto from : make_random_masks(kNumMask)) {
+        auto to = from & dis(gen);
+        if (to == 0) {
+            to = from;
+        }
+
+        result.push_back(
+            {from, to,
+             make_message_bytes(kNumItem, get_channel_mask_dimension(from))});
+    }
+
+    return result;
+}
+
+} // namespace
+
+// Per channel copy through message_view.
+void BM_SubsetChannelLoop(benchmark::State& state)
+{
+    using namespace shadowmocap;
+
+    const auto data = make_random_pairs();
+
+    std::string out;
+    std::size_t num_bytes = 0;
+    for (auto _ : state) {
+        for (const auto& item : data) {
+            const message_layout from{item.from};
+            const message_layout to{item.to};
+
+            const auto view = make_message_view(item.message, from);
+
+            out.resize(view.size() * to.item_size());
+
+            auto* ptr = out.data();
+            for (const auto node : view) {
+                const int header[2] = {node.key(), to.dimension()};
+                std::memcpy(ptr, header, sizeof(header));
+                ptr += sizeof(header);
+
+                for (auto c : kChannelList) {
+                    if (!to.contains(c)) {
+                        continue;
+                    }
+
+                    float values[4];
+                    const auto n = node.get(c, values);
+
+                    std::memcpy(ptr, values, n * sizeof(float));
+                    ptr += n * sizeof(float);
+                }
+            }
+
+            benchmark::DoNotOptimize(out.data());
+            num_bytes += item.message.size();
+        }
+    }
+
+    state.SetBytesProcessed(static_cast<int64_t>(num_bytes));
+}
+
+BENCHMARK(BM_SubsetChannelLoop);
+
+// Precomputed memcpy runs, plan looked up from the cache for every message.
+void BM_SubsetPlan(benchmark::State& state)
+{
+    using namespace shadowmocap;
+
+    const auto data = make_random_pairs();
+
+    std::string out;
+    std::size_t num_bytes = 0;
+    for (auto _ : state) {
+        for (const auto& item : data) {
+            const auto& subset = get_channel_subset(item.from, item.to);
+
+            benchmark::DoNotOptimize(subset.apply(item.message, out));
+            num_bytes += item.message.size();
+        }
+    }
+
+    state.SetBytesProcessed(static_cast<int64_t>(num_bytes));
+}
+
+BENCHMARK(BM_SubsetPlan);
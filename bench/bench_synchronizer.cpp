@@ -0,0 +1,132 @@
+#include <benchmark/benchmark.h>
+
+#include <shadowmocap/message.hpp>
+#include <shadowmocap/synchronizer.hpp>
+
+#include "support.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr int kMask = shadowmocap::channel::Lq | shadowmocap::channel::c |
+                      shadowmocap::channel::timestamp;
+
+constexpr std::size_t kNumItem = 32;
+
+constexpr auto kPeriod = std::chrono::microseconds{10'000};
+
+// Every node turns about z at its own rate so slerp takes the full path.
+std::string make_frame(int frame)
+{
+    using namespace shadowmocap;
+
+    const message_layout layout(kMask);
+
+    std::string message;
+    for (std::size_t i = 0; i < kNumItem; ++i) {
+        const float angle = static_cast<float>(frame * (i + 1)) * 0.05f;
+
+        std::vector<float> values(layout.dimension());
+        values[layout.offset(channel::Lq)] = std::cos(angle / 2);
+        values[layout.offset(channel::Lq) + 3] = std::sin(angle / 2);
+        values[layout.offset(channel::c)] = static_cast<float>(i);
+        values[layout.offset(channel::timestamp)] =
+            static_cast<float>(frame) * 0.01f;
+
+        append_item(message, static_cast<int>(i) + 1, values);
+    }
+
+    return message;
+}
+
+// Frames at 100 Hz, a few seconds worth so the timestamp goes forward.
+std::vector<std::string> make_frames()
+{
+    std::vector<std::string> result;
+    for (int i = 0; i < 1000; ++i) {
+        result.push_back(make_frame(i));
+    }
+
+    return result;
+}
+
+} // namespace
+
+// Producer side, copy a frame into the ring of its stream.
+void BM_SynchronizerPush(benchmark::State& state)
+{
+    using namespace shadowmocap;
+
+    const auto frames = make_frames();
+
+    sync_options options;
+    options.message_capacity = frames.front().size();
+
+    synchronizer sync(options);
+    sync.add(kMask);
+
+    auto now = synchronizer::clock_type::now();
+    std::size_t index = 0;
+    for (auto _ : state) {
+        sync.push(0, frames[index], now);
+
+        now += kPeriod;
+        index = (index + 1) % frames.size();
+    }
+
+    state.SetBytesProcessed(
+        static_cast<int64_t>(state.iterations()) * frames.front().size());
+}
+
+BENCHMARK(BM_SynchronizerPush);
+
+// One tick of the consumer with a new frame from every stream. Take the
+// waiting frames and interpolate every stream at the sample time.
+void BM_SynchronizerSample(benchmark::State& state)
+{
+    using namespace shadowmocap;
+
+    const auto num_stream = static_cast<std::size_t>(state.range(0));
+    const auto frames = make_frames();
+
+    sync_options options;
+    options.message_capacity = frames.front().size();
+
+    synchronizer sync(options);
+    for (std::size_t k = 0; k < num_stream; ++k) {
+        sync.add(kMask);
+    }
+
+    // The timestamp starts over at the end of the list, which resets the
+    // history of every stream. Sample at the middle of each period so every
+    // stream is interpolated in between.
+    auto now = synchronizer::clock_type::now();
+    std::size_t index = 0;
+    std::size_t num_interpolated = 0;
+    for (auto _ : state) {
+        for (std::size_t k = 0; k < num_stream; ++k) {
+            sync.push(k, frames[index], now);
+        }
+
+        const auto& frame = sync.sample(now + kPeriod / 2);
+        for (const auto& stream : frame.streams) {
+            num_interpolated += stream.state == sync_state::interpolated;
+        }
+
+        now += kPeriod;
+        index = (index + 1) % frames.size();
+    }
+
+    state.SetItemsProcessed(
+        static_cast<int64_t>(state.iterations() * num_stream));
+    state.counters["interpolated"] = benchmark::Counter(
+        static_cast<double>(num_interpolated) /
+        static_cast<double>(num_stream),
+        benchmark::Counter::kAvgIterations);
+}
+
+BENCHMARK(BM_SynchronizerSample)->Arg(4)->Arg(16)->Arg(64);
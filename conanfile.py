@@ -11,8 +11,8 @@ class ShadowmocapRecipe(ConanFile):
 
     # Binary configuration
     settings = "os", "arch", "compiler", "build_type"
-    options = {"enable_benchmarks": [True, False]}
-    default_options = {"enable_benchmarks": False}
+    options = {"enable_benchmarks": [True, False], "enable_io_uring": [True, False]}
+    default_options = {"enable_benchmarks": False, "enable_io_uring": False}
 
     # Copy sources to when building this recipe for the local cache
     exports_sources = "CMakeLists.txt", "include/*", "src/*", "examples/*", "tests/*", "bench/*"
@@ -26,6 +26,9 @@ class ShadowmocapRecipe(ConanFile):
         if self.options.enable_benchmarks:
             self.requires("benchmark/1.7.1")
 
+        if self.options.enable_io_uring:
+            self.requires("liburing/2.3")
+
         if not self.conf.get("tools.build:skip_test", default=False):
             self.requires("catch2/3.3.2")
 
@@ -36,7 +39,10 @@ class ShadowmocapRecipe(ConanFile):
         deps.generate()
 
     def build(self):
-        variables = {"ENABLE_BENCHMARKS": self.options.enable_benchmarks}
+        variables = {
+            "ENABLE_BENCHMARKS": self.options.enable_benchmarks,
+            "ENABLE_IO_URING": self.options.enable_io_uring,
+        }
 
         cmake = CMake(self)
         cmake.configure(variables=variables)
@@ -0,0 +1,179 @@
+#include <shadowmocap.hpp>
+
+#include <asio/co_spawn.hpp>
+#include <asio/detached.hpp>
+#include <asio/io_context.hpp>
+#include <asio/ip/tcp.hpp>
+#include <asio/signal_set.hpp>
+
+#include <csignal>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <utility>
+
+using shadowmocap::tcp;
+
+// Utility class to store all of the options to run our relay server.
+struct command_line_options {
+    /**
+      Read the command line tokens and load them into this state. Returns 0 if
+      successful, -1 if the command line options are invalid, or 1 if the help
+      message should be printed out.
+    */
+    int parse(int argc, char* argv[]);
+
+    /**
+      Print command line usage help for this program. Returns 1 which is
+      intended to be the main return code as well.
+    */
+    int print_help(std::ostream* out, char* program_name);
+
+    /**
+      Store an error or informational message about why the parse phase failed.
+      This will be shown to the user with additional help so they can correct
+      the input parameters.
+    */
+    std::string message;
+
+    /** IP address of the Shadow data service. */
+    std::string host = "127.0.0.1";
+
+    /** Port of the Shadow data service. */
+    std::string service = "32076";
+
+    /** Listen for clients on this port. */
+    unsigned short port = 32077;
+
+    /** Line ending for the help text and status output. */
+    std::string newline = "\n";
+};
+
+asio::awaitable<void> relay_stream(
+    command_line_options options, tcp::endpoint endpoint,
+    tcp::acceptor& acceptor)
+{
+    using namespace shadowmocap;
+
+    // Request every channel so clients can ask for any subset.
+    const auto mask = get_all_channel_mask();
+
+    auto upstream = co_await open_connection(endpoint);
+
+    co_await write_message(upstream, make_channel_message(mask));
+
+    relay relay(upstream, mask);
+
+    co_spawn(acceptor.get_executor(), relay.serve(acceptor), asio::detached);
+
+    std::cout << "Relay " << options.host << ":" << options.service
+              << " on port " << options.port << options.newline;
+
+    co_await relay.run();
+}
+
+bool relay_server(command_line_options options)
+{
+    try {
+        // All sessions share one thread so the relay needs no locks.
+        asio::io_context ctx(1);
+
+        auto endpoint =
+            *tcp::resolver(ctx).resolve(options.host, options.service);
+
+        tcp::acceptor acceptor{ctx, tcp::endpoint{tcp::v4(), options.port}};
+
+        co_spawn(
+            ctx,
+            relay_stream(std::move(options), std::move(endpoint), acceptor),
+            [](auto ptr) {
+                // Propagate exception from the coroutine
+                if (ptr) {
+                    std::rethrow_exception(ptr);
+                }
+            });
+
+        // Run until Ctrl+C.
+        asio::signal_set signals(ctx, SIGINT, SIGTERM);
+        signals.async_wait([&ctx](auto, auto) { ctx.stop(); });
+
+        ctx.run();
+
+        return true;
+    } catch (std::exception& e) {
+        std::cerr << e.what() << "\n";
+    }
+
+    return false;
+}
+
+int main(int argc, char* argv[])
+{
+    command_line_options options;
+    if (options.parse(argc, argv) != 0) {
+        return options.print_help(&std::cerr, *argv);
+    }
+
+    // Share one connection to the data service with many clients.
+    if (!relay_server(options)) {
+        return -1;
+    }
+
+    return 0;
+}
+
+int command_line_options::parse(int argc, char* argv[])
+{
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg(argv[i]);
+        if (arg == "--host") {
+            ++i;
+            if (i < argc) {
+                host = argv[i];
+            } else {
+                message = "Missing required argument for --host";
+                return -1;
+            }
+        } else if (arg == "--service") {
+            ++i;
+            if (i < argc) {
+                service = argv[i];
+            } else {
+                message = "Missing required argument for --service";
+                return -1;
+            }
+        } else if (arg == "--port") {
+            ++i;
+            if (i < argc) {
+                port = static_cast<unsigned short>(std::stoi(argv[i]));
+            } else {
+                message = "Missing required argument for --port";
+                return -1;
+            }
+        } else if (arg == "--help") {
+            return 1;
+        } else {
+            message = "Unrecognized option \"" + arg + "\"";
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+int command_line_options::print_help(std::ostream* out, char* program_name)
+{
+    if (!message.empty()) {
+        *out << message << newline << newline;
+    }
+
+    *out << "Usage: " << program_name << " [options...]" << newline << newline
+         << "Allowed options:" << newline
+         << "  --help         show help message" << newline
+         << "  --host arg     IP address of the data service" << newline
+         << "  --service arg  port of the data service" << newline
+         << "  --port N       listen for clients on port N" << newline
+         << newline;
+
+    return 1;
+}
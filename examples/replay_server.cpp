@@ -0,0 +1,177 @@
+#include <shadowmocap.hpp>
+
+#include <asio/co_spawn.hpp>
+#include <asio/detached.hpp>
+#include <asio/ip/tcp.hpp>
+#include <asio/signal_set.hpp>
+#include <asio/thread_pool.hpp>
+
+#include <csignal>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <thread>
+
+using shadowmocap::tcp;
+
+// Utility class to store all of the options to run our replay server.
+struct command_line_options {
+    /**
+      Read the command line tokens and load them into this state. Returns 0 if
+      successful, -1 if the command line options are invalid, or 1 if the help
+      message should be printed out.
+    */
+    int parse(int argc, char* argv[]);
+
+    /**
+      Print command line usage help for this program. Returns 1 which is
+      intended to be the main return code as well.
+    */
+    int print_help(std::ostream* out, char* program_name);
+
+    /**
+      Store an error or informational message about why the parse phase failed.
+      This will be shown to the user with additional help so they can correct
+      the input parameters.
+    */
+    std::string message;
+
+    /** Replay this capture file. */
+    std::string filename = "take.cap";
+
+    /** Listen on this port. */
+    unsigned short port = 32076;
+
+    /**
+      Playback speed. 1 is the original rate, 0 is as fast as the clients can
+      read.
+    */
+    double rate = 1;
+
+    /** Start over at the end of the capture. */
+    bool loop = false;
+
+    /** Number of threads to run client sessions on. */
+    unsigned threads = std::thread::hardware_concurrency();
+
+    /** Line ending for the help text and status output. */
+    std::string newline = "\n";
+};
+
+bool replay_capture(const command_line_options& options)
+{
+    using namespace shadowmocap;
+
+    try {
+        const capture_reader reader(options.filename);
+
+        asio::thread_pool pool(options.threads);
+
+        tcp::acceptor acceptor{pool, tcp::endpoint{tcp::v4(), options.port}};
+
+        replay_options replay;
+        replay.rate = options.rate;
+        replay.loop = options.loop;
+
+        co_spawn(pool, replay_server(acceptor, reader, replay), asio::detached);
+
+        // Run until Ctrl+C.
+        asio::signal_set signals(pool, SIGINT, SIGTERM);
+        signals.async_wait([&pool](auto, auto) { pool.stop(); });
+
+        std::cout << "Replay " << reader.num_frame() << " frames from \""
+                  << options.filename << "\" on port " << options.port
+                  << options.newline;
+
+        pool.join();
+
+        return true;
+    } catch (std::exception& e) {
+        std::cerr << e.what() << "\n";
+    }
+
+    return false;
+}
+
+int main(int argc, char* argv[])
+{
+    command_line_options options;
+    if (options.parse(argc, argv) != 0) {
+        return options.print_help(&std::cerr, *argv);
+    }
+
+    // Serve the capture file to clients as if it were a live data service.
+    if (!replay_capture(options)) {
+        return -1;
+    }
+
+    return 0;
+}
+
+int command_line_options::parse(int argc, char* argv[])
+{
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg(argv[i]);
+        if (arg == "--file") {
+            ++i;
+            if (i < argc) {
+                filename = argv[i];
+            } else {
+                message = "Missing required argument for --file";
+                return -1;
+            }
+        } else if (arg == "--port") {
+            ++i;
+            if (i < argc) {
+                port = static_cast<unsigned short>(std::stoi(argv[i]));
+            } else {
+                message = "Missing required argument for --port";
+                return -1;
+            }
+        } else if (arg == "--rate") {
+            ++i;
+            if (i < argc) {
+                rate = std::stod(argv[i]);
+            } else {
+                message = "Missing required argument for --rate";
+                return -1;
+            }
+        } else if (arg == "--threads") {
+            ++i;
+            if (i < argc) {
+                threads = static_cast<unsigned>(std::stoi(argv[i]));
+            } else {
+                message = "Missing required argument for --threads";
+                return -1;
+            }
+        } else if (arg == "--loop") {
+            loop = true;
+        } else if (arg == "--help") {
+            return 1;
+        } else {
+            message = "Unrecognized option \"" + arg + "\"";
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+int command_line_options::print_help(std::ostream* out, char* program_name)
+{
+    if (!message.empty()) {
+        *out << message << newline << newline;
+    }
+
+    *out << "Usage: " << program_name << " [options...]" << newline << newline
+         << "Allowed options:" << newline
+         << "  --help         show help message" << newline
+         << "  --file arg     capture file to replay" << newline
+         << "  --port N       listen on port N" << newline
+         << "  --rate X       playback speed, 0 for as fast as possible"
+         << newline << "  --loop         start over at the end" << newline
+         << "  --threads N    run client sessions on N threads" << newline
+         << newline;
+
+    return 1;
+}
@@ -6,7 +6,6 @@
 #include <asio/io_context.hpp>
 #include <asio/ip/tcp.hpp>
 #include <asio/stream_file.hpp>
-#include <asio/write.hpp>
 
 #include <chrono>
 #include <exception>
@@ -68,94 +67,33 @@ struct command_line_options {
 };
 
 asio::awaitable<void> read_shadowmocap_datastream_frames(
-    command_line_options options, shadowmocap::datastream stream,
-    std::chrono::steady_clock::time_point& deadline)
+    int frames, shadowmocap::datastream stream, shadowmocap::csv_formatter& csv,
+    asio::stream_file& file, std::chrono::steady_clock::time_point& deadline)
 {
     using namespace shadowmocap;
     using namespace std::chrono_literals;
 
-    constexpr auto ItemMask = channel::Lq | channel::c;
-    constexpr auto ItemSize = get_channel_mask_dimension(ItemMask);
-
-    asio::stream_file file(
-        co_await asio::this_coro::executor, options.filename,
-        asio::stream_file::write_only | asio::stream_file::create |
-            asio::stream_file::truncate);
-
-    std::ostringstream line;
-    line.setf(std::ios_base::fixed, std::ios_base::floatfield);
-    line.precision(3);
+    std::string buffer;
 
     int num_frames = 0;
     for (;;) {
-        extend_deadline_for(deadline, 1s);
-
-        auto message = co_await read_message(stream);
-
-        int column = 0;
-
-        if (options.header && !stream.names_.empty()) {
-            std::vector<std::string> channel_names;
-            channel_names.reserve(ItemSize);
-
-            for (auto c : {channel::Lq, channel::c}) {
-                // Something like "Lq" or "a"
-                const std::string prefix = get_channel_name(c);
-
-                // Expand with axes "w", "x", "y", and "z"
-                const auto dim = get_channel_dimension(c);
-                if (dim == 1) {
-                    channel_names.push_back(prefix);
-                } else {
-                    if (dim == 4) {
-                        channel_names.push_back(prefix + "w");
-                    }
-
-                    for (const auto& axis : {"x", "y", "z"}) {
-                        channel_names.push_back(prefix + axis);
-                    }
-                }
-            }
-
-            for (auto& name : stream.names_) {
-                for (auto& channel_name : channel_names) {
-                    if (column++ > 0) {
-                        line << options.separator;
-                    }
-
-                    // Something like "Hips.ax" or "LeftLeg.Lqw"
-                    line << name << "." << channel_name;
-                }
-            }
+        extend_deadline_for(stream, deadline, 1s);
 
-            line << options.newline;
-            column = 0;
+        auto message = co_await read_message(stream, buffer);
 
-            stream.names_.clear();
+        if (!stream.nodes_.empty()) {
+            csv.header(stream.nodes_);
+            stream.nodes_.clear();
         }
 
-        auto view = make_message_list<ItemSize>(message);
-        for (auto& item : view) {
-            for (auto& value : item.data) {
-                if (column++ > 0) {
-                    line << options.separator;
-                }
+        csv.row(message);
 
-                line << value;
-            }
+        if (csv.ready()) {
+            co_await write_rows(file, csv);
         }
 
-        line << options.newline;
-
-        // Capture this row as a string and reset for the next line.
-        auto str = line.str();
-        line.str("");
-
-        co_await asio::async_write(
-            file, asio::buffer(str), asio::use_awaitable);
-
         // Optionally stop after N frames of data.
-        if ((options.frames > 0) && (++num_frames >= options.frames)) {
+        if ((frames > 0) && (++num_frames >= frames)) {
             break;
         }
     }
@@ -168,21 +106,50 @@ asio::awaitable<void> read_shadowmocap_datastream(
     using namespace asio::experimental::awaitable_operators;
     using namespace std::chrono_literals;
 
+    constexpr auto ItemMask = channel::Lq | channel::c;
+
     auto stream = co_await open_connection(endpoint);
 
     // Request a list of channels for this data stream
     {
-        const auto xml = make_channel_message(channel::Lq | channel::c);
+        const auto xml = make_channel_message(ItemMask);
         co_await write_message(stream, xml);
     }
 
+    asio::stream_file file(
+        co_await asio::this_coro::executor, options.filename,
+        asio::stream_file::write_only | asio::stream_file::create |
+            asio::stream_file::truncate);
+
+    csv_options format;
+    format.separator = options.separator;
+    format.newline = options.newline;
+    format.header = options.header;
+
+    // Format rows into one reusable buffer and write many rows at a time.
+    csv_formatter csv(ItemMask, std::move(format));
+
     std::chrono::steady_clock::time_point deadline{};
     extend_deadline_for(deadline, 1s);
 
-    co_await (
-        read_shadowmocap_datastream_frames(
-            std::move(options), std::move(stream), deadline) ||
-        watchdog(deadline));
+    std::exception_ptr error;
+    try {
+        co_await (
+            read_shadowmocap_datastream_frames(
+                options.frames, std::move(stream), csv, file, deadline) ||
+            watchdog(deadline));
+    } catch (...) {
+        error = std::current_exception();
+    }
+
+    // Write the rows that are still buffered on every exit path. The stream
+    // usually ends with the watchdog or a socket error, not after N frames.
+    // If the watchdog cancelled a write part way, only the rest is left.
+    co_await write_rows(file, csv);
+
+    if (error) {
+        std::rethrow_exception(error);
+    }
 }
 
 bool stream_data_to_csv(command_line_options options)
@@ -1,6 +1,22 @@
 // Copyright Motion Workshop. All Rights Reserved.
 #pragma once
 
+#include <shadowmocap/batch_writer.hpp>
+#include <shadowmocap/capture.hpp>
 #include <shadowmocap/channel.hpp>
+#include <shadowmocap/columns.hpp>
+#include <shadowmocap/csv.hpp>
 #include <shadowmocap/datastream.hpp>
+#include <shadowmocap/frame_ring.hpp>
+#include <shadowmocap/jitter_buffer.hpp>
+#include <shadowmocap/math.hpp>
 #include <shadowmocap/message.hpp>
+#include <shadowmocap/metrics.hpp>
+#include <shadowmocap/relay.hpp>
+#include <shadowmocap/replay.hpp>
+#include <shadowmocap/resilient_stream.hpp>
+#include <shadowmocap/soa.hpp>
+#include <shadowmocap/stream_group.hpp>
+#include <shadowmocap/subset.hpp>
+#include <shadowmocap/synchronizer.hpp>
+#include <shadowmocap/triple_buffer.hpp>
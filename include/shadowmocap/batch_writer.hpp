@@ -0,0 +1,145 @@
+// Copyright Motion Workshop. All Rights Reserved.
+#pragma once
+
+#include <shadowmocap/datastream.hpp>
+
+#include <asio/awaitable.hpp>
+#include <asio/buffer.hpp>
+#include <asio/steady_timer.hpp>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace shadowmocap {
+
+/// Binary message with its length header, ready to send. Shared by many
+/// writers so a frame is encoded once and sent to every client without a
+/// copy.
+using shared_message = std::shared_ptr<const std::string>;
+
+/**
+ * Copy a message and its length header into one shared buffer.
+ *
+ * @throw std::length_error if the message length is not valid
+ */
+shared_message make_shared_message(std::string_view message);
+
+struct batch_options {
+    /// Start a write once this many bytes are queued.
+    std::size_t flush_size = 1 << 16;
+
+    /// Start a write this long after the first message is queued, even if
+    /// there are fewer than flush_size bytes. Zero writes as soon as the
+    /// previous write is done, so only messages queued while a write is in
+    /// flight are batched.
+    std::chrono::microseconds flush_interval{0};
+};
+
+/// Queue messages for one socket and send them with as few writes as
+/// possible.
+/**
+ * Every write is one gathered async_write of all queued messages. Copied
+ * messages share one buffer with their headers so a batch of them is a
+ * single buffer. Shared messages are referenced, not copied. Messages queued
+ * while a write is in flight go in the next one. Not thread safe, use from
+ * one strand.
+ *
+ * @code
+ * std::vector<std::unique_ptr<batch_writer>> clients;
+ * for (auto& client : clients) {
+ *     co_spawn(executor, client->run(), detached);
+ * }
+ *
+ * for (;;) {
+ *     auto frame = make_shared_message(co_await read_message(stream, buffer));
+ *     for (auto& client : clients) {
+ *         client->write(frame);
+ *     }
+ * }
+ * @endcode
+ */
+class batch_writer {
+public:
+    using clock_type = std::chrono::steady_clock;
+
+    /**
+     * @param socket Must outlive the writer
+     */
+    explicit batch_writer(tcp::socket& socket, batch_options options = {});
+
+    /**
+     * Queue a copy of a message with its length header.
+     *
+     * @throw std::length_error if the message length is not valid
+     */
+    void write(std::string_view message);
+
+    /// Queue a shared message without a copy.
+    void write(shared_message message);
+
+    /// Write everything queued so far. Waits for a write in flight first.
+    /**
+     * @throw std::system_error if the write failed
+     */
+    asio::awaitable<void> flush();
+
+    /// Write queued messages whenever the size or time threshold is reached.
+    /// Returns after close() once the queue is empty.
+    /**
+     * @throw std::system_error if a write failed
+     */
+    asio::awaitable<void> run();
+
+    /// Stop run() once everything queued so far is written.
+    void close();
+
+    /// Number of bytes queued and not yet written.
+    std::size_t size() const
+    {
+        return size_;
+    }
+
+    /// Number of gathered writes so far.
+    std::uint64_t num_write() const
+    {
+        return num_write_;
+    }
+
+private:
+    // Range of the copy buffer, or a shared message if set.
+    struct entry {
+        shared_message message;
+        std::size_t offset{};
+        std::size_t size{};
+    };
+
+    tcp::socket& socket_;
+    batch_options options_;
+
+    // Queued messages.
+    std::string data_;
+    std::vector<entry> entries_;
+    std::size_t size_{};
+    clock_type::time_point first_;
+
+    // Messages of the write in flight.
+    std::string write_data_;
+    std::vector<entry> write_entries_;
+    std::vector<asio::const_buffer> buffers_;
+
+    // Wake run() when there is something to write, and flush() when the
+    // write in flight is done.
+    asio::steady_timer wake_;
+    asio::steady_timer idle_;
+    bool writing_{};
+    bool closed_{};
+
+    std::uint64_t num_write_{};
+};
+
+} // namespace shadowmocap
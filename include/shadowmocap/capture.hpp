@@ -0,0 +1,484 @@
+// Copyright Motion Workshop. All Rights Reserved.
+#pragma once
+
+#include <shadowmocap/datastream.hpp>
+
+#include <asio/any_io_executor.hpp>
+#include <asio/awaitable.hpp>
+#include <asio/steady_timer.hpp>
+
+// File support needs io_uring on Linux, see the ENABLE_IO_URING option.
+#if defined(ASIO_HAS_FILE)
+#include <asio/stream_file.hpp>
+#endif
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <iterator>
+#include <memory>
+#include <ranges>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace shadowmocap {
+
+/*
+ * Binary capture file of a data stream session. All integers are little
+ * endian.
+ *
+ *   capture_header
+ *   chunk 0: capture_record_header, payload, capture_record_header, ...
+ *   chunk 1: ...
+ *   capture_chunk[num_chunk]
+ *   capture_metadata[num_metadata]
+ *   capture_footer
+ *
+ * Each record stores one message exactly as it came off the socket, without
+ * the length prefix, and its receive time. The index after the last chunk
+ * locates every chunk and metadata record so a reader can seek by frame
+ * number or time without a scan.
+ */
+
+/// Magic bytes at the start and end of every capture file.
+constexpr char kCaptureMagic[8] = {'S', 'H', 'D', 'W', 'C', 'A', 'P', 0};
+
+/// Incremented for any change to the file layout.
+constexpr std::uint32_t kCaptureVersion = 1;
+
+/// Default target size in bytes of one chunk.
+constexpr std::size_t kCaptureChunkSize = 1 << 20;
+
+enum class capture_record_type : std::uint32_t {
+    /// Channel request XML sent to the server, from make_channel_message.
+    channel_request = 1,
+
+    /// Metadata XML that defines the node list for the frames that follow.
+    metadata = 2,
+
+    /// Binary frame message.
+    frame = 3
+};
+
+struct capture_header {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t reserved;
+
+    /// Wall clock time of the start of the capture, nanoseconds since the
+    /// Unix epoch.
+    std::int64_t start_time;
+};
+
+struct capture_record_header {
+    capture_record_type type;
+
+    /// Number of payload bytes that follow this header.
+    std::uint32_t length;
+
+    /// Monotonic receive time, nanoseconds since the start of the capture.
+    std::int64_t time;
+};
+
+struct capture_chunk {
+    /// File offset of the first record.
+    std::uint64_t offset;
+
+    /// Number of bytes of records.
+    std::uint64_t size;
+
+    /// Frame number of the first frame record, counting from zero.
+    std::uint64_t first_frame;
+
+    /// Number of frame records.
+    std::uint64_t num_frame;
+
+    /// Time of the first frame record, or the first record if there are no
+    /// frames.
+    std::int64_t first_time;
+};
+
+struct capture_metadata {
+    /// File offset of the metadata record.
+    std::uint64_t offset;
+
+    /// Number of the first frame that uses this metadata.
+    std::uint64_t frame;
+};
+
+struct capture_footer {
+    /// File offset of the capture_chunk array.
+    std::uint64_t chunk_offset;
+    std::uint64_t num_chunk;
+
+    /// File offset of the capture_metadata array.
+    std::uint64_t metadata_offset;
+    std::uint64_t num_metadata;
+
+    std::uint64_t num_frame;
+
+    /// File offset of the most recent channel request record, or zero if
+    /// there is none.
+    std::uint64_t channel_request_offset;
+
+    char magic[8];
+};
+
+static_assert(sizeof(capture_header) == 24);
+static_assert(sizeof(capture_record_header) == 16);
+static_assert(sizeof(capture_chunk) == 40);
+static_assert(sizeof(capture_metadata) == 16);
+static_assert(sizeof(capture_footer) == 56);
+
+/// Build the bytes of a capture file in memory, one chunk at a time.
+/**
+ * Records are appended to the open chunk. Once the chunk reaches the target
+ * size it is sealed and moved to the list of blocks ready to write. The
+ * caller writes blocks in order with as few writes as it likes. Does no I/O
+ * itself so it works with any file or socket type.
+ *
+ * @code
+ * capture_encoder encoder;
+ * encoder.channel_request(make_channel_message(mask), now);
+ * encoder.frame(message, now);
+ * encoder.finish();
+ *
+ * for (auto& block : encoder.take()) {
+ *     out.write(block.data(), block.size());
+ * }
+ * @endcode
+ */
+class capture_encoder {
+public:
+    using clock_type = std::chrono::steady_clock;
+
+    explicit capture_encoder(
+        std::size_t chunk_size = kCaptureChunkSize,
+        clock_type::time_point start = clock_type::now());
+
+    void channel_request(std::string_view xml, clock_type::time_point time);
+
+    void metadata(std::string_view xml, clock_type::time_point time);
+
+    void frame(std::string_view message, clock_type::time_point time);
+
+    /// Seal the open chunk and append the index and footer. No more records
+    /// may be added.
+    void finish();
+
+    /// True if there are blocks ready to write.
+    bool ready() const
+    {
+        return !blocks_.empty();
+    }
+
+    /// Move out all blocks ready to write, oldest first.
+    std::vector<std::string> take();
+
+    /// Number of frame records so far.
+    std::uint64_t num_frame() const
+    {
+        return num_frame_;
+    }
+
+private:
+    void append(
+        capture_record_type type, std::string_view payload,
+        clock_type::time_point time);
+
+    void seal();
+
+    std::size_t chunk_size_;
+    clock_type::time_point start_;
+
+    // Sealed blocks not yet taken by the caller.
+    std::vector<std::string> blocks_;
+
+    // Open chunk and its index entry.
+    std::string chunk_;
+    capture_chunk entry_{};
+
+    // Number of bytes in all blocks so far, i.e. the file offset of the open
+    // chunk.
+    std::uint64_t offset_{};
+
+    std::uint64_t num_frame_{};
+    std::uint64_t channel_request_offset_{};
+
+    std::vector<capture_chunk> chunks_;
+    std::vector<capture_metadata> metadata_;
+
+    bool finished_{};
+};
+
+/// One frame record from a capture file.
+struct capture_frame {
+    /// Frame number, counting from zero.
+    std::uint64_t index{};
+
+    /// Receive time, nanoseconds since the start of the capture.
+    std::int64_t time{};
+
+    /// Binary message. Pass to make_message_view or make_message_list.
+    std::string_view message;
+
+    /// Metadata XML that defines the node list for this frame.
+    std::string_view metadata;
+
+    /// True if the metadata changed since the previous frame, or this is the
+    /// first frame of an iteration.
+    bool metadata_changed{};
+};
+
+class capture_reader;
+
+/// Forward iterator over the frame records of a capture_reader. Returns
+/// frames by value.
+class capture_iterator {
+public:
+    // Frames are returned by value so this is not a legacy forward
+    // iterator. It does satisfy std::forward_iterator.
+    using iterator_concept = std::forward_iterator_tag;
+    using iterator_category = std::input_iterator_tag;
+    using value_type = capture_frame;
+    using difference_type = std::ptrdiff_t;
+
+    capture_iterator() = default;
+
+    value_type operator*() const
+    {
+        return frame_;
+    }
+
+    capture_iterator& operator++()
+    {
+        frame_.metadata_changed = false;
+        ++frame_.index;
+        next();
+        return *this;
+    }
+
+    capture_iterator operator++(int)
+    {
+        auto result = *this;
+        ++*this;
+        return result;
+    }
+
+    bool operator==(const capture_iterator& rhs) const
+    {
+        return offset_ == rhs.offset_;
+    }
+
+private:
+    friend class capture_reader;
+
+    capture_iterator(
+        const capture_reader* reader, std::uint64_t offset,
+        std::uint64_t index, std::string_view metadata);
+
+    // Move to the first frame record at or after next_.
+    void next();
+
+    const capture_reader* reader_{};
+
+    // Offset of the current frame record, and of the record after it.
+    std::uint64_t offset_{};
+    std::uint64_t next_{};
+
+    capture_frame frame_{};
+};
+
+/// Read a capture file with random access by frame number or time.
+/**
+ * Maps the whole file into memory. Frames are views into the mapping so
+ * there is no copy. Seek does a binary search of the chunk index and then
+ * scans at most one chunk. The reader is read only, so any number of threads
+ * or processes may map the same file and each iterate a different range.
+ *
+ * @code
+ * capture_reader reader("take.cap");
+ * for (const auto frame : reader.range(first, last)) {
+ *     if (frame.metadata_changed) {
+ *         nodes = node_map{parse_metadata_nodes(frame.metadata)};
+ *     }
+ *
+ *     for (auto item : make_message_view<8>(frame.message)) {
+ *         ...
+ *     }
+ * }
+ * @endcode
+ */
+class capture_reader {
+public:
+    using iterator = capture_iterator;
+    using range_type = std::ranges::subrange<iterator>;
+
+    /**
+     * @throw std::system_error if the file cannot be opened or mapped
+     * @throw std::runtime_error if the file is not a valid capture
+     */
+    explicit capture_reader(const std::string& path);
+
+    ~capture_reader();
+
+    capture_reader(capture_reader&& other) noexcept;
+    capture_reader& operator=(capture_reader&& other) noexcept;
+
+    capture_reader(const capture_reader&) = delete;
+    capture_reader& operator=(const capture_reader&) = delete;
+
+    std::uint64_t num_frame() const
+    {
+        return footer_.num_frame;
+    }
+
+    /// Wall clock start time, nanoseconds since the Unix epoch.
+    std::int64_t start_time() const;
+
+    /// Channel request XML, or empty if the capture does not have one.
+    std::string_view channel_request() const;
+
+    /// Metadata XML for a frame, or empty if there is none.
+    std::string_view metadata(std::uint64_t frame) const;
+
+    iterator begin() const;
+
+    iterator end() const;
+
+    /// First frame with this number, or end() if out of range.
+    iterator seek(std::uint64_t frame) const;
+
+    /// First frame received at or after this many nanoseconds since the
+    /// start of the capture, or end() if there is none.
+    iterator seek_time(std::int64_t time) const;
+
+    /// Frames in [first, last). Use disjoint ranges to split the capture
+    /// between parallel workers.
+    range_type range(std::uint64_t first, std::uint64_t last) const;
+
+private:
+    capture_chunk chunk(std::uint64_t i) const;
+
+    capture_metadata metadata_entry(std::uint64_t i) const;
+
+    capture_record_header record(std::uint64_t offset) const;
+
+    // Payload of the record at offset.
+    std::string_view payload(std::uint64_t offset) const;
+
+    // Scan from the start of a chunk.
+    iterator chunk_begin(std::uint64_t i) const;
+
+    friend class capture_iterator;
+
+    const char* data_{};
+    std::size_t size_{};
+    capture_footer footer_{};
+};
+
+#if defined(ASIO_HAS_FILE)
+
+/// Record a data stream session to a capture file.
+/**
+ * Records are buffered in memory by a capture_encoder. When a chunk is sealed
+ * a background write of all ready chunks starts, batched into one gathered
+ * asynchronous write. The caller keeps reading from the network while the
+ * write is in flight. Not thread safe, use from one strand.
+ *
+ * Call close() on every path, including after a read error, so the file gets
+ * its index and footer. Destroying the writer without close() abandons the
+ * capture. The background write is cancelled and capture_reader rejects the
+ * file.
+ *
+ * @code
+ * capture_writer writer(executor, "take.cap");
+ * writer.channel_request(make_channel_message(mask));
+ *
+ * try {
+ *     // Returns when the server ends the stream.
+ *     co_await record_frames(stream, writer);
+ * } catch (const std::exception&) {
+ *     // Lost the connection. Keep what we have.
+ * }
+ *
+ * co_await writer.close();
+ * @endcode
+ */
+class capture_writer {
+public:
+    using clock_type = capture_encoder::clock_type;
+
+    capture_writer(
+        asio::any_io_executor executor, const std::string& path,
+        std::size_t chunk_size = kCaptureChunkSize);
+
+    ~capture_writer();
+
+    capture_writer(const capture_writer&) = delete;
+    capture_writer& operator=(const capture_writer&) = delete;
+
+    /// Append a record. The record methods rethrow the error of a failed
+    /// background write.
+    void channel_request(
+        std::string_view xml, clock_type::time_point time = clock_type::now());
+
+    void metadata(
+        std::string_view xml, clock_type::time_point time = clock_type::now());
+
+    void frame(
+        std::string_view message,
+        clock_type::time_point time = clock_type::now());
+
+    /// Write all records, the index, and the footer and then close the file.
+    /**
+     * @throw asio::system_error if any write failed
+     */
+    asio::awaitable<void> close();
+
+    std::uint64_t num_frame() const
+    {
+        return state_->encoder.num_frame();
+    }
+
+private:
+    // Shared with the background write so it can outlive the writer.
+    struct state {
+        state(
+            const asio::any_io_executor& executor, const std::string& path,
+            std::size_t chunk_size);
+
+        asio::stream_file file;
+        capture_encoder encoder;
+
+        // Armed while a write is in flight. Signals close() when it is done.
+        asio::steady_timer idle;
+        bool writing{};
+        std::exception_ptr error;
+    };
+
+    void check_error() const;
+
+    void start_write();
+
+    static asio::awaitable<void> write_blocks(std::shared_ptr<state> ptr);
+
+    std::shared_ptr<state> state_;
+};
+
+/// Read messages from the stream and record each one, including metadata,
+/// with its receive time. Updates the node list and metrics of the stream
+/// the same way as read_message(datastream&).
+/**
+ * Returns when the other end closes the stream. Call capture_writer::close()
+ * afterwards to finish the file.
+ *
+ * @throw asio::system_error for any other socket error
+ */
+asio::awaitable<void> record_frames(datastream& stream, capture_writer& writer);
+
+#endif // ASIO_HAS_FILE
+
+} // namespace shadowmocap
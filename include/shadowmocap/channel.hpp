@@ -1,6 +1,7 @@
 // Copyright Motion Workshop. All Rights Reserved.
 #pragma once
 
+#include <bit>
 #include <initializer_list>
 #include <iterator>
 #include <type_traits>
@@ -225,24 +226,73 @@ constexpr const char* get_channel_name(channel c)
     }
 }
 
+/// Get the bit index of a channel, i.e. the index into per channel tables.
+/**
+ * get_channel_index(channel::Gq) -> 0
+ * get_channel_index(channel::Lq) -> 2
+ */
+constexpr int get_channel_index(channel c)
+{
+    return std::countr_zero(static_cast<unsigned>(c));
+}
+
+/// Get the bitmask of all channels with this many scalar values.
+/**
+ * get_channel_dimension_mask(4) -> Gq | Gdq | Lq | c | p | Bq
+ */
+constexpr int get_channel_dimension_mask(int dimension)
+{
+    int result = 0;
+    for (auto c : kChannelList) {
+        if (get_channel_dimension(c) == dimension) {
+            result |= c;
+        }
+    }
+
+    return result;
+}
+
 /// Get the total number of all scalar values in a bitmask of channels
 /**
  * Lq is a 4-vector, la is a 3-vector
  * Concatenate Lq and la to get (Lqw, Lqx, Lqy, Lqz, lax, lay, laz)
  *
  * get_channel_mask_dimension(channel::Lq | channel::la) -> 7
+ *
+ * Every channel is a 1, 3, or 4-vector so this is a popcount weighted sum
+ * of three constant masks rather than a loop over the channel list.
  */
 constexpr int get_channel_mask_dimension(int mask)
 {
-    int result = 0;
+    constexpr unsigned kMask1 = get_channel_dimension_mask(1);
+    constexpr unsigned kMask3 = get_channel_dimension_mask(3);
+    constexpr unsigned kMask4 = get_channel_dimension_mask(4);
 
-    for (auto c : kChannelList) {
-        if (mask & c) {
-            result += get_channel_dimension(c);
-        }
+    static_assert((kMask1 | kMask3 | kMask4) == kAllChannelMask);
+
+    const auto bits = static_cast<unsigned>(mask);
+
+    return std::popcount(bits & kMask1) + 3 * std::popcount(bits & kMask3) +
+           4 * std::popcount(bits & kMask4);
+}
+
+/// Get the index of the first scalar value of a channel in an item with a
+/// bitmask of channels.
+/**
+ * Channels are sorted by enumeration value so the offset is the dimension of
+ * all of the channels in the mask that come before this one.
+ *
+ * get_channel_offset(channel::Lq | channel::c, channel::c) -> 4
+ *
+ * @return -1 if the channel is not in the mask
+ */
+constexpr int get_channel_offset(int mask, channel c)
+{
+    if (!(mask & c)) {
+        return -1;
     }
 
-    return result;
+    return get_channel_mask_dimension(mask & (static_cast<int>(c) - 1));
 }
 
 /// Get the bitmask that activates all possible channels.
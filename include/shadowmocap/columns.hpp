@@ -0,0 +1,298 @@
+// Copyright Motion Workshop. All Rights Reserved.
+#pragma once
+
+#include <shadowmocap/capture.hpp>
+#include <shadowmocap/message.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace shadowmocap {
+
+/*
+ * Columnar export of a session. One float column per axis per channel per
+ * node, named like the stream_to_csv header, i.e. "Hips.Lqw", plus a time
+ * column. Rows are grouped so a reader can load one column of one row group
+ * without touching the rest. All integers are little endian.
+ *
+ *   column_file_header
+ *   row group 0: time chunk, column 0 chunk, column 1 chunk, ...
+ *   row group 1: ...
+ *   column names: uint16 length and bytes, one per column
+ *   column_row_group[num_row_group], each followed by
+ *     column_chunk[num_column]
+ *   column_file_footer
+ *
+ * Float chunks use XOR compression by default. Each value is XORed with the
+ * previous one and only the changed bits are stored. This is lossless and
+ * works best on values that repeat or change in a few bits. Set a precision
+ * to round values to a fixed number of decimal digits, like the CSV export,
+ * and store the deltas as variable length integers instead. Slowly varying
+ * quaternion and position data then takes about one byte per value. The time
+ * chunk stores delta of delta variable length integers.
+ */
+
+/// Magic bytes at the start and end of every column file.
+constexpr char kColumnMagic[8] = {'S', 'H', 'D', 'W', 'C', 'O', 'L', 0};
+
+/// Incremented for any change to the file layout.
+constexpr std::uint32_t kColumnVersion = 1;
+
+enum class column_encoding : std::uint32_t {
+    /// Little endian 32-bit floats.
+    raw = 0,
+
+    /// XOR with the previous value, bit packed.
+    xor_float = 1,
+
+    /// Rounded to column_chunk::precision decimal digits. Difference from
+    /// the previous value as zig zag variable length integers, zero for NaN.
+    delta_int = 2
+};
+
+struct column_file_header {
+    char magic[8];
+    std::uint32_t version;
+
+    /// Channel mask of the source messages.
+    std::uint32_t mask;
+};
+
+struct column_row_group {
+    std::uint64_t num_row;
+
+    /// File offset and size of the time chunk.
+    std::uint64_t time_offset;
+    std::uint64_t time_size;
+};
+
+/// Location and statistics of one column in one row group.
+struct column_chunk {
+    std::uint64_t offset;
+    std::uint32_t size;
+    column_encoding encoding;
+
+    /// Smallest and largest value, ignoring NaN.
+    float min;
+    float max;
+
+    /// Number of NaN values, i.e. rows where the node was missing.
+    std::uint32_t num_nan;
+
+    /// Number of decimal digits kept by the delta_int encoding.
+    std::uint32_t precision;
+};
+
+struct column_file_footer {
+    /// File offset of the column names.
+    std::uint64_t names_offset;
+    std::uint64_t num_column;
+
+    /// File offset of the row group index.
+    std::uint64_t row_group_offset;
+    std::uint64_t num_row_group;
+
+    std::uint64_t num_row;
+
+    char magic[8];
+};
+
+static_assert(sizeof(column_file_header) == 16);
+static_assert(sizeof(column_row_group) == 24);
+static_assert(sizeof(column_chunk) == 32);
+static_assert(sizeof(column_file_footer) == 48);
+
+struct column_options {
+    /// Number of rows in one row group.
+    std::size_t row_group_size = 4096;
+
+    /// Number of digits after the decimal point to keep. Negative keeps every
+    /// bit of the original floats.
+    int precision = -1;
+};
+
+/// Build the bytes of a column file in memory, one row group at a time.
+/**
+ * Columns are fixed by the node list and channel mask at construction. Items
+ * of nodes that are not in the list are ignored and nodes that are missing
+ * from a frame are NaN. Same block interface as capture_encoder, write the
+ * blocks in order.
+ *
+ * @code
+ * column_encoder columns(mask, stream.nodes_);
+ * for (;;) {
+ *     columns.frame(co_await read_message(stream, buffer), time);
+ *     for (auto& block : columns.take()) {
+ *         ...
+ *     }
+ * }
+ * @endcode
+ */
+class column_encoder {
+public:
+    column_encoder(
+        int mask, const node_map& nodes, column_options options = {});
+
+    /// Decode a message and append it as one row.
+    /**
+     * @param time Receive time of the frame, i.e. nanoseconds since the start
+     * of the session
+     *
+     * @return @c false if the message does not match the channel mask. No
+     * row is appended.
+     */
+    bool frame(std::string_view message, std::int64_t time);
+
+    /// Seal the open row group and append the index and footer. No more rows
+    /// may be added.
+    void finish();
+
+    /// True if there are blocks ready to write.
+    bool ready() const
+    {
+        return !blocks_.empty();
+    }
+
+    /// Move out all blocks ready to write, oldest first.
+    std::vector<std::string> take();
+
+    /// Column names, e.g. "Hips.Lqw".
+    const std::vector<std::string>& names() const
+    {
+        return names_;
+    }
+
+    std::uint64_t num_row() const
+    {
+        return num_row_;
+    }
+
+private:
+    void seal();
+
+    message_layout layout_;
+    node_map nodes_;
+    std::size_t row_group_size_;
+    int precision_;
+
+    // Values of one item, layout_.dimension() floats.
+    std::vector<float> item_;
+
+    std::vector<std::string> names_;
+
+    // Rows of the open row group, column major.
+    std::vector<float> values_;
+    std::vector<std::int64_t> times_;
+    std::size_t num_group_row_{};
+
+    std::vector<std::string> blocks_;
+    std::uint64_t offset_{};
+    std::uint64_t num_row_{};
+
+    // Row group index entries, num_column chunks after each row group.
+    std::string index_;
+    std::uint64_t num_row_group_{};
+
+    bool finished_{};
+};
+
+/// Convert a capture to a column file. Uses the metadata of the first frame
+/// for the node list.
+/**
+ * The columns are fixed by the first node list, so a capture that changes
+ * the names or keys of its nodes part way through is not supported.
+ *
+ * @throw std::invalid_argument if the node list changes in the capture, the
+ * file is incomplete
+ * @throw std::runtime_error if the file cannot be written
+ */
+void export_columns(
+    const capture_reader& reader, int mask, const std::string& path,
+    column_options options = {});
+
+/// Read one column at a time from the bytes of a column file.
+/**
+ * Only the footer and index are read up front. Each column chunk is decoded
+ * on request, e.g. from a file mapped into memory.
+ *
+ * @code
+ * column_reader columns(bytes);
+ * const auto index = columns.find("Hips.Lqw");
+ * std::vector<float> w(columns.num_row());
+ * columns.read(index, w);
+ * @endcode
+ */
+class column_reader {
+public:
+    /**
+     * @param data All bytes of the file. Must outlive the reader.
+     *
+     * @throw std::runtime_error if the data is not a valid column file
+     */
+    explicit column_reader(std::string_view data);
+
+    int mask() const
+    {
+        return mask_;
+    }
+
+    std::uint64_t num_row() const
+    {
+        return footer_.num_row;
+    }
+
+    std::size_t num_row_group() const
+    {
+        return static_cast<std::size_t>(footer_.num_row_group);
+    }
+
+    const std::vector<std::string>& names() const
+    {
+        return names_;
+    }
+
+    /// Index of the column with this name or -1 if there is no such column.
+    int find(std::string_view name) const;
+
+    /// Number of rows in one row group.
+    std::uint64_t num_row(std::size_t row_group) const;
+
+    /// Location and statistics of one column in one row group.
+    column_chunk chunk(std::size_t column, std::size_t row_group) const;
+
+    /// Decode one column of one row group.
+    /**
+     * @param out Must hold at least num_row(row_group) values
+     *
+     * @return Number of values
+     */
+    std::size_t
+    read(std::size_t column, std::size_t row_group, std::span<float> out) const;
+
+    /// Decode all rows of one column.
+    /**
+     * @param out Must hold at least num_row() values
+     */
+    std::size_t read(std::size_t column, std::span<float> out) const;
+
+    /// Decode the time column of one row group.
+    std::size_t
+    read_time(std::size_t row_group, std::span<std::int64_t> out) const;
+
+private:
+    column_row_group row_group(std::size_t i) const;
+
+    std::string_view data_;
+    int mask_{};
+    column_file_footer footer_{};
+    std::vector<std::string> names_;
+
+    // File offset of the index entry of every row group.
+    std::vector<std::uint64_t> row_group_offset_;
+};
+
+} // namespace shadowmocap
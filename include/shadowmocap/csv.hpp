@@ -0,0 +1,153 @@
+// Copyright Motion Workshop. All Rights Reserved.
+#pragma once
+
+#include <shadowmocap/message.hpp>
+
+#include <asio/awaitable.hpp>
+#include <asio/buffer.hpp>
+#include <asio/redirect_error.hpp>
+#include <asio/system_error.hpp>
+#include <asio/use_awaitable.hpp>
+#include <asio/write.hpp>
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace shadowmocap {
+
+/// Column name suffixes for every axis of every channel in a mask, in the
+/// same order as the item data, e.g. {"Lqw", "Lqx", "Lqy", "Lqz", "cw", ...}.
+/// Prefix with the node name to get the full column name, i.e. "Hips.Lqw".
+std::vector<std::string> get_channel_column_names(int mask);
+
+struct csv_options {
+    /// Print this string in between every column.
+    std::string separator = ",";
+
+    /// Print this string in between every row.
+    std::string newline = "\n";
+
+    /// Print channel names in the first row.
+    bool header = true;
+
+    /// Number of digits after the decimal point.
+    int precision = 3;
+
+    /// Target number of bytes of rows to format before a write.
+    std::size_t batch_size = 1 << 16;
+};
+
+/// Format binary messages as rows of delimited text, e.g. CSV or TSV.
+/**
+ * Rows are appended to one buffer that is reused for the whole export.
+ * Values are formatted with std::to_chars in fixed notation so there is no
+ * locale or stream state. Write the buffer once it is ready() to batch many
+ * rows per write.
+ *
+ * @code
+ * csv_formatter csv(channel::Lq | channel::c);
+ * csv.header(stream.nodes_);
+ * for (;;) {
+ *     csv.row(co_await read_message(stream, buffer));
+ *     if (csv.ready()) {
+ *         co_await write_rows(file, csv);
+ *     }
+ * }
+ * @endcode
+ */
+class csv_formatter {
+public:
+    explicit csv_formatter(int mask, csv_options options = {});
+
+    /// Append a row of column names, one per channel axis per node, e.g.
+    /// "Hips.Lqw". Does nothing if the header option is off.
+    void header(const node_map& nodes);
+
+    /// Append one row with every value of every item in a message.
+    /**
+     * @return @c false if the message does not match the channel mask. No
+     * row is appended.
+     */
+    bool row(std::string_view message);
+
+    /// True if the rows are at least the batch size.
+    bool ready() const
+    {
+        return size_ >= options_.batch_size;
+    }
+
+    /// Formatted rows waiting to be written.
+    std::string_view data() const
+    {
+        return {buffer_.data(), size_};
+    }
+
+    std::size_t size() const
+    {
+        return size_;
+    }
+
+    /// Discard the rows after a write. Keeps the buffer capacity.
+    void clear()
+    {
+        size_ = 0;
+    }
+
+    /// Discard the first n bytes after a partial write. Keeps the rest for
+    /// the next write.
+    void consume(std::size_t n);
+
+    const message_layout& layout() const
+    {
+        return layout_;
+    }
+
+private:
+    // Make room for at least n more bytes and return the write position.
+    char* reserve(std::size_t n);
+
+    void append(std::string_view str);
+
+    message_layout layout_;
+    csv_options options_;
+
+    // Column name suffixes, i.e. "Lqw", "Lqx", ...
+    std::vector<std::string> columns_;
+
+    // Only the first size_ bytes are valid. Grows but never shrinks so the
+    // formatting loop can write without a bounds check per value.
+    std::string buffer_;
+    std::size_t size_{};
+
+    std::vector<float> values_;
+};
+
+/// Write all formatted rows to a stream or file and clear the formatter.
+/**
+ * If the write fails or is cancelled part way, only the bytes that were
+ * written are cleared. Call again to write the rest.
+ *
+ * @throw asio::system_error if the write fails
+ */
+template <typename AsyncWriteStream>
+asio::awaitable<void> write_rows(AsyncWriteStream& out, csv_formatter& csv)
+{
+    if (csv.size() == 0) {
+        co_return;
+    }
+
+    asio::error_code ec;
+    const auto n = co_await asio::async_write(
+        out, asio::buffer(csv.data()),
+        asio::redirect_error(asio::use_awaitable, ec));
+
+    csv.consume(n);
+
+    if (ec) {
+        throw asio::system_error(ec);
+    }
+}
+
+} // namespace shadowmocap
@@ -2,13 +2,17 @@
 #pragma once
 
 #include <shadowmocap/message.hpp>
+#include <shadowmocap/metrics.hpp>
 
 #include <asio/awaitable.hpp>
+#include <asio/buffer.hpp>
 #include <asio/ip/tcp.hpp>
 #include <asio/use_awaitable.hpp>
 
 #include <algorithm>
+#include <array>
 #include <chrono>
+#include <cstddef>
 #include <string>
 #include <string_view>
 #include <vector>
@@ -17,9 +21,67 @@ namespace shadowmocap {
 
 using tcp = asio::ip::tcp;
 
+/**
+ * Buffered framing of length prefixed messages. Read as many bytes as the
+ * socket has available in one call and then hand out every complete message
+ * that is already in the buffer without another read.
+ *
+ * @code
+ * for (;;) {
+ *     auto message = reader.next();
+ *     if (!message.empty()) {
+ *         return message;
+ *     }
+ *
+ *     reader.commit(socket.read_some(reader.prepare()));
+ * }
+ * @endcode
+ */
+class message_reader {
+public:
+    message_reader();
+
+    /**
+     * Return the next complete message in the buffer. Returns an empty view if
+     * more bytes are needed. The view is valid until the next call to
+     * prepare().
+     *
+     * @throw std::length_error if the message length header is not valid
+     */
+    std::string_view next();
+
+    /**
+     * Get the free space at the end of the buffer to read into. May move a
+     * partial message to the front of the buffer.
+     */
+    asio::mutable_buffer prepare();
+
+    /**
+     * Mark @c n bytes at the front of the buffer returned by prepare() as
+     * received.
+     */
+    void commit(std::size_t n);
+
+    /// Number of received bytes not yet returned by next().
+    std::size_t size() const;
+
+private:
+    std::vector<char> buffer_;
+    std::size_t first_ = 0;
+    std::size_t last_ = 0;
+};
+
 struct datastream {
     tcp::socket socket_;
-    std::vector<std::string> names_;
+
+    /// Nodes from the most recent metadata message. Maps the key of each
+    /// measurement item to its node name.
+    node_map nodes_;
+
+    message_reader reader_;
+
+    /// Record counters and timings of the read path if set. Not owned.
+    stream_metrics* metrics_ = nullptr;
 };
 
 /**
@@ -27,13 +89,68 @@ struct datastream {
  */
 asio::awaitable<std::string> read_message(tcp::socket& socket);
 
+/**
+ * Read a binary message with its length header from the stream into a caller
+ * owned buffer. The buffer is resized to the message length and keeps its
+ * capacity between calls so there is no allocation once it is large enough.
+ *
+ * @return View of the message bytes in the buffer. Valid until the next read.
+ */
+asio::awaitable<std::string_view>
+read_message(tcp::socket& socket, std::string& buffer);
+
+/**
+ * Read one binary message from the stream using a buffered reader. Issues one
+ * large read when the buffer does not already contain a complete message.
+ *
+ * @return View of the message bytes in the reader. Valid until the next read.
+ */
+asio::awaitable<std::string_view>
+read_message(tcp::socket& socket, message_reader& reader);
+
+/*
+ * Read the next message of any type from the stream, metadata included. A
+ * metadata message replaces the node list of the stream. Records the metrics
+ * of the stream if it has any. Use this to build other read loops, e.g. to
+ * record or forward metadata, so every reader of a datastream frames and
+ * counts messages the same way.
+ *
+ * @return View of the message bytes in the reader. Valid until the next read.
+ */
+asio::awaitable<std::string_view> read_any_message(datastream& stream);
+
 /*
  * Read one binary message from the stream. Will read two messages if it detects
- * a metadata message which indicates a change in the name list. The protocol
+ * a metadata message which indicates a change in the node list. The protocol
  * dictates that two metadata messages are not sent in sequential order.
+ *
+ * Uses the buffered reader of the stream so there is one socket read for any
+ * number of messages that have already arrived.
  */
 asio::awaitable<std::string> read_message(datastream& stream);
 
+/*
+ * Read one binary message from the stream into a caller owned buffer. Handles
+ * metadata messages the same way as read_message(datastream&).
+ *
+ * @code
+ * std::string buffer;
+ * for (;;) {
+ *     auto message = co_await read_message(stream, buffer);
+ * }
+ * @endcode
+ */
+asio::awaitable<std::string_view>
+read_message(datastream& stream, std::string& buffer);
+
+/**
+ * Length header of a binary message. Unsigned integer in network byte order.
+ * Use to send many messages with one gathered write.
+ *
+ * @throw std::length_error if the message length is not valid
+ */
+std::array<char, 4> make_message_header(std::size_t length);
+
 /**
  * Write a binary message with its length header to the stream.
  */
@@ -45,6 +162,16 @@ write_message(datastream& stream, std::string_view message);
 
 asio::awaitable<datastream> open_connection(tcp::endpoint endpoint);
 
+/**
+ * Server side of the handshake in open_connection. Send the service XML and
+ * read the channel request of the client if the service is "configurable".
+ * Clients of any other service do not send one.
+ *
+ * @return The channel request, or an empty string if there is none
+ */
+asio::awaitable<std::string>
+accept_service(tcp::socket& socket, std::string_view name);
+
 /**
  * From Chris Kohlhoff talk "Talking Async Ep1: Why C++20 is the Awesomest
  * Language for Network Programming".
@@ -85,4 +212,19 @@ void extend_deadline_for(
         std::max(deadline, std::chrono::steady_clock::now() + timeout_duration);
 }
 
+/**
+ * Extend the deadline time by at least the duration and count the extension
+ * in the metrics of the stream, if it has any.
+ */
+template <class Rep, class Period>
+void extend_deadline_for(
+    datastream& stream, std::chrono::steady_clock::time_point& deadline,
+    const std::chrono::duration<Rep, Period>& timeout_duration)
+{
+    extend_deadline_for(deadline, timeout_duration);
+
+    record_metrics(
+        stream.metrics_, [](stream_metrics& m) { m.add_deadline_extension(); });
+}
+
 } // namespace shadowmocap
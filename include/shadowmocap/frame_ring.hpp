@@ -0,0 +1,175 @@
+// Copyright Motion Workshop. All Rights Reserved.
+#pragma once
+
+#include <shadowmocap/datastream.hpp>
+
+#include <asio/awaitable.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace shadowmocap {
+
+/// Assume 64 byte cache lines. Pad shared counters to avoid false sharing.
+constexpr std::size_t kCacheLineSize = 64;
+
+/// One frame handed from the network thread to a consumer thread.
+struct frame_slot {
+    /// Binary message bytes. Keeps its capacity between frames.
+    std::string message;
+
+    /// Frame number assigned by the producer, starting at 0.
+    std::uint64_t sequence{};
+
+    /// Time the message was read from the socket.
+    std::chrono::steady_clock::time_point time{};
+};
+
+/// What the producer does when the consumer falls behind.
+enum class overflow_policy {
+    /// Discard the oldest unread frame to make room for the newest one.
+    drop_oldest,
+
+    /// Do not accept the new frame until the consumer reads one.
+    block_producer
+};
+
+/// Bounded single producer, single consumer queue of preallocated frames.
+/**
+ * The producer fills a slot that it owns and then publishes it. The consumer
+ * takes ownership of a published slot by swapping it with the slot it owns.
+ * Slots are never shared by both threads so neither side copies a frame or
+ * waits on a lock.
+ *
+ * @code
+ * // Network thread
+ * auto& slot = ring.producer_slot();
+ * co_await read_message(stream, slot.message);
+ * ring.try_push();
+ *
+ * // Consumer thread
+ * if (auto* slot = ring.latest()) {
+ *     auto view = make_message_view<8>(slot->message);
+ * }
+ * @endcode
+ */
+class frame_ring {
+public:
+    /**
+     * @param capacity Number of frames that can wait for the consumer
+     * @param policy Drop the oldest frame or refuse new frames when full
+     * @param message_capacity Reserve this many bytes in every slot
+     */
+    explicit frame_ring(
+        std::size_t capacity,
+        overflow_policy policy = overflow_policy::drop_oldest,
+        std::size_t message_capacity = 0);
+
+    frame_ring(const frame_ring&) = delete;
+    frame_ring& operator=(const frame_ring&) = delete;
+
+    /// Producer only. Slot to fill with the next frame.
+    frame_slot& producer_slot()
+    {
+        return slots_[fill_];
+    }
+
+    /// Producer only. Publish the producer slot to the consumer.
+    /**
+     * @return @c false if the ring is full and the policy is block_producer.
+     * The producer slot is not published, try again later.
+     */
+    bool try_push();
+
+    /// Consumer only. Take the oldest unread frame.
+    /**
+     * @return The frame or @c nullptr if there are no unread frames. Valid
+     * until the next call to try_pop, latest, or drain.
+     */
+    const frame_slot* try_pop();
+
+    /// Consumer only. Skip to the newest unread frame.
+    /**
+     * @return The frame or @c nullptr if there are no unread frames. Valid
+     * until the next call to try_pop, latest, or drain.
+     */
+    const frame_slot* latest();
+
+    /// Consumer only. Call a function for every unread frame, oldest first.
+    /**
+     * @return Number of frames
+     */
+    template <typename F>
+    std::size_t drain(F&& f)
+    {
+        std::size_t n = 0;
+        while (const auto* slot = try_pop()) {
+            f(*slot);
+            ++n;
+        }
+
+        return n;
+    }
+
+    std::size_t capacity() const
+    {
+        return capacity_;
+    }
+
+    overflow_policy policy() const
+    {
+        return policy_;
+    }
+
+    /// Number of unread frames. Approximate if called during a push or pop.
+    std::size_t size() const
+    {
+        const auto tail = tail_.load(std::memory_order_acquire);
+        const auto head = head_.load(std::memory_order_acquire);
+
+        return (head > tail) ? static_cast<std::size_t>(head - tail) : 0;
+    }
+
+    /// Number of frames discarded by the drop_oldest policy.
+    std::uint64_t dropped() const
+    {
+        return dropped_.load(std::memory_order_relaxed);
+    }
+
+private:
+    const std::size_t capacity_;
+    const overflow_policy policy_;
+
+    // capacity_ + 2 slots. One per ring position, one owned by the producer,
+    // and one owned by the consumer.
+    std::vector<frame_slot> slots_;
+
+    // Each ring position packs the frame sequence number + 1 (or 0 if empty)
+    // with the index of the slot that it owns.
+    std::unique_ptr<std::atomic<std::uint64_t>[]> ring_;
+
+    alignas(kCacheLineSize) std::atomic<std::uint64_t> head_{0};
+    alignas(kCacheLineSize) std::atomic<std::uint64_t> tail_{0};
+    alignas(kCacheLineSize) std::atomic<std::uint64_t> dropped_{0};
+
+    // Producer thread state.
+    alignas(kCacheLineSize) std::uint32_t fill_{};
+
+    // Consumer thread state.
+    alignas(kCacheLineSize) std::uint32_t held_{};
+};
+
+/// Read frames from the stream straight into the producer slots of a ring.
+/**
+ * Runs until the stream fails. With the block_producer policy, stop reading
+ * from the socket while the ring is full. TCP flow control then pushes back
+ * on the sender.
+ */
+asio::awaitable<void> read_frames(datastream& stream, frame_ring& ring);
+
+} // namespace shadowmocap
@@ -0,0 +1,189 @@
+// Copyright Motion Workshop. All Rights Reserved.
+#pragma once
+
+#include <shadowmocap/message.hpp>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace shadowmocap {
+
+struct jitter_options {
+    /// Number of frames that can wait for release. Drop the oldest frame if
+    /// a new one arrives when full.
+    std::size_t capacity = 64;
+
+    /// Reserve this many bytes in every frame.
+    std::size_t message_capacity = 0;
+
+    /// Bounds of the delay added to every frame.
+    std::chrono::microseconds min_delay{0};
+    std::chrono::microseconds max_delay{100'000};
+
+    /// Delay is this many times the measured jitter.
+    double jitter_multiplier = 1.5;
+};
+
+/// One frame held by the jitter buffer.
+struct jitter_frame {
+    using clock_type = std::chrono::steady_clock;
+
+    /// Binary message bytes. Keeps its capacity between frames.
+    std::string message;
+
+    /// Time the frame arrived.
+    clock_type::time_point receive{};
+
+    /// Time the frame is due out of the buffer.
+    clock_type::time_point release{};
+
+    /// Time of the frame on the clock of the source, relative to the first
+    /// frame.
+    clock_type::duration source{};
+};
+
+/// Latency added by a jitter buffer against the jitter it removed.
+struct jitter_stats {
+    using duration = std::chrono::steady_clock::duration;
+
+    std::uint64_t num_push{};
+    std::uint64_t num_pop{};
+
+    /// Frames that arrived after their release time and went out as soon as
+    /// possible.
+    std::uint64_t num_late{};
+
+    /// Frames dropped because the buffer was full.
+    std::uint64_t num_dropped{};
+
+    /// Current delay added to every frame.
+    duration delay{};
+
+    /// Time from push to pop, over all released frames.
+    duration mean_latency{};
+    duration max_latency{};
+
+    /// Interarrival jitter of pushes and of pops against the source clock.
+    /// Same estimate as RFC 3550.
+    duration input_jitter{};
+    duration output_jitter{};
+};
+
+/// Release bursty frames at the steady rate of their source clock.
+/**
+ * Frames go in as they arrive and come out at source time plus a fixed
+ * offset plus a delay. The source time is the timestamp channel, the sum of
+ * the dt channel, or a steady clock at the mean frame rate if the mask has
+ * neither. The offset tracks the fastest transit seen so far. The delay
+ * follows the measured jitter: it grows at once when a frame is later than
+ * expected and shrinks slowly after that.
+ *
+ * Fixed storage with no allocation once every frame has held the largest
+ * message. Not thread safe, use from one thread or strand.
+ *
+ * @code
+ * jitter_buffer buffer(channel::Lq | channel::timestamp);
+ *
+ * // Network
+ * buffer.push(message, clock::now());
+ *
+ * // Playback, on every tick
+ * while (const auto* frame = buffer.pop(clock::now())) {
+ *     play(frame->message);
+ * }
+ * @endcode
+ */
+class jitter_buffer {
+public:
+    using clock_type = std::chrono::steady_clock;
+
+    /**
+     * @param mask Channels of the frames. Use timestamp or dt for the
+     * source clock if there is one. Values are in seconds.
+     *
+     * @throw std::invalid_argument if the capacity is zero
+     */
+    explicit jitter_buffer(int mask, jitter_options options = {});
+
+    /// Copy a frame into the buffer and schedule its release.
+    void push(std::string_view message, clock_type::time_point now);
+
+    /// Take the oldest frame if it is due.
+    /**
+     * @return The frame or @c nullptr if there is none due. Valid until the
+     * next call to pop.
+     */
+    const jitter_frame* pop(clock_type::time_point now);
+
+    /// Release time of the oldest frame, if there is one. Use to wait for
+    /// the next frame rather than poll.
+    std::optional<clock_type::time_point> next_release() const;
+
+    std::size_t size() const
+    {
+        return static_cast<std::size_t>(head_ - tail_);
+    }
+
+    bool empty() const
+    {
+        return head_ == tail_;
+    }
+
+    std::size_t capacity() const
+    {
+        return slots_.size();
+    }
+
+    /// Current delay added to every frame.
+    clock_type::duration delay() const
+    {
+        return delay_;
+    }
+
+    jitter_stats stats() const;
+
+private:
+    clock_type::duration get_source(
+        std::string_view message, clock_type::time_point now);
+
+    message_layout layout_;
+    jitter_options options_;
+
+    std::vector<jitter_frame> slots_;
+    std::uint64_t head_{};
+    std::uint64_t tail_{};
+
+    // Frame returned by the last pop. Swapped with a slot so the message
+    // storage moves around without a copy.
+    jitter_frame held_;
+
+    // Source clock.
+    bool has_source_{};
+    std::optional<double> first_time_;
+    clock_type::duration source_{};
+    clock_type::duration period_{};
+    clock_type::time_point first_receive_{};
+    clock_type::time_point last_receive_{};
+    std::uint64_t num_interval_{};
+
+    // Earliest arrival on the local clock of source time zero, and the
+    // measured jitter on top of it.
+    clock_type::time_point offset_{};
+    clock_type::duration jitter_{};
+    clock_type::duration delay_{};
+    clock_type::time_point last_release_{};
+
+    // Previous pop, for the output jitter.
+    clock_type::time_point last_pop_{};
+    clock_type::duration last_pop_source_{};
+
+    jitter_stats stats_;
+    clock_type::duration total_latency_{};
+};
+
+} // namespace shadowmocap
@@ -0,0 +1,196 @@
+// Copyright Motion Workshop. All Rights Reserved.
+#pragma once
+
+#include <shadowmocap/channel.hpp>
+#include <shadowmocap/soa.hpp>
+
+#include <array>
+#include <cstddef>
+#include <span>
+#include <type_traits>
+
+namespace shadowmocap {
+
+/// Quaternions of many nodes, one array per component in (w, x, y, z) order
+/// like the Gq, Lq, and Bq channels.
+template <typename T>
+struct quaternion_array {
+    T* w = nullptr;
+    T* x = nullptr;
+    T* y = nullptr;
+    T* z = nullptr;
+
+    operator quaternion_array<const T>() const
+        requires(!std::is_const_v<T>)
+    {
+        return {w, x, y, z};
+    }
+};
+
+/// Vectors of many nodes, one array per component in (x, y, z) order.
+template <typename T>
+struct vector_array {
+    T* x = nullptr;
+    T* y = nullptr;
+    T* z = nullptr;
+
+    operator vector_array<const T>() const
+        requires(!std::is_const_v<T>)
+    {
+        return {x, y, z};
+    }
+};
+
+/// 3x3 matrices of many nodes, one array per element in row major order.
+template <typename T>
+struct matrix_array {
+    std::array<T*, 9> m{};
+};
+
+/// Arrays of a quaternion channel in a decoded frame, i.e. channel::Lq.
+/**
+ * @throw std::invalid_argument if the channel is not in the frame or does
+ * not have four values
+ */
+quaternion_array<float> get_quaternion_array(soa_frame& frame, channel c);
+
+quaternion_array<const float>
+get_quaternion_array(const soa_frame& frame, channel c);
+
+/// Arrays of the first three values of a channel in a decoded frame, i.e.
+/// the position of channel::c or the vector of channel::a.
+/**
+ * @throw std::invalid_argument if the channel is not in the frame or has
+ * fewer than three values
+ */
+vector_array<float> get_vector_array(soa_frame& frame, channel c);
+
+vector_array<const float> get_vector_array(const soa_frame& frame, channel c);
+
+// Batch math over every node of a frame at once. Each function works on n
+// elements of its arrays with the widest SIMD instructions the build allows,
+// AVX2 with ENABLE_AVX2, SSE2 on other x86-64 targets, or NEON on AArch64,
+// and the scalar reference for the tail. Arrays need no alignment.
+//
+// Results match the scalar reference to within a few units in the last
+// place. Euler angles use a polynomial arc tangent and match to within a
+// few 1e-6 radians.
+//
+//   soa_frame frame(channel::Lq | channel::c);
+//   if (frame.decode(message)) {
+//       auto q = get_quaternion_array(frame, channel::Lq);
+//       normalize(q, frame.size());
+//   }
+
+/// Scale every quaternion to unit length. Quaternions must be non-zero.
+void normalize(quaternion_array<float> q, std::size_t n);
+
+/// Hamilton product out = lhs * rhs, i.e. compose a local rotation (rhs)
+/// into the global rotation of its parent (lhs). Output may be either input.
+void multiply(
+    quaternion_array<const float> lhs, quaternion_array<const float> rhs,
+    quaternion_array<float> out, std::size_t n);
+
+/// Euler angles of unit quaternions in radians. Rotation about x (roll) then
+/// y (pitch) then z (yaw) in the fixed frame, i.e. q = z * y * x. Pitch is
+/// in [-pi/2, pi/2], the others in [-pi, pi].
+void to_euler(
+    quaternion_array<const float> q, vector_array<float> out, std::size_t n);
+
+/// Rotation matrices of unit quaternions.
+void to_matrix(
+    quaternion_array<const float> q, matrix_array<float> out, std::size_t n);
+
+/// Rotate vectors by unit quaternions, out = q * v * conj(q). Output may be
+/// the input vectors.
+void rotate(
+    quaternion_array<const float> q, vector_array<const float> v,
+    vector_array<float> out, std::size_t n);
+
+/// Rotate and then translate points, out = q * v * conj(q) + t. Output may
+/// be any of the input vectors.
+void transform(
+    quaternion_array<const float> q, vector_array<const float> t,
+    vector_array<const float> v, vector_array<float> out, std::size_t n);
+
+/// World rotation and position of every node in a tree from its local
+/// rotation and its offset from the parent.
+/**
+ * One pass in order over the nodes. A node at the top level has its local
+ * rotation and offset as its world values. Every other node is
+ *
+ *   rotation[i] = rotation[parent[i]] * local[i]
+ *   position[i] = position[parent[i]] + rotate(rotation[parent[i]], offset[i])
+ *
+ * Parents are solved first since they come before their children. Works on
+ * n elements of each array and does not allocate.
+ *
+ * Element i of every array is item i of the frame, in message order. Do not
+ * pass node_map::parents() directly, it is in metadata order and may list
+ * nodes that are not in the frame. Map the frame keys to parent items with
+ * node_map::item_parents() once per node list change instead. Frames that
+ * list a node after one of its children are not supported and throw. The
+ * Shadow data service sends items in metadata order, which is parent first.
+ *
+ * If a joint is not in the frame, item_parents() links its children to the
+ * nearest ancestor that is. The missing joints are treated as identity, so
+ * offset[i] must be the position of node i in the frame of that mapped
+ * ancestor and not of its metadata parent. A skeleton with bone offsets per
+ * metadata parent gives wrong world values unless the frame has every joint.
+ *
+ * @code
+ * node_map nodes(parse_metadata_nodes(xml));
+ *
+ * // First frame after a node list change
+ * frame.decode(message);
+ * const auto parent = nodes.item_parents(frame.keys());
+ *
+ * // Every frame
+ * forward_kinematics(
+ *     parent, get_quaternion_array(frame, channel::Lq), offset, rotation,
+ *     position, frame.size());
+ * @endcode
+ *
+ * @param parent Item index of the parent of each item, or -1
+ * @param local Rotation of each node relative to its parent, i.e. Lq
+ * @param offset Position of each node in the frame of its parent item, i.e.
+ * the bone offsets of the skeleton summed over any joints not in the frame
+ *
+ * @throw std::invalid_argument if parent does not have n elements or a
+ * parent does not come before its child
+ */
+void forward_kinematics(
+    std::span<const int> parent, quaternion_array<const float> local,
+    vector_array<const float> offset, quaternion_array<float> rotation,
+    vector_array<float> position, std::size_t n);
+
+namespace detail {
+
+/// Name of the SIMD instructions in use, "avx2", "sse2", "neon", or "scalar".
+const char* get_simd_name();
+
+/// Scalar reference of every kernel. Exposed for testing and benchmarks of
+/// the SIMD paths.
+void normalize_scalar(quaternion_array<float> q, std::size_t n);
+
+void multiply_scalar(
+    quaternion_array<const float> lhs, quaternion_array<const float> rhs,
+    quaternion_array<float> out, std::size_t n);
+
+void to_euler_scalar(
+    quaternion_array<const float> q, vector_array<float> out, std::size_t n);
+
+void to_matrix_scalar(
+    quaternion_array<const float> q, matrix_array<float> out, std::size_t n);
+
+void rotate_scalar(
+    quaternion_array<const float> q, vector_array<const float> v,
+    vector_array<float> out, std::size_t n);
+
+void transform_scalar(
+    quaternion_array<const float> q, vector_array<const float> t,
+    vector_array<const float> v, vector_array<float> out, std::size_t n);
+
+} // namespace detail
+
+} // namespace shadowmocap
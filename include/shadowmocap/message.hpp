@@ -3,9 +3,20 @@
 
 #include <shadowmocap/channel.hpp>
 
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <compare>
+#include <cstddef>
 #include <cstring>
+#include <functional>
+#include <iterator>
+#include <ranges>
+#include <span>
+#include <stdexcept>
 #include <string>
 #include <string_view>
+#include <unordered_map>
 #include <vector>
 
 namespace shadowmocap {
@@ -22,38 +33,630 @@ struct message_list_item {
     float data[N] = {};
 };
 
-/// Parse a binary message and return an iterable container of items.
+/// Non-owning view of a binary message as a random access range of items.
 /**
- * Copy message bytes into a vector of structs.
+ * Items are decoded lazily from the message bytes when the iterator is
+ * dereferenced. No allocation or copy of the full message is made. The view
+ * does not own the message bytes so the underlying buffer must outlive it.
  *
  * message = [item0, ..., itemM)
  * item = [int = key] [int = N] [float0, ..., floatN)
  *
+ * @code
+ * for (auto item : make_message_view<8>(message)) {
+ *     ...
+ * }
+ * @endcode
+ *
+ * @tparam N Number of scalar values in each item
+ * @tparam T Item type with the same packed layout as message_list_item<N>
+ */
+template <std::size_t N, typename T = message_list_item<N>>
+class message_view : public std::ranges::view_interface<message_view<N, T>> {
+public:
+    using value_type = T;
+    using size_type = std::size_t;
+    using difference_type = std::ptrdiff_t;
+
+    static_assert(sizeof(value_type) == 2 * sizeof(int) + N * sizeof(float));
+    static_assert(offsetof(value_type, key) == 0);
+    static_assert(offsetof(value_type, length) == 4);
+    static_assert(offsetof(value_type, data) == 8);
+
+    /// Random access iterator that returns items by value.
+    class iterator {
+    public:
+        // Items are decoded into a temporary so this is not a legacy forward
+        // iterator. It does satisfy std::random_access_iterator.
+        using iterator_concept = std::random_access_iterator_tag;
+        using iterator_category = std::input_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+
+        iterator() = default;
+
+        value_type operator*() const
+        {
+            // https://en.cppreference.com/w/cpp/string/byte/memcpy
+            // Where strict aliasing prohibits examining the same memory as
+            // values of two different types, std::memcpy may be used to
+            // convert the values.
+            value_type item;
+            std::memcpy(&item, ptr_, sizeof(value_type));
+            return item;
+        }
+
+        value_type operator[](difference_type n) const
+        {
+            return *(*this + n);
+        }
+
+        iterator& operator++()
+        {
+            ptr_ += sizeof(value_type);
+            return *this;
+        }
+
+        iterator operator++(int)
+        {
+            auto result = *this;
+            ++*this;
+            return result;
+        }
+
+        iterator& operator--()
+        {
+            ptr_ -= sizeof(value_type);
+            return *this;
+        }
+
+        iterator operator--(int)
+        {
+            auto result = *this;
+            --*this;
+            return result;
+        }
+
+        iterator& operator+=(difference_type n)
+        {
+            ptr_ += n * static_cast<difference_type>(sizeof(value_type));
+            return *this;
+        }
+
+        iterator& operator-=(difference_type n)
+        {
+            return *this += -n;
+        }
+
+        friend iterator operator+(iterator it, difference_type n)
+        {
+            return it += n;
+        }
+
+        friend iterator operator+(difference_type n, iterator it)
+        {
+            return it += n;
+        }
+
+        friend iterator operator-(iterator it, difference_type n)
+        {
+            return it -= n;
+        }
+
+        friend difference_type
+        operator-(const iterator& lhs, const iterator& rhs)
+        {
+            return (lhs.ptr_ - rhs.ptr_) /
+                   static_cast<difference_type>(sizeof(value_type));
+        }
+
+        friend bool operator==(const iterator&, const iterator&) = default;
+        friend auto operator<=>(const iterator&, const iterator&) = default;
+
+    private:
+        explicit iterator(const char* ptr) : ptr_{ptr}
+        {
+        }
+
+        const char* ptr_ = nullptr;
+
+        friend class message_view;
+    };
+
+    message_view() = default;
+
+    /// Create a view of the message bytes. The view is empty if the message
+    /// is not a whole number of items.
+    explicit message_view(std::string_view message)
+    {
+        // Sanity checks. Leave the view empty on failure.
+        if (!message.empty() && (message.size() % sizeof(value_type) == 0)) {
+            message_ = message;
+        }
+    }
+
+    iterator begin() const
+    {
+        return iterator{message_.data()};
+    }
+
+    iterator end() const
+    {
+        return iterator{message_.data() + message_.size()};
+    }
+
+    size_type size() const
+    {
+        return message_.size() / sizeof(value_type);
+    }
+
+    /// Decode the item at index @c pos with bounds checking.
+    /**
+     * @throw std::out_of_range if pos >= size()
+     */
+    value_type at(size_type pos) const
+    {
+        if (pos >= size()) {
+            throw std::out_of_range("message item index is out of range");
+        }
+
+        return begin()[static_cast<difference_type>(pos)];
+    }
+
+    /// Underlying message bytes of all of the items.
+    std::string_view bytes() const
+    {
+        return message_;
+    }
+
+private:
+    std::string_view message_;
+};
+
+/// Create a non-owning view of the items in a binary message.
+/**
  * @param message Container of bytes
- * @return A vector of fixed size items. Returns an empty vector on error.
+ * @return A view of fixed size items. Returns an empty view on error.
  */
 template <std::size_t N>
-std::vector<message_list_item<N>> make_message_list(std::string_view message)
+message_view<N> make_message_view(std::string_view message)
+{
+    return message_view<N>{message};
+}
+
+/// One item of a binary message with a compile time bitmask of channels.
+/**
+ * Same packed layout as message_list_item but the channel offsets are known
+ * at compile time, so get<channel::Lq>() is a fixed size span at a constant
+ * offset with no lookup.
+ *
+ * @code
+ * frame_item<channel::Lq | channel::c> item;
+ * std::span<const float, 4> q = item.get<channel::Lq>();
+ * @endcode
+ */
+template <int Mask>
+struct frame_item {
+    static constexpr int kMask = Mask & kAllChannelMask;
+    static constexpr std::size_t kDimension =
+        get_channel_mask_dimension(kMask);
+
+    static_assert(kDimension > 0, "frame mask has no channels");
+
+    int key{};
+    int length{};
+    float data[kDimension] = {};
+
+    template <channel C>
+    static constexpr bool contains()
+    {
+        return (kMask & C) != 0;
+    }
+
+    /// All of the scalar values of one channel.
+    template <channel C>
+    std::span<float, get_channel_dimension(C)> get()
+    {
+        static_assert(contains<C>(), "channel is not in the frame mask");
+
+        return std::span<float, get_channel_dimension(C)>{
+            data + get_channel_offset(kMask, C), get_channel_dimension(C)};
+    }
+
+    template <channel C>
+    std::span<const float, get_channel_dimension(C)> get() const
+    {
+        static_assert(contains<C>(), "channel is not in the frame mask");
+
+        return std::span<const float, get_channel_dimension(C)>{
+            data + get_channel_offset(kMask, C), get_channel_dimension(C)};
+    }
+};
+
+/// Non-owning view of a binary message with a compile time bitmask of
+/// channels.
+/**
+ * @code
+ * for (auto item : make_frame<channel::Lq | channel::c>(message)) {
+ *     auto q = item.get<channel::Lq>();
+ *     auto c = item.get<channel::c>();
+ * }
+ * @endcode
+ */
+template <int Mask>
+using frame =
+    message_view<frame_item<Mask>::kDimension, frame_item<Mask>>;
+
+/// Create a non-owning view of the items in a binary message with a compile
+/// time bitmask of channels.
+/**
+ * @param message Container of bytes
+ * @return A view of items. Returns an empty view if the message is not a
+ * whole number of items or the length field of any item does not match the
+ * mask.
+ */
+template <int Mask>
+frame<Mask> make_frame(std::string_view message)
 {
-    using item_type = message_list_item<N>;
+    using item_type = frame_item<Mask>;
 
-    static_assert(sizeof(item_type) == 2 * sizeof(int) + N * sizeof(float));
-    static_assert(offsetof(item_type, key) == 0);
-    static_assert(offsetof(item_type, length) == 4);
-    static_assert(offsetof(item_type, data) == 8);
+    const frame<Mask> result{message};
+    for (std::size_t i = 0; i < result.bytes().size();
+         i += sizeof(item_type)) {
+        int length = 0;
+        std::memcpy(
+            &length, result.bytes().data() + i + sizeof(int), sizeof(int));
 
-    // Sanity checks. Return empty container on failure.
-    if (message.empty() || (message.size() % sizeof(item_type) != 0)) {
-        return {};
+        if (length != static_cast<int>(item_type::kDimension)) {
+            return {};
+        }
     }
 
-    const std::size_t count = message.size() / sizeof(item_type);
-    std::vector<item_type> items(count);
+    return result;
+}
+
+/// Layout of the scalar values in one message item for a runtime bitmask of
+/// channels.
+/**
+ * Channels are always sorted by the channel enumeration value from smallest
+ * to largest, same as make_channel_message.
+ *
+ * @code
+ * message_layout layout(channel::Lq | channel::c);
+ * layout.dimension() == 8
+ * layout.offset(channel::c) == 4
+ * @endcode
+ */
+class message_layout {
+public:
+    message_layout() = default;
+
+    /// Precompute the offset of every channel in the bitmask.
+    explicit message_layout(int mask);
 
-    // https://en.cppreference.com/w/cpp/string/byte/memcpy 
-    // Where strict aliasing prohibits examining the same memory as values of
-    // two different types, std::memcpy may be used to convert the values.
-    std::memcpy(items.data(), message.data(), message.size());
+    int mask() const
+    {
+        return mask_;
+    }
+
+    /// Number of scalar values in one item.
+    int dimension() const
+    {
+        return dimension_;
+    }
+
+    /// Number of bytes in one item including the key and length header.
+    std::size_t item_size() const
+    {
+        return (2 + static_cast<std::size_t>(dimension_)) * sizeof(float);
+    }
+
+    bool contains(channel c) const
+    {
+        return (mask_ & c) != 0;
+    }
+
+    /// Index of the first scalar value of a channel in the item data. Returns
+    /// -1 if the channel is not in the layout.
+    int offset(channel c) const
+    {
+        const auto index = get_channel_index(c);
+        if (!contains(c) || (index >= static_cast<int>(kNumChannel))) {
+            return -1;
+        }
+
+        return offset_[index];
+    }
+
+private:
+    int mask_ = 0;
+    int dimension_ = 0;
+    std::array<int, kNumChannel> offset_{};
+
+    friend class message_layout_item;
+};
+
+/// Non-owning view of one item in a binary message with a runtime layout.
+class message_layout_item {
+public:
+    message_layout_item(const char* ptr, const message_layout& layout)
+        : ptr_{ptr}, layout_{&layout}
+    {
+    }
+
+    int key() const
+    {
+        return load<int>(0);
+    }
+
+    int length() const
+    {
+        return load<int>(1);
+    }
+
+    /// Get one scalar value of a channel, i.e. axis 2 of channel::c is cz.
+    /**
+     * @pre layout.contains(c) and axis < get_channel_dimension(c)
+     */
+    float value(channel c, int axis = 0) const
+    {
+        // Skip the contains check of message_layout::offset on the hot path.
+        const auto index = get_channel_index(c);
+
+        return load<float>(2 + layout_->offset_[index] + axis);
+    }
+
+    /// Copy all of the scalar values of a channel into a buffer.
+    /**
+     * @return Number of values copied. Returns 0 if the channel is not in the
+     * layout.
+     */
+    std::size_t get(channel c, std::span<float> out) const
+    {
+        const auto offset = layout_->offset(c);
+        if (offset < 0) {
+            return 0;
+        }
+
+        const auto n = std::min(
+            out.size(), static_cast<std::size_t>(get_channel_dimension(c)));
+
+        std::memcpy(out.data(), scalar(2 + offset), n * sizeof(float));
+
+        return n;
+    }
+
+    /// Copy all of the scalar values of the item into a buffer.
+    std::size_t get(std::span<float> out) const
+    {
+        const auto n = std::min(
+            out.size(), static_cast<std::size_t>(layout_->dimension()));
+
+        std::memcpy(out.data(), scalar(2), n * sizeof(float));
+
+        return n;
+    }
+
+private:
+    const char* scalar(int index) const
+    {
+        return ptr_ + static_cast<std::size_t>(index) * sizeof(float);
+    }
+
+    template <typename T>
+    T load(int index) const
+    {
+        static_assert(sizeof(T) == sizeof(float));
+
+        T result;
+        std::memcpy(&result, scalar(index), sizeof(T));
+        return result;
+    }
+
+    const char* ptr_;
+    const message_layout* layout_;
+};
+
+/// Non-owning view of a binary message where the channels in each item are
+/// defined at runtime.
+/**
+ * Same as message_view but for a runtime bitmask of channels. The view and
+ * the layout do not own any data so both must outlive it.
+ *
+ * @code
+ * message_layout layout(mask);
+ * for (auto item : make_message_view(message, layout)) {
+ *     float cx = item.value(channel::c, 0);
+ * }
+ * @endcode
+ */
+class message_layout_view
+    : public std::ranges::view_interface<message_layout_view> {
+public:
+    using value_type = message_layout_item;
+    using size_type = std::size_t;
+    using difference_type = std::ptrdiff_t;
+
+    /// Random access iterator that returns item views by value.
+    class iterator {
+    public:
+        using iterator_concept = std::random_access_iterator_tag;
+        using iterator_category = std::input_iterator_tag;
+        using value_type = message_layout_item;
+        using difference_type = std::ptrdiff_t;
+
+        iterator() = default;
+
+        value_type operator*() const
+        {
+            return value_type{ptr_, *layout_};
+        }
+
+        value_type operator[](difference_type n) const
+        {
+            return *(*this + n);
+        }
+
+        iterator& operator++()
+        {
+            return *this += 1;
+        }
+
+        iterator operator++(int)
+        {
+            auto result = *this;
+            ++*this;
+            return result;
+        }
+
+        iterator& operator--()
+        {
+            return *this -= 1;
+        }
+
+        iterator operator--(int)
+        {
+            auto result = *this;
+            --*this;
+            return result;
+        }
+
+        iterator& operator+=(difference_type n)
+        {
+            ptr_ += n * static_cast<difference_type>(layout_->item_size());
+            return *this;
+        }
+
+        iterator& operator-=(difference_type n)
+        {
+            return *this += -n;
+        }
+
+        friend iterator operator+(iterator it, difference_type n)
+        {
+            return it += n;
+        }
+
+        friend iterator operator+(difference_type n, iterator it)
+        {
+            return it += n;
+        }
+
+        friend iterator operator-(iterator it, difference_type n)
+        {
+            return it -= n;
+        }
+
+        friend difference_type
+        operator-(const iterator& lhs, const iterator& rhs)
+        {
+            if (lhs.ptr_ == rhs.ptr_) {
+                return 0;
+            }
+
+            return (lhs.ptr_ - rhs.ptr_) /
+                   static_cast<difference_type>(lhs.layout_->item_size());
+        }
+
+        friend bool operator==(const iterator& lhs, const iterator& rhs)
+        {
+            return lhs.ptr_ == rhs.ptr_;
+        }
+
+        friend auto operator<=>(const iterator& lhs, const iterator& rhs)
+        {
+            return lhs.ptr_ <=> rhs.ptr_;
+        }
+
+    private:
+        iterator(const char* ptr, const message_layout* layout)
+            : ptr_{ptr}, layout_{layout}
+        {
+        }
+
+        const char* ptr_ = nullptr;
+        const message_layout* layout_ = nullptr;
+
+        friend class message_layout_view;
+    };
+
+    message_layout_view() = default;
+
+    /// Create a view of the message bytes. The view is empty if the message
+    /// is not a whole number of items or if the length field of any item does
+    /// not match the layout dimension.
+    message_layout_view(std::string_view message, const message_layout& layout);
+
+    iterator begin() const
+    {
+        return iterator{message_.data(), layout_};
+    }
+
+    iterator end() const
+    {
+        return iterator{message_.data() + message_.size(), layout_};
+    }
+
+    size_type size() const
+    {
+        return message_.empty() ? 0 : message_.size() / layout_->item_size();
+    }
+
+    /// Get the item at index @c pos with bounds checking.
+    /**
+     * @throw std::out_of_range if pos >= size()
+     */
+    value_type at(size_type pos) const
+    {
+        if (pos >= size()) {
+            throw std::out_of_range("message item index is out of range");
+        }
+
+        return begin()[static_cast<difference_type>(pos)];
+    }
+
+    /// Underlying message bytes of all of the items.
+    std::string_view bytes() const
+    {
+        return message_;
+    }
+
+private:
+    std::string_view message_;
+    const message_layout* layout_ = nullptr;
+};
+
+/// Create a non-owning view of the items in a binary message with a runtime
+/// layout.
+/**
+ * @param message Container of bytes
+ * @param layout Channels in each item, must outlive the view
+ * @return A view of items. Returns an empty view on error.
+ */
+inline message_layout_view
+make_message_view(std::string_view message, const message_layout& layout)
+{
+    return message_layout_view{message, layout};
+}
+
+/// Parse a binary message and return an iterable container of items.
+/**
+ * Copy message bytes into a vector of structs. Prefer make_message_view to
+ * avoid the allocation and copy.
+ *
+ * @param message Container of bytes
+ * @return A vector of fixed size items. Returns an empty vector on error.
+ */
+template <std::size_t N>
+std::vector<message_list_item<N>> make_message_list(std::string_view message)
+{
+    const auto view = make_message_view<N>(message);
+
+    std::vector<message_list_item<N>> items(view.size());
+
+    if (!items.empty()) {
+        std::memcpy(items.data(), view.bytes().data(), view.bytes().size());
+    }
 
     return items;
 }
@@ -80,6 +683,159 @@ bool is_metadata(std::string_view message);
  */
 std::vector<std::string> parse_metadata(std::string_view message);
 
+/// One node from the metadata message of the Shadow data service.
+struct metadata_node {
+    /// String name from the id="..." attribute, i.e. "Hips".
+    std::string name;
+
+    /// Integer key from the key="..." attribute. Matches the key of the
+    /// measurement data items.
+    int key{};
+
+    /// Index of the parent node in the same list, or -1 if the node is at
+    /// the top level. Always less than the index of the node itself.
+    int parent = -1;
+};
+
+/// Parse a metadata message from the Shadow data service and return a flat list
+/// of nodes with their names, keys, and parents.
+/**
+ * Same as parse_metadata but also keeps the key and the parent of each node.
+ * The list is in document order so every parent comes before its children.
+ * Single pass over the message with no allocation other than the result and
+ * a stack as deep as the node tree.
+ *
+ * @param message Container of bytes that contains an XML string.
+ *
+ * @return List of nodes in the same order as measurement data.
+ */
+std::vector<metadata_node> parse_metadata_nodes(std::string_view message);
+
+/// Lookup table from node key or node name to the node in the metadata.
+/**
+ * Build once per metadata message. Lookup by key is an index into a dense
+ * table. Lookup by name is a hash table that accepts a string_view so it does
+ * not allocate.
+ *
+ * @code
+ * node_map nodes(parse_metadata_nodes(xml));
+ * for (auto item : make_message_view<8>(message)) {
+ *     auto name = nodes.name(item.key);
+ * }
+ * @endcode
+ */
+class node_map {
+public:
+    /// Dense key table covers keys in [0, kMaxKey). Nodes with keys outside
+    /// of this range are not found by key.
+    static constexpr int kMaxKey = 1 << 16;
+
+    node_map() = default;
+
+    explicit node_map(std::vector<metadata_node> nodes);
+
+    /// Index of the node with this key or -1 if there is no such node.
+    int find(int key) const
+    {
+        if ((key < 0) || (static_cast<std::size_t>(key) >= by_key_.size())) {
+            return -1;
+        }
+
+        return by_key_[key];
+    }
+
+    /// Index of the node with this name or -1 if there is no such node.
+    int find(std::string_view name) const
+    {
+        auto itr = by_name_.find(name);
+        if (itr == by_name_.end()) {
+            return -1;
+        }
+
+        return itr->second;
+    }
+
+    /// Name of the node with this key. Returns an empty string if there is no
+    /// such node.
+    std::string_view name(int key) const
+    {
+        const auto index = find(key);
+        if (index < 0) {
+            return {};
+        }
+
+        return nodes_[index].name;
+    }
+
+    const metadata_node& operator[](std::size_t index) const
+    {
+        return nodes_[index];
+    }
+
+    auto begin() const
+    {
+        return nodes_.begin();
+    }
+
+    auto end() const
+    {
+        return nodes_.end();
+    }
+
+    std::size_t size() const
+    {
+        return nodes_.size();
+    }
+
+    bool empty() const
+    {
+        return nodes_.empty();
+    }
+
+    void clear();
+
+    /// All nodes in the same order as measurement data.
+    const std::vector<metadata_node>& nodes() const
+    {
+        return nodes_;
+    }
+
+    /// Parent index of every node, or -1 for a top level node. Parents come
+    /// before their children so one pass in order visits the whole tree from
+    /// the top down. In metadata order, see item_parents for frame order.
+    std::span<const int> parents() const
+    {
+        return parents_;
+    }
+
+    /// Parent of every item of a frame as an item index, or -1. Items are
+    /// the node keys in message order, i.e. soa_frame::keys(). If the parent
+    /// node is not in the frame, the nearest ancestor that is in the frame is
+    /// the parent and the joints in between are skipped, see
+    /// forward_kinematics for what that means for the offsets. An item with an
+    /// unknown key, or with no ancestor in the frame, is top level. Items are
+    /// not reordered, so a parent may come after its child if the frame is not
+    /// in metadata order. Allocates, call once per node list change and not
+    /// per frame.
+    std::vector<int> item_parents(std::span<const int> keys) const;
+
+private:
+    struct string_hash {
+        using is_transparent = void;
+
+        std::size_t operator()(std::string_view str) const
+        {
+            return std::hash<std::string_view>{}(str);
+        }
+    };
+
+    std::vector<metadata_node> nodes_;
+    std::vector<int> by_key_;
+    std::vector<int> parents_;
+    std::unordered_map<std::string, int, string_hash, std::equal_to<>>
+        by_name_;
+};
+
 /// Create an XML metadata string that lists the channels we want.
 /**
  * Always sorted by the channel enumeration value from smallest to largest.
@@ -93,4 +849,16 @@ std::vector<std::string> parse_metadata(std::string_view message);
  */
 std::string make_channel_message(int mask);
 
+/// Get the bitmask of channels listed in a channel request XML string.
+/**
+ * Inverse of make_channel_message. Elements that are not channel names are
+ * ignored.
+ *
+ * @code
+ * parse_channel_message("<configurable><Lq/><c/></configurable>") ==
+ *     (channel::Lq | channel::c)
+ * @endcode
+ */
+int parse_channel_message(std::string_view message);
+
 } // namespace shadowmocap
@@ -0,0 +1,237 @@
+// Copyright Motion Workshop. All Rights Reserved.
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace shadowmocap {
+
+/// Metrics are recorded only if this is true. Define
+/// SHADOWMOCAP_DISABLE_METRICS to compile out all of the recording code.
+#if defined(SHADOWMOCAP_DISABLE_METRICS)
+constexpr bool kEnableMetrics = false;
+#else
+constexpr bool kEnableMetrics = true;
+#endif
+
+/// Copy of a histogram at one point in time.
+struct histogram_snapshot {
+    /// Values below 2^kSubBucketBits have their own bucket. Every power of
+    /// two above that is split into 2^kSubBucketBits buckets, so a bucket
+    /// is within 1/16 = 6.25% of any value in it.
+    static constexpr int kSubBucketBits = 4;
+    static constexpr std::size_t kSubBucketCount = 1 << kSubBucketBits;
+    static constexpr std::size_t kBucketCount =
+        (64 - kSubBucketBits + 1) * kSubBucketCount;
+
+    std::array<std::uint64_t, kBucketCount> counts{};
+    std::uint64_t count{};
+    std::uint64_t sum{};
+    std::uint64_t max{};
+
+    /// Bucket of a value.
+    static constexpr std::size_t index(std::uint64_t value)
+    {
+        if (value < kSubBucketCount) {
+            return static_cast<std::size_t>(value);
+        }
+
+        const int shift = std::bit_width(value) - 1 - kSubBucketBits;
+
+        return static_cast<std::size_t>(shift + 1) * kSubBucketCount +
+               static_cast<std::size_t>((value >> shift) - kSubBucketCount);
+    }
+
+    /// Smallest value in a bucket.
+    static constexpr std::uint64_t lower_bound(std::size_t index)
+    {
+        if (index < kSubBucketCount) {
+            return index;
+        }
+
+        const auto shift = index / kSubBucketCount - 1;
+
+        return (kSubBucketCount + index % kSubBucketCount) << shift;
+    }
+
+    double mean() const;
+
+    /// Value that is at least this percent of the recorded values, i.e.
+    /// percentile(99) is the p99 value. Rounded down to its bucket, except
+    /// in the bucket of the max where it is the max.
+    std::uint64_t percentile(double percent) const;
+};
+
+/// Log-linear histogram of non-negative integer values, e.g. nanoseconds.
+/**
+ * Fixed size with no allocation. One thread records values and any thread
+ * may take a snapshot at any time. Every counter is a relaxed atomic so a
+ * snapshot taken during a record may be off by that one value between
+ * buckets and totals, but is never torn.
+ */
+class latency_histogram {
+public:
+    /// Writer only.
+    void record(std::uint64_t value)
+    {
+        increment(counts_[histogram_snapshot::index(value)]);
+        increment(count_);
+        add(sum_, value);
+
+        if (value > max_.load(std::memory_order_relaxed)) {
+            max_.store(value, std::memory_order_relaxed);
+        }
+    }
+
+    template <class Rep, class Period>
+    void record(std::chrono::duration<Rep, Period> value)
+    {
+        const auto ns =
+            std::chrono::duration_cast<std::chrono::nanoseconds>(value)
+                .count();
+
+        record(static_cast<std::uint64_t>(ns > 0 ? ns : 0));
+    }
+
+    /// Safe to call from any thread.
+    histogram_snapshot snapshot() const;
+
+private:
+    // Only one writer so a load and a store is enough. Cheaper than a
+    // locked read-modify-write.
+    static void increment(std::atomic<std::uint64_t>& value)
+    {
+        add(value, 1);
+    }
+
+    static void add(std::atomic<std::uint64_t>& value, std::uint64_t n)
+    {
+        value.store(
+            value.load(std::memory_order_relaxed) + n,
+            std::memory_order_relaxed);
+    }
+
+    std::array<std::atomic<std::uint64_t>, histogram_snapshot::kBucketCount>
+        counts_{};
+    std::atomic<std::uint64_t> count_{};
+    std::atomic<std::uint64_t> sum_{};
+    std::atomic<std::uint64_t> max_{};
+};
+
+/// Copy of the metrics of one stream at one point in time.
+struct metrics_snapshot {
+    /// Bytes read from the socket, including headers and metadata.
+    std::uint64_t num_bytes{};
+
+    /// Measurement messages returned to the caller.
+    std::uint64_t num_frame{};
+
+    /// Metadata messages that changed the node list.
+    std::uint64_t num_metadata{};
+
+    /// Times the watchdog deadline was pushed back.
+    std::uint64_t num_deadline_extension{};
+
+    /// Time between two frames in nanoseconds.
+    histogram_snapshot arrival;
+
+    /// Time from when the length header of a frame is in the buffer until
+    /// the full payload is, in nanoseconds. Zero if they arrive in the same
+    /// read.
+    histogram_snapshot read;
+};
+
+/// Counters and histograms of one data stream.
+/**
+ * Attach to a stream to record. The stream only ever writes from the one
+ * thread that reads it. A scraper thread may call snapshot() at any time
+ * without stopping the stream.
+ *
+ * @code
+ * stream_metrics metrics;
+ * stream.metrics_ = &metrics;
+ *
+ * // Any thread
+ * const auto snapshot = metrics.snapshot();
+ * auto p99 = snapshot.arrival.percentile(99);
+ * @endcode
+ */
+class stream_metrics {
+public:
+    using clock_type = std::chrono::steady_clock;
+
+    void add_bytes(std::size_t n)
+    {
+        add(num_bytes_, n);
+    }
+
+    /// Count a frame that arrived now.
+    void add_frame(clock_type::time_point now)
+    {
+        if (last_frame_ != clock_type::time_point{}) {
+            arrival_.record(now - last_frame_);
+        }
+
+        last_frame_ = now;
+        add(num_frame_, 1);
+    }
+
+    void add_read(clock_type::duration header_to_payload)
+    {
+        read_.record(header_to_payload);
+    }
+
+    void add_metadata()
+    {
+        add(num_metadata_, 1);
+    }
+
+    void add_deadline_extension()
+    {
+        add(num_deadline_extension_, 1);
+    }
+
+    /// Safe to call from any thread.
+    metrics_snapshot snapshot() const;
+
+private:
+    static void add(std::atomic<std::uint64_t>& value, std::uint64_t n)
+    {
+        value.store(
+            value.load(std::memory_order_relaxed) + n,
+            std::memory_order_relaxed);
+    }
+
+    std::atomic<std::uint64_t> num_bytes_{};
+    std::atomic<std::uint64_t> num_frame_{};
+    std::atomic<std::uint64_t> num_metadata_{};
+    std::atomic<std::uint64_t> num_deadline_extension_{};
+
+    latency_histogram arrival_;
+    latency_histogram read_;
+
+    // Writer only.
+    clock_type::time_point last_frame_{};
+};
+
+/// Call a function with the metrics if metrics are enabled and attached.
+/**
+ * @code
+ * record_metrics(stream.metrics_, [n](stream_metrics& m) { m.add_bytes(n); });
+ * @endcode
+ */
+template <typename F>
+void record_metrics(stream_metrics* metrics, F&& f)
+{
+    if constexpr (kEnableMetrics) {
+        if (metrics != nullptr) {
+            f(*metrics);
+        }
+    }
+}
+
+} // namespace shadowmocap
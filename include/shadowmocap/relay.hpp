@@ -0,0 +1,144 @@
+// Copyright Motion Workshop. All Rights Reserved.
+#pragma once
+
+#include <shadowmocap/batch_writer.hpp>
+#include <shadowmocap/datastream.hpp>
+#include <shadowmocap/message.hpp>
+#include <shadowmocap/subset.hpp>
+
+#include <asio/awaitable.hpp>
+#include <asio/steady_timer.hpp>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace shadowmocap {
+
+struct relay_options {
+    /// Service name sent to clients in the handshake. Only clients of the
+    /// "configurable" service send a channel request, the others get every
+    /// upstream channel.
+    std::string name = "configurable";
+
+    /// Drop frames for a client that has more than this many bytes queued,
+    /// i.e. it reads slower than the upstream sends.
+    std::size_t max_queue_size = 1 << 20;
+
+    /// Write batching for every client.
+    batch_options batch;
+
+    /// Once the upstream fails, give clients this long to receive what is
+    /// queued for them before they are disconnected.
+    std::chrono::milliseconds drain_timeout{1000};
+};
+
+/// Share one upstream data stream with many downstream clients.
+/**
+ * Clients speak the same protocol as the Shadow data service. Each client
+ * requests any subset of the upstream channels and gets frames with only
+ * those channels. Every frame is encoded once per distinct client mask and
+ * shared by reference between the clients, not copied. Each client has its
+ * own write queue so a slow client drops frames rather than stall the others.
+ *
+ * Runs on the executor of the upstream socket. The acceptor and upstream
+ * must use the same single threaded executor or strand.
+ *
+ * When the upstream fails, run() closes the acceptor, lets every client
+ * drain its queue up to the drain timeout, and waits for serve() and every
+ * session to end before it throws. The relay may then be destroyed.
+ *
+ * @code
+ * auto upstream = co_await open_connection(endpoint);
+ * co_await write_message(upstream, make_channel_message(mask));
+ *
+ * relay relay(upstream, mask);
+ * co_spawn(executor, relay.serve(acceptor), detached);
+ * co_await relay.run();
+ * @endcode
+ */
+class relay {
+public:
+    /**
+     * @param upstream Connected stream that sent its channel request and has
+     * not read any messages since. Must outlive the relay.
+     * @param mask Channels requested from the upstream
+     */
+    relay(datastream& upstream, int mask, relay_options options = {});
+
+    relay(const relay&) = delete;
+    relay& operator=(const relay&) = delete;
+
+    /// Read messages from the upstream and send them to every client. Runs
+    /// until the upstream fails. Then stops serve() and ends every session
+    /// before it rethrows the upstream error.
+    asio::awaitable<void> run();
+
+    /// Accept clients and start a session for each one. Runs until the
+    /// acceptor is closed or run() ends. Start it before run().
+    asio::awaitable<void> serve(tcp::acceptor& acceptor);
+
+    /// Number of clients that finished the handshake.
+    std::size_t num_client() const
+    {
+        return clients_.size();
+    }
+
+    /// Number of frames dropped for slow clients.
+    std::uint64_t num_dropped() const
+    {
+        return num_dropped_;
+    }
+
+private:
+    struct client {
+        client(tcp::socket socket, const batch_options& options);
+
+        tcp::socket socket;
+        batch_writer writer;
+        const channel_subset* subset{};
+    };
+
+    asio::awaitable<void> session(std::shared_ptr<client> ptr);
+
+    // Called at the end of serve() and every session(). Wakes stop().
+    void end_task();
+    void end_session(const std::shared_ptr<client>& ptr);
+
+    // Close the acceptor, drain or drop every client, and wait for all of
+    // the coroutines that use this relay.
+    asio::awaitable<void> stop();
+
+    // Frame for one client mask. Shared by all clients with that mask.
+    shared_message
+    get_frame(std::string_view message, const channel_subset& subset);
+
+    datastream& upstream_;
+    message_layout layout_;
+    relay_options options_;
+
+    // Most recent node list. Sent to clients when they connect.
+    shared_message metadata_;
+
+    std::vector<std::shared_ptr<client>> clients_;
+
+    // Every session, including the ones still in the handshake, and the
+    // number of serve() and session() coroutines that are still running.
+    std::vector<std::shared_ptr<client>> sessions_;
+    std::size_t num_task_{};
+    tcp::acceptor* acceptor_{};
+    asio::steady_timer idle_;
+    bool stopped_{};
+
+    // Frames for each distinct client mask for the current upstream message.
+    std::vector<std::pair<int, shared_message>> frames_;
+    std::string buffer_;
+
+    std::uint64_t num_dropped_{};
+};
+
+} // namespace shadowmocap
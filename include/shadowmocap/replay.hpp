@@ -0,0 +1,56 @@
+// Copyright Motion Workshop. All Rights Reserved.
+#pragma once
+
+#include <shadowmocap/capture.hpp>
+#include <shadowmocap/datastream.hpp>
+
+#include <asio/awaitable.hpp>
+
+#include <string>
+
+namespace shadowmocap {
+
+struct replay_options {
+    /// Playback speed. 1 is the original rate, 2 is twice as fast, and so
+    /// on. Zero or less sends frames as fast as the client reads them.
+    double rate = 1;
+
+    /// Start over from the first frame after the last one.
+    bool loop = false;
+
+    /// Service name sent to the client in the handshake. Only a client of
+    /// the "configurable" service sends a channel request.
+    std::string name = "configurable";
+};
+
+/// Stream a capture to one client as if it were the Shadow data service.
+/**
+ * Sends the service XML, reads the channel request if the service is
+ * "configurable", and sends the node list.
+ * Then sends every frame with the same timing as the original session, scaled
+ * by the playback rate. Metadata changes are sent before the first frame
+ * that uses them. The recorded channels are sent regardless of the request.
+ *
+ * Runs until the end of the capture or the client disconnects. The reader
+ * is not modified so many sessions may share it across threads.
+ */
+asio::awaitable<void> replay_session(
+    tcp::socket socket, const capture_reader& reader, replay_options options);
+
+/// Accept client connections and start a replay_session for each one.
+/**
+ * Sessions run on the executor of the acceptor. Use a thread pool to spread
+ * many clients over many cores.
+ *
+ * @code
+ * asio::thread_pool pool;
+ * tcp::acceptor acceptor{pool, tcp::endpoint{tcp::v4(), 32076}};
+ * co_spawn(pool, replay_server(acceptor, reader, {}), detached);
+ * pool.join();
+ * @endcode
+ */
+asio::awaitable<void> replay_server(
+    tcp::acceptor& acceptor, const capture_reader& reader,
+    replay_options options);
+
+} // namespace shadowmocap
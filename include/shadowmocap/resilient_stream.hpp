@@ -0,0 +1,202 @@
+// Copyright Motion Workshop. All Rights Reserved.
+#pragma once
+
+#include <shadowmocap/datastream.hpp>
+#include <shadowmocap/message.hpp>
+#include <shadowmocap/metrics.hpp>
+
+#include <asio/any_io_executor.hpp>
+#include <asio/awaitable.hpp>
+#include <asio/steady_timer.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <string_view>
+
+namespace shadowmocap {
+
+struct reconnect_options {
+    /// Drop the connection if there is no message for this long. Also limits
+    /// the connect and handshake.
+    std::chrono::steady_clock::duration timeout = std::chrono::seconds(1);
+
+    /// Wait before the second connection attempt in a row. The first attempt
+    /// after a frame is immediate. A connection that is lost before its first
+    /// frame does not reset the wait.
+    std::chrono::milliseconds initial_delay{100};
+
+    /// Longest wait between two connection attempts.
+    std::chrono::milliseconds max_delay{5000};
+
+    /// Grow the wait by this factor after every failed attempt.
+    double multiplier = 2;
+
+    /// Shorten each wait by a random fraction up to this much so many
+    /// clients of one service do not reconnect in lock step. In [0, 1].
+    double jitter = 0.5;
+
+    /// Give up after this many attempts in a row with no frame. Zero tries
+    /// forever.
+    int max_attempts = 0;
+
+    /// Record the read path of every connection if set. Not owned.
+    stream_metrics* metrics = nullptr;
+};
+
+/// Time span with no frames because the connection was lost.
+struct stream_gap {
+    using clock_type = std::chrono::steady_clock;
+
+    /// Receive time of the last frame before the connection was lost.
+    clock_type::time_point first;
+
+    /// Receive time of the first frame after the new connection.
+    clock_type::time_point last;
+
+    /// Number of connection attempts it took.
+    int num_attempt{};
+
+    clock_type::duration duration() const
+    {
+        return last - first;
+    }
+};
+
+/// Data stream that reconnects on its own.
+/**
+ * Connects on the first read. If the socket fails or there is no message for
+ * the timeout, reconnects with a jittered exponential backoff, sends the
+ * same channel request, and reads the new node list. Reads only fail if the
+ * stream is closed or runs out of attempts.
+ *
+ * The gap handler is called before the first frame on a new connection with
+ * the span of time that has no frames, so the consumer can interpolate or
+ * hold across it.
+ *
+ * @code
+ * resilient_stream stream(executor, endpoint, channel::Lq | channel::c);
+ * stream.on_gap([](const stream_gap& gap) {
+ *     // No frames for gap.duration()
+ * });
+ *
+ * std::string buffer;
+ * for (;;) {
+ *     auto message = co_await stream.read(buffer);
+ *     auto name = stream.nodes().name(key);
+ * }
+ * @endcode
+ */
+class resilient_stream {
+public:
+    using clock_type = std::chrono::steady_clock;
+
+    /// Called once per reconnect, just before the first frame.
+    using gap_handler = std::function<void(const stream_gap& gap)>;
+
+    /**
+     * @param endpoint Address of the Shadow data service
+     * @param mask Bitmask of channels to request on every connection
+     */
+    resilient_stream(
+        const asio::any_io_executor& executor, tcp::endpoint endpoint,
+        int mask, reconnect_options options = {});
+
+    ~resilient_stream();
+
+    resilient_stream(const resilient_stream&) = delete;
+    resilient_stream& operator=(const resilient_stream&) = delete;
+
+    void on_gap(gap_handler handler);
+
+    /// Read the next frame. Connects or reconnects as needed. Metadata
+    /// messages update nodes() and are not returned.
+    /**
+     * @return View of the message bytes in the buffer. Valid until the next
+     * read.
+     *
+     * @throw asio::system_error if the stream was closed, or the error of the
+     * last attempt if there were max_attempts attempts in a row with no
+     * frame.
+     * Exceptions from the gap handler pass through, the connection stays up.
+     */
+    asio::awaitable<std::string_view> read(std::string& buffer);
+
+    /// Close the connection and stop any read in progress.
+    void close();
+
+    /// Nodes from the most recent metadata message.
+    const node_map& nodes() const;
+
+    bool is_connected() const
+    {
+        return connected_;
+    }
+
+    /// Number of connections made, including the first one.
+    std::uint64_t num_connect() const
+    {
+        return num_connect_;
+    }
+
+    /// Number of connection attempts that failed.
+    std::uint64_t num_failed() const
+    {
+        return num_failed_;
+    }
+
+private:
+    // One connection and its watchdog. Shared with the watchdog so it can
+    // outlive the stream.
+    struct connection {
+        explicit connection(const asio::any_io_executor& executor);
+
+        datastream stream;
+        asio::steady_timer timer;
+        clock_type::time_point deadline;
+        bool closed{};
+
+        void close();
+    };
+
+    static asio::awaitable<void> watch(std::shared_ptr<connection> ptr);
+
+    asio::awaitable<void> connect();
+    asio::awaitable<void> reconnect();
+    void disconnect();
+
+    asio::any_io_executor executor_;
+    tcp::endpoint endpoint_;
+    std::string request_;
+    reconnect_options options_;
+    gap_handler on_gap_;
+
+    std::shared_ptr<connection> connection_;
+    bool connected_{};
+
+    // Connection in the middle of connect and handshake, so close can stop it.
+    std::shared_ptr<connection> pending_;
+    bool closed_{};
+
+    // Wait between attempts. The attempt count and the next wait carry over
+    // between connections and reset only when a frame arrives, so a service
+    // that drops every connection after the handshake still gets a backoff.
+    asio::steady_timer timer_;
+    std::minstd_rand random_;
+    std::chrono::duration<double, std::milli> delay_{};
+    int num_attempt_{};
+
+    // Receive time of the most recent frame, and the gap in progress.
+    clock_type::time_point last_frame_;
+    stream_gap gap_;
+    bool has_frame_{};
+    bool has_gap_{};
+
+    std::uint64_t num_connect_{};
+    std::uint64_t num_failed_{};
+};
+
+} // namespace shadowmocap
@@ -0,0 +1,174 @@
+// Copyright Motion Workshop. All Rights Reserved.
+#pragma once
+
+#include <shadowmocap/channel.hpp>
+#include <shadowmocap/message.hpp>
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace shadowmocap {
+
+/// Minimal allocator that aligns storage for SIMD loads and stores.
+template <typename T, std::size_t Alignment>
+struct aligned_allocator {
+    using value_type = T;
+
+    template <typename U>
+    struct rebind {
+        using other = aligned_allocator<U, Alignment>;
+    };
+
+    aligned_allocator() = default;
+
+    template <typename U>
+    constexpr aligned_allocator(const aligned_allocator<U, Alignment>&) noexcept
+    {
+    }
+
+    T* allocate(std::size_t n)
+    {
+        return static_cast<T*>(
+            ::operator new(n * sizeof(T), std::align_val_t{Alignment}));
+    }
+
+    void deallocate(T* ptr, std::size_t) noexcept
+    {
+        ::operator delete(ptr, std::align_val_t{Alignment});
+    }
+
+    template <typename U>
+    bool operator==(const aligned_allocator<U, Alignment>&) const noexcept
+    {
+        return true;
+    }
+};
+
+/// Structure of arrays decoding of a binary message.
+/**
+ * Transpose the items of a message into one contiguous array for every
+ * scalar value of every channel. For example, all of the Lqw values for all
+ * nodes, then all of the Lqx values, and so on. Each array is aligned and
+ * padded with zeros for SIMD loads of kWidth floats.
+ *
+ * Storage is reused between calls to decode so there is no allocation once
+ * the node count is stable.
+ *
+ * @code
+ * soa_frame frame(channel::Lq | channel::c);
+ * if (frame.decode(message)) {
+ *     auto w = frame.values(channel::Lq, 0);
+ *     auto x = frame.values(channel::Lq, 1);
+ *     ...
+ * }
+ * @endcode
+ */
+class soa_frame {
+public:
+    /// Number of floats in the widest SIMD register we use.
+    static constexpr std::size_t kWidth = 8;
+
+    /// Byte alignment of every array.
+    static constexpr std::size_t kAlignment = kWidth * sizeof(float);
+
+    soa_frame() = default;
+
+    explicit soa_frame(int mask);
+
+    /// Transpose all of the items in a binary message.
+    /**
+     * @return @c false and leave the frame empty if the message does not
+     * match the channel layout, otherwise @c true.
+     */
+    bool decode(std::string_view message);
+
+    /// Number of nodes in the last decoded message.
+    std::size_t size() const
+    {
+        return keys_.size();
+    }
+
+    bool empty() const
+    {
+        return keys_.empty();
+    }
+
+    const message_layout& layout() const
+    {
+        return layout_;
+    }
+
+    /// Length of every array including padding. Multiple of kWidth.
+    std::size_t stride() const
+    {
+        return stride_;
+    }
+
+    /// Node keys in message order.
+    std::span<const int> keys() const
+    {
+        return keys_;
+    }
+
+    /// Values of one scalar of a channel for all nodes, i.e. axis 1 of
+    /// channel::Lq is Lqx. Returns an empty span if the channel is not in the
+    /// layout.
+    std::span<const float> values(channel c, int axis = 0) const
+    {
+        const auto offset = layout_.offset(c);
+        if ((offset < 0) || (axis < 0) || (axis >= get_channel_dimension(c))) {
+            return {};
+        }
+
+        return {data_.data() + (offset + axis) * stride_, size()};
+    }
+
+    std::span<float> values(channel c, int axis = 0)
+    {
+        const auto offset = layout_.offset(c);
+        if ((offset < 0) || (axis < 0) || (axis >= get_channel_dimension(c))) {
+            return {};
+        }
+
+        return {data_.data() + (offset + axis) * stride_, size()};
+    }
+
+    /// Map from node key to node name, from the metadata message.
+    const node_map& nodes() const
+    {
+        return nodes_;
+    }
+
+    void set_nodes(const node_map& nodes)
+    {
+        nodes_ = nodes;
+    }
+
+private:
+    message_layout layout_;
+    std::vector<int> keys_;
+    std::vector<float, aligned_allocator<float, kAlignment>> data_;
+    std::size_t stride_ = 0;
+    node_map nodes_;
+};
+
+namespace detail {
+
+/// Transpose num_item items of dim floats each from the packed message bytes
+/// into dim arrays of length stride. Exposed for testing of the SIMD paths.
+void transpose_items(
+    const char* message, std::size_t num_item, int dim, int mask, float* out,
+    std::size_t stride);
+
+void transpose_items_scalar(
+    const char* message, std::size_t num_item, int dim, float* out,
+    std::size_t stride);
+
+} // namespace detail
+
+} // namespace shadowmocap
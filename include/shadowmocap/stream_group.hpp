@@ -0,0 +1,130 @@
+// Copyright Motion Workshop. All Rights Reserved.
+#pragma once
+
+#include <shadowmocap/datastream.hpp>
+#include <shadowmocap/message.hpp>
+#include <shadowmocap/metrics.hpp>
+
+#include <asio/cancellation_signal.hpp>
+#include <asio/io_context.hpp>
+#include <asio/ip/tcp.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace shadowmocap {
+
+/// Run many data streams at once on a pool of threads.
+/**
+ * Each thread runs its own io_context. Streams are spread over the threads
+ * round robin so each stream is only ever run by one thread and needs no
+ * locking. Every stream requests its channels, reads frames, and has its own
+ * watchdog timer.
+ *
+ * @code
+ * stream_group group(4);
+ * for (auto& endpoint : endpoints) {
+ *     group.add(endpoint, channel::Lq | channel::c);
+ * }
+ *
+ * group.start([](std::size_t index, std::string_view message,
+ *                const node_map& nodes) {
+ *     // Called on the thread that owns stream #index
+ * });
+ *
+ * group.join();
+ * @endcode
+ */
+class stream_group {
+public:
+    /// Called once for every frame. The message is only valid for the
+    /// duration of the call. Handlers for different streams may run
+    /// concurrently on different threads.
+    using frame_handler = std::function<void(
+        std::size_t index, std::string_view message, const node_map& nodes)>;
+
+    /// Called once if a stream stops with an error, i.e. the connection is
+    /// refused or the watchdog timer expires.
+    using error_handler =
+        std::function<void(std::size_t index, std::exception_ptr ptr)>;
+
+    /// Create a group with a fixed number of threads. Defaults to one thread
+    /// per core.
+    explicit stream_group(
+        std::size_t num_thread = std::thread::hardware_concurrency());
+
+    ~stream_group();
+
+    stream_group(const stream_group&) = delete;
+    stream_group& operator=(const stream_group&) = delete;
+
+    /// Add a stream to the group. Call before start().
+    /**
+     * @param endpoint Address of the Shadow data service
+     * @param mask Bitmask of channels to request
+     * @param timeout Stop the stream if there is no frame for this long
+     * @param metrics Record the read path of the stream if set. Must
+     * outlive the group.
+     *
+     * @return Index of the stream that is passed to the handlers
+     */
+    std::size_t add(
+        tcp::endpoint endpoint, int mask,
+        std::chrono::steady_clock::duration timeout = std::chrono::seconds(1),
+        stream_metrics* metrics = nullptr);
+
+    /// Connect all of the streams and start the threads.
+    void start(frame_handler on_frame, error_handler on_error = {});
+
+    /// Stop all of the streams and threads. Each stream is cancelled and
+    /// closes its connection, and each thread exits once its streams have
+    /// ended. Streams stopped this way do not call the error handler. Safe to
+    /// call from any thread, including from inside of a handler.
+    void stop();
+
+    /// Wait for all of the streams to end, or for a call to stop().
+    void join();
+
+    std::size_t num_thread() const
+    {
+        return contexts_.size();
+    }
+
+    std::size_t size() const
+    {
+        return streams_.size();
+    }
+
+private:
+    struct stream_options {
+        tcp::endpoint endpoint;
+        int mask{};
+        std::chrono::steady_clock::duration timeout{};
+        stream_metrics* metrics{};
+    };
+
+    asio::awaitable<void> run_stream(std::size_t index);
+
+    asio::awaitable<void> read_frames(
+        std::size_t index, datastream& stream,
+        std::chrono::steady_clock::time_point& deadline);
+
+    std::vector<std::unique_ptr<asio::io_context>> contexts_;
+    std::vector<std::thread> threads_;
+    std::vector<stream_options> streams_;
+    frame_handler on_frame_;
+    error_handler on_error_;
+
+    // One per stream, emitted by stop() on the context of the stream.
+    std::vector<std::unique_ptr<asio::cancellation_signal>> signals_;
+    std::atomic<bool> stopped_{false};
+};
+
+} // namespace shadowmocap
@@ -0,0 +1,113 @@
+// Copyright Motion Workshop. All Rights Reserved.
+#pragma once
+
+#include <shadowmocap/channel.hpp>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+
+namespace shadowmocap {
+
+/// Re-encode a binary message with a subset of its channels.
+/**
+ * The copy plan is computed once from the two masks. Channels that are next
+ * to each other in both layouts merge into one run, so each item is the key,
+ * the new length, and a few straight memcpy runs. There is no per channel
+ * work per frame.
+ *
+ * @code
+ * const auto& subset = get_channel_subset(mask, channel::Lq | channel::c);
+ * std::string out;
+ * if (subset.apply(message, out)) {
+ *     // Same items as message with only the Lq and c channels
+ * }
+ * @endcode
+ */
+class channel_subset {
+public:
+    /**
+     * @param from Channels of the input messages
+     * @param to Channels of the output messages
+     *
+     * @throw std::invalid_argument if to is not a subset of from
+     */
+    channel_subset(int from, int to);
+
+    int from() const
+    {
+        return from_;
+    }
+
+    int to() const
+    {
+        return to_;
+    }
+
+    /// Number of bytes of one input item, including the key and length.
+    std::size_t input_item_size() const
+    {
+        return input_item_size_;
+    }
+
+    /// Number of bytes of one output item, including the key and length.
+    std::size_t output_item_size() const
+    {
+        return output_item_size_;
+    }
+
+    /// Number of bytes of output for a message of this many bytes.
+    std::size_t output_size(std::size_t input_size) const
+    {
+        return (input_size / input_item_size_) * output_item_size_;
+    }
+
+    /// Write the subset of every item of the message.
+    /**
+     * @param out Must hold at least output_size(message.size()) bytes
+     *
+     * @return Number of bytes written. Returns 0 if the message is not a
+     * whole number of items or the length of any item does not match.
+     */
+    std::size_t apply(std::string_view message, std::span<char> out) const;
+
+    /// Resize the string and write the subset of every item into it.
+    /**
+     * @return @c false if the message does not match the input layout
+     */
+    bool apply(std::string_view message, std::string& out) const;
+
+private:
+    // Copy size bytes from offset src of the input item to offset dst of the
+    // output item.
+    struct run {
+        std::uint16_t src;
+        std::uint16_t dst;
+        std::uint16_t size;
+    };
+
+    int from_{};
+    int to_{};
+    int dimension_{};
+    std::size_t input_item_size_{};
+    std::size_t output_item_size_{};
+
+    // At most one run per channel.
+    std::array<run, kNumChannel> runs_{};
+    std::size_t num_run_{};
+};
+
+/// Shared copy plan for a pair of masks.
+/**
+ * Plans are created on first use and kept for the life of the process. Safe
+ * to call from any thread. The reference is valid forever so look it up once
+ * per stream or client, not per frame.
+ *
+ * @throw std::invalid_argument if to is not a subset of from
+ */
+const channel_subset& get_channel_subset(int from, int to);
+
+} // namespace shadowmocap
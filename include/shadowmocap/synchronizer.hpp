@@ -0,0 +1,187 @@
+// Copyright Motion Workshop. All Rights Reserved.
+#pragma once
+
+#include <shadowmocap/channel.hpp>
+#include <shadowmocap/frame_ring.hpp>
+#include <shadowmocap/message.hpp>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace shadowmocap {
+
+struct sync_options {
+    /// Channel with the time of each frame in seconds, timestamp or
+    /// systime. The timestamp of every stream is on its own clock. The
+    /// systime of every stream is on one shared clock. Streams that do not
+    /// have the channel use the time their frames arrive.
+    channel time_channel = channel::timestamp;
+
+    /// Sample this far in the past so there is a frame on both sides of the
+    /// sample time. Upper bound on the latency added to every stream that
+    /// keeps up.
+    std::chrono::microseconds latency{20'000};
+
+    /// Mark a stream as stale if its newest frame is this much older than
+    /// the sample time.
+    std::chrono::microseconds max_hold{100'000};
+
+    /// Frames per stream that can wait for the next sample, and frames kept
+    /// to interpolate between. At least the frame rate times the latency
+    /// plus two.
+    std::size_t capacity = 16;
+
+    /// Reserve this many bytes in every frame.
+    std::size_t message_capacity = 0;
+};
+
+/// How the frame of one stream in a sample was made.
+enum class sync_state {
+    /// No frame from the stream yet.
+    empty,
+
+    /// Interpolated between the frames just before and just after the
+    /// sample time.
+    interpolated,
+
+    /// No frame on one side of the sample time. Nearest frame as is.
+    held,
+
+    /// Held, and the newest frame is older than max_hold.
+    stale
+};
+
+/// Frame of one stream at the sample time.
+struct sync_sample {
+    /// Binary message in the same layout as the stream. Quaternion channels
+    /// use slerp and every other value is linear. Keeps its capacity between
+    /// samples.
+    std::string message;
+
+    sync_state state = sync_state::empty;
+
+    /// Sample time minus the time of the newest frame if held. Negative if
+    /// the stream only has frames after the sample time. Zero otherwise.
+    std::chrono::steady_clock::duration lag{};
+};
+
+/// Frames of all streams at one time.
+struct sync_frame {
+    /// Sample time on the local clock, i.e. now minus the latency.
+    std::chrono::steady_clock::time_point time{};
+
+    /// One per stream in the order they were added.
+    std::vector<sync_sample> streams;
+};
+
+/// Align frames from many streams in time and sample them all at once.
+/**
+ * Each stream thread pushes frames into its own single producer, single
+ * consumer ring, so producers never wait on a lock or on each other. One
+ * consumer thread calls sample() once per tick to get a merged frame of every
+ * stream at the same time.
+ *
+ * The time of a frame is the time channel of its first node. The local time
+ * of source time zero is the earliest arrival seen so far, per stream for
+ * timestamp or shared by all streams for systime. Every frame is O(1) work
+ * on top of one pass over its bytes to check and copy it. Every sample is
+ * O(number of streams) plus the interpolation of each message.
+ *
+ * @code
+ * synchronizer sync;
+ * for (auto& endpoint : endpoints) {
+ *     group.add(endpoint, mask);
+ *     sync.add(mask);
+ * }
+ *
+ * // Stream threads
+ * group.start([&sync](std::size_t index, std::string_view message,
+ *                     const node_map&) {
+ *     sync.push(index, message, std::chrono::steady_clock::now());
+ * });
+ *
+ * // Render thread, every tick
+ * const auto& frame = sync.sample(std::chrono::steady_clock::now());
+ * for (const auto& stream : frame.streams) {
+ *     auto view = make_message_view(stream.message, layout);
+ * }
+ * @endcode
+ */
+class synchronizer {
+public:
+    using clock_type = std::chrono::steady_clock;
+
+    explicit synchronizer(sync_options options = {});
+
+    ~synchronizer();
+
+    synchronizer(const synchronizer&) = delete;
+    synchronizer& operator=(const synchronizer&) = delete;
+
+    /// Add a stream. Call before any push or sample.
+    /**
+     * @param mask Channels of the stream
+     *
+     * @return Index of the stream
+     */
+    std::size_t add(int mask);
+
+    /// Producer only, one thread per stream. Copy a frame into the ring of a
+    /// stream. Drops the oldest waiting frame if the ring is full.
+    void push(
+        std::size_t index, std::string_view message,
+        clock_type::time_point now);
+
+    /// Producer only. Ring of a stream to fill without a copy, i.e. with
+    /// read_frames.
+    frame_ring& ring(std::size_t index);
+
+    /// Consumer only. Take all waiting frames and sample every stream.
+    /**
+     * @return Merged frame. Valid until the next call to sample.
+     */
+    const sync_frame& sample(clock_type::time_point now);
+
+    /// Number of streams.
+    std::size_t size() const
+    {
+        return streams_.size();
+    }
+
+    const sync_options& options() const
+    {
+        return options_;
+    }
+
+private:
+    struct stream;
+
+    void add_frame(stream& s, const frame_slot& slot);
+
+    void sample_stream(stream& s, sync_sample& out);
+
+    // Blend two messages of a stream into out. Returns false if they do not
+    // have the same nodes.
+    static bool interpolate(
+        const stream& s, std::string_view a, std::string_view b, float t,
+        std::string& out);
+
+    clock_type::time_point get_offset(const stream& s) const;
+
+    sync_options options_;
+    std::vector<std::unique_ptr<stream>> streams_;
+
+    // Consumer thread state.
+    sync_frame frame_;
+
+    // Local time of source time zero for the shared systime clock.
+    clock_type::time_point offset_{};
+    bool has_offset_{};
+};
+
+} // namespace shadowmocap
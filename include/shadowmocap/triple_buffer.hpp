@@ -0,0 +1,147 @@
+// Copyright Motion Workshop. All Rights Reserved.
+#pragma once
+
+#include <shadowmocap/datastream.hpp>
+#include <shadowmocap/frame_ring.hpp>
+
+#include <asio/awaitable.hpp>
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+namespace shadowmocap {
+
+/// Wait-free single producer, single consumer "latest value" buffer.
+/**
+ * The producer writes into a back buffer and publishes it. The consumer
+ * takes the most recently published buffer. Three buffers mean the producer
+ * never waits for the consumer and the consumer never sees a frame that is
+ * partly written. Frames published between two consumer updates are skipped.
+ *
+ * @code
+ * triple_buffer<soa_frame> latest{soa_frame{mask}};
+ *
+ * // Consumer thread, once per render frame
+ * if (latest.update()) {
+ *     const auto skipped = latest.frame() - last - 1;
+ *     last = latest.frame();
+ *     const soa_frame& frame = latest.read_buffer();
+ * }
+ * @endcode
+ */
+template <typename T>
+class triple_buffer {
+public:
+    triple_buffer() = default;
+
+    /// Initialize all three buffers, e.g. with storage that is already
+    /// allocated.
+    explicit triple_buffer(const T& value)
+        : buffers_{{{value, 0}, {value, 0}, {value, 0}}}
+    {
+    }
+
+    triple_buffer(const triple_buffer&) = delete;
+    triple_buffer& operator=(const triple_buffer&) = delete;
+
+    /// Producer only. Buffer to fill with the next frame.
+    T& write_buffer()
+    {
+        return buffers_[back_].value;
+    }
+
+    /// Producer only. Publish the write buffer as the latest frame.
+    void publish()
+    {
+        buffers_[back_].frame = ++frame_;
+
+        const auto prev =
+            state_.exchange(back_ | kDirty, std::memory_order_acq_rel);
+
+        back_ = prev & kIndexMask;
+    }
+
+    /// Consumer only. Take the latest frame if there is a new one.
+    /**
+     * @return @c true if the read buffer changed
+     */
+    bool update()
+    {
+        if (!(state_.load(std::memory_order_relaxed) & kDirty)) {
+            return false;
+        }
+
+        const auto prev = state_.exchange(front_, std::memory_order_acq_rel);
+
+        front_ = prev & kIndexMask;
+
+        return true;
+    }
+
+    /// Consumer only. The frame taken by the last successful update.
+    const T& read_buffer() const
+    {
+        return buffers_[front_].value;
+    }
+
+    /// Consumer only. Frame counter of the read buffer, starting at 1 for
+    /// the first published frame. Zero if there is no frame yet.
+    std::uint64_t frame() const
+    {
+        return buffers_[front_].frame;
+    }
+
+private:
+    static constexpr std::uint8_t kIndexMask = 0x3;
+    static constexpr std::uint8_t kDirty = 0x4;
+
+    struct buffer {
+        T value{};
+        std::uint64_t frame{};
+    };
+
+    std::array<buffer, 3> buffers_{};
+
+    // Index of the middle buffer, plus the dirty bit if it holds a frame
+    // that the consumer has not taken yet.
+    alignas(kCacheLineSize) std::atomic<std::uint8_t> state_{1};
+
+    // Producer thread state.
+    alignas(kCacheLineSize) std::uint8_t back_{0};
+    std::uint64_t frame_{};
+
+    // Consumer thread state.
+    alignas(kCacheLineSize) std::uint8_t front_{2};
+};
+
+/// Read, decode, and publish every frame from the stream.
+/**
+ * T is a decoder with a <tt>bool decode(std::string_view)</tt> method, e.g.
+ * soa_frame. Decodes straight into the write buffer so a frame is never
+ * copied. Runs until the stream fails. Throws std::length_error if a message
+ * does not match the decoder.
+ *
+ * @code
+ * triple_buffer<soa_frame> latest{soa_frame{mask}};
+ * co_spawn(ioc, read_latest(stream, latest), detached);
+ * @endcode
+ */
+template <typename T>
+asio::awaitable<void> read_latest(datastream& stream, triple_buffer<T>& latest)
+{
+    std::string buffer;
+    for (;;) {
+        const auto message = co_await read_message(stream, buffer);
+
+        if (!latest.write_buffer().decode(message)) {
+            throw std::length_error("message does not match frame decoder");
+        }
+
+        latest.publish();
+    }
+}
+
+} // namespace shadowmocap
@@ -0,0 +1,159 @@
+// Copyright Motion Workshop. All Rights Reserved.
+#include <shadowmocap/batch_writer.hpp>
+
+#include <asio/redirect_error.hpp>
+#include <asio/use_awaitable.hpp>
+#include <asio/write.hpp>
+
+#include <system_error>
+#include <utility>
+
+namespace shadowmocap {
+
+shared_message make_shared_message(std::string_view message)
+{
+    const auto header = make_message_header(message.size());
+
+    auto result = std::make_shared<std::string>();
+    result->reserve(header.size() + message.size());
+    result->append(header.data(), header.size());
+    result->append(message);
+
+    return result;
+}
+
+batch_writer::batch_writer(tcp::socket& socket, batch_options options)
+    : socket_{socket}, options_{options}, wake_{socket.get_executor()},
+      idle_{socket.get_executor()}
+{
+}
+
+void batch_writer::write(std::string_view message)
+{
+    const auto header = make_message_header(message.size());
+
+    const auto offset = data_.size();
+    data_.append(header.data(), header.size());
+    data_.append(message);
+
+    const auto n = data_.size() - offset;
+
+    // Extend the previous copy so a run of copies is one buffer.
+    if (!entries_.empty() && !entries_.back().message) {
+        entries_.back().size += n;
+    } else {
+        if (entries_.empty()) {
+            first_ = clock_type::now();
+        }
+
+        entries_.push_back({nullptr, offset, n});
+    }
+
+    size_ += n;
+    if ((entries_.size() == 1) || (size_ >= options_.flush_size)) {
+        wake_.cancel();
+    }
+}
+
+void batch_writer::write(shared_message message)
+{
+    if (!message || message->empty()) {
+        return;
+    }
+
+    if (entries_.empty()) {
+        first_ = clock_type::now();
+    }
+
+    size_ += message->size();
+    entries_.push_back({std::move(message), 0, 0});
+
+    if ((entries_.size() == 1) || (size_ >= options_.flush_size)) {
+        wake_.cancel();
+    }
+}
+
+asio::awaitable<void> batch_writer::flush()
+{
+    // The write in flight armed the timer. Do not set its expiry here, that
+    // would cancel the wait of any other caller.
+    while (writing_) {
+        asio::error_code ec;
+        co_await idle_.async_wait(
+            asio::redirect_error(asio::use_awaitable, ec));
+    }
+
+    if (entries_.empty()) {
+        co_return;
+    }
+
+    // Swap the queue into the write in flight. Both keep their capacity so
+    // there is no allocation once they are large enough.
+    data_.swap(write_data_);
+    entries_.swap(write_entries_);
+    data_.clear();
+    entries_.clear();
+    size_ = 0;
+
+    buffers_.clear();
+    for (const auto& entry : write_entries_) {
+        if (entry.message) {
+            buffers_.push_back(asio::buffer(*entry.message));
+        } else {
+            buffers_.push_back(
+                asio::buffer(write_data_.data() + entry.offset, entry.size));
+        }
+    }
+
+    // Every flush() that comes in while we write waits for this timer.
+    idle_.expires_at(asio::steady_timer::time_point::max());
+    writing_ = true;
+    ++num_write_;
+
+    asio::error_code ec;
+    co_await asio::async_write(
+        socket_, buffers_, asio::redirect_error(asio::use_awaitable, ec));
+
+    // Release shared messages now rather than at the next write.
+    write_entries_.clear();
+
+    writing_ = false;
+    idle_.cancel();
+
+    if (ec) {
+        throw std::system_error{ec};
+    }
+}
+
+asio::awaitable<void> batch_writer::run()
+{
+    for (;;) {
+        if (!entries_.empty()) {
+            const auto deadline = first_ + options_.flush_interval;
+            if (closed_ || (size_ >= options_.flush_size) ||
+                (clock_type::now() >= deadline)) {
+                co_await flush();
+                continue;
+            }
+
+            wake_.expires_at(deadline);
+        } else if (closed_) {
+            co_return;
+        } else {
+            wake_.expires_at(asio::steady_timer::time_point::max());
+        }
+
+        // Woken early by write() or close().
+        asio::error_code ec;
+        co_await wake_.async_wait(
+            asio::redirect_error(asio::use_awaitable, ec));
+    }
+}
+
+void batch_writer::close()
+{
+    closed_ = true;
+    wake_.cancel();
+}
+
+} // namespace shadowmocap
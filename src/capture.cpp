@@ -0,0 +1,739 @@
+// Copyright Motion Workshop. All Rights Reserved.
+#include <shadowmocap/capture.hpp>
+
+#include <asio/buffer.hpp>
+#include <asio/co_spawn.hpp>
+#include <asio/detached.hpp>
+#include <asio/error.hpp>
+#include <asio/redirect_error.hpp>
+#include <asio/system_error.hpp>
+#include <asio/use_awaitable.hpp>
+#include <asio/write.hpp>
+
+#include <algorithm>
+#include <bit>
+#include <cerrno>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <system_error>
+#include <utility>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace shadowmocap {
+
+namespace {
+
+// The file format is little endian and the records are copied to and from
+// the file as they are in memory.
+static_assert(
+    std::endian::native == std::endian::little,
+    "capture files need a little endian host");
+
+template <typename T>
+void append_bytes(std::string& out, const T& value)
+{
+    const auto first = out.size();
+    out.resize(first + sizeof(T));
+    std::memcpy(out.data() + first, &value, sizeof(T));
+}
+
+std::int64_t to_nanoseconds(std::chrono::steady_clock::duration d)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(d).count();
+}
+
+template <typename T>
+T read_bytes(const char* data, std::uint64_t offset)
+{
+    T value;
+    std::memcpy(&value, data + offset, sizeof(T));
+    return value;
+}
+
+// First index in [0, n) for which pred is false. pred must be true for a
+// prefix of the range and false for the rest.
+template <typename Pred>
+std::uint64_t partition_point(std::uint64_t n, Pred pred)
+{
+    std::uint64_t first = 0;
+    while (n > 0) {
+        const auto half = n / 2;
+        if (pred(first + half)) {
+            first += half + 1;
+            n -= half + 1;
+        } else {
+            n = half;
+        }
+    }
+
+    return first;
+}
+
+[[noreturn]] void throw_not_valid()
+{
+    throw std::runtime_error("capture file is not valid");
+}
+
+#if defined(_WIN32)
+
+std::pair<const char*, std::size_t> map_file(const std::string& path)
+{
+    auto throw_last_error = []() {
+        throw std::system_error(
+            static_cast<int>(GetLastError()), std::system_category(),
+            "failed to map capture file");
+    };
+
+    HANDLE file = CreateFileA(
+        path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        throw_last_error();
+    }
+
+    LARGE_INTEGER size{};
+    if (!GetFileSizeEx(file, &size) || (size.QuadPart == 0)) {
+        CloseHandle(file);
+        throw_not_valid();
+    }
+
+    // The view keeps the file and mapping open after we close the handles.
+    HANDLE mapping =
+        CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);
+    if (mapping == nullptr) {
+        throw_last_error();
+    }
+
+    const void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (data == nullptr) {
+        throw_last_error();
+    }
+
+    return {
+        static_cast<const char*>(data),
+        static_cast<std::size_t>(size.QuadPart)};
+}
+
+void unmap_file(const char* data, std::size_t)
+{
+    UnmapViewOfFile(data);
+}
+
+#else
+
+std::pair<const char*, std::size_t> map_file(const std::string& path)
+{
+    auto throw_errno = []() {
+        throw std::system_error(
+            errno, std::generic_category(), "failed to map capture file");
+    };
+
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw_errno();
+    }
+
+    struct stat st {};
+    if ((::fstat(fd, &st) != 0) || (st.st_size == 0)) {
+        ::close(fd);
+        throw_not_valid();
+    }
+
+    const auto size = static_cast<std::size_t>(st.st_size);
+
+    // The mapping keeps the file open after we close the descriptor.
+    void* data = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) {
+        throw_errno();
+    }
+
+    // Most reads are one pass from front to back.
+    ::madvise(data, size, MADV_SEQUENTIAL);
+
+    return {static_cast<const char*>(data), size};
+}
+
+void unmap_file(const char* data, std::size_t size)
+{
+    ::munmap(const_cast<char*>(data), size);
+}
+
+#endif
+
+} // namespace
+
+capture_encoder::capture_encoder(
+    std::size_t chunk_size, clock_type::time_point start)
+    : chunk_size_{chunk_size}, start_{start}
+{
+    capture_header header{};
+    std::memcpy(header.magic, kCaptureMagic, sizeof(header.magic));
+    header.version = kCaptureVersion;
+    header.start_time =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch())
+            .count();
+
+    std::string block;
+    append_bytes(block, header);
+
+    offset_ = block.size();
+    blocks_.push_back(std::move(block));
+
+    chunk_.reserve(chunk_size_ + sizeof(capture_record_header) + (1 << 16));
+}
+
+void capture_encoder::channel_request(
+    std::string_view xml, clock_type::time_point time)
+{
+    channel_request_offset_ = offset_ + chunk_.size();
+    append(capture_record_type::channel_request, xml, time);
+}
+
+void capture_encoder::metadata(
+    std::string_view xml, clock_type::time_point time)
+{
+    metadata_.push_back(capture_metadata{offset_ + chunk_.size(), num_frame_});
+    append(capture_record_type::metadata, xml, time);
+}
+
+void capture_encoder::frame(
+    std::string_view message, clock_type::time_point time)
+{
+    append(capture_record_type::frame, message, time);
+}
+
+void capture_encoder::append(
+    capture_record_type type, std::string_view payload,
+    clock_type::time_point time)
+{
+    if (finished_) {
+        throw std::logic_error("capture is finished");
+    }
+
+    if (payload.size() > std::numeric_limits<std::uint32_t>::max()) {
+        throw std::length_error("capture record length is not valid");
+    }
+
+    const capture_record_header header{
+        type, static_cast<std::uint32_t>(payload.size()),
+        to_nanoseconds(time - start_)};
+
+    if (chunk_.empty()) {
+        entry_ = capture_chunk{};
+        entry_.offset = offset_;
+        entry_.first_frame = num_frame_;
+        entry_.first_time = header.time;
+    }
+
+    append_bytes(chunk_, header);
+    chunk_.append(payload);
+
+    if (type == capture_record_type::frame) {
+        if (entry_.num_frame == 0) {
+            entry_.first_frame = num_frame_;
+            entry_.first_time = header.time;
+        }
+
+        ++entry_.num_frame;
+        ++num_frame_;
+    }
+
+    if (chunk_.size() >= chunk_size_) {
+        seal();
+    }
+}
+
+void capture_encoder::seal()
+{
+    if (chunk_.empty()) {
+        return;
+    }
+
+    entry_.size = chunk_.size();
+    chunks_.push_back(entry_);
+
+    offset_ += chunk_.size();
+    blocks_.push_back(std::move(chunk_));
+
+    chunk_ = std::string{};
+    chunk_.reserve(chunk_size_ + sizeof(capture_record_header) + (1 << 16));
+}
+
+void capture_encoder::finish()
+{
+    if (finished_) {
+        return;
+    }
+
+    seal();
+    finished_ = true;
+
+    std::string block;
+    block.reserve(
+        chunks_.size() * sizeof(capture_chunk) +
+        metadata_.size() * sizeof(capture_metadata) + sizeof(capture_footer));
+
+    capture_footer footer{};
+    footer.chunk_offset = offset_;
+    footer.num_chunk = chunks_.size();
+    for (const auto& chunk : chunks_) {
+        append_bytes(block, chunk);
+    }
+
+    footer.metadata_offset = offset_ + block.size();
+    footer.num_metadata = metadata_.size();
+    for (const auto& metadata : metadata_) {
+        append_bytes(block, metadata);
+    }
+
+    footer.num_frame = num_frame_;
+    footer.channel_request_offset = channel_request_offset_;
+    std::memcpy(footer.magic, kCaptureMagic, sizeof(footer.magic));
+
+    append_bytes(block, footer);
+
+    offset_ += block.size();
+    blocks_.push_back(std::move(block));
+}
+
+std::vector<std::string> capture_encoder::take()
+{
+    std::vector<std::string> result;
+    result.swap(blocks_);
+
+    return result;
+}
+
+capture_reader::capture_reader(const std::string& path)
+{
+    std::tie(data_, size_) = map_file(path);
+
+    try {
+        if (size_ < sizeof(capture_header) + sizeof(capture_footer)) {
+            throw_not_valid();
+        }
+
+        const auto header = read_bytes<capture_header>(data_, 0);
+        footer_ =
+            read_bytes<capture_footer>(data_, size_ - sizeof(capture_footer));
+
+        if ((std::memcmp(header.magic, kCaptureMagic, sizeof(header.magic)) !=
+             0) ||
+            (std::memcmp(footer_.magic, kCaptureMagic, sizeof(footer_.magic)) !=
+             0) ||
+            (header.version != kCaptureVersion)) {
+            throw_not_valid();
+        }
+
+        // The index must sit between the records and the footer. Check the
+        // offsets before any unsigned subtraction so a bad footer cannot wrap.
+        const std::uint64_t end = size_ - sizeof(capture_footer);
+        if ((footer_.chunk_offset < sizeof(capture_header)) ||
+            (footer_.chunk_offset > end) || (footer_.metadata_offset > end)) {
+            throw_not_valid();
+        }
+
+        if ((footer_.num_chunk > (end - footer_.chunk_offset) /
+                                     sizeof(capture_chunk)) ||
+            (footer_.metadata_offset != footer_.chunk_offset +
+                                            footer_.num_chunk *
+                                                sizeof(capture_chunk)) ||
+            (footer_.num_metadata > (end - footer_.metadata_offset) /
+                                        sizeof(capture_metadata))) {
+            throw_not_valid();
+        }
+
+        for (std::uint64_t i = 0; i < footer_.num_chunk; ++i) {
+            const auto entry = chunk(i);
+            if ((entry.offset < sizeof(capture_header)) ||
+                (entry.offset >= footer_.chunk_offset) ||
+                (entry.size > footer_.chunk_offset - entry.offset)) {
+                throw_not_valid();
+            }
+        }
+
+        for (std::uint64_t i = 0; i < footer_.num_metadata; ++i) {
+            if (metadata_entry(i).offset >= footer_.chunk_offset) {
+                throw_not_valid();
+            }
+        }
+
+        if ((footer_.channel_request_offset != 0) &&
+            (footer_.channel_request_offset >= footer_.chunk_offset)) {
+            throw_not_valid();
+        }
+    } catch (...) {
+        unmap_file(data_, size_);
+        throw;
+    }
+}
+
+capture_reader::~capture_reader()
+{
+    if (data_ != nullptr) {
+        unmap_file(data_, size_);
+    }
+}
+
+capture_reader::capture_reader(capture_reader&& other) noexcept
+    : data_{std::exchange(other.data_, nullptr)},
+      size_{std::exchange(other.size_, 0)}, footer_{other.footer_}
+{
+}
+
+capture_reader& capture_reader::operator=(capture_reader&& other) noexcept
+{
+    std::swap(data_, other.data_);
+    std::swap(size_, other.size_);
+    std::swap(footer_, other.footer_);
+    return *this;
+}
+
+std::int64_t capture_reader::start_time() const
+{
+    return read_bytes<capture_header>(data_, 0).start_time;
+}
+
+std::string_view capture_reader::channel_request() const
+{
+    if (footer_.channel_request_offset == 0) {
+        return {};
+    }
+
+    return payload(footer_.channel_request_offset);
+}
+
+std::string_view capture_reader::metadata(std::uint64_t frame) const
+{
+    // Last metadata record that applies to this frame.
+    const auto i = partition_point(footer_.num_metadata, [&](auto i) {
+        return metadata_entry(i).frame <= frame;
+    });
+    if (i == 0) {
+        return {};
+    }
+
+    return payload(metadata_entry(i - 1).offset);
+}
+
+capture_reader::iterator capture_reader::begin() const
+{
+    return chunk_begin(0);
+}
+
+capture_reader::iterator capture_reader::end() const
+{
+    iterator result;
+    result.reader_ = this;
+    result.offset_ = result.next_ = footer_.chunk_offset;
+    return result;
+}
+
+capture_reader::iterator capture_reader::seek(std::uint64_t frame) const
+{
+    if (frame >= footer_.num_frame) {
+        return end();
+    }
+
+    // First chunk that ends after this frame.
+    const auto i = partition_point(footer_.num_chunk, [&](auto i) {
+        const auto entry = chunk(i);
+        return entry.first_frame + entry.num_frame <= frame;
+    });
+
+    auto it = chunk_begin(i);
+    while ((it != end()) && (it.frame_.index < frame)) {
+        ++it;
+    }
+
+    it.frame_.metadata_changed = true;
+
+    return it;
+}
+
+capture_reader::iterator capture_reader::seek_time(std::int64_t time) const
+{
+    // Start from the last chunk that begins at or before this time.
+    const auto i = partition_point(footer_.num_chunk, [&](auto i) {
+        return chunk(i).first_time <= time;
+    });
+
+    auto it = chunk_begin((i > 0) ? i - 1 : 0);
+    while ((it != end()) && (it.frame_.time < time)) {
+        ++it;
+    }
+
+    it.frame_.metadata_changed = true;
+
+    return it;
+}
+
+capture_reader::range_type
+capture_reader::range(std::uint64_t first, std::uint64_t last) const
+{
+    if (last <= first) {
+        return {end(), end()};
+    }
+
+    return {seek(first), seek(last)};
+}
+
+capture_chunk capture_reader::chunk(std::uint64_t i) const
+{
+    return read_bytes<capture_chunk>(
+        data_, footer_.chunk_offset + i * sizeof(capture_chunk));
+}
+
+capture_metadata capture_reader::metadata_entry(std::uint64_t i) const
+{
+    return read_bytes<capture_metadata>(
+        data_, footer_.metadata_offset + i * sizeof(capture_metadata));
+}
+
+capture_record_header capture_reader::record(std::uint64_t offset) const
+{
+    if ((offset > footer_.chunk_offset) ||
+        (footer_.chunk_offset - offset < sizeof(capture_record_header))) {
+        throw_not_valid();
+    }
+
+    const auto header = read_bytes<capture_record_header>(data_, offset);
+    if (header.length >
+        footer_.chunk_offset - offset - sizeof(capture_record_header)) {
+        throw_not_valid();
+    }
+
+    return header;
+}
+
+std::string_view capture_reader::payload(std::uint64_t offset) const
+{
+    const auto header = record(offset);
+
+    return {data_ + offset + sizeof(header), header.length};
+}
+
+capture_reader::iterator capture_reader::chunk_begin(std::uint64_t i) const
+{
+    if (i >= footer_.num_chunk) {
+        return end();
+    }
+
+    const auto entry = chunk(i);
+
+    // Last metadata record before this chunk. Records inside the chunk are
+    // picked up by the scan.
+    const auto j = partition_point(footer_.num_metadata, [&](auto j) {
+        return metadata_entry(j).offset < entry.offset;
+    });
+
+    std::string_view metadata;
+    if (j > 0) {
+        metadata = payload(metadata_entry(j - 1).offset);
+    }
+
+    return iterator{this, entry.offset, entry.first_frame, metadata};
+}
+
+capture_iterator::capture_iterator(
+    const capture_reader* reader, std::uint64_t offset, std::uint64_t index,
+    std::string_view metadata)
+    : reader_{reader}, next_{offset}
+{
+    frame_.index = index;
+    frame_.metadata = metadata;
+    frame_.metadata_changed = true;
+
+    next();
+}
+
+void capture_iterator::next()
+{
+    const auto end = reader_->footer_.chunk_offset;
+
+    while (next_ < end) {
+        const auto header = reader_->record(next_);
+        const std::string_view payload{
+            reader_->data_ + next_ + sizeof(header), header.length};
+
+        offset_ = next_;
+        next_ += sizeof(header) + header.length;
+
+        if (header.type == capture_record_type::metadata) {
+            frame_.metadata = payload;
+            frame_.metadata_changed = true;
+        } else if (header.type == capture_record_type::frame) {
+            frame_.time = header.time;
+            frame_.message = payload;
+            return;
+        }
+    }
+
+    offset_ = next_ = end;
+}
+
+#if defined(ASIO_HAS_FILE)
+
+capture_writer::state::state(
+    const asio::any_io_executor& executor, const std::string& path,
+    std::size_t chunk_size)
+    : file{executor, path,
+           asio::stream_file::write_only | asio::stream_file::create |
+               asio::stream_file::truncate},
+      encoder{chunk_size}, idle{executor}
+{
+}
+
+capture_writer::capture_writer(
+    asio::any_io_executor executor, const std::string& path,
+    std::size_t chunk_size)
+    : state_{std::make_shared<state>(executor, path, chunk_size)}
+{
+}
+
+capture_writer::~capture_writer()
+{
+    // Abandon the capture. Cancels the write in flight, which still owns the
+    // state and finishes on its own.
+    asio::error_code ec;
+    state_->file.close(ec);
+}
+
+void capture_writer::channel_request(
+    std::string_view xml, clock_type::time_point time)
+{
+    check_error();
+
+    state_->encoder.channel_request(xml, time);
+    start_write();
+}
+
+void capture_writer::metadata(std::string_view xml, clock_type::time_point time)
+{
+    check_error();
+
+    state_->encoder.metadata(xml, time);
+    start_write();
+}
+
+void capture_writer::frame(
+    std::string_view message, clock_type::time_point time)
+{
+    check_error();
+
+    state_->encoder.frame(message, time);
+    start_write();
+}
+
+asio::awaitable<void> capture_writer::close()
+{
+    auto ptr = state_;
+
+    ptr->encoder.finish();
+
+    // Let the background write finish, then write whatever is left
+    // ourselves.
+    while (ptr->writing) {
+        asio::error_code ec;
+        co_await ptr->idle.async_wait(
+            asio::redirect_error(asio::use_awaitable, ec));
+    }
+
+    if (!ptr->error && ptr->encoder.ready()) {
+        ptr->idle.expires_at(asio::steady_timer::time_point::max());
+        ptr->writing = true;
+        co_await write_blocks(ptr);
+    }
+
+    asio::error_code ec;
+    ptr->file.close(ec);
+
+    check_error();
+}
+
+void capture_writer::check_error() const
+{
+    if (state_->error) {
+        std::rethrow_exception(state_->error);
+    }
+}
+
+void capture_writer::start_write()
+{
+    if (state_->writing || !state_->encoder.ready()) {
+        return;
+    }
+
+    state_->idle.expires_at(asio::steady_timer::time_point::max());
+    state_->writing = true;
+
+    co_spawn(state_->file.get_executor(), write_blocks(state_), asio::detached);
+}
+
+asio::awaitable<void>
+capture_writer::write_blocks(std::shared_ptr<state> ptr)
+{
+    try {
+        while (ptr->encoder.ready()) {
+            const auto blocks = ptr->encoder.take();
+
+            std::vector<asio::const_buffer> buffers;
+            buffers.reserve(blocks.size());
+            for (const auto& block : blocks) {
+                buffers.push_back(asio::buffer(block));
+            }
+
+            co_await asio::async_write(
+                ptr->file, buffers, asio::use_awaitable);
+        }
+    } catch (...) {
+        ptr->error = std::current_exception();
+    }
+
+    ptr->writing = false;
+    ptr->idle.cancel();
+}
+
+asio::awaitable<void> record_frames(datastream& stream, capture_writer& writer)
+{
+    for (;;) {
+        std::string_view message;
+        try {
+            message = co_await read_any_message(stream);
+        } catch (const asio::system_error& e) {
+            // The other end closed the stream. Not an error.
+            if (e.code() == asio::error::eof) {
+                co_return;
+            }
+
+            throw;
+        }
+
+        const auto now = capture_writer::clock_type::now();
+
+        if (is_metadata(message)) {
+            writer.metadata(message, now);
+        } else {
+            writer.frame(message, now);
+        }
+    }
+}
+
+#endif // ASIO_HAS_FILE
+
+} // namespace shadowmocap
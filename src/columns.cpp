@@ -0,0 +1,712 @@
+// Copyright Motion Workshop. All Rights Reserved.
+#include <shadowmocap/columns.hpp>
+#include <shadowmocap/csv.hpp>
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+
+namespace shadowmocap {
+
+namespace {
+
+// The file format is little endian and the values are copied to and from
+// the file as they are in memory.
+static_assert(
+    std::endian::native == std::endian::little,
+    "column files need a little endian host");
+
+// Same limit as the CSV export.
+constexpr int kMaxPrecision = 9;
+
+// Largest rounded value for the delta_int encoding. The difference of two
+// values must fit in an int64.
+constexpr double kMaxIntValue = 0x1p61;
+
+template <typename T>
+void append_bytes(std::string& out, const T& value)
+{
+    const auto first = out.size();
+    out.resize(first + sizeof(T));
+    std::memcpy(out.data() + first, &value, sizeof(T));
+}
+
+template <typename T>
+T read_bytes(std::string_view data, std::uint64_t offset)
+{
+    T value;
+    std::memcpy(&value, data.data() + offset, sizeof(T));
+    return value;
+}
+
+[[noreturn]] void throw_not_valid()
+{
+    throw std::runtime_error("column file is not valid");
+}
+
+constexpr std::uint64_t low_bits(int n)
+{
+    return (std::uint64_t{1} << n) - 1;
+}
+
+// Write values of up to 32 bits, most significant bit first.
+class bit_writer {
+public:
+    explicit bit_writer(std::string& out) : out_{out}
+    {
+    }
+
+    void write(std::uint32_t value, int n)
+    {
+        acc_ = (acc_ << n) | (value & low_bits(n));
+        bits_ += n;
+        while (bits_ >= 8) {
+            bits_ -= 8;
+            out_.push_back(static_cast<char>(acc_ >> bits_));
+        }
+    }
+
+    void flush()
+    {
+        if (bits_ > 0) {
+            out_.push_back(static_cast<char>(acc_ << (8 - bits_)));
+            bits_ = 0;
+        }
+    }
+
+private:
+    std::string& out_;
+    std::uint64_t acc_{};
+    int bits_{};
+};
+
+// Read values written by bit_writer. Reads zeros past the end.
+class bit_reader {
+public:
+    explicit bit_reader(std::string_view data)
+        : ptr_{reinterpret_cast<const unsigned char*>(data.data())},
+          end_{ptr_ + data.size()}
+    {
+    }
+
+    std::uint32_t read(int n)
+    {
+        while (bits_ < n) {
+            acc_ = (acc_ << 8) | ((ptr_ < end_) ? *ptr_++ : 0);
+            bits_ += 8;
+        }
+
+        bits_ -= n;
+        return static_cast<std::uint32_t>((acc_ >> bits_) & low_bits(n));
+    }
+
+private:
+    const unsigned char* ptr_;
+    const unsigned char* end_;
+    std::uint64_t acc_{};
+    int bits_{};
+};
+
+// XOR each value with the previous one. Store a single zero bit if they are
+// equal. Otherwise store the bits between the leading and trailing zeros of
+// the XOR, reusing the previous window if the bits fit in it.
+void encode_xor(std::span<const float> values, std::string& out)
+{
+    if (values.empty()) {
+        return;
+    }
+
+    bit_writer writer{out};
+
+    auto prev = std::bit_cast<std::uint32_t>(values[0]);
+    writer.write(prev, 32);
+
+    int prev_lead = -1;
+    int prev_trail = 0;
+    for (std::size_t i = 1; i < values.size(); ++i) {
+        const auto value = std::bit_cast<std::uint32_t>(values[i]);
+        const auto x = value ^ prev;
+        prev = value;
+
+        if (x == 0) {
+            writer.write(0, 1);
+            continue;
+        }
+
+        const int lead = std::countl_zero(x);
+        const int trail = std::countr_zero(x);
+
+        if ((prev_lead >= 0) && (lead >= prev_lead) && (trail >= prev_trail)) {
+            writer.write(0b10, 2);
+            writer.write(x >> prev_trail, 32 - prev_lead - prev_trail);
+        } else {
+            const int length = 32 - lead - trail;
+
+            writer.write(0b11, 2);
+            writer.write(static_cast<std::uint32_t>(lead), 5);
+            writer.write(static_cast<std::uint32_t>(length - 1), 5);
+            writer.write(x >> trail, length);
+
+            prev_lead = lead;
+            prev_trail = trail;
+        }
+    }
+
+    writer.flush();
+}
+
+void decode_xor(std::string_view data, std::span<float> out)
+{
+    if (out.empty()) {
+        return;
+    }
+
+    bit_reader reader{data};
+
+    auto prev = reader.read(32);
+    out[0] = std::bit_cast<float>(prev);
+
+    int prev_lead = 0;
+    int prev_trail = 0;
+    for (std::size_t i = 1; i < out.size(); ++i) {
+        if (reader.read(1) != 0) {
+            if (reader.read(1) != 0) {
+                prev_lead = static_cast<int>(reader.read(5));
+                const auto length = static_cast<int>(reader.read(5)) + 1;
+                prev_trail = std::max(32 - prev_lead - length, 0);
+            }
+
+            const auto length = 32 - prev_lead - prev_trail;
+            prev ^= reader.read(length) << prev_trail;
+        }
+
+        out[i] = std::bit_cast<float>(prev);
+    }
+}
+
+void put_varint(std::string& out, std::uint64_t value)
+{
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>(value | 0x80));
+        value >>= 7;
+    }
+
+    out.push_back(static_cast<char>(value));
+}
+
+std::uint64_t get_varint(std::string_view data, std::size_t& pos)
+{
+    std::uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (pos >= data.size()) {
+            throw_not_valid();
+        }
+
+        const auto byte = static_cast<unsigned char>(data[pos++]);
+        value |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+            return value;
+        }
+    }
+
+    throw_not_valid();
+}
+
+std::uint64_t zigzag(std::int64_t value)
+{
+    // Zig zag so small negative numbers are small too.
+    const auto x = static_cast<std::uint64_t>(value);
+    return (x << 1) ^ (0 - (x >> 63));
+}
+
+std::int64_t unzigzag(std::uint64_t value)
+{
+    return static_cast<std::int64_t>((value >> 1) ^ (0 - (value & 1)));
+}
+
+double get_scale(int precision)
+{
+    double scale = 1;
+    for (int i = 0; i < precision; ++i) {
+        scale *= 10;
+    }
+
+    return scale;
+}
+
+// Round to a fixed number of decimal digits and store the difference from the
+// previous value. Shift by one so zero is free for NaN. Returns false and
+// writes nothing if any value is too large to round to an integer.
+bool encode_delta(
+    std::span<const float> values, int precision, std::string& out)
+{
+    const auto scale = get_scale(precision);
+    const auto first = out.size();
+
+    std::int64_t prev = 0;
+    for (const auto value : values) {
+        if (std::isnan(value)) {
+            out.push_back(0);
+            continue;
+        }
+
+        const auto scaled = std::round(static_cast<double>(value) * scale);
+        if (!(std::abs(scaled) < kMaxIntValue)) {
+            out.resize(first);
+            return false;
+        }
+
+        const auto current = static_cast<std::int64_t>(scaled);
+        put_varint(out, zigzag(current - prev) + 1);
+        prev = current;
+    }
+
+    return true;
+}
+
+void decode_delta(std::string_view data, int precision, std::span<float> out)
+{
+    if ((precision < 0) || (precision > kMaxPrecision)) {
+        throw_not_valid();
+    }
+
+    const auto scale = get_scale(precision);
+
+    std::size_t pos = 0;
+    std::int64_t prev = 0;
+    for (auto& value : out) {
+        const auto delta = get_varint(data, pos);
+        if (delta == 0) {
+            value = std::numeric_limits<float>::quiet_NaN();
+            continue;
+        }
+
+        prev += unzigzag(delta - 1);
+        value = static_cast<float>(static_cast<double>(prev) / scale);
+    }
+}
+
+// Receive times are close to evenly spaced so the delta of the delta is
+// usually a small number that fits in one byte.
+void encode_time(std::span<const std::int64_t> times, std::string& out)
+{
+    std::int64_t prev = 0;
+    std::int64_t prev_delta = 0;
+    for (const auto time : times) {
+        const auto delta = time - prev;
+        put_varint(out, zigzag(delta - prev_delta));
+
+        prev = time;
+        prev_delta = delta;
+    }
+}
+
+void decode_time(std::string_view data, std::span<std::int64_t> out)
+{
+    std::size_t pos = 0;
+    std::int64_t prev = 0;
+    std::int64_t prev_delta = 0;
+    for (auto& time : out) {
+        prev_delta += unzigzag(get_varint(data, pos));
+        prev += prev_delta;
+        time = prev;
+    }
+}
+
+} // namespace
+
+column_encoder::column_encoder(
+    int mask, const node_map& nodes, column_options options)
+    : layout_{mask}, nodes_{nodes},
+      row_group_size_{std::max<std::size_t>(options.row_group_size, 1)},
+      precision_{std::clamp(options.precision, -1, kMaxPrecision)},
+      item_(static_cast<std::size_t>(layout_.dimension()))
+{
+    const auto suffix = get_channel_column_names(mask);
+    for (const auto& node : nodes_) {
+        for (const auto& name : suffix) {
+            names_.push_back(node.name + "." + name);
+        }
+    }
+
+    values_.resize(names_.size() * row_group_size_);
+    times_.resize(row_group_size_);
+
+    column_file_header header{};
+    std::memcpy(header.magic, kColumnMagic, sizeof(header.magic));
+    header.version = kColumnVersion;
+    header.mask = static_cast<std::uint32_t>(mask);
+
+    std::string block;
+    append_bytes(block, header);
+
+    offset_ = block.size();
+    blocks_.push_back(std::move(block));
+}
+
+bool column_encoder::frame(std::string_view message, std::int64_t time)
+{
+    if (finished_) {
+        throw std::logic_error("column file is finished");
+    }
+
+    const auto view = make_message_view(message, layout_);
+    if (view.empty() && !message.empty()) {
+        return false;
+    }
+
+    const auto row = num_group_row_;
+    const auto dim = item_.size();
+
+    // Nodes that are missing from this frame are NaN.
+    for (std::size_t i = 0; i < names_.size(); ++i) {
+        values_[i * row_group_size_ + row] =
+            std::numeric_limits<float>::quiet_NaN();
+    }
+
+    for (const auto item : view) {
+        const auto index = nodes_.find(item.key());
+        if (index < 0) {
+            continue;
+        }
+
+        item.get(item_);
+
+        auto* column = values_.data() + static_cast<std::size_t>(index) * dim *
+                                            row_group_size_ + row;
+        for (const auto value : item_) {
+            *column = value;
+            column += row_group_size_;
+        }
+    }
+
+    times_[row] = time;
+
+    ++num_row_;
+    if (++num_group_row_ == row_group_size_) {
+        seal();
+    }
+
+    return true;
+}
+
+void column_encoder::seal()
+{
+    const auto n = num_group_row_;
+    if (n == 0) {
+        return;
+    }
+
+    std::string block;
+    encode_time(std::span{times_}.first(n), block);
+
+    append_bytes(index_, column_row_group{n, offset_, block.size()});
+
+    for (std::size_t i = 0; i < names_.size(); ++i) {
+        const auto values =
+            std::span{values_}.subspan(i * row_group_size_, n);
+
+        column_chunk chunk{};
+        chunk.offset = offset_ + block.size();
+        chunk.min = chunk.max = std::numeric_limits<float>::quiet_NaN();
+
+        for (const auto value : values) {
+            if (std::isnan(value)) {
+                ++chunk.num_nan;
+            } else if (std::isnan(chunk.min)) {
+                chunk.min = chunk.max = value;
+            } else {
+                chunk.min = std::min(chunk.min, value);
+                chunk.max = std::max(chunk.max, value);
+            }
+        }
+
+        const auto first = block.size();
+        if ((precision_ >= 0) && encode_delta(values, precision_, block)) {
+            chunk.encoding = column_encoding::delta_int;
+            chunk.precision = static_cast<std::uint32_t>(precision_);
+        } else {
+            encode_xor(values, block);
+            chunk.encoding = column_encoding::xor_float;
+        }
+
+        // Noisy data may not compress. Store it as is.
+        if (block.size() - first > n * sizeof(float)) {
+            block.resize(first + n * sizeof(float));
+            std::memcpy(
+                block.data() + first, values.data(), n * sizeof(float));
+            chunk.encoding = column_encoding::raw;
+            chunk.precision = 0;
+        }
+
+        chunk.size = static_cast<std::uint32_t>(block.size() - first);
+
+        append_bytes(index_, chunk);
+    }
+
+    offset_ += block.size();
+    blocks_.push_back(std::move(block));
+
+    num_group_row_ = 0;
+    ++num_row_group_;
+}
+
+void column_encoder::finish()
+{
+    if (finished_) {
+        return;
+    }
+
+    seal();
+    finished_ = true;
+
+    std::string block;
+    for (const auto& name : names_) {
+        const auto length = static_cast<std::uint16_t>(
+            std::min<std::size_t>(name.size(), 0xffff));
+        append_bytes(block, length);
+        block.append(name, 0, length);
+    }
+
+    column_file_footer footer{};
+    footer.names_offset = offset_;
+    footer.num_column = names_.size();
+    footer.row_group_offset = offset_ + block.size();
+    footer.num_row_group = num_row_group_;
+    footer.num_row = num_row_;
+    std::memcpy(footer.magic, kColumnMagic, sizeof(footer.magic));
+
+    block.append(index_);
+    append_bytes(block, footer);
+
+    offset_ += block.size();
+    blocks_.push_back(std::move(block));
+
+    index_ = std::string{};
+}
+
+std::vector<std::string> column_encoder::take()
+{
+    std::vector<std::string> result;
+    result.swap(blocks_);
+
+    return result;
+}
+
+void export_columns(
+    const capture_reader& reader, int mask, const std::string& path,
+    column_options options)
+{
+    const node_map nodes{parse_metadata_nodes(reader.metadata(0))};
+
+    // Columns are named once from the first node list. Names and keys must
+    // stay the same for the values to land in the right columns.
+    auto same_nodes = [&nodes](std::string_view metadata) {
+        const auto other = parse_metadata_nodes(metadata);
+
+        return std::ranges::equal(
+            nodes.nodes(), other, [](const auto& lhs, const auto& rhs) {
+                return (lhs.name == rhs.name) && (lhs.key == rhs.key);
+            });
+    };
+
+    column_encoder columns(mask, nodes, options);
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+
+    auto write = [&out, &columns]() {
+        for (const auto& block : columns.take()) {
+            out.write(block.data(), static_cast<std::streamsize>(block.size()));
+        }
+
+        if (!out) {
+            throw std::runtime_error("failed to write column file");
+        }
+    };
+
+    for (const auto frame : reader) {
+        if (frame.metadata_changed && !same_nodes(frame.metadata)) {
+            throw std::invalid_argument("node list changes in the capture");
+        }
+
+        columns.frame(frame.message, frame.time);
+
+        if (columns.ready()) {
+            write();
+        }
+    }
+
+    columns.finish();
+    write();
+}
+
+column_reader::column_reader(std::string_view data) : data_{data}
+{
+    if (data_.size() <
+        sizeof(column_file_header) + sizeof(column_file_footer)) {
+        throw_not_valid();
+    }
+
+    const auto header = read_bytes<column_file_header>(data_, 0);
+    footer_ = read_bytes<column_file_footer>(
+        data_, data_.size() - sizeof(column_file_footer));
+
+    if ((std::memcmp(header.magic, kColumnMagic, sizeof(header.magic)) != 0) ||
+        (std::memcmp(footer_.magic, kColumnMagic, sizeof(footer_.magic)) !=
+         0) ||
+        (header.version != kColumnVersion)) {
+        throw_not_valid();
+    }
+
+    mask_ = static_cast<int>(header.mask);
+
+    const std::uint64_t end = data_.size() - sizeof(column_file_footer);
+    if ((footer_.names_offset < sizeof(column_file_header)) ||
+        (footer_.names_offset > footer_.row_group_offset) ||
+        (footer_.row_group_offset > end)) {
+        throw_not_valid();
+    }
+
+    // Every row group entry is followed by one chunk per column.
+    const auto entry_size = sizeof(column_row_group) +
+                            footer_.num_column * sizeof(column_chunk);
+    if ((footer_.num_row_group > 0) &&
+        ((footer_.num_column > end) ||
+         (footer_.num_row_group >
+          (end - footer_.row_group_offset) / entry_size) ||
+         (footer_.row_group_offset + footer_.num_row_group * entry_size !=
+          end))) {
+        throw_not_valid();
+    }
+
+    auto pos = footer_.names_offset;
+    for (std::uint64_t i = 0; i < footer_.num_column; ++i) {
+        if (footer_.row_group_offset - pos < sizeof(std::uint16_t)) {
+            throw_not_valid();
+        }
+
+        const auto length = read_bytes<std::uint16_t>(data_, pos);
+        pos += sizeof(length);
+        if (footer_.row_group_offset - pos < length) {
+            throw_not_valid();
+        }
+
+        names_.emplace_back(data_.substr(pos, length));
+        pos += length;
+    }
+
+    std::uint64_t num_row = 0;
+    for (std::uint64_t i = 0; i < footer_.num_row_group; ++i) {
+        row_group_offset_.push_back(footer_.row_group_offset + i * entry_size);
+        num_row += row_group(i).num_row;
+    }
+
+    if (num_row != footer_.num_row) {
+        throw_not_valid();
+    }
+}
+
+int column_reader::find(std::string_view name) const
+{
+    const auto itr = std::find(names_.begin(), names_.end(), name);
+    if (itr == names_.end()) {
+        return -1;
+    }
+
+    return static_cast<int>(itr - names_.begin());
+}
+
+std::uint64_t column_reader::num_row(std::size_t row_group) const
+{
+    return this->row_group(row_group).num_row;
+}
+
+column_chunk
+column_reader::chunk(std::size_t column, std::size_t row_group) const
+{
+    if ((column >= names_.size()) || (row_group >= row_group_offset_.size())) {
+        throw std::out_of_range("column or row group is out of range");
+    }
+
+    return read_bytes<column_chunk>(
+        data_, row_group_offset_[row_group] + sizeof(column_row_group) +
+                   column * sizeof(column_chunk));
+}
+
+std::size_t column_reader::read(
+    std::size_t column, std::size_t row_group, std::span<float> out) const
+{
+    const auto entry = chunk(column, row_group);
+    const auto n = static_cast<std::size_t>(num_row(row_group));
+    if (out.size() < n) {
+        throw std::length_error("output is smaller than the row group");
+    }
+
+    if ((entry.offset > footer_.names_offset) ||
+        (entry.size > footer_.names_offset - entry.offset)) {
+        throw_not_valid();
+    }
+
+    const auto bytes = data_.substr(entry.offset, entry.size);
+
+    if (entry.encoding == column_encoding::raw) {
+        if (bytes.size() != n * sizeof(float)) {
+            throw_not_valid();
+        }
+
+        std::memcpy(out.data(), bytes.data(), bytes.size());
+    } else if (entry.encoding == column_encoding::xor_float) {
+        decode_xor(bytes, out.first(n));
+    } else if (entry.encoding == column_encoding::delta_int) {
+        decode_delta(
+            bytes, static_cast<int>(entry.precision), out.first(n));
+    } else {
+        throw_not_valid();
+    }
+
+    return n;
+}
+
+std::size_t column_reader::read(std::size_t column, std::span<float> out) const
+{
+    std::size_t n = 0;
+    for (std::size_t i = 0; i < row_group_offset_.size(); ++i) {
+        n += read(column, i, out.subspan(n));
+    }
+
+    return n;
+}
+
+std::size_t column_reader::read_time(
+    std::size_t row_group, std::span<std::int64_t> out) const
+{
+    const auto entry = this->row_group(row_group);
+    const auto n = static_cast<std::size_t>(entry.num_row);
+    if (out.size() < n) {
+        throw std::length_error("output is smaller than the row group");
+    }
+
+    if ((entry.time_offset > footer_.names_offset) ||
+        (entry.time_size > footer_.names_offset - entry.time_offset)) {
+        throw_not_valid();
+    }
+
+    decode_time(data_.substr(entry.time_offset, entry.time_size), out.first(n));
+
+    return n;
+}
+
+column_row_group column_reader::row_group(std::size_t i) const
+{
+    if (i >= row_group_offset_.size()) {
+        throw std::out_of_range("row group is out of range");
+    }
+
+    return read_bytes<column_row_group>(data_, row_group_offset_[i]);
+}
+
+} // namespace shadowmocap
@@ -0,0 +1,166 @@
+// Copyright Motion Workshop. All Rights Reserved.
+#include <shadowmocap/csv.hpp>
+
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <utility>
+
+namespace shadowmocap {
+
+namespace {
+
+// Fixed notation of the largest float is 39 digits, plus sign and decimal
+// point.
+constexpr std::size_t kMaxIntegerChars = 41;
+
+// Limit the digits after the decimal point so we can bound the row length.
+constexpr int kMaxPrecision = 9;
+
+char* format_value(char* first, char* last, float value, int precision)
+{
+#if defined(__cpp_lib_to_chars)
+    return std::to_chars(
+               first, last, value, std::chars_format::fixed, precision)
+        .ptr;
+#else
+    // Standard library without floating point to_chars, i.e. libc++.
+    const auto n = std::snprintf(
+        first, static_cast<std::size_t>(last - first), "%.*f", precision,
+        static_cast<double>(value));
+    return first + std::clamp<std::ptrdiff_t>(n, 0, last - first - 1);
+#endif
+}
+
+} // namespace
+
+std::vector<std::string> get_channel_column_names(int mask)
+{
+    std::vector<std::string> result;
+    for (auto c : kChannelList) {
+        if (!(mask & c)) {
+            continue;
+        }
+
+        // Something like "Lq" or "a"
+        const std::string prefix = get_channel_name(c);
+
+        // Expand with axes "w", "x", "y", and "z"
+        const auto dim = get_channel_dimension(c);
+        if (dim == 1) {
+            result.push_back(prefix);
+        } else {
+            if (dim == 4) {
+                result.push_back(prefix + "w");
+            }
+
+            for (const auto& axis : {"x", "y", "z"}) {
+                result.push_back(prefix + axis);
+            }
+        }
+    }
+
+    return result;
+}
+
+csv_formatter::csv_formatter(int mask, csv_options options)
+    : layout_{mask}, options_{std::move(options)},
+      columns_{get_channel_column_names(mask)},
+      values_(static_cast<std::size_t>(layout_.dimension()))
+{
+    options_.precision = std::clamp(options_.precision, 0, kMaxPrecision);
+
+    buffer_.resize(options_.batch_size + (1 << 16));
+}
+
+void csv_formatter::header(const node_map& nodes)
+{
+    if (!options_.header) {
+        return;
+    }
+
+    int column = 0;
+    for (const auto& node : nodes) {
+        for (const auto& name : columns_) {
+            if (column++ > 0) {
+                append(options_.separator);
+            }
+
+            // Something like "Hips.ax" or "LeftLeg.Lqw"
+            append(node.name);
+            append(".");
+            append(name);
+        }
+    }
+
+    append(options_.newline);
+}
+
+bool csv_formatter::row(std::string_view message)
+{
+    const auto view = make_message_view(message, layout_);
+    if (view.empty() && !message.empty()) {
+        return false;
+    }
+
+    const auto& sep = options_.separator;
+    const auto precision = options_.precision;
+
+    // Longest possible row.
+    const auto max_value = kMaxIntegerChars + 1 + kMaxPrecision + sep.size();
+    const auto max_row =
+        view.size() * values_.size() * max_value + options_.newline.size();
+
+    char* first = reserve(max_row);
+    char* const last = first + max_row;
+    char* ptr = first;
+
+    bool first_column = true;
+    for (const auto item : view) {
+        item.get(values_);
+
+        for (const auto value : values_) {
+            if (!first_column) {
+                std::memcpy(ptr, sep.data(), sep.size());
+                ptr += sep.size();
+            }
+
+            first_column = false;
+
+            ptr = format_value(ptr, last, value, precision);
+        }
+    }
+
+    std::memcpy(ptr, options_.newline.data(), options_.newline.size());
+    ptr += options_.newline.size();
+
+    size_ += static_cast<std::size_t>(ptr - first);
+
+    return true;
+}
+
+void csv_formatter::consume(std::size_t n)
+{
+    n = std::min(n, size_);
+
+    std::memmove(buffer_.data(), buffer_.data() + n, size_ - n);
+    size_ -= n;
+}
+
+char* csv_formatter::reserve(std::size_t n)
+{
+    if (buffer_.size() - size_ < n) {
+        buffer_.resize(std::max(2 * buffer_.size(), size_ + n));
+    }
+
+    return buffer_.data() + size_;
+}
+
+void csv_formatter::append(std::string_view str)
+{
+    std::memcpy(reserve(str.size()), str.data(), str.size());
+    size_ += str.size();
+}
+
+} // namespace shadowmocap
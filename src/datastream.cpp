@@ -10,15 +10,85 @@
 #include <asio/use_awaitable.hpp>
 #include <asio/write.hpp>
 
+#include <algorithm>
 #include <array>
 #include <chrono>
+#include <cstring>
+#include <stdexcept>
 
 namespace shadowmocap {
 
 constexpr auto kMinMessageLength = 1;
 constexpr auto kMaxMessageLength = 1 << 16;
 
-asio::awaitable<std::string> read_message(tcp::socket& socket)
+// Length prefix of every message. Unsigned integer in network byte order.
+constexpr std::size_t kHeaderLength = 4;
+
+// Room for a few of the largest possible messages so that we always have
+// space to read at least one complete message after we compact the buffer.
+constexpr std::size_t kReaderCapacity = 4 * (kHeaderLength + kMaxMessageLength);
+
+message_reader::message_reader() : buffer_(kReaderCapacity)
+{
+}
+
+std::string_view message_reader::next()
+{
+    if (last_ - first_ < kHeaderLength) {
+        return {};
+    }
+
+    unsigned length = 0;
+    {
+        static_assert(sizeof(unsigned) == kHeaderLength);
+
+        std::memcpy(&length, buffer_.data() + first_, kHeaderLength);
+        length = ntohl(length);
+    }
+
+    if ((length < kMinMessageLength) || (length > kMaxMessageLength)) {
+        throw std::length_error("message length is not valid");
+    }
+
+    if (last_ - first_ - kHeaderLength < length) {
+        return {};
+    }
+
+    const std::string_view message{
+        buffer_.data() + first_ + kHeaderLength, length};
+
+    first_ += kHeaderLength + length;
+
+    return message;
+}
+
+asio::mutable_buffer message_reader::prepare()
+{
+    if (first_ == last_) {
+        first_ = last_ = 0;
+    } else if (buffer_.size() - last_ < kHeaderLength + kMaxMessageLength) {
+        // Move the partial message to the front. This is at most one message
+        // so the copy is small compared to the bytes we just handed out.
+        std::memmove(buffer_.data(), buffer_.data() + first_, last_ - first_);
+        last_ -= first_;
+        first_ = 0;
+    }
+
+    return asio::buffer(buffer_.data() + last_, buffer_.size() - last_);
+}
+
+void message_reader::commit(std::size_t n)
+{
+    last_ = std::min(last_ + n, buffer_.size());
+}
+
+std::size_t message_reader::size() const
+{
+    return last_ - first_;
+}
+
+asio::awaitable<std::string_view>
+read_message(tcp::socket& socket, std::string& buffer)
 {
     unsigned length = 0;
     {
@@ -36,43 +106,138 @@ asio::awaitable<std::string> read_message(tcp::socket& socket)
         throw std::length_error("message length is not valid");
     }
 
-    std::string message(length, 0);
+    // Reuse the buffer capacity. Only allocates and zero fills if this message
+    // is longer than any previous one.
+    buffer.resize(length);
 
     co_await asio::async_read(
-        socket, asio::buffer(message), asio::use_awaitable);
+        socket, asio::buffer(buffer), asio::use_awaitable);
+
+    co_return std::string_view{buffer};
+}
+
+asio::awaitable<std::string_view>
+read_message(tcp::socket& socket, message_reader& reader)
+{
+    for (;;) {
+        auto message = reader.next();
+        if (!message.empty()) {
+            co_return message;
+        }
+
+        const auto n = co_await socket.async_read_some(
+            reader.prepare(), asio::use_awaitable);
+
+        reader.commit(n);
+    }
+}
+
+asio::awaitable<std::string> read_message(tcp::socket& socket)
+{
+    std::string message;
+    co_await read_message(socket, message);
 
     co_return message;
 }
 
-asio::awaitable<std::string> read_message(datastream& stream)
+asio::awaitable<std::string_view> read_any_message(datastream& stream)
+{
+    using clock_type = stream_metrics::clock_type;
+
+    // Time the header of a partial message was in the buffer.
+    clock_type::time_point header_time{};
+
+    // Same loop as read_message(socket, reader) but records metrics for
+    // every socket read.
+    for (;;) {
+        auto message = stream.reader_.next();
+        if (message.empty()) {
+            record_metrics(stream.metrics_, [&](stream_metrics&) {
+                if ((header_time == clock_type::time_point{}) &&
+                    (stream.reader_.size() >= kHeaderLength)) {
+                    header_time = clock_type::now();
+                }
+            });
+
+            const auto n = co_await stream.socket_.async_read_some(
+                stream.reader_.prepare(), asio::use_awaitable);
+
+            stream.reader_.commit(n);
+
+            record_metrics(
+                stream.metrics_, [n](stream_metrics& m) { m.add_bytes(n); });
+
+            continue;
+        }
+
+        if (is_metadata(message)) {
+            stream.nodes_ = node_map{parse_metadata_nodes(message)};
+
+            record_metrics(
+                stream.metrics_, [](stream_metrics& m) { m.add_metadata(); });
+
+            co_return message;
+        }
+
+        record_metrics(stream.metrics_, [&header_time](stream_metrics& m) {
+            const auto now = clock_type::now();
+            m.add_frame(now);
+
+            // Zero if the header and payload came in with the same read.
+            if (header_time == clock_type::time_point{}) {
+                m.add_read(clock_type::duration{});
+            } else {
+                m.add_read(now - header_time);
+            }
+        });
+
+        co_return message;
+    }
+}
+
+asio::awaitable<std::string_view>
+read_message(datastream& stream, std::string& buffer)
 {
-    auto message = co_await read_message(stream.socket_);
+    for (;;) {
+        auto message = co_await read_any_message(stream);
+        if (is_metadata(message)) {
+            continue;
+        }
 
-    if (is_metadata(message)) {
-        stream.names_ = parse_metadata(message);
+        // Copy out of the reader buffer which is only valid until the next
+        // read.
+        buffer.assign(message);
 
-        message = co_await read_message(stream.socket_);
+        co_return std::string_view{buffer};
     }
+}
+
+asio::awaitable<std::string> read_message(datastream& stream)
+{
+    std::string message;
+    co_await read_message(stream, message);
 
     co_return message;
 }
 
-asio::awaitable<void>
-write_message(tcp::socket& socket, std::string_view message)
+std::array<char, 4> make_message_header(std::size_t length)
 {
-    if ((message.size() < kMinMessageLength) ||
-        (message.size() > kMaxMessageLength)) {
+    if ((length < kMinMessageLength) || (length > kMaxMessageLength)) {
         throw std::length_error("message length is not valid");
     }
 
-    const std::array<char, 4> header = [&message]() {
-        static_assert(sizeof(unsigned) == 4);
+    static_assert(sizeof(unsigned) == 4);
 
-        std::array<char, 4> buf{};
-        const unsigned length = htonl(static_cast<unsigned>(message.size()));
-        std::memcpy(buf.data(), &length, buf.size());
-        return buf;
-    }();
+    std::array<char, 4> header{};
+    const unsigned value = htonl(static_cast<unsigned>(length));
+    std::memcpy(header.data(), &value, header.size());
+    return header;
+}
+
+asio::awaitable<void>
+write_message(tcp::socket& socket, std::string_view message)
+{
+    const auto header = make_message_header(message.size());
 
     const auto buffers = {asio::buffer(header), asio::buffer(message)};
 
@@ -106,6 +271,23 @@ asio::awaitable<datastream> open_connection(tcp::endpoint endpoint)
     co_return datastream{std::move(socket)};
 }
 
+asio::awaitable<std::string>
+accept_service(tcp::socket& socket, std::string_view name)
+{
+    constexpr std::string_view kConfigurable = "configurable";
+
+    std::string message = "<?xml version=\"1.0\"?><service name=\"";
+    message.append(name).append("\"/>");
+
+    co_await write_message(socket, message);
+
+    if (name != kConfigurable) {
+        co_return std::string{};
+    }
+
+    co_return co_await read_message(socket);
+}
+
 asio::awaitable<void> watchdog(std::chrono::steady_clock::time_point& deadline)
 {
     asio::steady_timer timer{co_await asio::this_coro::executor};
@@ -0,0 +1,165 @@
+// Copyright Motion Workshop. All Rights Reserved.
+#include <shadowmocap/frame_ring.hpp>
+
+#include <asio/steady_timer.hpp>
+#include <asio/this_coro.hpp>
+#include <asio/use_awaitable.hpp>
+
+#include <stdexcept>
+
+namespace shadowmocap {
+
+namespace {
+
+// Ring positions pack a 48 bit sequence with a 16 bit slot index.
+constexpr std::uint64_t kIndexBits = 16;
+constexpr std::uint64_t kIndexMask = (std::uint64_t{1} << kIndexBits) - 1;
+
+constexpr std::uint64_t pack(std::uint64_t sequence, std::uint32_t index)
+{
+    return (sequence << kIndexBits) | index;
+}
+
+constexpr std::uint64_t get_sequence(std::uint64_t value)
+{
+    return value >> kIndexBits;
+}
+
+constexpr std::uint32_t get_index(std::uint64_t value)
+{
+    return static_cast<std::uint32_t>(value & kIndexMask);
+}
+
+} // namespace
+
+frame_ring::frame_ring(
+    std::size_t capacity, overflow_policy policy, std::size_t message_capacity)
+    : capacity_{capacity}, policy_{policy}, slots_(capacity + 2),
+      ring_{std::make_unique<std::atomic<std::uint64_t>[]>(capacity)}
+{
+    if ((capacity == 0) || (capacity + 2 > kIndexMask)) {
+        throw std::invalid_argument("frame ring capacity is not valid");
+    }
+
+    for (auto& slot : slots_) {
+        slot.message.reserve(message_capacity);
+    }
+
+    for (std::size_t i = 0; i < capacity; ++i) {
+        ring_[i].store(pack(0, static_cast<std::uint32_t>(i)));
+    }
+
+    fill_ = static_cast<std::uint32_t>(capacity);
+    held_ = static_cast<std::uint32_t>(capacity + 1);
+}
+
+bool frame_ring::try_push()
+{
+    const auto head = head_.load(std::memory_order_relaxed);
+    auto tail = tail_.load(std::memory_order_acquire);
+
+    while (head - tail >= capacity_) {
+        if (policy_ == overflow_policy::block_producer) {
+            return false;
+        }
+
+        // Skip the oldest frame. Races with the consumer taking the same
+        // frame, the loser reloads the tail. The consumer may still take the
+        // frame after we advance the tail, so do not count it as dropped yet.
+        if (tail_.compare_exchange_weak(
+                tail, tail + 1, std::memory_order_acq_rel,
+                std::memory_order_acquire)) {
+            ++tail;
+        }
+    }
+
+    slots_[fill_].sequence = head;
+
+    // Publish our slot and take ownership of the one that was in this
+    // position. It is either already read or dropped.
+    const auto prev = ring_[head % capacity_].exchange(
+        pack(head + 1, fill_), std::memory_order_acq_rel);
+
+    // The consumer clears the sequence of every frame it takes. If it is
+    // still set then we took back an unread frame.
+    if (get_sequence(prev) != 0) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    fill_ = get_index(prev);
+
+    head_.store(head + 1, std::memory_order_release);
+
+    return true;
+}
+
+const frame_slot* frame_ring::try_pop()
+{
+    for (;;) {
+        auto tail = tail_.load(std::memory_order_acquire);
+        if (tail == head_.load(std::memory_order_acquire)) {
+            return nullptr;
+        }
+
+        auto& position = ring_[tail % capacity_];
+
+        auto value = position.load(std::memory_order_acquire);
+        if (get_sequence(value) != tail + 1) {
+            // The producer dropped this frame and replaced it. Try again.
+            continue;
+        }
+
+        // Swap our slot in for the frame. Fails if the producer replaced the
+        // frame after we loaded it.
+        if (!position.compare_exchange_strong(
+                value, pack(0, held_), std::memory_order_acq_rel,
+                std::memory_order_relaxed)) {
+            continue;
+        }
+
+        held_ = get_index(value);
+
+        // Advance the tail past this frame unless the producer already
+        // dropped it.
+        auto expected = tail;
+        while (!tail_.compare_exchange_weak(
+                   expected, tail + 1, std::memory_order_acq_rel,
+                   std::memory_order_relaxed) &&
+               (expected == tail)) {
+        }
+
+        return &slots_[held_];
+    }
+}
+
+const frame_slot* frame_ring::latest()
+{
+    const frame_slot* result = nullptr;
+    while (const auto* slot = try_pop()) {
+        result = slot;
+    }
+
+    return result;
+}
+
+asio::awaitable<void> read_frames(datastream& stream, frame_ring& ring)
+{
+    using namespace std::chrono_literals;
+
+    asio::steady_timer timer{co_await asio::this_coro::executor};
+
+    for (;;) {
+        auto& slot = ring.producer_slot();
+
+        co_await read_message(stream, slot.message);
+
+        slot.time = std::chrono::steady_clock::now();
+
+        while (!ring.try_push()) {
+            timer.expires_after(100us);
+            co_await timer.async_wait(asio::use_awaitable);
+        }
+    }
+}
+
+} // namespace shadowmocap
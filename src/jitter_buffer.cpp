@@ -0,0 +1,219 @@
+// Copyright Motion Workshop. All Rights Reserved.
+#include <shadowmocap/jitter_buffer.hpp>
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+namespace shadowmocap {
+
+namespace {
+
+using duration = jitter_buffer::clock_type::duration;
+
+// Gain of the frame period and interarrival jitter estimates, same as
+// RFC 3550.
+constexpr int kGain = 16;
+
+// Measured jitter decays over this many frames once the late frames stop.
+constexpr int kJitterDecay = 64;
+
+// Follow clock drift between the source and us over this many frames.
+constexpr int kDriftDecay = 1024;
+
+duration to_duration(double seconds)
+{
+    return std::chrono::duration_cast<duration>(
+        std::chrono::duration<double>{seconds});
+}
+
+void update_jitter(duration& jitter, duration d)
+{
+    jitter += (std::chrono::abs(d) - jitter) / kGain;
+}
+
+} // namespace
+
+jitter_buffer::jitter_buffer(int mask, jitter_options options)
+    : layout_{mask}, options_{options}, slots_(options.capacity)
+{
+    if (options.capacity == 0) {
+        throw std::invalid_argument("jitter buffer capacity is not valid");
+    }
+
+    for (auto& slot : slots_) {
+        slot.message.reserve(options.message_capacity);
+    }
+
+    held_.message.reserve(options.message_capacity);
+}
+
+void jitter_buffer::push(std::string_view message, clock_type::time_point now)
+{
+    const bool first = !has_source_;
+    const auto prev_source = source_;
+    const auto prev_receive = last_receive_;
+
+    const auto source = get_source(message, now);
+    const auto transit = now - source;
+
+    if (first) {
+        offset_ = transit;
+    } else {
+        update_jitter(
+            stats_.input_jitter,
+            (now - prev_receive) - (source - prev_source));
+
+        // Fastest transit so far, drifting up slowly in case the source
+        // clock runs slower than ours.
+        if (transit < offset_) {
+            offset_ = transit;
+        } else {
+            offset_ += (transit - offset_) / kDriftDecay;
+        }
+    }
+
+    // Grow the delay at once for a late frame. Shrink it slowly.
+    const auto late = transit - offset_;
+    if (late > jitter_) {
+        jitter_ = late;
+    } else {
+        jitter_ += (late - jitter_) / kJitterDecay;
+    }
+
+    delay_ = std::clamp<duration>(
+        std::chrono::duration_cast<duration>(
+            jitter_ * options_.jitter_multiplier),
+        options_.min_delay, options_.max_delay);
+
+    // Never release out of order, even if the delay just went down.
+    auto release = std::max(offset_ + source + delay_, last_release_);
+    if (release < now) {
+        release = now;
+        ++stats_.num_late;
+    }
+
+    last_release_ = release;
+
+    if (size() == slots_.size()) {
+        ++tail_;
+        ++stats_.num_dropped;
+    }
+
+    auto& slot = slots_[head_ % slots_.size()];
+    slot.message.assign(message);
+    slot.receive = now;
+    slot.release = release;
+    slot.source = source;
+
+    ++head_;
+    ++stats_.num_push;
+}
+
+const jitter_frame* jitter_buffer::pop(clock_type::time_point now)
+{
+    if (empty()) {
+        return nullptr;
+    }
+
+    auto& slot = slots_[tail_ % slots_.size()];
+    if (slot.release > now) {
+        return nullptr;
+    }
+
+    std::swap(held_, slot);
+    ++tail_;
+
+    const auto latency = now - held_.receive;
+    total_latency_ += latency;
+    stats_.max_latency = std::max(stats_.max_latency, latency);
+
+    if (stats_.num_pop > 0) {
+        update_jitter(
+            stats_.output_jitter,
+            (now - last_pop_) - (held_.source - last_pop_source_));
+    }
+
+    last_pop_ = now;
+    last_pop_source_ = held_.source;
+    ++stats_.num_pop;
+
+    return &held_;
+}
+
+std::optional<jitter_buffer::clock_type::time_point>
+jitter_buffer::next_release() const
+{
+    if (empty()) {
+        return std::nullopt;
+    }
+
+    return slots_[tail_ % slots_.size()].release;
+}
+
+jitter_stats jitter_buffer::stats() const
+{
+    auto result = stats_;
+    result.delay = delay_;
+
+    if (stats_.num_pop > 0) {
+        result.mean_latency =
+            total_latency_ / static_cast<duration::rep>(stats_.num_pop);
+    }
+
+    return result;
+}
+
+duration jitter_buffer::get_source(
+    std::string_view message, clock_type::time_point now)
+{
+    const bool first = !has_source_;
+    has_source_ = true;
+
+    // Frame period from the arrival times, for frames without a source
+    // clock. Mean over every frame so far since a burst throws off any
+    // short window.
+    if (first) {
+        first_receive_ = now;
+    } else {
+        period_ = (now - first_receive_) /
+                  static_cast<duration::rep>(++num_interval_);
+    }
+
+    last_receive_ = now;
+
+    if (first) {
+        source_ = duration{};
+    } else {
+        source_ += period_;
+    }
+
+    if (!layout_.contains(channel::timestamp) &&
+        !layout_.contains(channel::dt)) {
+        return source_;
+    }
+
+    const auto view = make_message_view(message, layout_);
+    if (view.empty()) {
+        return source_;
+    }
+
+    // Every node has the same time, use the first one.
+    const auto item = view[0];
+
+    if (layout_.contains(channel::timestamp)) {
+        const double time = item.value(channel::timestamp);
+        if (!first_time_) {
+            first_time_ =
+                time - std::chrono::duration<double>{source_}.count();
+        }
+
+        source_ = to_duration(time - *first_time_);
+    } else if (!first) {
+        source_ = source_ - period_ + to_duration(item.value(channel::dt));
+    }
+
+    return source_;
+}
+
+} // namespace shadowmocap
@@ -0,0 +1,798 @@
+// Copyright Motion Workshop. All Rights Reserved.
+#include <shadowmocap/math.hpp>
+
+#if defined(__AVX2__)
+#define SHADOWMOCAP_MATH_AVX2
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (_M_IX86_FP >= 2)
+#define SHADOWMOCAP_MATH_SSE2
+#include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#define SHADOWMOCAP_MATH_NEON
+#include <arm_neon.h>
+#endif
+
+#include <algorithm>
+#include <array>
+#include <cfloat>
+#include <cmath>
+#include <stdexcept>
+
+namespace shadowmocap {
+
+namespace {
+
+template <typename T>
+auto get_quaternion_array_impl(T& frame, channel c)
+{
+    if ((get_channel_dimension(c) != 4) || !frame.layout().contains(c)) {
+        throw std::invalid_argument("channel is not a quaternion in the frame");
+    }
+
+    using value_type = std::remove_pointer_t<decltype(frame.values(c).data())>;
+
+    return quaternion_array<value_type>{
+        frame.values(c, 0).data(), frame.values(c, 1).data(),
+        frame.values(c, 2).data(), frame.values(c, 3).data()};
+}
+
+template <typename T>
+auto get_vector_array_impl(T& frame, channel c)
+{
+    if ((get_channel_dimension(c) < 3) || !frame.layout().contains(c)) {
+        throw std::invalid_argument("channel is not a vector in the frame");
+    }
+
+    using value_type = std::remove_pointer_t<decltype(frame.values(c).data())>;
+
+    return vector_array<value_type>{
+        frame.values(c, 0).data(), frame.values(c, 1).data(),
+        frame.values(c, 2).data()};
+}
+
+// Same arrays starting at element i.
+template <typename T>
+quaternion_array<T> advance(quaternion_array<T> q, std::size_t i)
+{
+    return {q.w + i, q.x + i, q.y + i, q.z + i};
+}
+
+template <typename T>
+vector_array<T> advance(vector_array<T> v, std::size_t i)
+{
+    return {v.x + i, v.y + i, v.z + i};
+}
+
+template <typename T>
+matrix_array<T> advance(matrix_array<T> m, std::size_t i)
+{
+    for (auto& ptr : m.m) {
+        ptr += i;
+    }
+
+    return m;
+}
+
+// Rotate element j of v by element i of q.
+std::array<float, 3> rotate_one(
+    quaternion_array<const float> q, vector_array<const float> v,
+    std::size_t i, std::size_t j)
+{
+    const float w = q.w[i], x = q.x[i], y = q.y[i], z = q.z[i];
+    const float vx = v.x[j], vy = v.y[j], vz = v.z[j];
+
+    // t = 2 * cross(q, v), out = v + w * t + cross(q, t)
+    const float tx = 2 * (y * vz - z * vy);
+    const float ty = 2 * (z * vx - x * vz);
+    const float tz = 2 * (x * vy - y * vx);
+
+    return {
+        vx + w * tx + (y * tz - z * ty), vy + w * ty + (z * tx - x * tz),
+        vz + w * tz + (x * ty - y * tx)};
+}
+
+constexpr float kPi = 3.14159265358979323846f;
+
+} // namespace
+
+quaternion_array<float> get_quaternion_array(soa_frame& frame, channel c)
+{
+    return get_quaternion_array_impl(frame, c);
+}
+
+quaternion_array<const float>
+get_quaternion_array(const soa_frame& frame, channel c)
+{
+    return get_quaternion_array_impl(frame, c);
+}
+
+vector_array<float> get_vector_array(soa_frame& frame, channel c)
+{
+    return get_vector_array_impl(frame, c);
+}
+
+vector_array<const float> get_vector_array(const soa_frame& frame, channel c)
+{
+    return get_vector_array_impl(frame, c);
+}
+
+namespace detail {
+
+void normalize_scalar(quaternion_array<float> q, std::size_t n)
+{
+    for (std::size_t i = 0; i < n; ++i) {
+        const float s =
+            1 / std::sqrt(
+                    q.w[i] * q.w[i] + q.x[i] * q.x[i] + q.y[i] * q.y[i] +
+                    q.z[i] * q.z[i]);
+
+        q.w[i] *= s;
+        q.x[i] *= s;
+        q.y[i] *= s;
+        q.z[i] *= s;
+    }
+}
+
+void multiply_scalar(
+    quaternion_array<const float> lhs, quaternion_array<const float> rhs,
+    quaternion_array<float> out, std::size_t n)
+{
+    for (std::size_t i = 0; i < n; ++i) {
+        const float aw = lhs.w[i], ax = lhs.x[i], ay = lhs.y[i], az = lhs.z[i];
+        const float bw = rhs.w[i], bx = rhs.x[i], by = rhs.y[i], bz = rhs.z[i];
+
+        out.w[i] = aw * bw - ax * bx - ay * by - az * bz;
+        out.x[i] = aw * bx + ax * bw + ay * bz - az * by;
+        out.y[i] = aw * by - ax * bz + ay * bw + az * bx;
+        out.z[i] = aw * bz + ax * by - ay * bx + az * bw;
+    }
+}
+
+void to_euler_scalar(
+    quaternion_array<const float> q, vector_array<float> out, std::size_t n)
+{
+    for (std::size_t i = 0; i < n; ++i) {
+        const float w = q.w[i], x = q.x[i], y = q.y[i], z = q.z[i];
+
+        out.x[i] =
+            std::atan2(2 * (w * x + y * z), 1 - 2 * (x * x + y * y));
+        out.y[i] = std::asin(std::clamp(2 * (w * y - z * x), -1.0f, 1.0f));
+        out.z[i] =
+            std::atan2(2 * (w * z + x * y), 1 - 2 * (y * y + z * z));
+    }
+}
+
+void to_matrix_scalar(
+    quaternion_array<const float> q, matrix_array<float> out, std::size_t n)
+{
+    auto& m = out.m;
+    for (std::size_t i = 0; i < n; ++i) {
+        const float w = q.w[i], x = q.x[i], y = q.y[i], z = q.z[i];
+
+        m[0][i] = 1 - 2 * (y * y + z * z);
+        m[1][i] = 2 * (x * y - w * z);
+        m[2][i] = 2 * (x * z + w * y);
+        m[3][i] = 2 * (x * y + w * z);
+        m[4][i] = 1 - 2 * (x * x + z * z);
+        m[5][i] = 2 * (y * z - w * x);
+        m[6][i] = 2 * (x * z - w * y);
+        m[7][i] = 2 * (y * z + w * x);
+        m[8][i] = 1 - 2 * (x * x + y * y);
+    }
+}
+
+void rotate_scalar(
+    quaternion_array<const float> q, vector_array<const float> v,
+    vector_array<float> out, std::size_t n)
+{
+    for (std::size_t i = 0; i < n; ++i) {
+        const auto r = rotate_one(q, v, i, i);
+
+        out.x[i] = r[0];
+        out.y[i] = r[1];
+        out.z[i] = r[2];
+    }
+}
+
+void transform_scalar(
+    quaternion_array<const float> q, vector_array<const float> t,
+    vector_array<const float> v, vector_array<float> out, std::size_t n)
+{
+    for (std::size_t i = 0; i < n; ++i) {
+        const auto r = rotate_one(q, v, i, i);
+
+        out.x[i] = r[0] + t.x[i];
+        out.y[i] = r[1] + t.y[i];
+        out.z[i] = r[2] + t.z[i];
+    }
+}
+
+} // namespace detail
+
+#if defined(SHADOWMOCAP_MATH_AVX2) || defined(SHADOWMOCAP_MATH_SSE2) ||       \
+    defined(SHADOWMOCAP_MATH_NEON)
+#define SHADOWMOCAP_MATH_SIMD
+
+namespace {
+
+// One register of floats and the handful of operations the kernels need.
+// Everything else is written once in terms of these.
+#if defined(SHADOWMOCAP_MATH_AVX2)
+
+constexpr std::size_t kWidth = 8;
+
+struct vf {
+    __m256 v;
+};
+
+using vmask = __m256;
+
+vf load(const float* ptr)
+{
+    return {_mm256_loadu_ps(ptr)};
+}
+
+void store(float* ptr, vf a)
+{
+    _mm256_storeu_ps(ptr, a.v);
+}
+
+vf broadcast(float value)
+{
+    return {_mm256_set1_ps(value)};
+}
+
+vf operator+(vf a, vf b)
+{
+    return {_mm256_add_ps(a.v, b.v)};
+}
+
+vf operator-(vf a, vf b)
+{
+    return {_mm256_sub_ps(a.v, b.v)};
+}
+
+vf operator*(vf a, vf b)
+{
+    return {_mm256_mul_ps(a.v, b.v)};
+}
+
+vf operator/(vf a, vf b)
+{
+    return {_mm256_div_ps(a.v, b.v)};
+}
+
+// a * b + c
+vf fmadd(vf a, vf b, vf c)
+{
+#if defined(__FMA__) || defined(_MSC_VER)
+    return {_mm256_fmadd_ps(a.v, b.v, c.v)};
+#else
+    return a * b + c;
+#endif
+}
+
+vf min(vf a, vf b)
+{
+    return {_mm256_min_ps(a.v, b.v)};
+}
+
+vf max(vf a, vf b)
+{
+    return {_mm256_max_ps(a.v, b.v)};
+}
+
+vf sqrt(vf a)
+{
+    return {_mm256_sqrt_ps(a.v)};
+}
+
+// 12 bit estimate and one Newton-Raphson step.
+vf rsqrt(vf a)
+{
+    const vf y{_mm256_rsqrt_ps(a.v)};
+
+    return y * (broadcast(1.5f) - broadcast(0.5f) * a * y * y);
+}
+
+vmask less(vf a, vf b)
+{
+    return _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ);
+}
+
+// mask ? a : b
+vf select(vmask mask, vf a, vf b)
+{
+    return {_mm256_blendv_ps(b.v, a.v, mask)};
+}
+
+vf abs(vf a)
+{
+    return {_mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v)};
+}
+
+// Magnitude of a with the sign of b.
+vf copysign(vf a, vf b)
+{
+    const auto sign = _mm256_set1_ps(-0.0f);
+
+    return {_mm256_or_ps(
+        _mm256_andnot_ps(sign, a.v), _mm256_and_ps(sign, b.v))};
+}
+
+constexpr const char* kSimdName = "avx2";
+
+#elif defined(SHADOWMOCAP_MATH_SSE2)
+
+constexpr std::size_t kWidth = 4;
+
+struct vf {
+    __m128 v;
+};
+
+using vmask = __m128;
+
+vf load(const float* ptr)
+{
+    return {_mm_loadu_ps(ptr)};
+}
+
+void store(float* ptr, vf a)
+{
+    _mm_storeu_ps(ptr, a.v);
+}
+
+vf broadcast(float value)
+{
+    return {_mm_set1_ps(value)};
+}
+
+vf operator+(vf a, vf b)
+{
+    return {_mm_add_ps(a.v, b.v)};
+}
+
+vf operator-(vf a, vf b)
+{
+    return {_mm_sub_ps(a.v, b.v)};
+}
+
+vf operator*(vf a, vf b)
+{
+    return {_mm_mul_ps(a.v, b.v)};
+}
+
+vf operator/(vf a, vf b)
+{
+    return {_mm_div_ps(a.v, b.v)};
+}
+
+vf fmadd(vf a, vf b, vf c)
+{
+    return a * b + c;
+}
+
+vf min(vf a, vf b)
+{
+    return {_mm_min_ps(a.v, b.v)};
+}
+
+vf max(vf a, vf b)
+{
+    return {_mm_max_ps(a.v, b.v)};
+}
+
+vf sqrt(vf a)
+{
+    return {_mm_sqrt_ps(a.v)};
+}
+
+vf rsqrt(vf a)
+{
+    const vf y{_mm_rsqrt_ps(a.v)};
+
+    return y * (broadcast(1.5f) - broadcast(0.5f) * a * y * y);
+}
+
+vmask less(vf a, vf b)
+{
+    return _mm_cmplt_ps(a.v, b.v);
+}
+
+// No blend before SSE4.1.
+vf select(vmask mask, vf a, vf b)
+{
+    return {_mm_or_ps(_mm_and_ps(mask, a.v), _mm_andnot_ps(mask, b.v))};
+}
+
+vf abs(vf a)
+{
+    return {_mm_andnot_ps(_mm_set1_ps(-0.0f), a.v)};
+}
+
+vf copysign(vf a, vf b)
+{
+    const auto sign = _mm_set1_ps(-0.0f);
+
+    return {_mm_or_ps(_mm_andnot_ps(sign, a.v), _mm_and_ps(sign, b.v))};
+}
+
+constexpr const char* kSimdName = "sse2";
+
+#elif defined(SHADOWMOCAP_MATH_NEON)
+
+constexpr std::size_t kWidth = 4;
+
+struct vf {
+    float32x4_t v;
+};
+
+using vmask = uint32x4_t;
+
+vf load(const float* ptr)
+{
+    return {vld1q_f32(ptr)};
+}
+
+void store(float* ptr, vf a)
+{
+    vst1q_f32(ptr, a.v);
+}
+
+vf broadcast(float value)
+{
+    return {vdupq_n_f32(value)};
+}
+
+vf operator+(vf a, vf b)
+{
+    return {vaddq_f32(a.v, b.v)};
+}
+
+vf operator-(vf a, vf b)
+{
+    return {vsubq_f32(a.v, b.v)};
+}
+
+vf operator*(vf a, vf b)
+{
+    return {vmulq_f32(a.v, b.v)};
+}
+
+vf operator/(vf a, vf b)
+{
+    return {vdivq_f32(a.v, b.v)};
+}
+
+vf fmadd(vf a, vf b, vf c)
+{
+    return {vfmaq_f32(c.v, a.v, b.v)};
+}
+
+vf min(vf a, vf b)
+{
+    return {vminq_f32(a.v, b.v)};
+}
+
+vf max(vf a, vf b)
+{
+    return {vmaxq_f32(a.v, b.v)};
+}
+
+vf sqrt(vf a)
+{
+    return {vsqrtq_f32(a.v)};
+}
+
+// 8 bit estimate and two Newton-Raphson steps.
+vf rsqrt(vf a)
+{
+    auto y = vrsqrteq_f32(a.v);
+    y = vmulq_f32(y, vrsqrtsq_f32(vmulq_f32(a.v, y), y));
+    y = vmulq_f32(y, vrsqrtsq_f32(vmulq_f32(a.v, y), y));
+
+    return {y};
+}
+
+vmask less(vf a, vf b)
+{
+    return vcltq_f32(a.v, b.v);
+}
+
+vf select(vmask mask, vf a, vf b)
+{
+    return {vbslq_f32(mask, a.v, b.v)};
+}
+
+vf abs(vf a)
+{
+    return {vabsq_f32(a.v)};
+}
+
+vf copysign(vf a, vf b)
+{
+    return {vbslq_f32(vdupq_n_u32(0x80000000), b.v, a.v)};
+}
+
+constexpr const char* kSimdName = "neon";
+
+#endif
+
+struct quat {
+    vf w, x, y, z;
+};
+
+struct vec {
+    vf x, y, z;
+};
+
+quat load(quaternion_array<const float> q, std::size_t i)
+{
+    return {load(q.w + i), load(q.x + i), load(q.y + i), load(q.z + i)};
+}
+
+void store(quaternion_array<float> q, std::size_t i, const quat& a)
+{
+    store(q.w + i, a.w);
+    store(q.x + i, a.x);
+    store(q.y + i, a.y);
+    store(q.z + i, a.z);
+}
+
+vec load(vector_array<const float> v, std::size_t i)
+{
+    return {load(v.x + i), load(v.y + i), load(v.z + i)};
+}
+
+void store(vector_array<float> v, std::size_t i, const vec& a)
+{
+    store(v.x + i, a.x);
+    store(v.y + i, a.y);
+    store(v.z + i, a.z);
+}
+
+// Arc tangent of y / x in [-pi, pi] with the reduction and polynomial of the
+// Cephes atanf. Within a couple of units in the last place of std::atan2.
+vf atan2(vf y, vf x)
+{
+    const vf ax = abs(x);
+    const vf ay = abs(y);
+    const vf hi = max(ax, ay);
+    const vf lo = min(ax, ay);
+
+    // atan(lo / hi) in [0, pi/4]. Above tan(pi/8) use
+    // pi/4 + atan((lo - hi) / (lo + hi)) so the polynomial only sees
+    // [-tan(pi/8), tan(pi/8)].
+    const auto big = less(hi * broadcast(0.414213562373095f), lo);
+    const vf a = select(big, lo - hi, lo) /
+                 max(select(big, lo + hi, hi), broadcast(FLT_MIN));
+
+    const vf z = a * a;
+    vf p = broadcast(8.05374449538e-2f);
+    p = fmadd(p, z, broadcast(-1.38776856032e-1f));
+    p = fmadd(p, z, broadcast(1.99777106478e-1f));
+    p = fmadd(p, z, broadcast(-3.33329491539e-1f));
+
+    vf r = fmadd(p * z, a, a);
+    r = r + select(big, broadcast(kPi / 4), broadcast(0));
+
+    r = select(less(ax, ay), broadcast(kPi / 2) - r, r);
+    r = select(less(x, broadcast(0)), broadcast(kPi) - r, r);
+
+    return copysign(r, y);
+}
+
+quat multiply(const quat& a, const quat& b)
+{
+    return {
+        a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z,
+        a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y,
+        a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x,
+        a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w};
+}
+
+vec rotate(const quat& q, const vec& v)
+{
+    const vf two = broadcast(2);
+
+    const vf tx = two * (q.y * v.z - q.z * v.y);
+    const vf ty = two * (q.z * v.x - q.x * v.z);
+    const vf tz = two * (q.x * v.y - q.y * v.x);
+
+    return {
+        fmadd(q.w, tx, v.x) + (q.y * tz - q.z * ty),
+        fmadd(q.w, ty, v.y) + (q.z * tx - q.x * tz),
+        fmadd(q.w, tz, v.z) + (q.x * ty - q.y * tx)};
+}
+
+} // namespace
+
+#endif
+
+void normalize(quaternion_array<float> q, std::size_t n)
+{
+    std::size_t i = 0;
+#if defined(SHADOWMOCAP_MATH_SIMD)
+    for (; i + kWidth <= n; i += kWidth) {
+        const auto a = load(q, i);
+
+        const vf s = rsqrt(fmadd(
+            a.w, a.w, fmadd(a.x, a.x, fmadd(a.y, a.y, a.z * a.z))));
+
+        store(q, i, {a.w * s, a.x * s, a.y * s, a.z * s});
+    }
+#endif
+
+    detail::normalize_scalar(advance(q, i), n - i);
+}
+
+void multiply(
+    quaternion_array<const float> lhs, quaternion_array<const float> rhs,
+    quaternion_array<float> out, std::size_t n)
+{
+    std::size_t i = 0;
+#if defined(SHADOWMOCAP_MATH_SIMD)
+    for (; i + kWidth <= n; i += kWidth) {
+        store(out, i, multiply(load(lhs, i), load(rhs, i)));
+    }
+#endif
+
+    detail::multiply_scalar(
+        advance(lhs, i), advance(rhs, i), advance(out, i), n - i);
+}
+
+void to_euler(
+    quaternion_array<const float> q, vector_array<float> out, std::size_t n)
+{
+    std::size_t i = 0;
+#if defined(SHADOWMOCAP_MATH_SIMD)
+    const vf one = broadcast(1);
+    const vf two = broadcast(2);
+
+    for (; i + kWidth <= n; i += kWidth) {
+        const auto a = load(q, i);
+
+        const vf roll = atan2(
+            two * fmadd(a.w, a.x, a.y * a.z),
+            one - two * fmadd(a.x, a.x, a.y * a.y));
+
+        // asin(s) = atan2(s, sqrt((1 - s) * (1 + s))), which keeps its
+        // precision near +-1.
+        const vf s = max(
+            min(two * (a.w * a.y - a.z * a.x), one), broadcast(-1));
+        const vf pitch = atan2(s, sqrt((one - s) * (one + s)));
+
+        const vf yaw = atan2(
+            two * fmadd(a.w, a.z, a.x * a.y),
+            one - two * fmadd(a.y, a.y, a.z * a.z));
+
+        store(out, i, {roll, pitch, yaw});
+    }
+#endif
+
+    detail::to_euler_scalar(advance(q, i), advance(out, i), n - i);
+}
+
+void to_matrix(
+    quaternion_array<const float> q, matrix_array<float> out, std::size_t n)
+{
+    std::size_t i = 0;
+#if defined(SHADOWMOCAP_MATH_SIMD)
+    const vf one = broadcast(1);
+    const vf two = broadcast(2);
+
+    auto& m = out.m;
+    for (; i + kWidth <= n; i += kWidth) {
+        const auto a = load(q, i);
+
+        store(m[0] + i, one - two * fmadd(a.y, a.y, a.z * a.z));
+        store(m[1] + i, two * (a.x * a.y - a.w * a.z));
+        store(m[2] + i, two * fmadd(a.x, a.z, a.w * a.y));
+        store(m[3] + i, two * fmadd(a.x, a.y, a.w * a.z));
+        store(m[4] + i, one - two * fmadd(a.x, a.x, a.z * a.z));
+        store(m[5] + i, two * (a.y * a.z - a.w * a.x));
+        store(m[6] + i, two * (a.x * a.z - a.w * a.y));
+        store(m[7] + i, two * fmadd(a.y, a.z, a.w * a.x));
+        store(m[8] + i, one - two * fmadd(a.x, a.x, a.y * a.y));
+    }
+#endif
+
+    detail::to_matrix_scalar(advance(q, i), advance(out, i), n - i);
+}
+
+void rotate(
+    quaternion_array<const float> q, vector_array<const float> v,
+    vector_array<float> out, std::size_t n)
+{
+    std::size_t i = 0;
+#if defined(SHADOWMOCAP_MATH_SIMD)
+    for (; i + kWidth <= n; i += kWidth) {
+        store(out, i, rotate(load(q, i), load(v, i)));
+    }
+#endif
+
+    detail::rotate_scalar(
+        advance(q, i), advance(v, i), advance(out, i), n - i);
+}
+
+void transform(
+    quaternion_array<const float> q, vector_array<const float> t,
+    vector_array<const float> v, vector_array<float> out, std::size_t n)
+{
+    std::size_t i = 0;
+#if defined(SHADOWMOCAP_MATH_SIMD)
+    for (; i + kWidth <= n; i += kWidth) {
+        const auto a = rotate(load(q, i), load(v, i));
+        const auto b = load(t, i);
+
+        store(out, i, {a.x + b.x, a.y + b.y, a.z + b.z});
+    }
+#endif
+
+    detail::transform_scalar(
+        advance(q, i), advance(t, i), advance(v, i), advance(out, i), n - i);
+}
+
+void forward_kinematics(
+    std::span<const int> parent, quaternion_array<const float> local,
+    vector_array<const float> offset, quaternion_array<float> rotation,
+    vector_array<float> position, std::size_t n)
+{
+    if (parent.size() != n) {
+        throw std::invalid_argument("parent list does not match the frame");
+    }
+
+    for (std::size_t i = 0; i < n; ++i) {
+        const int p = parent[i];
+        if (p < 0) {
+            rotation.w[i] = local.w[i];
+            rotation.x[i] = local.x[i];
+            rotation.y[i] = local.y[i];
+            rotation.z[i] = local.z[i];
+
+            position.x[i] = offset.x[i];
+            position.y[i] = offset.y[i];
+            position.z[i] = offset.z[i];
+            continue;
+        }
+
+        if (static_cast<std::size_t>(p) >= i) {
+            throw std::invalid_argument(
+                "parent does not come before its child");
+        }
+
+        // Parent is already solved.
+        const auto j = static_cast<std::size_t>(p);
+
+        const float pw = rotation.w[j], px = rotation.x[j],
+                    py = rotation.y[j], pz = rotation.z[j];
+        const float lw = local.w[i], lx = local.x[i], ly = local.y[i],
+                    lz = local.z[i];
+
+        const auto r = rotate_one(rotation, offset, j, i);
+
+        position.x[i] = position.x[j] + r[0];
+        position.y[i] = position.y[j] + r[1];
+        position.z[i] = position.z[j] + r[2];
+
+        rotation.w[i] = pw * lw - px * lx - py * ly - pz * lz;
+        rotation.x[i] = pw * lx + px * lw + py * lz - pz * ly;
+        rotation.y[i] = pw * ly - px * lz + py * lw + pz * lx;
+        rotation.z[i] = pw * lz + px * ly - py * lx + pz * lw;
+    }
+}
+
+namespace detail {
+
+const char* get_simd_name()
+{
+#if defined(SHADOWMOCAP_MATH_SIMD)
+    return kSimdName;
+#else
+    return "scalar";
+#endif
+}
+
+} // namespace detail
+
+} // namespace shadowmocap
@@ -2,11 +2,49 @@
 #include <shadowmocap/message.hpp>
 
 #include <algorithm>
-#include <iterator>
-#include <regex>
+#include <bit>
+#include <charconv>
+#include <cstring>
+#include <utility>
 
 namespace shadowmocap {
 
+message_layout::message_layout(int mask)
+    : mask_{mask & kAllChannelMask},
+      dimension_{get_channel_mask_dimension(mask & kAllChannelMask)}
+{
+    int offset = 0;
+    for (auto c : kChannelList) {
+        if (mask_ & c) {
+            offset_[std::countr_zero(static_cast<unsigned>(c))] = offset;
+            offset += get_channel_dimension(c);
+        }
+    }
+}
+
+message_layout_view::message_layout_view(
+    std::string_view message, const message_layout& layout)
+{
+    const auto item_size = layout.item_size();
+
+    // Sanity checks. Leave the view empty on failure.
+    if (message.empty() || (message.size() % item_size != 0)) {
+        return;
+    }
+
+    for (std::size_t i = 0; i < message.size(); i += item_size) {
+        int length = 0;
+        std::memcpy(&length, message.data() + i + sizeof(int), sizeof(int));
+
+        if (length != layout.dimension()) {
+            return;
+        }
+    }
+
+    message_ = message;
+    layout_ = &layout;
+}
+
 bool is_metadata(std::string_view message)
 {
     constexpr std::string_view kXmlMagic = "<?xml";
@@ -14,39 +52,286 @@ bool is_metadata(std::string_view message)
     return message.starts_with(kXmlMagic);
 }
 
-std::vector<std::string> parse_metadata(std::string_view message)
+namespace {
+
+// Same as \s in a regular expression.
+bool is_space(char c)
+{
+    return (c == ' ') || (c == '\t') || (c == '\n') || (c == '\v') ||
+           (c == '\f') || (c == '\r');
+}
+
+bool is_digit(char c)
+{
+    return (c >= '0') && (c <= '9');
+}
+
+// Match the attributes of one node element, starting just after "<node".
+//
+//   \s+id="([^"]+)"\s+key="(\d+)"
+//
+// Returns the position after the match or npos if it does not match.
+std::size_t match_node(
+    std::string_view message, std::size_t pos, std::string_view& name,
+    std::string_view& key)
 {
-    // Use regular expression to parse the very simple XML string so we do not
-    // depend on a full XML library.
-    const std::regex re{"<node\\s+id=\"([^\"]+)\"\\s+key=\"(\\d+)\""};
+    constexpr auto npos = std::string_view::npos;
+    constexpr std::string_view kId = "id=\"";
+    constexpr std::string_view kKey = "key=\"";
+
+    const auto skip_space = [&message](std::size_t i) {
+        const auto first = i;
+        while ((i < message.size()) && is_space(message[i])) {
+            ++i;
+        }
+
+        return (i == first) ? npos : i;
+    };
+
+    pos = skip_space(pos);
+    if ((pos == npos) || !message.substr(pos).starts_with(kId)) {
+        return npos;
+    }
 
-    auto first = std::regex_iterator{message.begin(), message.end(), re};
-    auto last = decltype(first){};
+    pos += kId.size();
 
-    if (first == last) {
-        return {};
+    const auto last = message.find('"', pos);
+    if ((last == npos) || (last == pos)) {
+        return npos;
     }
 
-    // Skip over the first <node id="default"> root level element.
-    ++first;
+    name = message.substr(pos, last - pos);
+
+    pos = skip_space(last + 1);
+    if ((pos == npos) || !message.substr(pos).starts_with(kKey)) {
+        return npos;
+    }
+
+    pos += kKey.size();
+
+    auto i = pos;
+    while ((i < message.size()) && is_digit(message[i])) {
+        ++i;
+    }
+
+    if ((i == pos) || (i == message.size()) || (message[i] != '"')) {
+        return npos;
+    }
+
+    key = message.substr(pos, i - pos);
+
+    return i + 1;
+}
+
+// Position of the '>' that ends an element, skipping over quoted attribute
+// values. Returns npos if the element is not closed, i.e. another element
+// starts first. One pass, and it stops at the next element so the scans of
+// all elements together stay linear in the message size.
+std::size_t find_element_end(std::string_view message, std::size_t pos)
+{
+    bool in_quote = false;
+    for (; pos < message.size(); ++pos) {
+        const char c = message[pos];
+        if (c == '"') {
+            in_quote = !in_quote;
+        } else if (!in_quote && (c == '>')) {
+            return pos;
+        } else if (!in_quote && (c == '<')) {
+            break;
+        }
+    }
+
+    return std::string_view::npos;
+}
+
+} // namespace
+
+std::vector<metadata_node> parse_metadata_nodes(std::string_view message)
+{
+    // Hand written scanner for the very simple XML string so we do not depend
+    // on a full XML library. Matches the same elements as the regular
+    // expression:
+    //
+    //   <node\s+id="([^"]+)"\s+key="(\d+)"
+    //
+    // and follows the nesting of the elements for the parent of each node.
+    // The search for the next match starts right after the previous one, as
+    // for the regular expression, so an element that does not match never
+    // hides a match inside of it.
+    constexpr std::string_view kNode = "<node";
+    constexpr std::string_view kEndNode = "</node";
+    constexpr auto npos = std::string_view::npos;
+
+    std::vector<metadata_node> node_list;
+    bool is_root = true;
+
+    // Parent index for the children of each open element. Children of the
+    // root or of an element that does not match belong to the nearest node
+    // above them in the list.
+    std::vector<int> parent_stack;
+
+    for (auto pos = message.find('<'); pos != npos;
+         pos = message.find('<', pos)) {
+        const auto tag = message.substr(pos);
+        if (tag.starts_with(kEndNode)) {
+            if (!parent_stack.empty()) {
+                parent_stack.pop_back();
+            }
+
+            pos += kEndNode.size();
+            continue;
+        }
+
+        if (!tag.starts_with(kNode)) {
+            ++pos;
+            continue;
+        }
+
+        pos += kNode.size();
+
+        std::string_view name;
+        std::string_view key;
+
+        const auto last = match_node(message, pos, name, key);
 
-    auto num_node = std::distance(first, last);
-    if (num_node <= 0) {
-        return {};
+        // Only look ahead for the end of the element to track the nesting.
+        // An element that is not closed has no children.
+        const auto end = find_element_end(message, (last == npos) ? pos : last);
+        const bool is_open = (end != npos) && (message[end - 1] != '/');
+        const int parent = parent_stack.empty() ? -1 : parent_stack.back();
+
+        if (last == npos) {
+            if (is_open) {
+                parent_stack.push_back(parent);
+            }
+
+            continue;
+        }
+
+        pos = last;
+
+        // Skip over the first <node id="default"> root level element.
+        if (is_root) {
+            is_root = false;
+            if (is_open) {
+                parent_stack.push_back(-1);
+            }
+
+            continue;
+        }
+
+        if (node_list.empty()) {
+            // Count the remaining elements so we allocate once. Overestimates
+            // if any of them do not match.
+            std::size_t n = 1;
+            for (auto i = message.find(kNode, pos); i != npos;
+                 i = message.find(kNode, i + kNode.size())) {
+                ++n;
+            }
+
+            node_list.reserve(n);
+        }
+
+        int value = 0;
+        std::from_chars(key.data(), key.data() + key.size(), value);
+
+        if (is_open) {
+            parent_stack.push_back(static_cast<int>(node_list.size()));
+        }
+
+        node_list.push_back(metadata_node{std::string{name}, value, parent});
     }
 
+    return node_list;
+}
+
+std::vector<std::string> parse_metadata(std::string_view message)
+{
+    auto node_list = parse_metadata_nodes(message);
+
     // Create a list of id string in order.
     // <node id="A"/><node id="B"/> -> ["A", "B"]
-    std::vector<std::string> name_list(num_node);
+    std::vector<std::string> name_list(node_list.size());
 
-    std::transform(first, last, name_list.begin(), [](const auto& match) {
-        // Return submatch #1 as a string, the id="..." attribute.
-        return match.str(1);
-    });
+    std::transform(
+        node_list.begin(), node_list.end(), name_list.begin(),
+        [](auto& node) { return std::move(node.name); });
 
     return name_list;
 }
 
+node_map::node_map(std::vector<metadata_node> nodes) : nodes_{std::move(nodes)}
+{
+    int max_key = -1;
+    for (const auto& node : nodes_) {
+        if ((node.key >= 0) && (node.key < kMaxKey)) {
+            max_key = std::max(max_key, node.key);
+        }
+    }
+
+    by_key_.assign(static_cast<std::size_t>(max_key + 1), -1);
+    by_name_.reserve(nodes_.size());
+    parents_.resize(nodes_.size());
+
+    for (int i = 0; i < static_cast<int>(nodes_.size()); ++i) {
+        const auto& node = nodes_[i];
+
+        // First node wins if the metadata has duplicate keys or names.
+        if ((node.key >= 0) && (node.key < kMaxKey) &&
+            (by_key_[node.key] < 0)) {
+            by_key_[node.key] = i;
+        }
+
+        by_name_.emplace(node.name, i);
+
+        // Keep the list in topological order even if the nodes were not
+        // from the parser.
+        parents_[i] = ((node.parent >= 0) && (node.parent < i)) ? node.parent
+                                                                : -1;
+    }
+}
+
+std::vector<int> node_map::item_parents(std::span<const int> keys) const
+{
+    // Item of every node, or -1 if the node is not in the frame.
+    std::vector<int> items(nodes_.size(), -1);
+    for (std::size_t i = 0; i < keys.size(); ++i) {
+        const auto index = find(keys[i]);
+        if ((index >= 0) && (items[index] < 0)) {
+            items[index] = static_cast<int>(i);
+        }
+    }
+
+    std::vector<int> result(keys.size(), -1);
+    for (std::size_t i = 0; i < keys.size(); ++i) {
+        const auto index = find(keys[i]);
+        if (index < 0) {
+            continue;
+        }
+
+        // Nearest ancestor that is in the frame. Parents come before their
+        // children so this ends.
+        auto parent = parents_[index];
+        while ((parent >= 0) && (items[parent] < 0)) {
+            parent = parents_[parent];
+        }
+
+        if (parent >= 0) {
+            result[i] = items[parent];
+        }
+    }
+
+    return result;
+}
+
+void node_map::clear()
+{
+    nodes_.clear();
+    by_key_.clear();
+    by_name_.clear();
+    parents_.clear();
+}
+
 std::string make_channel_message(int mask)
 {
     constexpr std::string_view kPre =
@@ -66,4 +351,34 @@ std::string make_channel_message(int mask)
     return message;
 }
 
+int parse_channel_message(std::string_view message)
+{
+    constexpr auto npos = std::string_view::npos;
+
+    int mask = 0;
+    for (auto pos = message.find('<'); pos != npos;
+         pos = message.find('<', pos)) {
+        ++pos;
+
+        // Element name ends at the first space, slash, or closing bracket.
+        auto last = pos;
+        while ((last < message.size()) && !is_space(message[last]) &&
+               (message[last] != '/') && (message[last] != '>')) {
+            ++last;
+        }
+
+        const auto name = message.substr(pos, last - pos);
+        for (auto c : kChannelList) {
+            if (name == get_channel_name(c)) {
+                mask |= c;
+                break;
+            }
+        }
+
+        pos = last;
+    }
+
+    return mask;
+}
+
 } // namespace shadowmocap
@@ -0,0 +1,73 @@
+// Copyright Motion Workshop. All Rights Reserved.
+#include <shadowmocap/metrics.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+namespace shadowmocap {
+
+double histogram_snapshot::mean() const
+{
+    if (count == 0) {
+        return 0;
+    }
+
+    return static_cast<double>(sum) / static_cast<double>(count);
+}
+
+std::uint64_t histogram_snapshot::percentile(double percent) const
+{
+    if (count == 0) {
+        return 0;
+    }
+
+    // Rank of the value we want, from 1 to count.
+    const auto rank = std::max<std::uint64_t>(
+        1, static_cast<std::uint64_t>(std::ceil(
+               std::clamp(percent, 0.0, 100.0) / 100 *
+               static_cast<double>(count))));
+
+    std::uint64_t total = 0;
+    for (std::size_t i = 0; i < counts.size(); ++i) {
+        total += counts[i];
+        if (total >= rank) {
+            // Largest value is exact, the rest are rounded down.
+            return (i == index(max)) ? max : lower_bound(i);
+        }
+    }
+
+    return max;
+}
+
+histogram_snapshot latency_histogram::snapshot() const
+{
+    histogram_snapshot result;
+
+    for (std::size_t i = 0; i < counts_.size(); ++i) {
+        result.counts[i] = counts_[i].load(std::memory_order_relaxed);
+    }
+
+    result.count = count_.load(std::memory_order_relaxed);
+    result.sum = sum_.load(std::memory_order_relaxed);
+    result.max = max_.load(std::memory_order_relaxed);
+
+    return result;
+}
+
+metrics_snapshot stream_metrics::snapshot() const
+{
+    metrics_snapshot result;
+
+    result.num_bytes = num_bytes_.load(std::memory_order_relaxed);
+    result.num_frame = num_frame_.load(std::memory_order_relaxed);
+    result.num_metadata = num_metadata_.load(std::memory_order_relaxed);
+    result.num_deadline_extension =
+        num_deadline_extension_.load(std::memory_order_relaxed);
+
+    result.arrival = arrival_.snapshot();
+    result.read = read_.snapshot();
+
+    return result;
+}
+
+} // namespace shadowmocap
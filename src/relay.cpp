@@ -0,0 +1,220 @@
+// Copyright Motion Workshop. All Rights Reserved.
+#include <shadowmocap/relay.hpp>
+
+#include <asio/co_spawn.hpp>
+#include <asio/redirect_error.hpp>
+#include <asio/use_awaitable.hpp>
+
+#include <algorithm>
+#include <exception>
+
+namespace shadowmocap {
+
+relay::client::client(tcp::socket socket, const batch_options& options)
+    : socket{std::move(socket)}, writer{this->socket, options}
+{
+}
+
+relay::relay(datastream& upstream, int mask, relay_options options)
+    : upstream_{upstream}, layout_{mask}, options_{std::move(options)},
+      idle_{upstream.socket_.get_executor()}
+{
+}
+
+asio::awaitable<void> relay::run()
+{
+    std::exception_ptr error;
+    try {
+        for (;;) {
+            const auto message = co_await read_any_message(upstream_);
+
+            // Node list changes go to every client, never dropped.
+            if (is_metadata(message)) {
+                metadata_ = make_shared_message(message);
+
+                for (auto& ptr : clients_) {
+                    ptr->writer.write(metadata_);
+                }
+
+                continue;
+            }
+
+            frames_.clear();
+            for (auto& ptr : clients_) {
+                if (ptr->writer.size() > options_.max_queue_size) {
+                    ++num_dropped_;
+                    continue;
+                }
+
+                ptr->writer.write(get_frame(message, *ptr->subset));
+            }
+        }
+    } catch (...) {
+        error = std::current_exception();
+    }
+
+    co_await stop();
+
+    std::rethrow_exception(error);
+}
+
+asio::awaitable<void> relay::serve(tcp::acceptor& acceptor)
+{
+    if (stopped_) {
+        co_return;
+    }
+
+    acceptor_ = &acceptor;
+    ++num_task_;
+
+    try {
+        for (;;) {
+            auto socket =
+                co_await acceptor.async_accept(asio::use_awaitable);
+
+            if (stopped_) {
+                break;
+            }
+
+            auto ptr =
+                std::make_shared<client>(std::move(socket), options_.batch);
+
+            // Count the session now so stop() waits for it even if it has
+            // not started yet.
+            sessions_.push_back(ptr);
+            ++num_task_;
+
+            // Client disconnects end the session quietly.
+            co_spawn(
+                acceptor.get_executor(), session(std::move(ptr)),
+                [](std::exception_ptr) {});
+        }
+    } catch (...) {
+        acceptor_ = nullptr;
+        end_task();
+        throw;
+    }
+
+    acceptor_ = nullptr;
+    end_task();
+}
+
+asio::awaitable<void> relay::session(std::shared_ptr<client> ptr)
+{
+    try {
+        ptr->socket.set_option(tcp::no_delay{true});
+
+        // Serve the channels the client asked for that we have. Serve all
+        // of them if there are none in common, or if the service is not
+        // configurable and the client does not send a request.
+        {
+            const auto request =
+                co_await accept_service(ptr->socket, options_.name);
+
+            auto mask = parse_channel_message(request) & layout_.mask();
+            if (mask == 0) {
+                mask = layout_.mask();
+            }
+
+            ptr->subset = &get_channel_subset(layout_.mask(), mask);
+        }
+
+        if (metadata_) {
+            ptr->writer.write(metadata_);
+        }
+
+        // The upstream is gone. Send the node list and end the session.
+        if (stopped_) {
+            ptr->writer.close();
+        } else {
+            clients_.push_back(ptr);
+        }
+
+        co_await ptr->writer.run();
+    } catch (...) {
+        end_session(ptr);
+        throw;
+    }
+
+    end_session(ptr);
+}
+
+asio::awaitable<void> relay::stop()
+{
+    stopped_ = true;
+
+    // No new clients.
+    if (acceptor_ != nullptr) {
+        asio::error_code ec;
+        acceptor_->close(ec);
+    }
+
+    // Send what is queued and end every session. Sessions that are still in
+    // the handshake end now.
+    for (auto& ptr : sessions_) {
+        if (ptr->subset != nullptr) {
+            ptr->writer.close();
+        } else {
+            asio::error_code ec;
+            ptr->socket.close(ec);
+        }
+    }
+
+    // Wait for every coroutine that uses this relay. Drop the clients that
+    // are still draining at the timeout.
+    idle_.expires_after(options_.drain_timeout);
+    while (num_task_ > 0) {
+        asio::error_code ec;
+        co_await idle_.async_wait(
+            asio::redirect_error(asio::use_awaitable, ec));
+
+        if (!ec) {
+            for (auto& ptr : sessions_) {
+                asio::error_code ignored;
+                ptr->socket.close(ignored);
+            }
+
+            idle_.expires_at(asio::steady_timer::time_point::max());
+        }
+    }
+}
+
+void relay::end_task()
+{
+    --num_task_;
+    idle_.cancel();
+}
+
+void relay::end_session(const std::shared_ptr<client>& ptr)
+{
+    std::erase(clients_, ptr);
+    std::erase(sessions_, ptr);
+    end_task();
+}
+
+shared_message
+relay::get_frame(std::string_view message, const channel_subset& subset)
+{
+    const auto mask = subset.to();
+
+    auto itr = std::find_if(frames_.begin(), frames_.end(), [mask](auto& f) {
+        return f.first == mask;
+    });
+
+    if (itr != frames_.end()) {
+        return itr->second;
+    }
+
+    shared_message frame;
+    if (mask == layout_.mask()) {
+        frame = make_shared_message(message);
+    } else if (subset.apply(message, buffer_)) {
+        frame = make_shared_message(buffer_);
+    }
+
+    frames_.emplace_back(mask, frame);
+
+    return frame;
+}
+
+} // namespace shadowmocap
@@ -0,0 +1,132 @@
+// Copyright Motion Workshop. All Rights Reserved.
+#include <shadowmocap/replay.hpp>
+
+#include <asio/buffer.hpp>
+#include <asio/co_spawn.hpp>
+#include <asio/detached.hpp>
+#include <asio/steady_timer.hpp>
+#include <asio/use_awaitable.hpp>
+#include <asio/write.hpp>
+
+#include <array>
+#include <chrono>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace shadowmocap {
+
+namespace {
+
+// Node list to send if the capture does not have one. The real service always
+// sends a node list before the first frame.
+constexpr std::string_view kDefaultMetadata =
+    "<?xml version=\"1.0\"?><node id=\"default\" key=\"0\"/>";
+
+// Most frames to send in one write.
+constexpr std::size_t kMaxBatch = 64;
+
+} // namespace
+
+asio::awaitable<void> replay_session(
+    tcp::socket socket, const capture_reader& reader, replay_options options)
+{
+    using clock_type = std::chrono::steady_clock;
+
+    socket.set_option(tcp::no_delay{true});
+
+    // The recorded channels are sent regardless of the request.
+    co_await accept_service(socket, options.name);
+
+    {
+        auto metadata = reader.metadata(0);
+        if (metadata.empty()) {
+            metadata = kDefaultMetadata;
+        }
+
+        co_await write_message(socket, metadata);
+    }
+
+    asio::steady_timer timer{socket.get_executor()};
+
+    // Schedule every frame relative to the first one.
+    const std::int64_t start_time =
+        (reader.num_frame() > 0) ? (*reader.begin()).time : 0;
+
+    // Send all frames that are due with one gathered write. Headers are
+    // reserved up front so the buffers that point at them stay valid.
+    std::vector<std::array<char, 4>> headers;
+    std::vector<asio::const_buffer> buffers;
+    headers.reserve(2 * kMaxBatch);
+    buffers.reserve(4 * kMaxBatch);
+
+    auto append = [&headers, &buffers](std::string_view message) {
+        headers.push_back(make_message_header(message.size()));
+        buffers.push_back(asio::buffer(headers.back()));
+        buffers.push_back(asio::buffer(message));
+    };
+
+    bool first = true;
+    do {
+        const auto start = clock_type::now();
+
+        auto due = [&](const capture_frame& frame) {
+            const std::chrono::nanoseconds elapsed{static_cast<std::int64_t>(
+                (frame.time - start_time) / options.rate)};
+
+            return start +
+                   std::chrono::duration_cast<clock_type::duration>(elapsed);
+        };
+
+        for (auto it = reader.begin(); it != reader.end();) {
+            if (options.rate > 0) {
+                const auto next = due(*it);
+                if (next > clock_type::now()) {
+                    timer.expires_at(next);
+                    co_await timer.async_wait(asio::use_awaitable);
+                }
+            }
+
+            headers.clear();
+            buffers.clear();
+
+            const auto now = clock_type::now();
+            for (std::size_t n = 0; (it != reader.end()) && (n < kMaxBatch);
+                 ++it, ++n) {
+                const auto frame = *it;
+                if ((options.rate > 0) && (n > 0) && (due(frame) > now)) {
+                    break;
+                }
+
+                // Metadata goes before the first frame that uses it. The
+                // handshake already sent the first one.
+                if (frame.metadata_changed && !first &&
+                    !frame.metadata.empty()) {
+                    append(frame.metadata);
+                }
+
+                first = false;
+
+                append(frame.message);
+            }
+
+            co_await asio::async_write(socket, buffers, asio::use_awaitable);
+        }
+    } while (options.loop && (reader.num_frame() > 0));
+}
+
+asio::awaitable<void> replay_server(
+    tcp::acceptor& acceptor, const capture_reader& reader,
+    replay_options options)
+{
+    for (;;) {
+        auto socket = co_await acceptor.async_accept(asio::use_awaitable);
+
+        // Client disconnects end the session quietly.
+        co_spawn(
+            acceptor.get_executor(),
+            replay_session(std::move(socket), reader, options), asio::detached);
+    }
+}
+
+} // namespace shadowmocap
@@ -0,0 +1,251 @@
+// Copyright Motion Workshop. All Rights Reserved.
+#include <shadowmocap/resilient_stream.hpp>
+
+#include <asio/co_spawn.hpp>
+#include <asio/detached.hpp>
+#include <asio/error.hpp>
+#include <asio/redirect_error.hpp>
+#include <asio/system_error.hpp>
+#include <asio/use_awaitable.hpp>
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+namespace shadowmocap {
+
+resilient_stream::connection::connection(
+    const asio::any_io_executor& executor)
+    : stream{tcp::socket{executor}}, timer{executor}
+{
+}
+
+void resilient_stream::connection::close()
+{
+    closed = true;
+
+    // Wakes the pending read or connect with an error.
+    asio::error_code ec;
+    stream.socket_.close(ec);
+    timer.cancel();
+}
+
+resilient_stream::resilient_stream(
+    const asio::any_io_executor& executor, tcp::endpoint endpoint, int mask,
+    reconnect_options options)
+    : executor_{executor}, endpoint_{std::move(endpoint)},
+      request_{make_channel_message(mask)}, options_{options},
+      timer_{executor}, random_{std::random_device{}()}
+{
+}
+
+resilient_stream::~resilient_stream()
+{
+    close();
+}
+
+void resilient_stream::on_gap(gap_handler handler)
+{
+    on_gap_ = std::move(handler);
+}
+
+asio::awaitable<std::string_view> resilient_stream::read(std::string& buffer)
+{
+    for (;;) {
+        if (!connected_) {
+            co_await reconnect();
+        }
+
+        std::string_view message;
+        try {
+            message = co_await read_message(connection_->stream, buffer);
+        } catch (const std::exception&) {
+            // Socket error, watchdog timeout, or a bad message length.
+            disconnect();
+
+            // Lost before its first frame. Counts as an attempt with no
+            // frame.
+            if ((options_.max_attempts > 0) &&
+                (num_attempt_ >= options_.max_attempts)) {
+                throw;
+            }
+
+            continue;
+        }
+
+        const auto now = clock_type::now();
+        extend_deadline_for(
+            connection_->stream, connection_->deadline, options_.timeout);
+
+        last_frame_ = now;
+        has_frame_ = true;
+        num_attempt_ = 0;
+
+        // Outside of the try block. Exceptions from the handler go to the
+        // caller and do not look like a socket failure.
+        if (has_gap_) {
+            has_gap_ = false;
+            gap_.last = now;
+
+            if (on_gap_) {
+                on_gap_(gap_);
+            }
+        }
+
+        co_return message;
+    }
+}
+
+void resilient_stream::close()
+{
+    closed_ = true;
+
+    if (pending_) {
+        pending_->close();
+    }
+
+    disconnect();
+    timer_.cancel();
+}
+
+const node_map& resilient_stream::nodes() const
+{
+    static const node_map kEmpty;
+
+    return connection_ ? connection_->stream.nodes_ : kEmpty;
+}
+
+asio::awaitable<void>
+resilient_stream::watch(std::shared_ptr<connection> ptr)
+{
+    while (!ptr->closed && (ptr->deadline > clock_type::now())) {
+        ptr->timer.expires_at(ptr->deadline);
+
+        asio::error_code ec;
+        co_await ptr->timer.async_wait(
+            asio::redirect_error(asio::use_awaitable, ec));
+    }
+
+    ptr->close();
+}
+
+asio::awaitable<void> resilient_stream::connect()
+{
+    auto ptr = std::make_shared<connection>(executor_);
+    ptr->stream.metrics_ = options_.metrics;
+    extend_deadline_for(ptr->deadline, options_.timeout);
+
+    co_spawn(executor_, watch(ptr), asio::detached);
+
+    pending_ = ptr;
+
+    auto& socket = ptr->stream.socket_;
+    try {
+        co_await socket.async_connect(endpoint_, asio::use_awaitable);
+
+        // Same as open_connection. Many small packets, latency first.
+        socket.set_option(tcp::no_delay{true});
+
+        // Shadow data service responds with its version and name.
+        // <service version="x.y.z" name="configurable"/>
+        const auto message =
+            co_await read_message(socket, ptr->stream.reader_);
+        if (!is_metadata(message)) {
+            throw std::runtime_error("service handshake is not valid");
+        }
+
+        co_await write_message(socket, request_);
+
+        // The connection was closed after the last operation completed.
+        if (ptr->closed) {
+            throw asio::system_error{asio::error::operation_aborted};
+        }
+    } catch (...) {
+        pending_.reset();
+        ptr->close();
+        throw;
+    }
+
+    pending_.reset();
+
+    connection_ = std::move(ptr);
+    connected_ = true;
+}
+
+asio::awaitable<void> resilient_stream::reconnect()
+{
+    for (;;) {
+        if (closed_) {
+            throw asio::system_error{asio::error::operation_aborted};
+        }
+
+        if (num_attempt_ == 0) {
+            delay_ = options_.initial_delay;
+        } else {
+            std::uniform_real_distribution<double> dis(
+                0, std::clamp(options_.jitter, 0.0, 1.0));
+
+            timer_.expires_after(
+                std::chrono::duration_cast<clock_type::duration>(
+                    delay_ * (1 - dis(random_))));
+
+            asio::error_code ec;
+            co_await timer_.async_wait(
+                asio::redirect_error(asio::use_awaitable, ec));
+
+            delay_ = std::min<decltype(delay_)>(
+                delay_ * options_.multiplier, options_.max_delay);
+
+            if (closed_) {
+                throw asio::system_error{asio::error::operation_aborted};
+            }
+        }
+
+        ++num_attempt_;
+
+        if (has_gap_) {
+            ++gap_.num_attempt;
+        }
+
+        try {
+            co_await connect();
+        } catch (...) {
+            ++num_failed_;
+
+            if ((options_.max_attempts > 0) &&
+                (num_attempt_ >= options_.max_attempts)) {
+                throw;
+            }
+
+            continue;
+        }
+
+        ++num_connect_;
+
+        // Closed while the handshake finished.
+        if (closed_) {
+            disconnect();
+            throw asio::system_error{asio::error::operation_aborted};
+        }
+
+        co_return;
+    }
+}
+
+void resilient_stream::disconnect()
+{
+    if (!connected_) {
+        return;
+    }
+
+    connected_ = false;
+    connection_->close();
+
+    // Only report a gap if there was a frame before it.
+    if (has_frame_ && !has_gap_) {
+        has_gap_ = true;
+        gap_ = stream_gap{last_frame_, {}, 0};
+    }
+}
+
+} // namespace shadowmocap
@@ -0,0 +1,158 @@
+// Copyright Motion Workshop. All Rights Reserved.
+#include <shadowmocap/soa.hpp>
+
+#if defined(__SSE2__) || defined(_M_X64) || (_M_IX86_FP >= 2)
+#define SHADOWMOCAP_SOA_SSE2
+#include <immintrin.h>
+#endif
+
+#include <algorithm>
+#include <cstring>
+
+namespace shadowmocap {
+
+namespace {
+
+// Copy scalars [first_scalar, last_scalar) of items [first_item, last_item).
+void transpose_range(
+    const char* message, std::size_t first_item, std::size_t last_item,
+    int dim, int first_scalar, int last_scalar, float* out, std::size_t stride)
+{
+    const std::size_t item_size = (2 + dim) * sizeof(float);
+
+    for (int j = first_scalar; j < last_scalar; ++j) {
+        float* dst = out + j * stride;
+        const char* src = message + (2 + j) * sizeof(float);
+
+        for (std::size_t i = first_item; i < last_item; ++i) {
+            std::memcpy(dst + i, src + i * item_size, sizeof(float));
+        }
+    }
+}
+
+} // namespace
+
+namespace detail {
+
+void transpose_items_scalar(
+    const char* message, std::size_t num_item, int dim, float* out,
+    std::size_t stride)
+{
+    transpose_range(message, 0, num_item, dim, 0, dim, out, stride);
+}
+
+void transpose_items(
+    const char* message, std::size_t num_item, int dim, int mask, float* out,
+    std::size_t stride)
+{
+#if defined(SHADOWMOCAP_SOA_SSE2)
+    // 4x4 transpose of quaternion channels, four items at a time. With AVX2
+    // gather the other channels eight items at a time. Otherwise the other
+    // channels use the scalar path.
+    const std::size_t item_floats = 2 + dim;
+    const auto* base = reinterpret_cast<const float*>(message);
+
+#if defined(__AVX2__)
+    const auto index = _mm256_mullo_epi32(
+        _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7),
+        _mm256_set1_epi32(static_cast<int>(item_floats)));
+#endif
+
+    int offset = 0;
+    for (auto c : kChannelList) {
+        if (!(mask & c)) {
+            continue;
+        }
+
+        const int n = get_channel_dimension(c);
+        std::size_t num_simd = 0;
+
+        if (n == 4) {
+            num_simd = num_item - num_item % 4;
+
+            float* dst = out + offset * stride;
+            for (std::size_t i = 0; i < num_simd; i += 4) {
+                const float* src = base + i * item_floats + 2 + offset;
+
+                auto r0 = _mm_loadu_ps(src);
+                auto r1 = _mm_loadu_ps(src + item_floats);
+                auto r2 = _mm_loadu_ps(src + 2 * item_floats);
+                auto r3 = _mm_loadu_ps(src + 3 * item_floats);
+
+                _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+
+                _mm_store_ps(dst + i, r0);
+                _mm_store_ps(dst + stride + i, r1);
+                _mm_store_ps(dst + 2 * stride + i, r2);
+                _mm_store_ps(dst + 3 * stride + i, r3);
+            }
+        } else {
+#if defined(__AVX2__)
+            num_simd = num_item - num_item % 8;
+
+            for (int j = offset; j < offset + n; ++j) {
+                float* dst = out + j * stride;
+                for (std::size_t i = 0; i < num_simd; i += 8) {
+                    const auto v = _mm256_i32gather_ps(
+                        base + i * item_floats + 2 + j, index, 4);
+                    _mm256_store_ps(dst + i, v);
+                }
+            }
+#endif
+        }
+
+        transpose_range(
+            message, num_simd, num_item, dim, offset, offset + n, out, stride);
+
+        offset += n;
+    }
+#else
+    (void)mask;
+
+    transpose_items_scalar(message, num_item, dim, out, stride);
+#endif
+}
+
+} // namespace detail
+
+soa_frame::soa_frame(int mask) : layout_{mask}
+{
+}
+
+bool soa_frame::decode(std::string_view message)
+{
+    keys_.clear();
+
+    const auto view = make_message_view(message, layout_);
+    if (view.empty()) {
+        return false;
+    }
+
+    const auto num_item = view.size();
+    const auto dim = static_cast<std::size_t>(layout_.dimension());
+
+    stride_ = (num_item + kWidth - 1) / kWidth * kWidth;
+
+    keys_.resize(num_item);
+    data_.resize(dim * stride_);
+
+    for (std::size_t i = 0; i < num_item; ++i) {
+        std::memcpy(
+            &keys_[i], message.data() + i * layout_.item_size(), sizeof(int));
+    }
+
+    detail::transpose_items(
+        message.data(), num_item, layout_.dimension(), layout_.mask(),
+        data_.data(), stride_);
+
+    // Zero the padding so vector loops over the full stride are well defined.
+    for (std::size_t j = 0; j < dim; ++j) {
+        std::fill(
+            data_.begin() + j * stride_ + num_item,
+            data_.begin() + (j + 1) * stride_, 0.0f);
+    }
+
+    return true;
+}
+
+} // namespace shadowmocap
@@ -0,0 +1,157 @@
+// Copyright Motion Workshop. All Rights Reserved.
+#include <shadowmocap/stream_group.hpp>
+
+#include <asio/bind_cancellation_slot.hpp>
+#include <asio/co_spawn.hpp>
+#include <asio/error.hpp>
+#include <asio/experimental/awaitable_operators.hpp>
+#include <asio/post.hpp>
+#include <asio/system_error.hpp>
+#include <asio/use_awaitable.hpp>
+
+#include <algorithm>
+#include <string>
+#include <utility>
+
+namespace shadowmocap {
+
+stream_group::stream_group(std::size_t num_thread)
+{
+    num_thread = std::max<std::size_t>(num_thread, 1);
+
+    contexts_.reserve(num_thread);
+    for (std::size_t i = 0; i < num_thread; ++i) {
+        // Each context is only run by one thread.
+        contexts_.push_back(std::make_unique<asio::io_context>(1));
+    }
+}
+
+stream_group::~stream_group()
+{
+    stop();
+    join();
+}
+
+std::size_t stream_group::add(
+    tcp::endpoint endpoint, int mask,
+    std::chrono::steady_clock::duration timeout, stream_metrics* metrics)
+{
+    streams_.push_back(
+        stream_options{std::move(endpoint), mask, timeout, metrics});
+
+    return streams_.size() - 1;
+}
+
+void stream_group::start(frame_handler on_frame, error_handler on_error)
+{
+    on_frame_ = std::move(on_frame);
+    on_error_ = std::move(on_error);
+
+    signals_.clear();
+    for (std::size_t i = 0; i < streams_.size(); ++i) {
+        signals_.push_back(std::make_unique<asio::cancellation_signal>());
+    }
+
+    for (std::size_t i = 0; i < streams_.size(); ++i) {
+        auto& ctx = *contexts_[i % contexts_.size()];
+
+        co_spawn(
+            ctx, run_stream(i),
+            asio::bind_cancellation_slot(
+                signals_[i]->slot(), [this, i](std::exception_ptr ptr) {
+                    // A stream that ends because of stop() is not an error.
+                    if (ptr && on_error_ && !stopped_) {
+                        on_error_(i, ptr);
+                    }
+                }));
+    }
+
+    threads_.reserve(contexts_.size());
+    for (auto& ctx : contexts_) {
+        // Each thread exits when all of its streams end or on stop().
+        threads_.emplace_back([&ctx]() { ctx->run(); });
+    }
+}
+
+void stream_group::stop()
+{
+    stopped_ = true;
+
+    // Cancel each stream on the thread that runs it. The stream closes its
+    // socket as it unwinds and each thread exits once its streams are done.
+    for (std::size_t i = 0; i < signals_.size(); ++i) {
+        auto& ctx = *contexts_[i % contexts_.size()];
+
+        asio::post(ctx, [signal = signals_[i].get()]() {
+            signal->emit(asio::cancellation_type::terminal);
+        });
+    }
+}
+
+void stream_group::join()
+{
+    for (auto& thread : threads_) {
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+
+    threads_.clear();
+}
+
+asio::awaitable<void> stream_group::run_stream(std::size_t index)
+{
+    using namespace asio::experimental::awaitable_operators;
+
+    const auto& options = streams_[index];
+
+    // Stopped before the stream started waiting on anything to cancel.
+    if (stopped_) {
+        co_return;
+    }
+
+    auto stream = co_await open_connection(options.endpoint);
+    stream.metrics_ = options.metrics;
+
+    {
+        // Create an XML string that lists the channels we want in order.
+        const auto message = make_channel_message(options.mask);
+
+        co_await write_message(stream, message);
+    }
+
+    std::chrono::steady_clock::time_point deadline{};
+    extend_deadline_for(deadline, options.timeout);
+
+    auto result =
+        co_await (read_frames(index, stream, deadline) || watchdog(deadline));
+
+    // The read loop only completes with an error so the watchdog won.
+    if (result.index() == 1) {
+        throw asio::system_error{asio::error::timed_out};
+    }
+}
+
+asio::awaitable<void> stream_group::read_frames(
+    std::size_t index, datastream& stream,
+    std::chrono::steady_clock::time_point& deadline)
+{
+    const auto timeout = streams_[index].timeout;
+
+    std::string buffer;
+    for (;;) {
+        auto message = co_await read_message(stream, buffer);
+
+        extend_deadline_for(stream, deadline, timeout);
+
+        on_frame_(index, message, stream.nodes_);
+
+        // Also end the loop here in case the cancellation arrived while
+        // nothing was waiting for it.
+        if (stopped_) {
+            co_return;
+        }
+    }
+}
+
+} // namespace shadowmocap
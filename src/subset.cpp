@@ -0,0 +1,128 @@
+// Copyright Motion Workshop. All Rights Reserved.
+#include <shadowmocap/subset.hpp>
+
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace shadowmocap {
+
+namespace {
+
+// Key and length fields at the start of every item.
+constexpr std::size_t kHeaderSize = 2 * sizeof(int);
+
+} // namespace
+
+channel_subset::channel_subset(int from, int to)
+    : from_{from}, to_{to}, dimension_{get_channel_mask_dimension(to)}
+{
+    if ((to & ~from) != 0) {
+        throw std::invalid_argument("channel subset mask is not in the input");
+    }
+
+    input_item_size_ =
+        kHeaderSize + get_channel_mask_dimension(from) * sizeof(float);
+    output_item_size_ = kHeaderSize + dimension_ * sizeof(float);
+
+    std::size_t src = kHeaderSize;
+    std::size_t dst = kHeaderSize;
+    for (auto c : kChannelList) {
+        if (!(from & c)) {
+            continue;
+        }
+
+        const auto size = get_channel_dimension(c) * sizeof(float);
+
+        if (to & c) {
+            // Extend the previous run if it ends right here in both items.
+            if ((num_run_ > 0) &&
+                (runs_[num_run_ - 1].src + runs_[num_run_ - 1].size == src) &&
+                (runs_[num_run_ - 1].dst + runs_[num_run_ - 1].size == dst)) {
+                runs_[num_run_ - 1].size += static_cast<std::uint16_t>(size);
+            } else {
+                runs_[num_run_++] = {
+                    static_cast<std::uint16_t>(src),
+                    static_cast<std::uint16_t>(dst),
+                    static_cast<std::uint16_t>(size)};
+            }
+
+            dst += size;
+        }
+
+        src += size;
+    }
+}
+
+std::size_t
+channel_subset::apply(std::string_view message, std::span<char> out) const
+{
+    if (message.empty() || (message.size() % input_item_size_ != 0)) {
+        return 0;
+    }
+
+    const auto size = output_size(message.size());
+    if (out.size() < size) {
+        return 0;
+    }
+
+    const int input_dimension =
+        static_cast<int>((input_item_size_ - kHeaderSize) / sizeof(float));
+
+    const auto* src = message.data();
+    const auto* end = src + message.size();
+    auto* dst = out.data();
+
+    for (; src != end; src += input_item_size_, dst += output_item_size_) {
+        int header[2];
+        std::memcpy(header, src, kHeaderSize);
+        if (header[1] != input_dimension) {
+            return 0;
+        }
+
+        header[1] = dimension_;
+        std::memcpy(dst, header, kHeaderSize);
+
+        for (std::size_t i = 0; i < num_run_; ++i) {
+            const auto& r = runs_[i];
+            std::memcpy(dst + r.dst, src + r.src, r.size);
+        }
+    }
+
+    return size;
+}
+
+bool channel_subset::apply(std::string_view message, std::string& out) const
+{
+    if (message.size() % input_item_size_ != 0) {
+        return false;
+    }
+
+    out.resize(output_size(message.size()));
+
+    return apply(message, std::span<char>{out}) > 0;
+}
+
+const channel_subset& get_channel_subset(int from, int to)
+{
+    static std::mutex mutex;
+    static std::unordered_map<std::uint64_t, std::unique_ptr<channel_subset>>
+        cache;
+
+    const auto key = (static_cast<std::uint64_t>(from) << 32) |
+                     static_cast<std::uint32_t>(to);
+
+    std::lock_guard lock{mutex};
+
+    auto& ptr = cache[key];
+    if (!ptr) {
+        auto subset = std::make_unique<channel_subset>(from, to);
+        ptr = std::move(subset);
+    }
+
+    return *ptr;
+}
+
+} // namespace shadowmocap
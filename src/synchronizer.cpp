@@ -0,0 +1,332 @@
+// Copyright Motion Workshop. All Rights Reserved.
+#include <shadowmocap/synchronizer.hpp>
+
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+namespace shadowmocap {
+
+namespace {
+
+using clock_type = synchronizer::clock_type;
+using duration = clock_type::duration;
+
+// Follow clock drift between a source and us over this many frames.
+constexpr int kDriftDecay = 1024;
+
+constexpr int kMaxDimension = get_channel_mask_dimension(kAllChannelMask);
+
+constexpr channel kQuaternionList[] = {
+    channel::Gq, channel::Gdq, channel::Lq, channel::Bq};
+
+duration to_duration(double seconds)
+{
+    return std::chrono::duration_cast<duration>(
+        std::chrono::duration<double>{seconds});
+}
+
+// Earliest arrival of source time zero so far, drifting up slowly in case
+// the source clock runs slower than ours.
+void update_offset(
+    clock_type::time_point& offset, bool& has_offset,
+    clock_type::time_point transit)
+{
+    if (!has_offset || (transit < offset)) {
+        offset = transit;
+        has_offset = true;
+    } else {
+        offset += (transit - offset) / kDriftDecay;
+    }
+}
+
+// Spherical linear interpolation of unit quaternions along the shortest path.
+void slerp(const float* a, const float* b, float t, float* out)
+{
+    float d = a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + a[3] * b[3];
+
+    const float sign = (d < 0) ? -1.0f : 1.0f;
+    d *= sign;
+
+    // Nearly the same rotation. Blend linearly and normalize, sin(theta) is
+    // too small to divide by.
+    if (d > 0.9995f) {
+        float norm = 0;
+        for (int j = 0; j < 4; ++j) {
+            out[j] = (1 - t) * a[j] + t * sign * b[j];
+            norm += out[j] * out[j];
+        }
+
+        const float s = 1 / std::sqrt(norm);
+        for (int j = 0; j < 4; ++j) {
+            out[j] *= s;
+        }
+
+        return;
+    }
+
+    const float theta = std::acos(d);
+    const float s = 1 / std::sin(theta);
+    const float wa = std::sin((1 - t) * theta) * s;
+    const float wb = std::sin(t * theta) * s * sign;
+
+    for (int j = 0; j < 4; ++j) {
+        out[j] = wa * a[j] + wb * b[j];
+    }
+}
+
+} // namespace
+
+struct synchronizer::stream {
+    stream(int mask, const sync_options& options)
+        : layout{mask},
+          ring{options.capacity, overflow_policy::drop_oldest,
+               options.message_capacity},
+          history(options.capacity + 2)
+    {
+        for (auto c : kQuaternionList) {
+            if (layout.contains(c)) {
+                quaternions.push_back(layout.offset(c));
+            }
+        }
+
+        for (auto& item : history) {
+            item.message.reserve(options.message_capacity);
+        }
+    }
+
+    struct entry {
+        std::string message;
+        duration source{};
+    };
+
+    std::size_t size() const
+    {
+        return static_cast<std::size_t>(head - tail);
+    }
+
+    entry& at(std::uint64_t i)
+    {
+        return history[i % history.size()];
+    }
+
+    message_layout layout;
+
+    // Offset of every quaternion channel in an item, in floats.
+    std::vector<int> quaternions;
+
+    frame_ring ring;
+
+    // Consumer thread state. Frames in time order, the oldest one is the
+    // newest frame at or before the last sample time.
+    std::vector<entry> history;
+    std::uint64_t head{};
+    std::uint64_t tail{};
+
+    clock_type::time_point offset{};
+    bool has_offset{};
+};
+
+synchronizer::synchronizer(sync_options options) : options_{options}
+{
+    if ((options.time_channel != channel::timestamp) &&
+        (options.time_channel != channel::systime)) {
+        throw std::invalid_argument("synchronizer time channel is not valid");
+    }
+
+    if (options.capacity == 0) {
+        throw std::invalid_argument("synchronizer capacity is not valid");
+    }
+}
+
+synchronizer::~synchronizer() = default;
+
+std::size_t synchronizer::add(int mask)
+{
+    streams_.push_back(std::make_unique<stream>(mask, options_));
+    frame_.streams.resize(streams_.size());
+
+    auto& sample = frame_.streams.back();
+    sample.message.reserve(options_.message_capacity);
+
+    return streams_.size() - 1;
+}
+
+void synchronizer::push(
+    std::size_t index, std::string_view message, clock_type::time_point now)
+{
+    auto& ring = streams_[index]->ring;
+
+    auto& slot = ring.producer_slot();
+    slot.message.assign(message);
+    slot.time = now;
+
+    ring.try_push();
+}
+
+frame_ring& synchronizer::ring(std::size_t index)
+{
+    return streams_[index]->ring;
+}
+
+const sync_frame& synchronizer::sample(clock_type::time_point now)
+{
+    // Take every frame first so the shared clock offset is up to date for
+    // all streams.
+    for (auto& ptr : streams_) {
+        auto& s = *ptr;
+        s.ring.drain(
+            [this, &s](const frame_slot& slot) { add_frame(s, slot); });
+    }
+
+    frame_.time = now - options_.latency;
+
+    for (std::size_t i = 0; i < streams_.size(); ++i) {
+        sample_stream(*streams_[i], frame_.streams[i]);
+    }
+
+    return frame_;
+}
+
+void synchronizer::add_frame(stream& s, const frame_slot& slot)
+{
+    const auto view = make_message_view(slot.message, s.layout);
+    if (view.empty()) {
+        return;
+    }
+
+    const bool has_time = s.layout.contains(options_.time_channel);
+
+    const auto source = has_time
+                            ? to_duration(view[0].value(options_.time_channel))
+                            : slot.time.time_since_epoch();
+
+    if (s.size() > 0) {
+        const auto last = s.at(s.head - 1).source;
+        if (source == last) {
+            return;
+        }
+
+        // Time went back, i.e. the source restarted. Start over.
+        if (source < last) {
+            s.tail = s.head;
+            s.has_offset = false;
+        }
+    }
+
+    const auto transit = slot.time - source;
+
+    update_offset(s.offset, s.has_offset, transit);
+    if (has_time && (options_.time_channel == channel::systime)) {
+        update_offset(offset_, has_offset_, transit);
+    }
+
+    if (s.size() == s.history.size()) {
+        ++s.tail;
+    }
+
+    auto& item = s.at(s.head);
+    item.message.assign(slot.message);
+    item.source = source;
+
+    ++s.head;
+}
+
+void synchronizer::sample_stream(stream& s, sync_sample& out)
+{
+    if (s.size() == 0) {
+        out.message.clear();
+        out.state = sync_state::empty;
+        out.lag = {};
+        return;
+    }
+
+    const auto source = frame_.time - get_offset(s);
+
+    // Keep the newest frame at or before the sample time. Sample times only
+    // go forward so the older ones are done.
+    while ((s.size() > 1) && (s.at(s.tail + 1).source <= source)) {
+        ++s.tail;
+    }
+
+    const auto& a = s.at(s.tail);
+
+    if ((s.size() > 1) && (source >= a.source)) {
+        const auto& b = s.at(s.tail + 1);
+        const auto t = std::chrono::duration<float>(source - a.source) /
+                       std::chrono::duration<float>(b.source - a.source);
+
+        if (interpolate(s, a.message, b.message, t, out.message)) {
+            out.state = sync_state::interpolated;
+            out.lag = {};
+            return;
+        }
+    }
+
+    out.message.assign(a.message);
+    out.lag = source - a.source;
+
+    if (out.lag > options_.max_hold) {
+        out.state = sync_state::stale;
+    } else {
+        out.state = sync_state::held;
+    }
+}
+
+bool synchronizer::interpolate(
+    const stream& s, std::string_view a, std::string_view b, float t,
+    std::string& out)
+{
+    // Node list changed between the two frames.
+    if (a.size() != b.size()) {
+        return false;
+    }
+
+    const auto item_size = s.layout.item_size();
+    const auto dim = static_cast<std::size_t>(s.layout.dimension());
+
+    out.resize(a.size());
+
+    std::array<float, kMaxDimension> va;
+    std::array<float, kMaxDimension> vb;
+    std::array<float, kMaxDimension> result;
+
+    for (std::size_t i = 0; i < a.size(); i += item_size) {
+        if (std::memcmp(a.data() + i, b.data() + i, sizeof(int)) != 0) {
+            return false;
+        }
+
+        constexpr auto kHeaderSize = 2 * sizeof(int);
+
+        std::memcpy(va.data(), a.data() + i + kHeaderSize, dim * sizeof(float));
+        std::memcpy(vb.data(), b.data() + i + kHeaderSize, dim * sizeof(float));
+
+        for (std::size_t j = 0; j < dim; ++j) {
+            result[j] = va[j] + t * (vb[j] - va[j]);
+        }
+
+        for (int offset : s.quaternions) {
+            slerp(va.data() + offset, vb.data() + offset, t,
+                  result.data() + offset);
+        }
+
+        std::memcpy(out.data() + i, a.data() + i, kHeaderSize);
+        std::memcpy(
+            out.data() + i + kHeaderSize, result.data(), dim * sizeof(float));
+    }
+
+    return true;
+}
+
+clock_type::time_point synchronizer::get_offset(const stream& s) const
+{
+    if ((options_.time_channel == channel::systime) &&
+        s.layout.contains(channel::systime)) {
+        return offset_;
+    }
+
+    return s.offset;
+}
+
+} // namespace shadowmocap
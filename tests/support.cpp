@@ -0,0 +1,62 @@
+#include "support.hpp"
+
+#include <shadowmocap/channel.hpp>
+
+#include <algorithm>
+#include <random>
+
+void append_item(std::string& message, int key, std::span<const float> values)
+{
+    const int header[2] = {key, static_cast<int>(values.size())};
+    message.append(reinterpret_cast<const char*>(header), sizeof(header));
+    message.append(
+        reinterpret_cast<const char*>(values.data()), values.size_bytes());
+}
+
+std::string make_message(int mask, int num_item)
+{
+    const int dim = shadowmocap::get_channel_mask_dimension(mask);
+
+    std::string message;
+    std::vector<float> values(dim);
+    for (int i = 0; i < num_item; ++i) {
+        for (int axis = 0; axis < dim; ++axis) {
+            values[axis] = static_cast<float>(i * 1000 + axis);
+        }
+
+        append_item(message, i + 1, values);
+    }
+
+    return message;
+}
+
+std::string make_message_bytes(std::size_t num_item, int dim)
+{
+    std::mt19937 gen(static_cast<unsigned>(num_item));
+    std::uniform_real_distribution<float> dis(-100, 100);
+
+    std::string message;
+    message.reserve(num_item * (2 + dim) * sizeof(float));
+
+    std::vector<float> values(dim);
+    for (std::size_t i = 0; i < num_item; ++i) {
+        std::generate(values.begin(), values.end(), [&]() { return dis(gen); });
+
+        append_item(message, static_cast<int>(i) + 1, values);
+    }
+
+    return message;
+}
+
+std::vector<int> make_random_masks(std::size_t n)
+{
+    std::random_device rd;
+    std::mt19937 gen(rd());
+
+    std::uniform_int_distribution<int> dis(1, shadowmocap::kAllChannelMask);
+
+    std::vector<int> buf(n);
+    std::generate(std::begin(buf), std::end(buf), [&]() { return dis(gen); });
+
+    return buf;
+}
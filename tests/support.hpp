@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstddef>
+#include <span>
+#include <string>
+#include <vector>
+
+// Fixtures shared by the tests and the benchmarks.
+
+// Append one item to a binary message, its key and length header followed
+// by its values.
+void append_item(std::string& message, int key, std::span<const float> values);
+
+// Items with keys 1, 2, ... and every value its item number times 1000 plus
+// its axis in the mask.
+std::string make_message(int mask, int num_item);
+
+// Random float values in [-100, 100] with a valid key and length header in
+// every item. Finite values so the math and formatting benchmarks can use it.
+std::string make_message_bytes(std::size_t num_item, int dim);
+
+// Random channel masks with at least one channel.
+std::vector<int> make_random_masks(std::size_t n);
@@ -7,11 +7,14 @@
 #include <asio/ip/tcp.hpp>
 #include <catch2/catch_test_macros.hpp>
 
+#include <algorithm>
 #include <chrono>
+#include <cstring>
 #include <exception>
 #include <iostream>
 #include <string>
 #include <string_view>
+#include <vector>
 
 using tcp = shadowmocap::tcp;
 
@@ -44,7 +47,7 @@ asio::awaitable<void> read_shadowmocap_datastream_frames(
 
         num_bytes += message.size();
 
-        const auto num_item = stream.names_.size();
+        const auto num_item = stream.nodes_.size();
 
         REQUIRE(num_item > 0);
 
@@ -64,6 +67,7 @@ asio::awaitable<void> read_shadowmocap_datastream_frames(
 
         for (const auto& item : items) {
             REQUIRE(item.length == kItemSize);
+            REQUIRE(stream.nodes_.find(item.key) >= 0);
 
             std::cout << "{\"key\": " << item.key
                       << ", \"length\": " << item.length << ", \"data\": [";
@@ -131,3 +135,50 @@ TEST_CASE("read", "[datastream]")
 {
     REQUIRE(run());
 }
+
+TEST_CASE("message_reader", "[datastream]")
+{
+    using namespace shadowmocap;
+
+    // Three length prefixed messages in one contiguous stream of bytes.
+    const std::string input = std::string("\0\0\0\3abc", 7) +
+                              std::string("\0\0\0\1d", 5) +
+                              std::string("\0\0\0\2ef", 6);
+
+    // Deliver the bytes in chunks of every size to test split and coalesced
+    // messages.
+    for (std::size_t chunk = 1; chunk <= input.size(); ++chunk) {
+        message_reader reader;
+        std::vector<std::string> output;
+
+        for (std::size_t i = 0; i < input.size(); i += chunk) {
+            const auto n = std::min(chunk, input.size() - i);
+
+            auto buf = reader.prepare();
+            REQUIRE(buf.size() >= n);
+
+            std::memcpy(buf.data(), input.data() + i, n);
+            reader.commit(n);
+
+            for (auto message = reader.next(); !message.empty();
+                 message = reader.next()) {
+                output.emplace_back(message);
+            }
+        }
+
+        REQUIRE(output == std::vector<std::string>{"abc", "d", "ef"});
+        REQUIRE(reader.size() == 0);
+    }
+
+    {
+        message_reader reader;
+
+        const std::string input("\0\0\0\0", 4);
+
+        auto buf = reader.prepare();
+        std::memcpy(buf.data(), input.data(), input.size());
+        reader.commit(input.size());
+
+        REQUIRE_THROWS_AS(reader.next(), std::length_error);
+    }
+}
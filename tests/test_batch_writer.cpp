@@ -0,0 +1,190 @@
+#include <shadowmocap/batch_writer.hpp>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <asio/co_spawn.hpp>
+#include <asio/io_context.hpp>
+#include <asio/use_awaitable.hpp>
+
+#include <chrono>
+#include <exception>
+#include <string>
+#include <vector>
+
+namespace {
+
+asio::awaitable<std::vector<std::string>>
+read_all(shadowmocap::tcp::socket& socket, std::size_t n)
+{
+    std::vector<std::string> result;
+    for (std::size_t i = 0; i < n; ++i) {
+        result.push_back(co_await shadowmocap::read_message(socket));
+    }
+
+    co_return result;
+}
+
+} // namespace
+
+TEST_CASE("batch_writer", "[batch_writer]")
+{
+    using namespace shadowmocap;
+    using namespace std::chrono_literals;
+
+    asio::io_context ioc;
+
+    tcp::acceptor acceptor{
+        ioc, tcp::endpoint{asio::ip::make_address("127.0.0.1"), 0}};
+
+    tcp::socket client{ioc};
+    client.connect(acceptor.local_endpoint());
+    auto server = acceptor.accept();
+
+    REQUIRE_THROWS_AS(make_shared_message({}), std::length_error);
+
+    const auto shared = make_shared_message("shared");
+    REQUIRE(shared->size() == 4 + 6);
+
+    SECTION("flush interval")
+    {
+        batch_options options;
+        options.flush_size = 1 << 20;
+        options.flush_interval = 10ms;
+
+        batch_writer writer(server, options);
+        REQUIRE_THROWS_AS(writer.write(std::string_view{}), std::length_error);
+
+        // Copies in a row are one buffer. The shared message is in between.
+        writer.write("a");
+        writer.write("bc");
+        writer.write(shared);
+        writer.write("def");
+        REQUIRE(writer.size() == 4 * 4 + 1 + 2 + 6 + 3);
+
+        // Close once every message is back so run() returns.
+        std::vector<std::string> messages;
+        auto read = [&]() -> asio::awaitable<void> {
+            messages = co_await read_all(client, 4);
+            writer.close();
+        };
+
+        bool ok = true;
+        auto check = [&ok](std::exception_ptr ptr) { ok = ok && !ptr; };
+
+        const auto start = std::chrono::steady_clock::now();
+        co_spawn(ioc, read(), check);
+        co_spawn(ioc, writer.run(), check);
+
+        ioc.run();
+
+        REQUIRE(ok);
+        REQUIRE(std::chrono::steady_clock::now() - start >= 10ms);
+        REQUIRE(
+            messages == std::vector<std::string>{"a", "bc", "shared", "def"});
+
+        REQUIRE(writer.num_write() == 1);
+        REQUIRE(writer.size() == 0);
+        REQUIRE(shared.use_count() == 1);
+    }
+
+    SECTION("fan out")
+    {
+        tcp::socket other_client{ioc};
+        other_client.connect(acceptor.local_endpoint());
+        auto other_server = acceptor.accept();
+
+        batch_writer first(server);
+        batch_writer second(other_server);
+
+        constexpr int kNumMessage = 100;
+
+        std::vector<std::string> first_messages;
+        std::vector<std::string> second_messages;
+        auto read = [&]() -> asio::awaitable<void> {
+            first_messages = co_await read_all(client, kNumMessage);
+            second_messages = co_await read_all(other_client, kNumMessage);
+        };
+
+        // One copy of each message for both sockets.
+        auto write = [&]() -> asio::awaitable<void> {
+            for (int i = 0; i < kNumMessage; ++i) {
+                const auto message = make_shared_message(std::to_string(i));
+                first.write(message);
+                second.write(message);
+
+                // Let the writes start every few messages so batches form
+                // while a write is in flight.
+                if (i % 10 == 9) {
+                    co_await first.flush();
+                }
+            }
+
+            first.close();
+            second.close();
+        };
+
+        bool ok = true;
+        auto check = [&ok](std::exception_ptr ptr) { ok = ok && !ptr; };
+
+        co_spawn(ioc, first.run(), check);
+        co_spawn(ioc, second.run(), check);
+        co_spawn(ioc, read(), check);
+        co_spawn(ioc, write(), check);
+
+        ioc.run();
+
+        REQUIRE(ok);
+        REQUIRE(first_messages.size() == kNumMessage);
+        REQUIRE(first_messages == second_messages);
+        REQUIRE(first_messages.back() == "99");
+
+        REQUIRE(first.num_write() <= 20);
+        REQUIRE(second.num_write() < kNumMessage);
+    }
+
+    SECTION("concurrent flush")
+    {
+        batch_writer writer(server);
+
+        // More than the socket buffers hold so the first write stays in
+        // flight until the client reads.
+        constexpr int kNumMessage = 256;
+        const std::string message(60000, 'x');
+        for (int i = 0; i < kNumMessage; ++i) {
+            writer.write(message);
+        }
+
+        int num_flush = 0;
+        bool ok = true;
+        auto check = [&](std::exception_ptr ptr) {
+            ok = ok && !ptr;
+            ++num_flush;
+        };
+
+        co_spawn(ioc, writer.flush(), check);
+        co_spawn(ioc, writer.flush(), check);
+        co_spawn(ioc, writer.flush(), check);
+
+        // The other two wait for the write without waking each other.
+        const auto num_handler = ioc.run_for(20ms);
+        REQUIRE(num_handler < 100);
+        REQUIRE(num_flush == 0);
+
+        std::vector<std::string> messages;
+        auto read = [&]() -> asio::awaitable<void> {
+            messages = co_await read_all(client, kNumMessage);
+        };
+
+        co_spawn(ioc, read(), [&ok](std::exception_ptr ptr) {
+            ok = ok && !ptr;
+        });
+
+        ioc.run();
+
+        REQUIRE(ok);
+        REQUIRE(num_flush == 3);
+        REQUIRE(messages.size() == kNumMessage);
+        REQUIRE(messages.back() == message);
+        REQUIRE(writer.num_write() == 1);
+    }
+}
@@ -0,0 +1,516 @@
+#include <shadowmocap/capture.hpp>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <asio/co_spawn.hpp>
+#include <asio/detached.hpp>
+#include <asio/io_context.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <string_view>
+
+namespace {
+
+template <typename T>
+T read_at(std::string_view bytes, std::uint64_t offset)
+{
+    T value{};
+    std::memcpy(&value, bytes.data() + offset, sizeof(T));
+    return value;
+}
+
+template <typename T>
+void write_at(std::string& bytes, std::uint64_t offset, const T& value)
+{
+    std::memcpy(bytes.data() + offset, &value, sizeof(T));
+}
+
+} // namespace
+
+TEST_CASE("capture_encoder", "[capture]")
+{
+    using namespace shadowmocap;
+    using namespace std::chrono_literals;
+
+    const auto start = capture_encoder::clock_type::now();
+
+    // Small chunks so we get more than one.
+    capture_encoder encoder(256, start);
+
+    const auto xml = make_channel_message(channel::Lq | channel::c);
+    const std::string metadata =
+        "<?xml version=\"1.0\"?><node id=\"default\" key=\"0\"/>";
+
+    encoder.channel_request(xml, start);
+    encoder.metadata(metadata, start + 1ms);
+
+    constexpr int kNumFrame = 20;
+    for (int i = 0; i < kNumFrame; ++i) {
+        const std::string message(40, static_cast<char>('a' + i));
+        encoder.frame(message, start + 2ms + i * 1ms);
+    }
+
+    REQUIRE(encoder.num_frame() == kNumFrame);
+
+    encoder.finish();
+    REQUIRE_THROWS_AS(encoder.frame("x", start), std::logic_error);
+
+    std::string bytes;
+    for (const auto& block : encoder.take()) {
+        bytes += block;
+    }
+
+    REQUIRE(!encoder.ready());
+    REQUIRE(bytes.size() > sizeof(capture_header) + sizeof(capture_footer));
+
+    const auto header = read_at<capture_header>(bytes, 0);
+    REQUIRE(std::memcmp(header.magic, kCaptureMagic, 8) == 0);
+    REQUIRE(header.version == kCaptureVersion);
+
+    const auto footer = read_at<capture_footer>(
+        bytes, bytes.size() - sizeof(capture_footer));
+    REQUIRE(std::memcmp(footer.magic, kCaptureMagic, 8) == 0);
+    REQUIRE(footer.num_frame == kNumFrame);
+    REQUIRE(footer.num_chunk > 1);
+    REQUIRE(footer.num_metadata == 1);
+    REQUIRE(footer.channel_request_offset == sizeof(capture_header));
+
+    {
+        const auto record = read_at<capture_record_header>(
+            bytes, footer.channel_request_offset);
+        REQUIRE(record.type == capture_record_type::channel_request);
+        REQUIRE(record.time == 0);
+        REQUIRE(
+            bytes.substr(
+                footer.channel_request_offset + sizeof(record),
+                record.length) == xml);
+    }
+
+    {
+        const auto entry =
+            read_at<capture_metadata>(bytes, footer.metadata_offset);
+        REQUIRE(entry.frame == 0);
+
+        const auto record =
+            read_at<capture_record_header>(bytes, entry.offset);
+        REQUIRE(record.type == capture_record_type::metadata);
+        REQUIRE(record.time == 1000000);
+        REQUIRE(
+            bytes.substr(entry.offset + sizeof(record), record.length) ==
+            metadata);
+    }
+
+    // Walk every chunk and check that its frames are in order and match the
+    // index.
+    std::uint64_t next_frame = 0;
+    std::uint64_t next_offset = sizeof(capture_header);
+    for (std::uint64_t i = 0; i < footer.num_chunk; ++i) {
+        const auto chunk = read_at<capture_chunk>(
+            bytes, footer.chunk_offset + i * sizeof(capture_chunk));
+
+        REQUIRE(chunk.offset == next_offset);
+        REQUIRE(chunk.first_frame == next_frame);
+        next_offset += chunk.size;
+
+        bool first = true;
+        for (auto offset = chunk.offset; offset < chunk.offset + chunk.size;) {
+            const auto record = read_at<capture_record_header>(bytes, offset);
+            offset += sizeof(record) + record.length;
+
+            if (record.type != capture_record_type::frame) {
+                continue;
+            }
+
+            if (first) {
+                REQUIRE(chunk.first_time == record.time);
+                first = false;
+            }
+
+            REQUIRE(record.length == 40);
+            REQUIRE(
+                bytes[offset - 1] == static_cast<char>('a' + next_frame));
+            REQUIRE(
+                record.time ==
+                static_cast<std::int64_t>(2000000 + next_frame * 1000000));
+            ++next_frame;
+        }
+
+        REQUIRE(next_frame == chunk.first_frame + chunk.num_frame);
+    }
+
+    REQUIRE(next_frame == kNumFrame);
+    REQUIRE(next_offset == footer.chunk_offset);
+}
+
+TEST_CASE("capture_reader", "[capture]")
+{
+    using namespace shadowmocap;
+    using namespace std::chrono_literals;
+
+    static_assert(std::forward_iterator<capture_reader::iterator>);
+
+    const auto path =
+        (std::filesystem::temp_directory_path() / "shadowmocap_test.cap")
+            .string();
+
+    const std::string first_metadata = "<node id=\"A\" key=\"1\"/>";
+    const std::string second_metadata = "<node id=\"B\" key=\"1\"/>";
+
+    // 1000 frames at 1 ms intervals with a node list change at frame 600.
+    constexpr int kNumFrame = 1000;
+    {
+        const auto start = capture_encoder::clock_type::now();
+
+        capture_encoder encoder(4096, start);
+        encoder.channel_request("<configurable/>", start);
+        encoder.metadata(first_metadata, start);
+        for (int i = 0; i < kNumFrame; ++i) {
+            if (i == 600) {
+                encoder.metadata(second_metadata, start + i * 1ms);
+            }
+
+            const auto message = std::to_string(i);
+            encoder.frame(message, start + i * 1ms);
+        }
+
+        encoder.finish();
+
+        std::ofstream out(path, std::ios::binary);
+        for (const auto& block : encoder.take()) {
+            out.write(block.data(), block.size());
+        }
+    }
+
+    {
+        capture_reader reader(path);
+        REQUIRE(reader.num_frame() == kNumFrame);
+        REQUIRE(reader.channel_request() == "<configurable/>");
+        REQUIRE(reader.metadata(0) == first_metadata);
+        REQUIRE(reader.metadata(599) == first_metadata);
+        REQUIRE(reader.metadata(600) == second_metadata);
+
+        // Sequential read with one metadata change.
+        int index = 0;
+        int num_change = 0;
+        for (const auto frame : reader) {
+            REQUIRE(frame.index == static_cast<std::uint64_t>(index));
+            REQUIRE(frame.message == std::to_string(index));
+            REQUIRE(
+                frame.metadata ==
+                (index < 600 ? first_metadata : second_metadata));
+            if (frame.metadata_changed) {
+                REQUIRE(((index == 0) || (index == 600)));
+                ++num_change;
+            }
+
+            ++index;
+        }
+
+        REQUIRE(index == kNumFrame);
+        REQUIRE(num_change == 2);
+
+        for (int i : {0, 1, 599, 600, 601, 999}) {
+            auto it = reader.seek(i);
+            REQUIRE(it != reader.end());
+            REQUIRE((*it).index == static_cast<std::uint64_t>(i));
+            REQUIRE((*it).message == std::to_string(i));
+            REQUIRE((*it).metadata_changed);
+            REQUIRE((*it).metadata == reader.metadata(i));
+
+            // Same frame by time.
+            const std::int64_t time = i * 1000000;
+            REQUIRE((*reader.seek_time(time)).index == (*it).index);
+            REQUIRE((*reader.seek_time(time - 1)).index == (*it).index);
+        }
+
+        REQUIRE(reader.seek(kNumFrame) == reader.end());
+        REQUIRE(reader.seek_time(kNumFrame * 1000000) == reader.end());
+
+        // Split between workers.
+        std::uint64_t count = 0;
+        for (std::uint64_t first = 0; first < kNumFrame; first += 300) {
+            for (const auto frame : reader.range(first, first + 300)) {
+                REQUIRE(frame.index == count);
+                ++count;
+            }
+        }
+
+        REQUIRE(count == kNumFrame);
+        REQUIRE(reader.range(10, 10).empty());
+    }
+
+    {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out << "not a capture file, just some text that is long enough";
+    }
+
+    REQUIRE_THROWS_AS(capture_reader(path), std::runtime_error);
+
+    std::remove(path.c_str());
+
+    REQUIRE_THROWS_AS(capture_reader(path), std::system_error);
+}
+
+TEST_CASE("capture_reader_corrupt", "[capture]")
+{
+    using namespace shadowmocap;
+    using namespace std::chrono_literals;
+
+    const auto path =
+        (std::filesystem::temp_directory_path() / "shadowmocap_corrupt.cap")
+            .string();
+
+    std::string bytes;
+    {
+        const auto start = capture_encoder::clock_type::now();
+
+        capture_encoder encoder(64, start);
+        encoder.metadata("<node id=\"A\" key=\"1\"/>", start);
+        for (int i = 0; i < 20; ++i) {
+            encoder.frame(std::to_string(i), start + i * 1ms);
+        }
+
+        encoder.finish();
+
+        for (const auto& block : encoder.take()) {
+            bytes += block;
+        }
+    }
+
+    const auto footer_offset = bytes.size() - sizeof(capture_footer);
+    const auto footer = read_at<capture_footer>(bytes, footer_offset);
+    REQUIRE(footer.num_chunk > 1);
+
+    auto open = [&path](const std::string& content) {
+        {
+            std::ofstream out(path, std::ios::binary | std::ios::trunc);
+            out.write(content.data(), content.size());
+        }
+
+        capture_reader reader(path);
+        return reader.num_frame();
+    };
+
+    REQUIRE(open(bytes) == 20);
+
+    // Index offsets past the footer would wrap the unsigned size checks.
+    {
+        auto bad = footer;
+        bad.chunk_offset = footer_offset + 1000;
+        bad.metadata_offset = bad.chunk_offset;
+        bad.num_chunk = 0;
+        bad.num_metadata = 0;
+
+        auto corrupt = bytes;
+        write_at(corrupt, footer_offset, bad);
+        REQUIRE_THROWS_AS(open(corrupt), std::runtime_error);
+    }
+
+    {
+        auto bad = footer;
+        bad.metadata_offset = ~std::uint64_t{0};
+
+        auto corrupt = bytes;
+        write_at(corrupt, footer_offset, bad);
+        REQUIRE_THROWS_AS(open(corrupt), std::runtime_error);
+    }
+
+    // Chunk that starts in the index.
+    {
+        auto entry = read_at<capture_chunk>(bytes, footer.chunk_offset);
+        entry.offset = footer.chunk_offset + 8;
+        entry.size = 16;
+
+        auto corrupt = bytes;
+        write_at(corrupt, footer.chunk_offset, entry);
+        REQUIRE_THROWS_AS(open(corrupt), std::runtime_error);
+    }
+
+    // Metadata record that starts in the index.
+    {
+        auto entry = read_at<capture_metadata>(bytes, footer.metadata_offset);
+        entry.offset = footer.chunk_offset;
+
+        auto corrupt = bytes;
+        write_at(corrupt, footer.metadata_offset, entry);
+        REQUIRE_THROWS_AS(open(corrupt), std::runtime_error);
+    }
+
+    std::remove(path.c_str());
+}
+
+#if defined(ASIO_HAS_FILE)
+
+TEST_CASE("capture_writer", "[capture]")
+{
+    using namespace shadowmocap;
+    using namespace std::chrono_literals;
+
+    const auto path =
+        (std::filesystem::temp_directory_path() / "shadowmocap_writer.cap")
+            .string();
+
+    const std::string first_metadata =
+        "<?xml version=\"1.0\"?><node id=\"default\" key=\"0\">"
+        "<node id=\"A\" key=\"1\"/></node>";
+    const std::string second_metadata =
+        "<?xml version=\"1.0\"?><node id=\"default\" key=\"0\">"
+        "<node id=\"B\" key=\"1\"/></node>";
+    const auto request = make_channel_message(static_cast<int>(channel::Lq));
+
+    constexpr int kNumFrame = 200;
+
+    SECTION("direct")
+    {
+        asio::io_context ioc;
+
+        bool ok = false;
+        auto writer_task = [&]() -> asio::awaitable<void> {
+            // Small chunks so there are background writes while we record.
+            capture_writer writer(ioc.get_executor(), path, 256);
+
+            const auto start = capture_writer::clock_type::now();
+            writer.channel_request(request, start);
+            writer.metadata(first_metadata, start);
+            for (int i = 0; i < kNumFrame; ++i) {
+                if (i == 100) {
+                    writer.metadata(second_metadata, start + i * 1ms);
+                }
+
+                writer.frame(std::to_string(i), start + i * 1ms);
+            }
+
+            REQUIRE(writer.num_frame() == kNumFrame);
+
+            co_await writer.close();
+        };
+
+        co_spawn(ioc, writer_task(), [&ok](std::exception_ptr ptr) {
+            ok = !ptr;
+        });
+
+        ioc.run();
+
+        REQUIRE(ok);
+    }
+
+    SECTION("record_frames")
+    {
+        asio::io_context ioc;
+
+        tcp::acceptor acceptor{
+            ioc, tcp::endpoint{asio::ip::make_address("127.0.0.1"), 0}};
+
+        // Send the node lists and frames and then hang up.
+        auto server = [&]() -> asio::awaitable<void> {
+            auto socket = co_await acceptor.async_accept(asio::use_awaitable);
+
+            co_await write_message(socket, first_metadata);
+            for (int i = 0; i < kNumFrame; ++i) {
+                if (i == 100) {
+                    co_await write_message(socket, second_metadata);
+                }
+
+                co_await write_message(socket, std::to_string(i));
+            }
+        };
+
+        co_spawn(ioc, server(), asio::detached);
+
+        bool ok = false;
+        std::string name;
+        stream_metrics metrics;
+        auto client = [&]() -> asio::awaitable<void> {
+            tcp::socket socket{ioc};
+            co_await socket.async_connect(
+                acceptor.local_endpoint(), asio::use_awaitable);
+
+            datastream stream{std::move(socket)};
+            stream.metrics_ = &metrics;
+
+            capture_writer writer(ioc.get_executor(), path, 256);
+            writer.channel_request(request);
+
+            // Returns when the server hangs up.
+            co_await record_frames(stream, writer);
+
+            name = stream.nodes_.name(1);
+
+            REQUIRE(writer.num_frame() == kNumFrame);
+
+            co_await writer.close();
+        };
+
+        co_spawn(ioc, client(), [&ok](std::exception_ptr ptr) {
+            ok = !ptr;
+        });
+
+        ioc.run();
+
+        REQUIRE(ok);
+        REQUIRE(name == "B");
+
+        // Same read path as read_message so the stream metrics count too.
+        const auto snapshot = metrics.snapshot();
+        REQUIRE(snapshot.num_frame == kNumFrame);
+        REQUIRE(snapshot.num_metadata == 2);
+        REQUIRE(snapshot.num_bytes > 0);
+    }
+
+    {
+        capture_reader reader(path);
+        REQUIRE(reader.num_frame() == kNumFrame);
+        REQUIRE(reader.channel_request() == request);
+        REQUIRE(reader.metadata(0) == first_metadata);
+        REQUIRE(reader.metadata(99) == first_metadata);
+        REQUIRE(reader.metadata(100) == second_metadata);
+
+        int index = 0;
+        std::int64_t time = 0;
+        for (const auto frame : reader) {
+            REQUIRE(frame.message == std::to_string(index));
+            REQUIRE(frame.time >= time);
+            time = frame.time;
+            ++index;
+        }
+
+        REQUIRE(index == kNumFrame);
+    }
+
+    std::remove(path.c_str());
+}
+
+TEST_CASE("capture_writer_abandon", "[capture]")
+{
+    using namespace shadowmocap;
+
+    const auto path =
+        (std::filesystem::temp_directory_path() / "shadowmocap_abandon.cap")
+            .string();
+
+    asio::io_context ioc;
+
+    // Destroy the writer with a background write in flight and no close().
+    {
+        capture_writer writer(ioc.get_executor(), path, 256);
+        for (int i = 0; i < 100; ++i) {
+            writer.frame(std::to_string(i));
+        }
+    }
+
+    ioc.run();
+
+    // No index or footer.
+    REQUIRE_THROWS_AS(capture_reader(path), std::runtime_error);
+
+    std::remove(path.c_str());
+}
+
+#endif // ASIO_HAS_FILE
@@ -80,3 +80,51 @@ TEST_CASE("mask_dimension", "[channel]")
     dim = get_channel_mask_dimension(channel::c | channel::Bq);
     REQUIRE(dim == 8);
 }
+
+TEST_CASE("mask_dimension_table", "[channel]")
+{
+    using namespace shadowmocap;
+
+    // Same result as the loop over the channel list for every mask.
+    auto loop = [](int mask) {
+        int result = 0;
+        for (auto c : kChannelList) {
+            if (mask & c) {
+                result += get_channel_dimension(c);
+            }
+        }
+
+        return result;
+    };
+
+    for (int mask = 0; mask < (1 << 16); ++mask) {
+        REQUIRE(get_channel_mask_dimension(mask) == loop(mask));
+        REQUIRE(get_channel_mask_dimension(mask << 12) == loop(mask << 12));
+    }
+
+    // Bits above the last channel are not channels.
+    REQUIRE(get_channel_mask_dimension(-1) == 66);
+
+    static_assert(get_channel_mask_dimension(channel::Lq | channel::c) == 8);
+}
+
+TEST_CASE("channel_offset", "[channel]")
+{
+    using namespace shadowmocap;
+
+    constexpr int mask = channel::Gq | channel::Lq | channel::c | channel::dt;
+
+    static_assert(get_channel_offset(mask, channel::Gq) == 0);
+    static_assert(get_channel_offset(mask, channel::Lq) == 4);
+    static_assert(get_channel_offset(mask, channel::c) == 8);
+    static_assert(get_channel_offset(mask, channel::dt) == 12);
+    static_assert(get_channel_offset(mask, channel::a) == -1);
+
+    const auto all = get_all_channel_mask();
+
+    int offset = 0;
+    for (auto c : kChannelList) {
+        REQUIRE(get_channel_offset(all, c) == offset);
+        offset += get_channel_dimension(c);
+    }
+}
@@ -0,0 +1,284 @@
+#include <shadowmocap/columns.hpp>
+
+#include "support.hpp"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr int kMask = shadowmocap::channel::Lq | shadowmocap::channel::c;
+constexpr int kDim = shadowmocap::get_channel_mask_dimension(kMask);
+
+// Value of one axis of one node in one frame. Changes slowly like real data.
+float make_value(int frame, int key, int axis)
+{
+    return static_cast<float>(
+        std::sin(0.002 * frame + key) * (axis + 1) + 0.25 * axis);
+}
+
+std::string make_frame(int frame, const std::vector<int>& keys)
+{
+    std::string message;
+    float values[kDim];
+    for (const auto key : keys) {
+        for (int axis = 0; axis < kDim; ++axis) {
+            values[axis] = make_value(frame, key, axis);
+        }
+
+        append_item(message, key, values);
+    }
+
+    return message;
+}
+
+std::string join(std::vector<std::string> blocks)
+{
+    std::string result;
+    for (const auto& block : blocks) {
+        result.append(block);
+    }
+
+    return result;
+}
+
+} // namespace
+
+TEST_CASE("column_encoder", "[columns]")
+{
+    using namespace shadowmocap;
+
+    const node_map nodes{std::vector<metadata_node>{{"Hips", 1}, {"Head", 2}}};
+
+    // 250 frames at 10 ms intervals in row groups of 100. Head is missing
+    // from frame 120.
+    constexpr int kNumFrame = 250;
+    constexpr std::int64_t kInterval = 10'000'000;
+
+    column_encoder encoder(kMask, nodes, {100});
+    REQUIRE(encoder.names().size() == 2 * kDim);
+    REQUIRE(encoder.names().front() == "Hips.Lqw");
+    REQUIRE(encoder.names().back() == "Head.cz");
+
+    for (int i = 0; i < kNumFrame; ++i) {
+        std::vector<int> keys = {1, 2};
+        if (i == 120) {
+            keys = {1};
+        }
+
+        REQUIRE(encoder.frame(make_frame(i, keys), i * kInterval + i % 3));
+    }
+
+    // Wrong channel mask.
+    REQUIRE(!encoder.frame(std::string(12, 0), 0));
+    REQUIRE(encoder.num_row() == kNumFrame);
+
+    encoder.finish();
+    REQUIRE_THROWS_AS(encoder.frame({}, 0), std::logic_error);
+
+    const auto data = join(encoder.take());
+    REQUIRE(!encoder.ready());
+
+    const column_reader reader(data);
+    REQUIRE(reader.mask() == kMask);
+    REQUIRE(reader.num_row() == kNumFrame);
+    REQUIRE(reader.num_row_group() == 3);
+    REQUIRE(reader.num_row(2) == 50);
+    REQUIRE(reader.names() == encoder.names());
+
+    REQUIRE(reader.find("Hips.Lqw") == 0);
+    REQUIRE(reader.find("Head.cx") == kDim + 5);
+    REQUIRE(reader.find("Head") == -1);
+
+    // Round trip is exact.
+    std::vector<float> values(kNumFrame);
+    for (int column = 0; column < 2 * kDim; ++column) {
+        REQUIRE(reader.read(column, values) == kNumFrame);
+
+        const auto key = column / kDim + 1;
+        const auto axis = column % kDim;
+        for (int i = 0; i < kNumFrame; ++i) {
+            if ((key == 2) && (i == 120)) {
+                REQUIRE(std::isnan(values[i]));
+            } else {
+                REQUIRE(values[i] == make_value(i, key, axis));
+            }
+        }
+    }
+
+    std::vector<std::int64_t> times(100);
+    REQUIRE(reader.read_time(1, times) == 100);
+    for (int i = 0; i < 100; ++i) {
+        REQUIRE(times[i] == (100 + i) * kInterval + (100 + i) % 3);
+    }
+
+    // Statistics skip missing values.
+    const auto chunk = reader.chunk(reader.find("Head.Lqw"), 1);
+    REQUIRE(chunk.num_nan == 1);
+    REQUIRE(chunk.encoding == column_encoding::xor_float);
+
+    float min = make_value(100, 2, 0);
+    float max = min;
+    for (int i = 101; i < 200; ++i) {
+        if (i != 120) {
+            min = std::min(min, make_value(i, 2, 0));
+            max = std::max(max, make_value(i, 2, 0));
+        }
+    }
+
+    REQUIRE(chunk.min == min);
+    REQUIRE(chunk.max == max);
+    REQUIRE(reader.chunk(0, 1).num_nan == 0);
+
+    REQUIRE_THROWS_AS(reader.chunk(2 * kDim, 0), std::out_of_range);
+    REQUIRE_THROWS_AS(
+        reader.read(0, 0, std::span{values}.first(10)), std::length_error);
+
+    // Truncated file.
+    REQUIRE_THROWS_AS(
+        column_reader(std::string_view{data}.substr(0, data.size() - 1)),
+        std::runtime_error);
+    REQUIRE_THROWS_AS(column_reader(std::string_view{}), std::runtime_error);
+
+    SECTION("precision")
+    {
+        // Round to 3 digits like the CSV export.
+        column_encoder rounded(kMask, nodes, {100, 3});
+        for (int i = 0; i < kNumFrame; ++i) {
+            std::vector<int> keys = {1, 2};
+            if (i == 120) {
+                keys = {1};
+            }
+
+            rounded.frame(make_frame(i, keys), i * kInterval);
+        }
+
+        rounded.finish();
+
+        const auto rounded_data = join(rounded.take());
+        REQUIRE(rounded_data.size() < data.size() / 2);
+
+        const column_reader rounded_reader(rounded_data);
+        const auto chunk = rounded_reader.chunk(0, 0);
+        REQUIRE(chunk.encoding == column_encoding::delta_int);
+        REQUIRE(chunk.precision == 3);
+
+        for (int column = 0; column < 2 * kDim; ++column) {
+            REQUIRE(rounded_reader.read(column, values) == kNumFrame);
+
+            const auto key = column / kDim + 1;
+            const auto axis = column % kDim;
+            for (int i = 0; i < kNumFrame; ++i) {
+                if ((key == 2) && (i == 120)) {
+                    REQUIRE(std::isnan(values[i]));
+                } else {
+                    REQUIRE(
+                        std::abs(values[i] - make_value(i, key, axis)) <
+                        0.0005f + 1e-6f);
+                }
+            }
+        }
+    }
+}
+
+TEST_CASE("export_columns", "[columns]")
+{
+    using namespace shadowmocap;
+    using namespace std::chrono_literals;
+
+    const auto dir = std::filesystem::temp_directory_path();
+    const auto capture_path = (dir / "shadowmocap_test_columns.cap").string();
+    const auto path = (dir / "shadowmocap_test.col").string();
+
+    constexpr int kNumFrame = 500;
+    {
+        const auto start = capture_encoder::clock_type::now();
+
+        capture_encoder encoder(4096, start);
+        encoder.metadata(
+            "<node id=\"default\" key=\"0\"><node id=\"Hips\" key=\"1\"/>"
+            "</node>",
+            start);
+        for (int i = 0; i < kNumFrame; ++i) {
+            encoder.frame(make_frame(i, {1}), start + i * 1ms);
+        }
+
+        encoder.finish();
+
+        std::ofstream out(capture_path, std::ios::binary);
+        for (const auto& block : encoder.take()) {
+            out.write(block.data(), block.size());
+        }
+    }
+
+    export_columns(capture_reader(capture_path), kMask, path, {128});
+
+    std::string data;
+    {
+        std::ifstream in(path, std::ios::binary);
+        data.assign(std::istreambuf_iterator<char>{in}, {});
+    }
+
+    const column_reader reader(data);
+    REQUIRE(reader.num_row() == kNumFrame);
+    REQUIRE(reader.num_row_group() == 4);
+    REQUIRE(reader.names().size() == kDim);
+
+    std::vector<float> values(kNumFrame);
+    reader.read(reader.find("Hips.cy"), values);
+    for (int i = 0; i < kNumFrame; ++i) {
+        REQUIRE(values[i] == make_value(i, 1, 6));
+    }
+
+    std::vector<std::int64_t> times(128);
+    reader.read_time(3, times);
+    REQUIRE(times[0] == 384'000'000);
+
+    // Slowly varying values take less space than raw floats.
+    REQUIRE(data.size() < kNumFrame * kDim * sizeof(float));
+
+    // A new node list part way through would put the values of the new
+    // nodes in the columns of the old ones.
+    {
+        const auto start = capture_encoder::clock_type::now();
+
+        capture_encoder encoder(4096, start);
+        encoder.metadata(
+            "<node id=\"default\" key=\"0\"><node id=\"Hips\" key=\"1\"/>"
+            "</node>",
+            start);
+        for (int i = 0; i < 10; ++i) {
+            if (i == 5) {
+                encoder.metadata(
+                    "<node id=\"default\" key=\"0\"><node id=\"Head\" "
+                    "key=\"1\"/></node>",
+                    start + i * 1ms);
+            }
+
+            encoder.frame(make_frame(i, {1}), start + i * 1ms);
+        }
+
+        encoder.finish();
+
+        std::ofstream out(capture_path, std::ios::binary);
+        for (const auto& block : encoder.take()) {
+            out.write(block.data(), block.size());
+        }
+    }
+
+    REQUIRE_THROWS_AS(
+        export_columns(capture_reader(capture_path), kMask, path, {128}),
+        std::invalid_argument);
+
+    std::remove(capture_path.c_str());
+    std::remove(path.c_str());
+}
@@ -0,0 +1,76 @@
+#include <shadowmocap/csv.hpp>
+
+#include "support.hpp"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+TEST_CASE("csv_formatter", "[csv]")
+{
+    using namespace shadowmocap;
+
+    const node_map nodes{std::vector<metadata_node>{{"Hips", 1}, {"Head", 2}}};
+
+    SECTION("csv")
+    {
+        const auto mask = channel::Lq | channel::dt;
+
+        csv_formatter csv(mask);
+        REQUIRE(csv.size() == 0);
+
+        csv.header(nodes);
+        REQUIRE(
+            csv.data() == "Hips.Lqw,Hips.Lqx,Hips.Lqy,Hips.Lqz,Hips.dt,"
+                          "Head.Lqw,Head.Lqx,Head.Lqy,Head.Lqz,Head.dt\n");
+
+        csv.clear();
+        REQUIRE(csv.row(make_message(mask, 2)));
+        REQUIRE(
+            csv.data() == "0.000,1.000,2.000,3.000,4.000,"
+                          "1000.000,1001.000,1002.000,1003.000,1004.000\n");
+
+        // Wrong channel mask.
+        const auto size = csv.size();
+        REQUIRE(!csv.row(make_message(static_cast<int>(channel::Lq), 1)));
+        REQUIRE(csv.size() == size);
+    }
+
+    SECTION("tsv")
+    {
+        const auto mask = channel::a | channel::Temp;
+
+        csv_options options;
+        options.separator = "\t";
+        options.newline = "\r\n";
+        options.header = false;
+        options.precision = 1;
+        options.batch_size = 64;
+
+        csv_formatter csv(mask, options);
+        csv.header(nodes);
+        REQUIRE(csv.size() == 0);
+
+        REQUIRE(csv.row(make_message(mask, 1)));
+        REQUIRE(csv.data() == "0.0\t1.0\t2.0\t3.0\r\n");
+        REQUIRE(!csv.ready());
+
+        // Grows past the batch size.
+        for (int i = 0; i < 100; ++i) {
+            REQUIRE(csv.row(make_message(mask, 10)));
+        }
+
+        REQUIRE(csv.ready());
+        REQUIRE(csv.data().ends_with("9002.0\t9003.0\r\n"));
+
+        // Keep the rest after a partial write.
+        const std::string rest{csv.data().substr(5)};
+        csv.consume(5);
+        REQUIRE(csv.data() == rest);
+
+        csv.consume(csv.size() + 1);
+        REQUIRE(csv.size() == 0);
+    }
+}
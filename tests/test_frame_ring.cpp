@@ -0,0 +1,109 @@
+#include <shadowmocap/frame_ring.hpp>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <cstdint>
+#include <string>
+#include <thread>
+
+TEST_CASE("frame_ring", "[frame_ring]")
+{
+    using namespace shadowmocap;
+
+    REQUIRE_THROWS_AS(frame_ring(0), std::invalid_argument);
+
+    auto push = [](frame_ring& ring, int value) {
+        ring.producer_slot().message = std::to_string(value);
+        return ring.try_push();
+    };
+
+    SECTION("drop_oldest")
+    {
+        frame_ring ring(4, overflow_policy::drop_oldest);
+        REQUIRE(ring.capacity() == 4);
+        REQUIRE(ring.try_pop() == nullptr);
+        REQUIRE(ring.latest() == nullptr);
+
+        for (int i = 0; i < 6; ++i) {
+            REQUIRE(push(ring, i));
+        }
+
+        REQUIRE(ring.size() == 4);
+        REQUIRE(ring.dropped() == 2);
+
+        auto* slot = ring.try_pop();
+        REQUIRE(slot != nullptr);
+        REQUIRE(slot->message == "2");
+        REQUIRE(slot->sequence == 2);
+
+        slot = ring.latest();
+        REQUIRE(slot != nullptr);
+        REQUIRE(slot->message == "5");
+        REQUIRE(slot->sequence == 5);
+
+        REQUIRE(ring.size() == 0);
+        REQUIRE(ring.try_pop() == nullptr);
+    }
+
+    SECTION("block_producer")
+    {
+        frame_ring ring(2, overflow_policy::block_producer);
+
+        REQUIRE(push(ring, 0));
+        REQUIRE(push(ring, 1));
+        REQUIRE(!push(ring, 2));
+        REQUIRE(ring.dropped() == 0);
+
+        // The rejected slot is still ours, publish it once there is room.
+        auto* slot = ring.try_pop();
+        REQUIRE(slot != nullptr);
+        REQUIRE(slot->message == "0");
+        REQUIRE(ring.try_push());
+
+        std::string result;
+        REQUIRE(ring.drain([&](const frame_slot& slot) {
+            result += slot.message;
+        }) == 2);
+        REQUIRE(result == "12");
+    }
+
+    SECTION("threads")
+    {
+        constexpr std::uint64_t kNumFrame = 100000;
+
+        for (auto policy :
+             {overflow_policy::drop_oldest, overflow_policy::block_producer}) {
+            frame_ring ring(8, policy);
+
+            std::thread producer([&ring] {
+                for (std::uint64_t i = 0; i < kNumFrame; ++i) {
+                    ring.producer_slot().message = std::to_string(i);
+                    while (!ring.try_push()) {
+                        std::this_thread::yield();
+                    }
+                }
+            });
+
+            // Frames arrive in order and every slot holds its own frame.
+            std::uint64_t count = 0;
+            std::uint64_t next = 0;
+            bool ok = true;
+            while (next < kNumFrame) {
+                ring.drain([&](const frame_slot& slot) {
+                    ok = ok && (slot.sequence >= next) &&
+                         (slot.message == std::to_string(slot.sequence));
+                    next = slot.sequence + 1;
+                    ++count;
+                });
+            }
+
+            producer.join();
+
+            REQUIRE(ok);
+            REQUIRE(count + ring.dropped() == kNumFrame);
+            if (policy == overflow_policy::block_producer) {
+                REQUIRE(count == kNumFrame);
+            }
+        }
+    }
+}
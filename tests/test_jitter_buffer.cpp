@@ -0,0 +1,240 @@
+#include <shadowmocap/jitter_buffer.hpp>
+
+#include "support.hpp"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+using clock_type = shadowmocap::jitter_buffer::clock_type;
+using namespace std::chrono_literals;
+
+constexpr auto kPeriod = 10ms;
+constexpr int kNumFrame = 500;
+
+// One node with a quaternion and a time value in seconds.
+std::string make_frame(int mask, int frame, float time)
+{
+    const int dim = shadowmocap::get_channel_mask_dimension(mask);
+
+    std::vector<float> values(dim, time);
+    std::fill_n(values.begin(), std::min(dim, 4), static_cast<float>(frame));
+
+    std::string message;
+    append_item(message, 1, values);
+
+    return message;
+}
+
+int get_frame(const std::string& message)
+{
+    float value = 0;
+    std::memcpy(&value, message.data() + 8, sizeof(value));
+    return static_cast<int>(value);
+}
+
+// Frames arrive in bursts of three every third period, plus a late frame
+// now and then.
+clock_type::duration make_delay(int frame)
+{
+    auto delay = (2 - frame % 3) * kPeriod;
+    if (frame % 50 == 25) {
+        delay += 15ms;
+    }
+
+    return delay;
+}
+
+struct result {
+    std::vector<clock_type::duration> intervals;
+    bool in_order = true;
+    shadowmocap::jitter_stats stats;
+};
+
+// Push bursty frames and pop on a 1 ms tick.
+result run(int mask, float time_scale)
+{
+    using namespace shadowmocap;
+
+    jitter_buffer buffer(mask);
+
+    const clock_type::time_point start{};
+
+    result out;
+    clock_type::time_point last{};
+    int expected = 0;
+
+    int frame = 0;
+    for (auto now = start; frame < kNumFrame || !buffer.empty();
+         now += 1ms) {
+        while ((frame < kNumFrame) &&
+               (start + frame * kPeriod + make_delay(frame) <= now)) {
+            const auto time = time_scale * static_cast<float>(frame) *
+                              std::chrono::duration<float>{kPeriod}.count();
+
+            buffer.push(make_frame(mask, frame, time), now);
+            ++frame;
+        }
+
+        while (const auto* slot = buffer.pop(now)) {
+            if (get_frame(slot->message) != expected++) {
+                out.in_order = false;
+            }
+
+            if (last != clock_type::time_point{}) {
+                out.intervals.push_back(now - last);
+            }
+
+            last = now;
+        }
+    }
+
+    out.stats = buffer.stats();
+
+    return out;
+}
+
+void check(const result& out)
+{
+    REQUIRE(out.in_order);
+    REQUIRE(out.stats.num_push == kNumFrame);
+    REQUIRE(out.stats.num_pop == kNumFrame);
+    REQUIRE(out.stats.num_dropped == 0);
+
+    // Arrivals come three at once. Releases are one per period once the
+    // delay covers the bursts.
+    std::size_t num_steady = 0;
+    for (std::size_t i = 100; i < out.intervals.size(); ++i) {
+        const auto d = out.intervals[i] - kPeriod;
+        if ((d >= -1ms) && (d <= 1ms)) {
+            ++num_steady;
+        }
+    }
+
+    REQUIRE(num_steady >= (out.intervals.size() - 100) * 9 / 10);
+
+    CHECK(out.stats.output_jitter < out.stats.input_jitter / 4);
+    CHECK(out.stats.delay >= 2 * kPeriod);
+    CHECK(out.stats.mean_latency > 0ms);
+    CHECK(out.stats.max_latency <= 100ms);
+}
+
+} // namespace
+
+TEST_CASE("jitter_buffer", "[jitter_buffer]")
+{
+    using namespace shadowmocap;
+
+    REQUIRE_THROWS_AS(
+        jitter_buffer(0, jitter_options{0}), std::invalid_argument);
+
+    SECTION("receive_time")
+    {
+        check(run(static_cast<int>(channel::Lq), 1));
+    }
+
+    SECTION("timestamp")
+    {
+        check(run(channel::Lq | channel::timestamp, 1));
+    }
+
+    SECTION("dt")
+    {
+        // The dt channel holds the frame period.
+        jitter_buffer buffer(channel::Lq | channel::dt);
+
+        const auto dt = std::chrono::duration<float>{kPeriod}.count();
+
+        clock_type::time_point now{};
+        for (int i = 0; i < 3; ++i) {
+            buffer.push(make_frame(channel::Lq | channel::dt, i, dt), now);
+        }
+
+        std::vector<clock_type::duration> source;
+        while (const auto* slot = buffer.pop(now + 1s)) {
+            source.push_back(slot->source);
+        }
+
+        REQUIRE(source.size() == 3);
+        REQUIRE(source[0] == 0ms);
+        REQUIRE(std::chrono::abs(source[1] - kPeriod) < 1us);
+        REQUIRE(std::chrono::abs(source[2] - 2 * kPeriod) < 1us);
+    }
+}
+
+TEST_CASE("jitter_buffer_overflow", "[jitter_buffer]")
+{
+    using namespace shadowmocap;
+
+    const int mask = static_cast<int>(channel::Lq);
+
+    jitter_options options;
+    options.capacity = 4;
+
+    jitter_buffer buffer(mask, options);
+    REQUIRE(buffer.capacity() == 4);
+    REQUIRE(buffer.pop(clock_type::time_point{}) == nullptr);
+    REQUIRE(!buffer.next_release());
+
+    clock_type::time_point now{};
+    for (int i = 0; i < 6; ++i) {
+        buffer.push(make_frame(mask, i, 0), now);
+        now += kPeriod;
+    }
+
+    REQUIRE(buffer.size() == 4);
+    REQUIRE(buffer.next_release());
+
+    // Nothing is due before its release time.
+    REQUIRE(buffer.pop(*buffer.next_release() - 1ns) == nullptr);
+
+    std::vector<int> frames;
+    while (const auto* slot = buffer.pop(now + 1s)) {
+        frames.push_back(get_frame(slot->message));
+    }
+
+    REQUIRE(frames == std::vector<int>{2, 3, 4, 5});
+
+    const auto stats = buffer.stats();
+    REQUIRE(stats.num_dropped == 2);
+    REQUIRE(stats.num_pop == 4);
+}
+
+TEST_CASE("jitter_buffer_late", "[jitter_buffer]")
+{
+    using namespace shadowmocap;
+
+    const int mask = static_cast<int>(channel::Lq);
+
+    jitter_options options;
+    options.max_delay = 5ms;
+
+    jitter_buffer buffer(mask, options);
+
+    clock_type::time_point now{};
+    for (int i = 0; i < 10; ++i) {
+        buffer.push(make_frame(mask, i, 0), now);
+        REQUIRE(buffer.pop(now) != nullptr);
+        now += kPeriod;
+    }
+
+    // Far later than the largest delay goes out at once.
+    now += 50ms;
+    buffer.push(make_frame(mask, 10, 0), now);
+
+    const auto* slot = buffer.pop(now);
+    REQUIRE(slot != nullptr);
+    REQUIRE(get_frame(slot->message) == 10);
+    REQUIRE(slot->release == now);
+
+    const auto stats = buffer.stats();
+    REQUIRE(stats.num_late >= 1);
+    REQUIRE(stats.delay == 5ms);
+}
@@ -0,0 +1,457 @@
+#include <shadowmocap/math.hpp>
+#include <shadowmocap/message.hpp>
+
+#include "support.hpp"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <cmath>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr float kPi = 3.14159265358979323846f;
+
+// Range of vector components.
+constexpr float kScale = 100;
+
+// Structure of arrays storage for n elements with k components.
+struct arrays {
+    arrays(std::size_t k, std::size_t n) : n{n}, data(k * n)
+    {
+    }
+
+    float* operator[](std::size_t j)
+    {
+        return data.data() + j * n;
+    }
+
+    shadowmocap::quaternion_array<float> quaternion()
+    {
+        return {(*this)[0], (*this)[1], (*this)[2], (*this)[3]};
+    }
+
+    shadowmocap::vector_array<float> vector()
+    {
+        return {(*this)[0], (*this)[1], (*this)[2]};
+    }
+
+    shadowmocap::matrix_array<float> matrix()
+    {
+        shadowmocap::matrix_array<float> result;
+        for (std::size_t j = 0; j < result.m.size(); ++j) {
+            result.m[j] = (*this)[j];
+        }
+
+        return result;
+    }
+
+    std::size_t n;
+    std::vector<float> data;
+};
+
+arrays make_quaternions(std::size_t n, unsigned seed)
+{
+    std::mt19937 gen(seed);
+    std::normal_distribution<float> dis;
+
+    arrays q(4, n);
+    for (auto& value : q.data) {
+        value = dis(gen);
+    }
+
+    shadowmocap::detail::normalize_scalar(q.quaternion(), n);
+
+    return q;
+}
+
+arrays make_vectors(std::size_t n, unsigned seed)
+{
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<float> dis(-kScale, kScale);
+
+    arrays v(3, n);
+    for (auto& value : v.data) {
+        value = dis(gen);
+    }
+
+    return v;
+}
+
+// Largest absolute difference relative to the magnitude of the inputs.
+float get_error(const arrays& a, const arrays& b, float scale = 1)
+{
+    float result = 0;
+    for (std::size_t i = 0; i < a.data.size(); ++i) {
+        result = std::max(result, std::abs(a.data[i] - b.data[i]) / scale);
+    }
+
+    return result;
+}
+
+constexpr float kEpsilon = 1e-6f;
+
+} // namespace
+
+TEST_CASE("math", "[math]")
+{
+    using namespace shadowmocap;
+
+    INFO(detail::get_simd_name());
+
+    // Cover the SIMD loop, the scalar tail, and both.
+    for (std::size_t n : {0, 1, 3, 4, 7, 8, 9, 16, 33, 256, 4099}) {
+        INFO(n);
+
+        const auto lhs = make_quaternions(n, 1);
+        const auto rhs = make_quaternions(n, 2);
+        const auto v = make_vectors(n, 3);
+        const auto t = make_vectors(n, 4);
+
+        {
+            // Far from unit length.
+            auto q = lhs;
+            for (auto& value : q.data) {
+                value *= 10;
+            }
+
+            auto expected = q;
+
+            normalize(q.quaternion(), n);
+            detail::normalize_scalar(expected.quaternion(), n);
+
+            REQUIRE(get_error(q, expected) < kEpsilon);
+        }
+
+        {
+            arrays out(4, n);
+            arrays expected(4, n);
+
+            auto a = lhs;
+            auto b = rhs;
+
+            multiply(a.quaternion(), b.quaternion(), out.quaternion(), n);
+            detail::multiply_scalar(
+                a.quaternion(), b.quaternion(), expected.quaternion(), n);
+
+            REQUIRE(get_error(out, expected) < kEpsilon);
+
+            // In place
+            multiply(a.quaternion(), b.quaternion(), a.quaternion(), n);
+            REQUIRE(get_error(a, expected) < kEpsilon);
+        }
+
+        {
+            arrays out(3, n);
+            arrays expected(3, n);
+
+            auto q = lhs;
+
+            to_euler(q.quaternion(), out.vector(), n);
+            detail::to_euler_scalar(q.quaternion(), expected.vector(), n);
+
+            REQUIRE(get_error(out, expected) < 4 * kEpsilon);
+        }
+
+        {
+            arrays out(9, n);
+            arrays expected(9, n);
+
+            auto q = lhs;
+
+            to_matrix(q.quaternion(), out.matrix(), n);
+            detail::to_matrix_scalar(q.quaternion(), expected.matrix(), n);
+
+            REQUIRE(get_error(out, expected) < kEpsilon);
+        }
+
+        {
+            arrays out(3, n);
+            arrays expected(3, n);
+
+            auto q = lhs;
+            auto a = v;
+            auto b = t;
+
+            rotate(q.quaternion(), a.vector(), out.vector(), n);
+            detail::rotate_scalar(
+                q.quaternion(), a.vector(), expected.vector(), n);
+
+            REQUIRE(get_error(out, expected, kScale) < kEpsilon);
+
+            transform(
+                q.quaternion(), b.vector(), a.vector(), out.vector(), n);
+            detail::transform_scalar(
+                q.quaternion(), b.vector(), a.vector(), expected.vector(), n);
+
+            REQUIRE(get_error(out, expected, kScale) < kEpsilon);
+
+            // In place
+            transform(q.quaternion(), b.vector(), a.vector(), a.vector(), n);
+            REQUIRE(get_error(a, expected, kScale) < kEpsilon);
+        }
+    }
+}
+
+TEST_CASE("math_reference", "[math]")
+{
+    using namespace shadowmocap;
+
+    // Identity, 90 degrees about z, and 90 degrees about x. Eight of each so
+    // the SIMD path sees them too.
+    const float h = std::sqrt(0.5f);
+    const float input[3][4] = {{1, 0, 0, 0}, {h, 0, 0, h}, {h, h, 0, 0}};
+
+    constexpr std::size_t n = 24;
+
+    arrays q(4, n);
+    for (std::size_t i = 0; i < n; ++i) {
+        for (std::size_t j = 0; j < 4; ++j) {
+            q[j][i] = input[i % 3][j];
+        }
+    }
+
+    arrays euler(3, n);
+    to_euler(q.quaternion(), euler.vector(), n);
+
+    arrays matrix(9, n);
+    to_matrix(q.quaternion(), matrix.matrix(), n);
+
+    // Unit x and a translation.
+    arrays v(3, n);
+    arrays t(3, n);
+    for (std::size_t i = 0; i < n; ++i) {
+        v[0][i] = 1;
+        t[2][i] = 10;
+    }
+
+    arrays out(3, n);
+    transform(q.quaternion(), t.vector(), v.vector(), out.vector(), n);
+
+    const float expected_euler[3][3] = {
+        {0, 0, 0}, {0, 0, kPi / 2}, {kPi / 2, 0, 0}};
+    const float expected_matrix[3][9] = {
+        {1, 0, 0, 0, 1, 0, 0, 0, 1},
+        {0, -1, 0, 1, 0, 0, 0, 0, 1},
+        {1, 0, 0, 0, 0, -1, 0, 1, 0}};
+    const float expected_point[3][3] = {{1, 0, 10}, {0, 1, 10}, {1, 0, 10}};
+
+    for (std::size_t i = 0; i < n; ++i) {
+        for (std::size_t j = 0; j < 3; ++j) {
+            REQUIRE(std::abs(euler[j][i] - expected_euler[i % 3][j]) < 1e-6f);
+            REQUIRE(std::abs(out[j][i] - expected_point[i % 3][j]) < 1e-6f);
+        }
+
+        for (std::size_t j = 0; j < 9; ++j) {
+            REQUIRE(std::abs(matrix[j][i] - expected_matrix[i % 3][j]) < 1e-6f);
+        }
+    }
+}
+
+TEST_CASE("math_soa_frame", "[math]")
+{
+    using namespace shadowmocap;
+
+    const int mask = channel::Lq | channel::c;
+
+    // Quaternion of length 2 and point (1, 2, 3) for every node.
+    constexpr int kNumItem = 11;
+    const float values[8] = {2, 0, 0, 0, 1, 2, 3, 1};
+
+    std::string message;
+    for (int i = 0; i < kNumItem; ++i) {
+        append_item(message, i + 1, values);
+    }
+
+    soa_frame frame(mask);
+    REQUIRE(frame.decode(message));
+
+    auto q = get_quaternion_array(frame, channel::Lq);
+    normalize(q, frame.size());
+
+    const auto& cframe = frame;
+    const auto p = get_vector_array(cframe, channel::c);
+
+    for (std::size_t i = 0; i < frame.size(); ++i) {
+        REQUIRE(std::abs(q.w[i] - 1) < kEpsilon);
+        REQUIRE(p.x[i] == 1);
+        REQUIRE(p.y[i] == 2);
+        REQUIRE(p.z[i] == 3);
+    }
+
+    REQUIRE_THROWS_AS(
+        get_quaternion_array(frame, channel::Gq), std::invalid_argument);
+    REQUIRE_THROWS_AS(
+        get_vector_array(frame, channel::a), std::invalid_argument);
+}
+
+TEST_CASE("forward_kinematics", "[math]")
+{
+    using namespace shadowmocap;
+
+    // Hips -> Spine -> Head, and Hips -> Leg, plus a second root. Every bone
+    // is one unit along x from its parent.
+    const std::vector<int> parent = {-1, 0, 1, 0, -1};
+    const std::size_t n = parent.size();
+
+    const float h = std::sqrt(0.5f);
+
+    // Spine turns 90 degrees about z, the rest are identity.
+    arrays local(4, n);
+    for (std::size_t i = 0; i < n; ++i) {
+        local[0][i] = 1;
+    }
+
+    local[0][1] = h;
+    local[3][1] = h;
+
+    arrays offset(3, n);
+    for (std::size_t i = 0; i < n; ++i) {
+        offset[0][i] = 1;
+    }
+
+    offset[0][0] = 0;
+    offset[1][0] = 10;
+    offset[0][4] = -5;
+
+    arrays rotation(4, n);
+    arrays position(3, n);
+
+    forward_kinematics(
+        parent, local.quaternion(), offset.vector(), rotation.quaternion(),
+        position.vector(), n);
+
+    // Head inherits the spine rotation, so its bone points along y.
+    const float expected_position[5][3] = {
+        {0, 10, 0}, {1, 10, 0}, {1, 11, 0}, {1, 10, 0}, {-5, 0, 0}};
+    const float expected_rotation[5][4] = {
+        {1, 0, 0, 0}, {h, 0, 0, h}, {h, 0, 0, h}, {1, 0, 0, 0}, {1, 0, 0, 0}};
+
+    for (std::size_t i = 0; i < n; ++i) {
+        for (std::size_t j = 0; j < 3; ++j) {
+            REQUIRE(std::abs(position[j][i] - expected_position[i][j]) < 1e-6f);
+        }
+
+        for (std::size_t j = 0; j < 4; ++j) {
+            REQUIRE(std::abs(rotation[j][i] - expected_rotation[i][j]) < 1e-6f);
+        }
+    }
+
+    // Same result as composing by hand along each chain, for a random tree.
+    {
+        constexpr std::size_t kNumNode = 64;
+
+        std::mt19937 gen(5);
+        std::vector<int> tree(kNumNode, -1);
+        for (std::size_t i = 1; i < kNumNode; ++i) {
+            tree[i] = std::uniform_int_distribution<int>(
+                -1, static_cast<int>(i) - 1)(gen);
+        }
+
+        auto q = make_quaternions(kNumNode, 6);
+        auto v = make_vectors(kNumNode, 7);
+
+        arrays r(4, kNumNode);
+        arrays p(3, kNumNode);
+
+        forward_kinematics(
+            tree, q.quaternion(), v.vector(), r.quaternion(), p.vector(),
+            kNumNode);
+
+        for (std::size_t i = 0; i < kNumNode; ++i) {
+            // Walk up to the root: p = v[i], then p = q[k] * p + v[k].
+            arrays point(3, 1);
+            arrays rot(4, 1);
+            for (std::size_t j = 0; j < 3; ++j) {
+                point[j][0] = v[j][i];
+            }
+
+            for (std::size_t j = 0; j < 4; ++j) {
+                rot[j][0] = q[j][i];
+            }
+
+            for (int k = tree[i]; k >= 0; k = tree[k]) {
+                const auto uk = static_cast<std::size_t>(k);
+                const quaternion_array<float> qk{
+                    q[0] + uk, q[1] + uk, q[2] + uk, q[3] + uk};
+                const vector_array<float> vk{v[0] + uk, v[1] + uk, v[2] + uk};
+
+                detail::transform_scalar(
+                    qk, vk, point.vector(), point.vector(), 1);
+                detail::multiply_scalar(
+                    qk, rot.quaternion(), rot.quaternion(), 1);
+            }
+
+            for (std::size_t j = 0; j < 3; ++j) {
+                REQUIRE(std::abs(p[j][i] - point[j][0]) < 1e-3f);
+            }
+
+            for (std::size_t j = 0; j < 4; ++j) {
+                REQUIRE(std::abs(r[j][i] - rot[j][0]) < 1e-5f);
+            }
+        }
+    }
+
+    REQUIRE_THROWS_AS(
+        forward_kinematics(
+            std::vector<int>{-1, 2, 0}, local.quaternion(), offset.vector(),
+            rotation.quaternion(), position.vector(), 3),
+        std::invalid_argument);
+
+    // More parents than items in the frame.
+    REQUIRE_THROWS_AS(
+        forward_kinematics(
+            parent, local.quaternion(), offset.vector(),
+            rotation.quaternion(), position.vector(), n - 1),
+        std::invalid_argument);
+
+    // A frame without the spine. The head hangs off the hips, its offset is
+    // from the hips and the spine counts as identity.
+    {
+        const node_map tree(std::vector<metadata_node>{
+            {"Hips", 1, -1}, {"Spine", 2, 0}, {"Head", 3, 1}});
+        const auto items = tree.item_parents(std::vector<int>{1, 3});
+        REQUIRE(items == std::vector<int>{-1, 0});
+
+        // Hips at y = 10 turned 90 degrees about z, head one unit along x.
+        arrays q(4, 2);
+        q[0][0] = h;
+        q[3][0] = h;
+        q[0][1] = 1;
+
+        arrays v(3, 2);
+        v[1][0] = 10;
+        v[0][1] = 1;
+
+        arrays r(4, 2);
+        arrays p(3, 2);
+
+        forward_kinematics(
+            items, q.quaternion(), v.vector(), r.quaternion(), p.vector(), 2);
+
+        const float expected_head[3] = {0, 11, 0};
+        for (std::size_t j = 0; j < 3; ++j) {
+            REQUIRE(std::abs(p[j][1] - expected_head[j]) < 1e-6f);
+        }
+
+        const float expected_rot[4] = {h, 0, 0, h};
+        for (std::size_t j = 0; j < 4; ++j) {
+            REQUIRE(std::abs(r[j][1] - expected_rot[j]) < 1e-6f);
+        }
+    }
+
+    // A frame that lists the leg before the hips is not supported.
+    const node_map nodes(
+        std::vector<metadata_node>{{"Hips", 1, -1}, {"Leg", 2, 0}});
+    const auto reversed = nodes.item_parents(std::vector<int>{2, 1});
+    REQUIRE(reversed == std::vector<int>{1, -1});
+
+    REQUIRE_THROWS_AS(
+        forward_kinematics(
+            reversed, local.quaternion(), offset.vector(),
+            rotation.quaternion(), position.vector(), 2),
+        std::invalid_argument);
+}
@@ -2,6 +2,13 @@
 
 #include <catch2/catch_test_macros.hpp>
 
+#include <array>
+#include <cstring>
+#include <ranges>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
 TEST_CASE("make_message_list", "[message]")
 {
     using namespace shadowmocap;
@@ -43,6 +50,225 @@ TEST_CASE("make_message_list", "[message]")
     }
 }
 
+TEST_CASE("make_message_view", "[message]")
+{
+    using namespace shadowmocap;
+
+    static_assert(std::ranges::random_access_range<message_view<8>>);
+    static_assert(std::ranges::view<message_view<8>>);
+
+    {
+        using item_type = message_list_item<3>;
+
+        std::vector<item_type> expected(6);
+        for (int i = 0; i < 6; ++i) {
+            expected[i].key = i + 1;
+            expected[i].length = 3;
+            expected[i].data[2] = static_cast<float>(i);
+        }
+
+        auto input = std::string(expected.size() * sizeof(item_type), 0);
+        std::memcpy(input.data(), expected.data(), input.size());
+
+        auto output = make_message_view<3>(input);
+
+        REQUIRE(std::size(output) == 6);
+        REQUIRE(!output.empty());
+
+        int i = 0;
+        for (auto item : output) {
+            CHECK(item.key == i + 1);
+            CHECK(item.length == 3);
+            CHECK(item.data[2] == static_cast<float>(i));
+            ++i;
+        }
+
+        CHECK(output[5].key == 6);
+        CHECK(output.at(3).key == 4);
+        CHECK((output.end() - output.begin()) == 6);
+        CHECK_THROWS_AS(output.at(6), std::out_of_range);
+
+        auto list = make_message_list<3>(input);
+        REQUIRE(std::size(list) == 6);
+        CHECK(list.back().key == 6);
+    }
+
+    {
+        using item_type = message_list_item<10>;
+
+        auto input = std::string(sizeof(item_type) + 1, 0);
+        auto output = make_message_view<10>(input);
+
+        CHECK(std::size(output) == 0);
+        CHECK(output.empty());
+        CHECK_THROWS_AS(output.at(0), std::out_of_range);
+    }
+
+    {
+        auto output = make_message_view<1>(std::string_view{});
+
+        CHECK(std::size(output) == 0);
+    }
+}
+
+TEST_CASE("message_layout", "[message]")
+{
+    using namespace shadowmocap;
+
+    {
+        message_layout layout(channel::Lq | channel::c);
+
+        CHECK(layout.dimension() == 8);
+        CHECK(layout.item_size() == 40);
+        CHECK(layout.offset(channel::Lq) == 0);
+        CHECK(layout.offset(channel::c) == 4);
+        CHECK(layout.offset(channel::Gq) == -1);
+        CHECK(layout.offset(channel::None) == -1);
+    }
+
+    {
+        message_layout layout(get_all_channel_mask());
+
+        CHECK(layout.dimension() == 66);
+
+        int offset = 0;
+        for (auto c : kChannelList) {
+            CHECK(layout.offset(c) == offset);
+            offset += get_channel_dimension(c);
+        }
+    }
+}
+
+TEST_CASE("make_frame", "[message]")
+{
+    using namespace shadowmocap;
+
+    constexpr int mask = channel::Lq | channel::c | channel::dt;
+    using item_type = frame_item<mask>;
+
+    static_assert(std::ranges::random_access_range<frame<mask>>);
+    static_assert(item_type::kDimension == 9);
+    static_assert(sizeof(item_type) == sizeof(message_list_item<9>));
+    static_assert(item_type::contains<channel::c>());
+    static_assert(!item_type::contains<channel::Gq>());
+
+    std::array<item_type, 3> items;
+    for (int i = 0; i < 3; ++i) {
+        items[i].key = i + 1;
+        items[i].length = 9;
+        for (int j = 0; j < 9; ++j) {
+            items[i].data[j] = static_cast<float>(i * 10 + j);
+        }
+    }
+
+    std::string message(sizeof(items), 0);
+    std::memcpy(message.data(), items.data(), sizeof(items));
+
+    const auto view = make_frame<mask>(message);
+    REQUIRE(view.size() == 3);
+
+    int i = 0;
+    for (auto item : view) {
+        CHECK(item.key == i + 1);
+
+        std::span<const float, 4> q = std::as_const(item).get<channel::Lq>();
+        auto c = item.get<channel::c>();
+        auto dt = item.get<channel::dt>();
+
+        static_assert(decltype(c)::extent == 4);
+        static_assert(decltype(dt)::extent == 1);
+
+        for (int j = 0; j < 4; ++j) {
+            CHECK(q[j] == static_cast<float>(i * 10 + j));
+            CHECK(c[j] == static_cast<float>(i * 10 + 4 + j));
+        }
+
+        CHECK(dt[0] == static_cast<float>(i * 10 + 8));
+
+        ++i;
+    }
+
+    // Length field does not match the mask
+    message[sizeof(item_type) + 4] = 8;
+    CHECK(make_frame<mask>(message).empty());
+
+    // Not a whole number of items
+    CHECK(make_frame<mask>(message.substr(1)).empty());
+    CHECK(make_frame<mask>(std::string_view{}).empty());
+}
+
+TEST_CASE("make_message_view_layout", "[message]")
+{
+    using namespace shadowmocap;
+
+    constexpr auto kMask = channel::la | channel::c | channel::timestamp;
+    constexpr auto kDim = get_channel_mask_dimension(kMask);
+
+    static_assert(std::ranges::random_access_range<message_layout_view>);
+
+    message_layout layout(kMask);
+
+    using item_type = message_list_item<kDim>;
+
+    std::vector<item_type> expected(4);
+    for (int i = 0; i < 4; ++i) {
+        expected[i].key = i + 1;
+        expected[i].length = kDim;
+        for (int j = 0; j < kDim; ++j) {
+            expected[i].data[j] = static_cast<float>(i * 100 + j);
+        }
+    }
+
+    auto input = std::string(expected.size() * sizeof(item_type), 0);
+    std::memcpy(input.data(), expected.data(), input.size());
+
+    {
+        auto output = make_message_view(input, layout);
+
+        REQUIRE(std::size(output) == 4);
+
+        int i = 0;
+        for (auto item : output) {
+            CHECK(item.key() == i + 1);
+            CHECK(item.length() == kDim);
+            CHECK(item.value(channel::la, 0) == i * 100);
+            CHECK(item.value(channel::c, 3) == i * 100 + 6);
+            CHECK(item.value(channel::timestamp) == i * 100 + 7);
+
+            std::array<float, 4> c{};
+            CHECK(item.get(channel::c, c) == 4);
+            CHECK(c[0] == i * 100 + 3);
+
+            std::array<float, 4> a{};
+            CHECK(item.get(channel::a, a) == 0);
+
+            ++i;
+        }
+
+        CHECK(output.at(3).key() == 4);
+        CHECK_THROWS_AS(output.at(4), std::out_of_range);
+    }
+
+    {
+        // Length field does not match the layout.
+        auto bad = input;
+        const int length = kDim + 1;
+        std::memcpy(bad.data() + sizeof(item_type) + 4, &length, 4);
+
+        auto output = make_message_view(bad, layout);
+
+        CHECK(output.empty());
+        CHECK(std::size(output) == 0);
+    }
+
+    {
+        auto output = make_message_view(input.substr(1), layout);
+
+        CHECK(output.empty());
+        CHECK((output.end() - output.begin()) == 0);
+    }
+}
+
 TEST_CASE("is_metadata", "[message]")
 {
     using namespace shadowmocap;
@@ -115,6 +341,192 @@ TEST_CASE("parse_metadata", "[message]")
     }
 }
 
+TEST_CASE("parse_metadata_nodes", "[message]")
+{
+    using namespace shadowmocap;
+
+    {
+        auto input = "<?xml version=\"1.0\" encoding=\"utf-8\"?>"
+                     "<node id=\"default\" key=\"0\" tracking=\"1\">"
+                     "<node id=\"Hips\" key=\"1\">"
+                     "<node\tid=\"Left Leg\"\n key=\"12\"/>"
+                     "</node>"
+                     "<node id=\"Body\" key=\"3\" active=\"0\"/>"
+                     "</node>";
+
+        auto output = parse_metadata_nodes(input);
+
+        REQUIRE(output.size() == 3);
+        CHECK(output[0].name == "Hips");
+        CHECK(output[0].key == 1);
+        CHECK(output[0].parent == -1);
+        CHECK(output[1].name == "Left Leg");
+        CHECK(output[1].key == 12);
+        CHECK(output[1].parent == 0);
+        CHECK(output[2].name == "Body");
+        CHECK(output[2].key == 3);
+        CHECK(output[2].parent == -1);
+    }
+
+    {
+        // Nested tree, with quoted '>' and '/' in names and an element that
+        // does not match in the middle of it.
+        auto input = "<?xml version=\"1.0\"?>"
+                     "<node id=\"default\" key=\"0\">"
+                     "<node id=\"Hips\" key=\"1\">"
+                     "<node id=\"Spine/1>\" key=\"2\">"
+                     "<node id=\"\" key=\"9\">"
+                     "<node id=\"Head\" key=\"3\" active=\"0\"/>"
+                     "</node>"
+                     "<node id=\"LeftArm\" key=\"4\">"
+                     "<node id=\"LeftHand\" key=\"5\"></node>"
+                     "</node>"
+                     "</node>"
+                     "<node id=\"LeftLeg\" key=\"6\"/>"
+                     "</node>"
+                     "<node id=\"Prop\" key=\"7\"/>"
+                     "</node>";
+
+        auto output = parse_metadata_nodes(input);
+
+        const std::vector<std::string> names = {
+            "Hips",     "Spine/1>", "Head",    "LeftArm",
+            "LeftHand", "LeftLeg",  "Prop"};
+        const std::vector<int> parents = {-1, 0, 1, 1, 3, 0, -1};
+
+        REQUIRE(output.size() == names.size());
+        for (std::size_t i = 0; i < output.size(); ++i) {
+            CHECK(output[i].name == names[i]);
+            CHECK(output[i].parent == parents[i]);
+        }
+
+        node_map nodes(output);
+
+        REQUIRE(
+            std::vector<int>(nodes.parents().begin(), nodes.parents().end()) ==
+            parents);
+    }
+
+    {
+        // Elements that do not match the pattern are skipped, same as the
+        // regular expression <node\s+id="([^"]+)"\s+key="(\d+)"
+        auto input = "<node id=\"default\" key=\"0\">"
+                     "<node id=\"\" key=\"1\"/>"
+                     "<node key=\"2\" id=\"B\"/>"
+                     "<nodeid=\"C\" key=\"3\"/>"
+                     "<node id=\"D\" key=\"x\"/>"
+                     "<node id=\"E\"key=\"5\"/>"
+                     "<node id=\"F\" key=\"6\"/>"
+                     "<node id=\"G\" key=\"7";
+
+        auto output = parse_metadata_nodes(input);
+
+        REQUIRE(output.size() == 1);
+        CHECK(output[0].name == "F");
+        CHECK(output[0].key == 6);
+    }
+
+    {
+        // A match inside the quotes of an element that does not match, or
+        // after the key of one that does, is still found.
+        auto input = "<node id=\"default\" key=\"0\">"
+                     "<node x=\"<node id=\"A\" key=\"1\"\">"
+                     "<node id=\"B\" key=\"2\" x=\"<node id=\"C\" key=\"3\"\"/>"
+                     "</node>";
+
+        auto output = parse_metadata_nodes(input);
+
+        REQUIRE(output.size() == 3);
+        CHECK(output[0].name == "A");
+        CHECK(output[1].name == "B");
+        CHECK(output[2].name == "C");
+        CHECK(output[2].key == 3);
+    }
+
+    {
+        auto output = parse_metadata_nodes("");
+
+        CHECK(output.empty());
+    }
+}
+
+TEST_CASE("node_map", "[message]")
+{
+    using namespace shadowmocap;
+
+    {
+        auto input = "<?xml version=\"1.0\"?>"
+                     "<node id=\"default\" key=\"0\">"
+                     "<node id=\"Hips\" key=\"3\"/>"
+                     "<node id=\"Body\" key=\"1\"/>"
+                     "<node id=\"Head\" key=\"70000\"/>"
+                     "</node>";
+
+        node_map output(parse_metadata_nodes(input));
+
+        REQUIRE(output.size() == 3);
+        CHECK(output.find(3) == 0);
+        CHECK(output.find(1) == 1);
+        CHECK(output.find(2) == -1);
+        CHECK(output.find(-1) == -1);
+        CHECK(output.find(70000) == -1);
+
+        CHECK(output.find(std::string_view{"Body"}) == 1);
+        CHECK(output.find(std::string_view{"Head"}) == 2);
+        CHECK(output.find(std::string_view{"Nope"}) == -1);
+
+        CHECK(output.name(3) == "Hips");
+        CHECK(output.name(4).empty());
+        CHECK(output[2].name == "Head");
+
+        output.clear();
+        CHECK(output.empty());
+        CHECK(output.find(3) == -1);
+        CHECK(output.find(std::string_view{"Hips"}) == -1);
+    }
+
+    {
+        node_map output;
+
+        CHECK(output.empty());
+        CHECK(output.find(0) == -1);
+        CHECK(output.name(0).empty());
+        CHECK(output.parents().empty());
+    }
+
+    {
+        // Parents that do not come first are top level.
+        node_map output(std::vector<metadata_node>{
+            {"A", 1, 1}, {"B", 2, 0}, {"C", 3, 2}, {"D", 4, -5}});
+
+        REQUIRE(output.parents().size() == 4);
+        CHECK(output.parents()[0] == -1);
+        CHECK(output.parents()[1] == 0);
+        CHECK(output.parents()[2] == -1);
+        CHECK(output.parents()[3] == -1);
+    }
+
+    {
+        // Hips -> Spine -> Head. Frame items in a different order than the
+        // metadata, with one unknown key and without the spine. The head
+        // hangs off the hips, its nearest ancestor in the frame.
+        node_map output(std::vector<metadata_node>{
+            {"Hips", 1, -1}, {"Spine", 2, 0}, {"Head", 3, 1}, {"Leg", 4, 0}});
+
+        const std::vector<int> keys = {4, 1, 7, 3};
+        CHECK(output.item_parents(keys) == std::vector<int>{1, -1, -1, 1});
+
+        // Without the hips the head is top level.
+        const std::vector<int> head = {3, 4};
+        CHECK(output.item_parents(head) == std::vector<int>{-1, -1});
+
+        const std::vector<int> all = {1, 4, 2, 3};
+        CHECK(output.item_parents(all) == std::vector<int>{-1, 0, 0, 2});
+
+        CHECK(output.item_parents({}).empty());
+    }
+}
+
 TEST_CASE("make_channel_message", "[message]")
 {
     using namespace shadowmocap;
@@ -135,3 +547,21 @@ TEST_CASE("make_channel_message", "[message]")
         REQUIRE(is_metadata(output));
     }
 }
+
+TEST_CASE("parse_channel_message", "[message]")
+{
+    using namespace shadowmocap;
+
+    for (int mask :
+         {channel::Lq | channel::c, channel::Gq | channel::a | channel::elev,
+          get_all_channel_mask(), 0}) {
+        REQUIRE(parse_channel_message(make_channel_message(mask)) == mask);
+    }
+
+    REQUIRE(
+        parse_channel_message("<configurable><c /><Lq/><x/></configurable>") ==
+        (channel::Lq | channel::c));
+
+    REQUIRE(parse_channel_message("") == 0);
+    REQUIRE(parse_channel_message("<") == 0);
+}
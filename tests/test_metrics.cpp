@@ -0,0 +1,189 @@
+#include <shadowmocap/datastream.hpp>
+#include <shadowmocap/metrics.hpp>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <asio/co_spawn.hpp>
+#include <asio/io_context.hpp>
+#include <asio/steady_timer.hpp>
+#include <asio/write.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <limits>
+#include <string>
+#include <thread>
+
+TEST_CASE("histogram_buckets", "[metrics]")
+{
+    using namespace shadowmocap;
+    using snapshot = histogram_snapshot;
+
+    static_assert(snapshot::index(0) == 0);
+    static_assert(snapshot::index(15) == 15);
+    static_assert(snapshot::index(16) == 16);
+    static_assert(snapshot::lower_bound(snapshot::index(1000)) <= 1000);
+    static_assert(
+        snapshot::index(std::numeric_limits<std::uint64_t>::max()) ==
+        snapshot::kBucketCount - 1);
+
+    std::size_t last = 0;
+    for (std::uint64_t value = 0; value < (1 << 20); ++value) {
+        const auto i = snapshot::index(value);
+        const auto lower = snapshot::lower_bound(i);
+
+        // Buckets are in order and within 1/16 of the value.
+        REQUIRE(i >= last);
+        REQUIRE(lower <= value);
+        REQUIRE((value - lower) * snapshot::kSubBucketCount <= lower);
+        REQUIRE(snapshot::index(lower) == i);
+
+        last = i;
+    }
+}
+
+TEST_CASE("histogram_percentile", "[metrics]")
+{
+    using namespace shadowmocap;
+
+    latency_histogram histogram;
+
+    auto empty = histogram.snapshot();
+    CHECK(empty.count == 0);
+    CHECK(empty.percentile(50) == 0);
+    CHECK(empty.mean() == 0);
+
+    for (std::uint64_t value = 1; value <= 1000; ++value) {
+        histogram.record(value);
+    }
+
+    histogram.record(std::chrono::microseconds{-1});
+
+    const auto snapshot = histogram.snapshot();
+    CHECK(snapshot.count == 1001);
+    CHECK(snapshot.sum == 500500);
+    CHECK(snapshot.max == 1000);
+    CHECK(snapshot.percentile(0) == 0);
+    CHECK(snapshot.percentile(100) == 1000);
+
+    const auto p50 = snapshot.percentile(50);
+    CHECK(p50 <= 500);
+    CHECK(p50 >= 500 - 500 / 16);
+
+    const auto p99 = snapshot.percentile(99);
+    CHECK(p99 <= 990);
+    CHECK(p99 >= 990 - 990 / 16);
+}
+
+TEST_CASE("histogram_snapshot_concurrent", "[metrics]")
+{
+    using namespace shadowmocap;
+
+    constexpr std::uint64_t kNumValue = 1 << 20;
+
+    latency_histogram histogram;
+
+    std::thread writer([&histogram]() {
+        for (std::uint64_t value = 0; value < kNumValue; ++value) {
+            histogram.record(value % 1000);
+        }
+    });
+
+    // Counts only go up while the writer is running.
+    bool ok = true;
+    std::uint64_t last = 0;
+    while (last < kNumValue) {
+        const auto snapshot = histogram.snapshot();
+        ok = ok && (snapshot.count >= last) && (snapshot.max < 1000);
+        last = snapshot.count;
+    }
+
+    writer.join();
+
+    REQUIRE(ok);
+    REQUIRE(histogram.snapshot().count == kNumValue);
+}
+
+TEST_CASE("stream_metrics", "[metrics]")
+{
+    using namespace shadowmocap;
+    using namespace std::chrono_literals;
+
+    constexpr int kNumFrame = 10;
+
+    const std::string metadata =
+        "<?xml version=\"1.0\"?><node id=\"default\" key=\"0\"/>";
+    const std::string frame(40, 0);
+
+    asio::io_context ioc;
+
+    tcp::acceptor acceptor{
+        ioc, tcp::endpoint{asio::ip::make_address("127.0.0.1"), 0}};
+
+    // Sends the last frame in two parts so it takes two reads.
+    auto server = [&]() -> asio::awaitable<void> {
+        auto socket = co_await acceptor.async_accept(asio::use_awaitable);
+
+        co_await write_message(
+            socket, "<?xml version=\"1.0\"?><service name=\"test\"/>");
+        co_await write_message(socket, metadata);
+
+        for (int i = 0; i < kNumFrame - 1; ++i) {
+            co_await write_message(socket, frame);
+        }
+
+        const auto header = make_message_header(frame.size());
+        co_await asio::async_write(
+            socket, asio::buffer(header), asio::use_awaitable);
+
+        co_await asio::steady_timer{socket.get_executor(), 10ms}.async_wait(
+            asio::use_awaitable);
+
+        co_await asio::async_write(
+            socket, asio::buffer(frame), asio::use_awaitable);
+    };
+
+    stream_metrics metrics;
+
+    auto client = [&]() -> asio::awaitable<void> {
+        auto stream = co_await open_connection(acceptor.local_endpoint());
+        stream.metrics_ = &metrics;
+
+        std::chrono::steady_clock::time_point deadline{};
+        for (int i = 0; i < kNumFrame; ++i) {
+            extend_deadline_for(stream, deadline, 1s);
+
+            co_await read_message(stream);
+        }
+    };
+
+    co_spawn(ioc, server(), [](std::exception_ptr) {});
+
+    bool ok = false;
+    co_spawn(ioc, client(), [&ok](std::exception_ptr ptr) { ok = !ptr; });
+
+    ioc.run();
+
+    REQUIRE(ok);
+
+    const auto snapshot = metrics.snapshot();
+
+    if constexpr (kEnableMetrics) {
+        CHECK(snapshot.num_frame == kNumFrame);
+        CHECK(snapshot.num_metadata == 1);
+        CHECK(snapshot.num_deadline_extension == kNumFrame);
+        CHECK(
+            snapshot.num_bytes ==
+            4 + metadata.size() + kNumFrame * (4 + frame.size()));
+
+        CHECK(snapshot.arrival.count == kNumFrame - 1);
+        CHECK(snapshot.arrival.max >= 5'000'000);
+
+        CHECK(snapshot.read.count == kNumFrame);
+        CHECK(snapshot.read.max >= 5'000'000);
+        CHECK(snapshot.read.percentile(50) == 0);
+    } else {
+        CHECK(snapshot.num_frame == 0);
+    }
+}
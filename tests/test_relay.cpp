@@ -0,0 +1,425 @@
+#include <shadowmocap/relay.hpp>
+#include <shadowmocap/replay.hpp>
+
+#include "support.hpp"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <asio/co_spawn.hpp>
+#include <asio/detached.hpp>
+#include <asio/io_context.hpp>
+#include <asio/redirect_error.hpp>
+#include <asio/steady_timer.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <string>
+
+namespace {
+
+constexpr int kNumFrame = 200;
+constexpr int kMask = shadowmocap::channel::Lq | shadowmocap::channel::c;
+constexpr int kDim = shadowmocap::get_channel_mask_dimension(kMask);
+
+// Value of one axis of one node in one frame.
+float make_value(int frame, int key, int axis)
+{
+    return static_cast<float>(frame * 100 + key * 10 + axis);
+}
+
+// 200 frames at 1 ms intervals with two nodes.
+std::string make_capture()
+{
+    using namespace shadowmocap;
+    using namespace std::chrono_literals;
+
+    const auto path =
+        (std::filesystem::temp_directory_path() / "shadowmocap_relay.cap")
+            .string();
+
+    const auto start = capture_encoder::clock_type::now();
+
+    capture_encoder encoder(4096, start);
+    encoder.metadata(
+        "<?xml version=\"1.0\"?><node id=\"default\" key=\"0\">"
+        "<node id=\"A\" key=\"1\"/><node id=\"B\" key=\"2\"/></node>",
+        start);
+
+    for (int i = 0; i < kNumFrame; ++i) {
+        std::string message;
+        float values[kDim];
+        for (int key = 1; key <= 2; ++key) {
+            for (int axis = 0; axis < kDim; ++axis) {
+                values[axis] = make_value(i, key, axis);
+            }
+
+            append_item(message, key, values);
+        }
+
+        encoder.frame(message, start + i * 1ms);
+    }
+
+    encoder.finish();
+
+    std::ofstream out(path, std::ios::binary);
+    for (const auto& block : encoder.take()) {
+        out.write(block.data(), block.size());
+    }
+
+    return path;
+}
+
+} // namespace
+
+TEST_CASE("relay", "[relay]")
+{
+    using namespace shadowmocap;
+
+    const auto path = make_capture();
+    const capture_reader reader(path);
+
+    asio::io_context ioc;
+
+    const auto localhost = asio::ip::make_address("127.0.0.1");
+
+    // Replay server stands in for the Shadow data service.
+    tcp::acceptor upstream_acceptor{ioc, tcp::endpoint{localhost, 0}};
+    co_spawn(ioc, replay_server(upstream_acceptor, reader, {}), asio::detached);
+
+    tcp::acceptor acceptor{ioc, tcp::endpoint{localhost, 0}};
+
+    std::optional<datastream> upstream;
+    std::optional<relay> server;
+    stream_metrics metrics;
+
+    auto run = [&]() -> asio::awaitable<void> {
+        upstream.emplace(
+            co_await open_connection(upstream_acceptor.local_endpoint()));
+
+        co_await write_message(*upstream, make_channel_message(kMask));
+        upstream->metrics_ = &metrics;
+
+        server.emplace(*upstream, kMask);
+        co_spawn(ioc, server->serve(acceptor), asio::detached);
+
+        co_await server->run();
+    };
+
+    // Ends when the capture is done.
+    co_spawn(ioc, run(), [&](std::exception_ptr) {
+        upstream_acceptor.close();
+        acceptor.close();
+    });
+
+    struct result {
+        int num_frame = 0;
+        int last_frame = -1;
+        bool ok = true;
+        std::string name;
+    };
+
+    auto client = [&](int mask, int dim, int offset,
+                      result& out) -> asio::awaitable<void> {
+        auto stream = co_await open_connection(acceptor.local_endpoint());
+
+        co_await write_message(stream, make_channel_message(mask));
+
+        for (;;) {
+            const auto message = co_await read_message(stream);
+
+            out.name = stream.nodes_.name(2);
+
+            if (message.size() != 2 * (2 + dim) * sizeof(float)) {
+                out.ok = false;
+                continue;
+            }
+
+            int header[2] = {};
+            std::memcpy(header, message.data(), sizeof(header));
+            out.ok = out.ok && (header[0] == 1) && (header[1] == dim);
+
+            float value = 0;
+            std::memcpy(&value, message.data() + sizeof(header), sizeof(value));
+
+            // Frames arrive in order with no gaps once the client is in.
+            const auto frame = static_cast<int>(value - 10 - offset) / 100;
+            out.ok = out.ok && ((out.last_frame < 0) ||
+                                (frame == out.last_frame + 1));
+
+            for (int key = 1; key <= 2; ++key) {
+                for (int axis = 0; axis < dim; ++axis) {
+                    std::memcpy(
+                        &value,
+                        message.data() +
+                            ((key - 1) * (2 + dim) + 2 + axis) * sizeof(float),
+                        sizeof(value));
+
+                    out.ok = out.ok &&
+                             (value == make_value(frame, key, offset + axis));
+                }
+            }
+
+            out.last_frame = frame;
+            ++out.num_frame;
+        }
+    };
+
+    // Position only, sliced from the upstream frame.
+    result position;
+    co_spawn(
+        ioc, client(static_cast<int>(channel::c), 4, 4, position),
+        [](std::exception_ptr) {});
+
+    // Also asks for a channel the upstream does not have, which is ignored.
+    result all;
+    co_spawn(
+        ioc, client(kMask | channel::a, kDim, 0, all),
+        [](std::exception_ptr) {});
+
+    ioc.run();
+
+    for (const auto& out : {position, all}) {
+        REQUIRE(out.ok);
+        REQUIRE(out.num_frame > 0);
+        REQUIRE(out.last_frame == kNumFrame - 1);
+        REQUIRE(out.name == "B");
+    }
+
+    REQUIRE(server->num_client() == 0);
+    REQUIRE(server->num_dropped() == 0);
+
+    // The relay reads the upstream with the same routine as read_message.
+    const auto snapshot = metrics.snapshot();
+    REQUIRE(snapshot.num_frame == kNumFrame);
+    REQUIRE(snapshot.num_metadata == 1);
+
+    std::remove(path.c_str());
+}
+
+TEST_CASE("relay_stop", "[relay]")
+{
+    using namespace shadowmocap;
+    using namespace std::chrono_literals;
+
+    asio::io_context ioc;
+
+    const auto localhost = asio::ip::make_address("127.0.0.1");
+
+    // Upstream that sends a node list and then hangs up once told to.
+    tcp::acceptor upstream_acceptor{ioc, tcp::endpoint{localhost, 0}};
+    asio::steady_timer hang_up{ioc, asio::steady_timer::time_point::max()};
+
+    auto upstream_server = [&]() -> asio::awaitable<void> {
+        auto socket =
+            co_await upstream_acceptor.async_accept(asio::use_awaitable);
+
+        co_await write_message(
+            socket, "<?xml version=\"1.0\"?><service name=\"test\"/>");
+        co_await read_message(socket);
+        co_await write_message(
+            socket, "<?xml version=\"1.0\"?><node id=\"default\" key=\"0\"/>");
+
+        asio::error_code ec;
+        co_await hang_up.async_wait(
+            asio::redirect_error(asio::use_awaitable, ec));
+    };
+
+    co_spawn(ioc, upstream_server(), asio::detached);
+
+    tcp::acceptor acceptor{ioc, tcp::endpoint{localhost, 0}};
+    const auto endpoint = acceptor.local_endpoint();
+
+    std::optional<datastream> upstream;
+    std::optional<relay> server;
+
+    bool destroyed = false;
+    auto run = [&]() -> asio::awaitable<void> {
+        upstream.emplace(
+            co_await open_connection(upstream_acceptor.local_endpoint()));
+
+        co_await write_message(*upstream, make_channel_message(kMask));
+
+        server.emplace(*upstream, kMask);
+        co_spawn(ioc, server->serve(acceptor), asio::detached);
+
+        try {
+            co_await server->run();
+        } catch (const std::exception&) {
+        }
+
+        // Nothing may use the relay once run() is done.
+        server.reset();
+        destroyed = true;
+    };
+
+    co_spawn(ioc, run(), asio::detached);
+
+    // One client that finished the handshake and one that never sends its
+    // channel request.
+    bool ready_done = false;
+    bool stalled_done = false;
+
+    auto ready = [&]() -> asio::awaitable<void> {
+        auto stream = co_await open_connection(endpoint);
+        co_await write_message(stream, make_channel_message(kMask));
+
+        // Tell the upstream to hang up once we have the node list.
+        try {
+            for (;;) {
+                co_await read_any_message(stream);
+                hang_up.cancel();
+            }
+        } catch (const std::exception&) {
+        }
+
+        ready_done = true;
+    };
+
+    auto stalled = [&]() -> asio::awaitable<void> {
+        auto stream = co_await open_connection(endpoint);
+
+        try {
+            co_await read_any_message(stream);
+        } catch (const std::exception&) {
+        }
+
+        stalled_done = true;
+    };
+
+    co_spawn(ioc, stalled(), asio::detached);
+    co_spawn(ioc, ready(), asio::detached);
+
+    ioc.run();
+
+    REQUIRE(destroyed);
+    REQUIRE(ready_done);
+    REQUIRE(stalled_done);
+
+    // The acceptor is closed, so a late client is refused instead of left
+    // waiting on a session that never ends.
+    REQUIRE(!acceptor.is_open());
+}
+
+TEST_CASE("relay_slow_client", "[relay]")
+{
+    using namespace shadowmocap;
+    using namespace std::chrono_literals;
+
+    // Large frames so a client that never reads fills the socket buffers
+    // quickly.
+    constexpr int kNumSlowFrame = 1000;
+    constexpr int kNumNode = 1000;
+
+    asio::io_context ioc;
+
+    const auto localhost = asio::ip::make_address("127.0.0.1");
+
+    // Upstream sends the next frame once the fast client has the previous
+    // one, so the fast client never has more than one frame queued.
+    tcp::acceptor upstream_acceptor{ioc, tcp::endpoint{localhost, 0}};
+    asio::steady_timer next{ioc};
+    int num_received = 0;
+
+    std::optional<datastream> upstream;
+    std::optional<relay> server;
+
+    relay_options options;
+    options.max_queue_size = 1 << 16;
+    options.drain_timeout = 100ms;
+
+    auto upstream_server = [&]() -> asio::awaitable<void> {
+        auto socket =
+            co_await upstream_acceptor.async_accept(asio::use_awaitable);
+
+        co_await write_message(
+            socket, "<?xml version=\"1.0\"?><service name=\"test\"/>");
+        co_await read_message(socket);
+
+        // Start once both clients are in.
+        while (!server || (server->num_client() < 2)) {
+            next.expires_after(1ms);
+            co_await next.async_wait(asio::use_awaitable);
+        }
+
+        std::string message;
+        for (int i = 0; i < kNumSlowFrame; ++i) {
+            message.clear();
+
+            float values[kDim];
+            std::fill_n(values, kDim, make_value(i, 0, 0));
+            for (int key = 1; key <= kNumNode; ++key) {
+                append_item(message, key, values);
+            }
+
+            next.expires_at(asio::steady_timer::time_point::max());
+            co_await write_message(socket, message);
+
+            while (num_received <= i) {
+                asio::error_code ec;
+                co_await next.async_wait(
+                    asio::redirect_error(asio::use_awaitable, ec));
+            }
+        }
+    };
+
+    co_spawn(ioc, upstream_server(), asio::detached);
+
+    tcp::acceptor acceptor{ioc, tcp::endpoint{localhost, 0}};
+    const auto endpoint = acceptor.local_endpoint();
+
+    auto run = [&]() -> asio::awaitable<void> {
+        upstream.emplace(
+            co_await open_connection(upstream_acceptor.local_endpoint()));
+
+        co_await write_message(*upstream, make_channel_message(kMask));
+
+        server.emplace(*upstream, kMask, options);
+        co_spawn(ioc, server->serve(acceptor), asio::detached);
+
+        co_await server->run();
+    };
+
+    // A client that asks for frames and then never reads them.
+    std::optional<datastream> slow;
+    auto slow_client = [&]() -> asio::awaitable<void> {
+        slow.emplace(co_await open_connection(endpoint));
+        co_await write_message(*slow, make_channel_message(kMask));
+    };
+
+    bool ok = true;
+    auto fast_client = [&]() -> asio::awaitable<void> {
+        auto stream = co_await open_connection(endpoint);
+        co_await write_message(stream, make_channel_message(kMask));
+
+        for (;;) {
+            const auto message = co_await read_message(stream);
+
+            float value = 0;
+            std::memcpy(
+                &value, message.data() + 2 * sizeof(int), sizeof(value));
+
+            // Every frame arrives, in order.
+            ok = ok &&
+                 (message.size() == kNumNode * (2 + kDim) * sizeof(float)) &&
+                 (value == make_value(num_received, 0, 0));
+
+            ++num_received;
+            next.cancel();
+        }
+    };
+
+    co_spawn(ioc, slow_client(), asio::detached);
+    co_spawn(ioc, fast_client(), [](std::exception_ptr) {});
+    co_spawn(ioc, run(), [](std::exception_ptr) {});
+
+    ioc.run();
+
+    REQUIRE(ok);
+    REQUIRE(num_received == kNumSlowFrame);
+    REQUIRE(server->num_dropped() > 0);
+}
@@ -0,0 +1,164 @@
+#include <shadowmocap/replay.hpp>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <asio/co_spawn.hpp>
+#include <asio/detached.hpp>
+#include <asio/io_context.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+namespace {
+
+constexpr int kNumFrame = 100;
+
+const std::string kFirstMetadata =
+    "<?xml version=\"1.0\"?><node id=\"default\" key=\"0\">"
+    "<node id=\"A\" key=\"1\"/></node>";
+
+const std::string kSecondMetadata =
+    "<?xml version=\"1.0\"?><node id=\"default\" key=\"0\">"
+    "<node id=\"B\" key=\"1\"/></node>";
+
+// 100 frames at 1 ms intervals with a node list change at frame 60.
+std::string make_capture()
+{
+    using namespace shadowmocap;
+    using namespace std::chrono_literals;
+
+    const auto path =
+        (std::filesystem::temp_directory_path() / "shadowmocap_replay.cap")
+            .string();
+
+    const auto start = capture_encoder::clock_type::now();
+
+    capture_encoder encoder(1024, start);
+    encoder.metadata(kFirstMetadata, start);
+    for (int i = 0; i < kNumFrame; ++i) {
+        if (i == 60) {
+            encoder.metadata(kSecondMetadata, start + i * 1ms);
+        }
+
+        encoder.frame(std::to_string(i), start + i * 1ms);
+    }
+
+    encoder.finish();
+
+    std::ofstream out(path, std::ios::binary);
+    for (const auto& block : encoder.take()) {
+        out.write(block.data(), block.size());
+    }
+
+    return path;
+}
+
+} // namespace
+
+TEST_CASE("replay_server", "[replay]")
+{
+    using namespace shadowmocap;
+    using namespace std::chrono_literals;
+
+    const auto path = make_capture();
+    const capture_reader reader(path);
+
+    for (double rate : {0.0, 2.0}) {
+        asio::io_context ioc;
+
+        tcp::acceptor acceptor{
+            ioc, tcp::endpoint{asio::ip::make_address("127.0.0.1"), 0}};
+
+        replay_options options;
+        options.rate = rate;
+        co_spawn(ioc, replay_server(acceptor, reader, options), asio::detached);
+
+        // Two clients at once.
+        int num_client = 0;
+        bool ok = true;
+        auto client = [&]() -> asio::awaitable<void> {
+            auto stream = co_await open_connection(acceptor.local_endpoint());
+
+            co_await write_message(
+                stream, make_channel_message(channel::Lq | channel::c));
+
+            const auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < kNumFrame; ++i) {
+                const auto message = co_await read_message(stream);
+
+                ok = ok && (message == std::to_string(i));
+
+                ok = ok && (stream.nodes_.name(1) == ((i < 60) ? "A" : "B"));
+            }
+
+            // 99 ms of frames at twice the original rate.
+            if (rate > 0) {
+                ok = ok && (std::chrono::steady_clock::now() - start >= 45ms);
+            }
+
+            if (++num_client == 2) {
+                acceptor.close();
+            }
+        };
+
+        co_spawn(ioc, client(), [&](std::exception_ptr ptr) {
+            ok = ok && !ptr;
+        });
+        co_spawn(ioc, client(), [&](std::exception_ptr ptr) {
+            ok = ok && !ptr;
+        });
+
+        ioc.run();
+
+        REQUIRE(ok);
+        REQUIRE(num_client == 2);
+    }
+
+    std::remove(path.c_str());
+}
+
+TEST_CASE("replay_server_name", "[replay]")
+{
+    using namespace shadowmocap;
+
+    const auto path = make_capture();
+    const capture_reader reader(path);
+
+    asio::io_context ioc;
+
+    tcp::acceptor acceptor{
+        ioc, tcp::endpoint{asio::ip::make_address("127.0.0.1"), 0}};
+
+    replay_options options;
+    options.rate = 0;
+    options.name = "preview";
+    co_spawn(ioc, replay_server(acceptor, reader, options), asio::detached);
+
+    // A client of a service that is not configurable does not send a channel
+    // request before it reads.
+    bool ok = true;
+    auto client = [&]() -> asio::awaitable<void> {
+        auto stream = co_await open_connection(acceptor.local_endpoint());
+
+        for (int i = 0; i < kNumFrame; ++i) {
+            const auto message = co_await read_message(stream);
+
+            ok = ok && (message == std::to_string(i));
+        }
+
+        acceptor.close();
+    };
+
+    co_spawn(ioc, client(), [&](std::exception_ptr ptr) {
+        ok = ok && !ptr;
+    });
+
+    ioc.run();
+
+    REQUIRE(ok);
+
+    std::remove(path.c_str());
+}
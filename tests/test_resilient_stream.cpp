@@ -0,0 +1,398 @@
+#include <shadowmocap/resilient_stream.hpp>
+
+#include "support.hpp"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <asio/co_spawn.hpp>
+#include <asio/io_context.hpp>
+#include <asio/steady_timer.hpp>
+
+#include <chrono>
+#include <exception>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr int kMask = static_cast<int>(shadowmocap::channel::Lq);
+constexpr int kNumFrame = 20;
+
+std::string make_metadata(const std::string& name)
+{
+    return "<?xml version=\"1.0\"?><node id=\"default\" key=\"0\"><node id=\"" +
+           name + "\" key=\"1\"/></node>";
+}
+
+std::string make_frame(int frame)
+{
+    const auto value = static_cast<float>(frame);
+    const float values[4] = {value, value, value, value};
+
+    std::string message;
+    append_item(message, 1, values);
+
+    return message;
+}
+
+} // namespace
+
+TEST_CASE("resilient_stream", "[resilient_stream]")
+{
+    using namespace shadowmocap;
+    using namespace std::chrono_literals;
+
+    asio::io_context ioc;
+
+    tcp::acceptor acceptor{
+        ioc, tcp::endpoint{asio::ip::make_address("127.0.0.1"), 0}};
+
+    // Connections that went quiet. Kept open until the end.
+    std::vector<tcp::socket> silent;
+
+    bool request_ok = true;
+
+    auto serve = [&](tcp::socket& socket, const std::string& name,
+                     int first) -> asio::awaitable<void> {
+        co_await write_message(
+            socket, "<?xml version=\"1.0\"?><service name=\"test\"/>");
+
+        const auto request = co_await read_message(socket);
+        request_ok = request_ok && (parse_channel_message(request) == kMask);
+
+        co_await write_message(socket, make_metadata(name));
+
+        for (int i = 0; i < kNumFrame; ++i) {
+            co_await write_message(socket, make_frame(first + i));
+        }
+    };
+
+    // Drops the first connection, refuses the handshake of the second, and
+    // goes silent on the third.
+    auto server = [&]() -> asio::awaitable<void> {
+        {
+            auto socket = co_await acceptor.async_accept(asio::use_awaitable);
+            co_await serve(socket, "A", 0);
+        }
+
+        co_await acceptor.async_accept(asio::use_awaitable);
+
+        {
+            auto socket = co_await acceptor.async_accept(asio::use_awaitable);
+            co_await serve(socket, "B", kNumFrame);
+            silent.push_back(std::move(socket));
+        }
+
+        {
+            auto socket = co_await acceptor.async_accept(asio::use_awaitable);
+            co_await serve(socket, "C", 2 * kNumFrame);
+
+            // Until the client closes the stream.
+            co_await read_message(socket);
+        }
+    };
+
+    co_spawn(ioc, server(), [](std::exception_ptr) {});
+
+    reconnect_options options;
+    options.timeout = 100ms;
+    options.initial_delay = 5ms;
+    options.max_delay = 20ms;
+
+    resilient_stream stream(
+        ioc.get_executor(), acceptor.local_endpoint(), kMask, options);
+
+    std::vector<stream_gap> gaps;
+    stream.on_gap([&gaps](const stream_gap& gap) { gaps.push_back(gap); });
+
+    std::vector<std::string> names;
+    int num_frame = 0;
+    bool frame_ok = true;
+    bool closed = false;
+
+    auto client = [&]() -> asio::awaitable<void> {
+        std::string buffer;
+        while (num_frame < 3 * kNumFrame) {
+            const auto message = co_await stream.read(buffer);
+
+            frame_ok = frame_ok && (message == make_frame(num_frame));
+            ++num_frame;
+
+            names.emplace_back(stream.nodes().name(1));
+        }
+
+        stream.close();
+
+        try {
+            co_await stream.read(buffer);
+        } catch (const std::exception&) {
+            closed = true;
+        }
+
+        acceptor.close();
+        silent.clear();
+    };
+
+    co_spawn(ioc, client(), [](std::exception_ptr) {});
+
+    ioc.run();
+
+    REQUIRE(request_ok);
+    REQUIRE(frame_ok);
+    REQUIRE(closed);
+    REQUIRE(num_frame == 3 * kNumFrame);
+
+    REQUIRE(names.front() == "A");
+    REQUIRE(names[kNumFrame] == "B");
+    REQUIRE(names.back() == "C");
+
+    REQUIRE(stream.num_connect() == 3);
+    REQUIRE(stream.num_failed() == 1);
+
+    REQUIRE(gaps.size() == 2);
+
+    // Dropped, then one failed handshake.
+    REQUIRE(gaps[0].num_attempt == 2);
+    REQUIRE(gaps[0].duration() > 0s);
+
+    // Went quiet, so the gap is at least the timeout.
+    REQUIRE(gaps[1].num_attempt == 1);
+    REQUIRE(gaps[1].duration() >= options.timeout);
+}
+
+TEST_CASE("resilient_stream_max_attempts", "[resilient_stream]")
+{
+    using namespace shadowmocap;
+    using namespace std::chrono_literals;
+
+    asio::io_context ioc;
+
+    // Nothing is listening on this port once the acceptor is closed.
+    tcp::endpoint endpoint;
+    {
+        tcp::acceptor acceptor{
+            ioc, tcp::endpoint{asio::ip::make_address("127.0.0.1"), 0}};
+        endpoint = acceptor.local_endpoint();
+    }
+
+    reconnect_options options;
+    options.initial_delay = 1ms;
+    options.max_attempts = 3;
+
+    resilient_stream stream(ioc.get_executor(), endpoint, kMask, options);
+
+    bool failed = false;
+
+    auto client = [&]() -> asio::awaitable<void> {
+        std::string buffer;
+        co_await stream.read(buffer);
+    };
+
+    co_spawn(ioc, client(), [&failed](std::exception_ptr ptr) {
+        failed = ptr != nullptr;
+    });
+
+    ioc.run();
+
+    REQUIRE(failed);
+    REQUIRE(!stream.is_connected());
+    REQUIRE(stream.num_connect() == 0);
+    REQUIRE(stream.num_failed() == 3);
+}
+
+TEST_CASE("resilient_stream_close_handshake", "[resilient_stream]")
+{
+    using namespace shadowmocap;
+    using namespace std::chrono_literals;
+
+    asio::io_context ioc;
+
+    tcp::acceptor acceptor{
+        ioc, tcp::endpoint{asio::ip::make_address("127.0.0.1"), 0}};
+
+    // Accept the connection but hold back the handshake.
+    auto server = [&]() -> asio::awaitable<void> {
+        auto socket = co_await acceptor.async_accept(asio::use_awaitable);
+
+        // Until the client closes the stream.
+        co_await read_message(socket);
+    };
+
+    co_spawn(ioc, server(), [](std::exception_ptr) {});
+
+    reconnect_options options;
+    options.timeout = 10s;
+
+    resilient_stream stream(
+        ioc.get_executor(), acceptor.local_endpoint(), kMask, options);
+
+    bool closed = false;
+
+    auto client = [&]() -> asio::awaitable<void> {
+        std::string buffer;
+        co_await stream.read(buffer);
+    };
+
+    co_spawn(ioc, client(), [&](std::exception_ptr ptr) {
+        closed = ptr != nullptr;
+        acceptor.close();
+    });
+
+    asio::steady_timer timer{ioc, 50ms};
+    timer.async_wait([&stream](asio::error_code) { stream.close(); });
+
+    const auto start = std::chrono::steady_clock::now();
+
+    ioc.run();
+
+    // Stopped by close, not by the watchdog.
+    REQUIRE(closed);
+    REQUIRE(std::chrono::steady_clock::now() - start < options.timeout);
+    REQUIRE(!stream.is_connected());
+    REQUIRE(stream.num_connect() == 0);
+}
+
+TEST_CASE("resilient_stream_handshake_drop", "[resilient_stream]")
+{
+    using namespace shadowmocap;
+    using namespace std::chrono_literals;
+
+    asio::io_context ioc;
+
+    tcp::acceptor acceptor{
+        ioc, tcp::endpoint{asio::ip::make_address("127.0.0.1"), 0}};
+
+    // Time of every accepted connection.
+    std::vector<std::chrono::steady_clock::time_point> accepted;
+
+    auto handshake = [&]() -> asio::awaitable<tcp::socket> {
+        auto socket = co_await acceptor.async_accept(asio::use_awaitable);
+        accepted.push_back(std::chrono::steady_clock::now());
+
+        co_await write_message(
+            socket, "<?xml version=\"1.0\"?><service name=\"test\"/>");
+        co_await read_message(socket);
+        co_await write_message(socket, make_metadata("A"));
+
+        co_return socket;
+    };
+
+    // Drops four connections right after the handshake, sends one frame on
+    // the fifth, and then serves the rest.
+    auto server = [&]() -> asio::awaitable<void> {
+        for (int i = 0; i < 4; ++i) {
+            co_await handshake();
+        }
+
+        {
+            auto socket = co_await handshake();
+            co_await write_message(socket, make_frame(0));
+        }
+
+        auto socket = co_await handshake();
+        for (int i = 1; i < kNumFrame; ++i) {
+            co_await write_message(socket, make_frame(i));
+        }
+
+        // Until the client closes the stream.
+        co_await read_message(socket);
+    };
+
+    co_spawn(ioc, server(), [](std::exception_ptr) {});
+
+    reconnect_options options;
+    options.initial_delay = 20ms;
+    options.max_delay = 1s;
+    options.jitter = 0;
+
+    resilient_stream stream(
+        ioc.get_executor(), acceptor.local_endpoint(), kMask, options);
+
+    std::vector<stream_gap> gaps;
+    stream.on_gap([&gaps](const stream_gap& gap) { gaps.push_back(gap); });
+
+    int num_frame = 0;
+
+    auto client = [&]() -> asio::awaitable<void> {
+        std::string buffer;
+        while (num_frame < kNumFrame) {
+            co_await stream.read(buffer);
+            ++num_frame;
+        }
+
+        stream.close();
+        acceptor.close();
+    };
+
+    co_spawn(ioc, client(), [](std::exception_ptr) {});
+
+    ioc.run();
+
+    REQUIRE(num_frame == kNumFrame);
+    REQUIRE(stream.num_connect() == 6);
+    REQUIRE(stream.num_failed() == 0);
+    REQUIRE(accepted.size() == 6);
+
+    // The wait grows over connections that end before their first frame.
+    auto delay = options.initial_delay;
+    for (int i = 1; i < 5; ++i) {
+        REQUIRE(accepted[i] - accepted[i - 1] >= delay);
+        delay *= 2;
+    }
+
+    // The frame reset it, so the next attempt is immediate.
+    REQUIRE(accepted[5] - accepted[4] < delay);
+
+    REQUIRE(gaps.size() == 1);
+    REQUIRE(gaps[0].num_attempt == 1);
+}
+
+TEST_CASE("resilient_stream_handshake_drop_max_attempts", "[resilient_stream]")
+{
+    using namespace shadowmocap;
+    using namespace std::chrono_literals;
+
+    asio::io_context ioc;
+
+    tcp::acceptor acceptor{
+        ioc, tcp::endpoint{asio::ip::make_address("127.0.0.1"), 0}};
+
+    // Drops every connection right after the handshake.
+    auto server = [&]() -> asio::awaitable<void> {
+        for (;;) {
+            auto socket = co_await acceptor.async_accept(asio::use_awaitable);
+
+            co_await write_message(
+                socket, "<?xml version=\"1.0\"?><service name=\"test\"/>");
+            co_await read_message(socket);
+            co_await write_message(socket, make_metadata("A"));
+        }
+    };
+
+    co_spawn(ioc, server(), [](std::exception_ptr) {});
+
+    reconnect_options options;
+    options.initial_delay = 1ms;
+    options.max_attempts = 3;
+
+    resilient_stream stream(
+        ioc.get_executor(), acceptor.local_endpoint(), kMask, options);
+
+    bool failed = false;
+
+    auto client = [&]() -> asio::awaitable<void> {
+        std::string buffer;
+        co_await stream.read(buffer);
+    };
+
+    co_spawn(ioc, client(), [&](std::exception_ptr ptr) {
+        failed = ptr != nullptr;
+        acceptor.close();
+    });
+
+    ioc.run();
+
+    REQUIRE(failed);
+    REQUIRE(!stream.is_connected());
+    REQUIRE(stream.num_connect() == 3);
+}
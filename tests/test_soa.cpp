@@ -0,0 +1,103 @@
+#include <shadowmocap/soa.hpp>
+
+#include "support.hpp"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+TEST_CASE("soa_frame", "[soa]")
+{
+    using namespace shadowmocap;
+
+    for (int mask : {channel::Lq | channel::c, get_all_channel_mask(),
+                     channel::a | channel::dt | channel::Bq}) {
+        const message_layout layout(mask);
+
+        for (int num_item : {1, 3, 4, 7, 8, 9, 33}) {
+            const auto message = make_message(mask, num_item);
+
+            soa_frame frame(mask);
+            REQUIRE(frame.decode(message));
+            REQUIRE(frame.size() == static_cast<std::size_t>(num_item));
+            REQUIRE(frame.stride() % soa_frame::kWidth == 0);
+
+            for (int i = 0; i < num_item; ++i) {
+                REQUIRE(frame.keys()[i] == i + 1);
+            }
+
+            for (auto c : kChannelList) {
+                if (!(mask & c)) {
+                    REQUIRE(frame.values(c).empty());
+                    continue;
+                }
+
+                for (int axis = 0; axis < get_channel_dimension(c); ++axis) {
+                    auto values = frame.values(c, axis);
+                    REQUIRE(values.size() == frame.size());
+
+                    const auto j = layout.offset(c) + axis;
+                    for (int i = 0; i < num_item; ++i) {
+                        REQUIRE(values[i] == static_cast<float>(i * 1000 + j));
+                    }
+
+                    REQUIRE(
+                        reinterpret_cast<std::uintptr_t>(values.data()) %
+                            soa_frame::kAlignment ==
+                        0);
+                }
+            }
+        }
+    }
+
+    {
+        soa_frame frame(channel::Lq | channel::c);
+
+        REQUIRE(!frame.decode("not a message"));
+        REQUIRE(frame.empty());
+    }
+}
+
+TEST_CASE("transpose_items", "[soa]")
+{
+    using namespace shadowmocap;
+
+    const auto mask = channel::Gq | channel::r | channel::Lq | channel::temp;
+    const auto dim = get_channel_mask_dimension(mask);
+
+    for (int num_item : {0, 1, 5, 16, 31}) {
+        const auto message = make_message(mask, num_item);
+        const std::size_t stride = 32;
+
+        std::vector<float> expected(dim * stride);
+        std::vector<float> output(dim * stride);
+
+        detail::transpose_items_scalar(
+            message.data(), num_item, dim, expected.data(), stride);
+
+        // Aligned output for the SIMD path.
+        soa_frame frame(mask);
+        if (num_item > 0) {
+            REQUIRE(frame.decode(message));
+
+            int offset = 0;
+            for (auto c : kChannelList) {
+                if (!(mask & c)) {
+                    continue;
+                }
+
+                for (int axis = 0; axis < get_channel_dimension(c); ++axis) {
+                    auto values = frame.values(c, axis);
+                    for (int i = 0; i < num_item; ++i) {
+                        REQUIRE(values[i] == expected[offset * stride + i]);
+                    }
+
+                    ++offset;
+                }
+            }
+        }
+    }
+}
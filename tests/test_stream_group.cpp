@@ -0,0 +1,123 @@
+#include <shadowmocap/stream_group.hpp>
+
+#include "support.hpp"
+
+#include <asio/co_spawn.hpp>
+#include <asio/io_context.hpp>
+#include <asio/ip/tcp.hpp>
+#include <asio/read.hpp>
+#include <asio/use_awaitable.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <string>
+#include <thread>
+
+TEST_CASE("stream_group", "[stream_group]")
+{
+    using namespace shadowmocap;
+    using namespace std::chrono_literals;
+
+    constexpr auto kMask = channel::Lq | channel::c;
+    constexpr std::size_t kNumStream = 2;
+    constexpr int kNumFrame = 5;
+
+    const tcp::endpoint endpoint{asio::ip::make_address("127.0.0.1"), 32076};
+
+    stream_group group(2);
+    REQUIRE(group.num_thread() == 2);
+
+    for (std::size_t i = 0; i < kNumStream; ++i) {
+        // The mock server accepts one connection at a time so the second
+        // stream waits for the first session to end.
+        REQUIRE(group.add(endpoint, kMask, 10s) == i);
+    }
+
+    std::array<std::atomic<int>, kNumStream> count{};
+    std::atomic<bool> is_valid{true};
+
+    group.start([&](std::size_t index, std::string_view message,
+                    const node_map& nodes) {
+        auto view = make_message_view<get_channel_mask_dimension(kMask)>(
+            message);
+        if (view.empty() || (view.size() != nodes.size()) ||
+            (nodes.find(view[0].key) < 0)) {
+            is_valid = false;
+        }
+
+        count[index]++;
+        if ((count[0] >= kNumFrame) && (count[1] >= kNumFrame)) {
+            group.stop();
+        }
+    });
+
+    group.join();
+
+    REQUIRE(is_valid);
+    REQUIRE(count[0] >= kNumFrame);
+    REQUIRE(count[1] >= kNumFrame);
+}
+
+TEST_CASE("stream_group_stop", "[stream_group]")
+{
+    using namespace shadowmocap;
+    using namespace std::chrono_literals;
+
+    constexpr auto kMask = channel::Lq | channel::c;
+
+    asio::io_context ioc;
+
+    tcp::acceptor acceptor{
+        ioc, tcp::endpoint{asio::ip::make_address("127.0.0.1"), 0}};
+
+    // Send one frame and then wait for the client to hang up.
+    auto server = [&]() -> asio::awaitable<void> {
+        auto socket = co_await acceptor.async_accept(asio::use_awaitable);
+
+        co_await accept_service(socket, "configurable");
+        co_await write_message(
+            socket, "<?xml version=\"1.0\"?><node id=\"default\" key=\"0\">"
+                    "<node id=\"Hips\" key=\"1\"/></node>");
+        co_await write_message(socket, make_message(kMask, 1));
+
+        char data = 0;
+        co_await asio::async_read(
+            socket, asio::buffer(&data, 1), asio::use_awaitable);
+    };
+
+    std::atomic<bool> closed{false};
+    co_spawn(ioc, server(), [&closed](std::exception_ptr ptr) {
+        closed = (ptr != nullptr);
+    });
+
+    std::thread thread([&ioc]() { ioc.run(); });
+
+    stream_group group(1);
+    group.add(acceptor.local_endpoint(), kMask, 10s);
+
+    std::atomic<int> num_frame{0};
+    std::atomic<int> num_error{0};
+    group.start(
+        [&](std::size_t, std::string_view, const node_map&) {
+            num_frame++;
+            group.stop();
+        },
+        [&](std::size_t, std::exception_ptr) { num_error++; });
+
+    group.join();
+
+    // The group is still alive so only stop() can have closed the socket.
+    for (int i = 0; (i < 500) && !closed; ++i) {
+        std::this_thread::sleep_for(10ms);
+    }
+
+    ioc.stop();
+    thread.join();
+
+    REQUIRE(num_frame == 1);
+    REQUIRE(num_error == 0);
+    REQUIRE(closed);
+}
@@ -0,0 +1,127 @@
+#include <shadowmocap/subset.hpp>
+
+#include "support.hpp"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Expected subset, one channel at a time.
+std::string make_expected(int from, int to, int num_item)
+{
+    using namespace shadowmocap;
+
+    const int dim = get_channel_mask_dimension(to);
+
+    std::string message;
+    for (int i = 0; i < num_item; ++i) {
+        const int header[2] = {i + 1, dim};
+        message.append(reinterpret_cast<const char*>(header), sizeof(header));
+
+        int axis = 0;
+        for (auto c : kChannelList) {
+            if (!(from & c)) {
+                continue;
+            }
+
+            for (int j = 0; j < get_channel_dimension(c); ++j, ++axis) {
+                if (to & c) {
+                    const auto value = static_cast<float>(i * 1000 + axis);
+                    message.append(
+                        reinterpret_cast<const char*>(&value), sizeof(value));
+                }
+            }
+        }
+    }
+
+    return message;
+}
+
+} // namespace
+
+TEST_CASE("channel_subset", "[subset]")
+{
+    using namespace shadowmocap;
+
+    const int from = channel::Gq | channel::Lq | channel::r | channel::c |
+                     channel::a | channel::timestamp;
+
+    const std::vector<int> list = {
+        from,
+        channel::Lq | channel::c,
+        channel::Lq | channel::r,
+        channel::Gq | channel::a | channel::timestamp,
+        static_cast<int>(channel::timestamp),
+        0};
+
+    const auto message = make_message(from, 5);
+
+    for (auto to : list) {
+        const channel_subset subset(from, to);
+
+        CHECK(subset.from() == from);
+        CHECK(subset.to() == to);
+        CHECK(
+            subset.input_item_size() ==
+            (2 + get_channel_mask_dimension(from)) * sizeof(float));
+        CHECK(
+            subset.output_item_size() ==
+            (2 + get_channel_mask_dimension(to)) * sizeof(float));
+
+        std::string out;
+        REQUIRE(subset.apply(message, out));
+        CHECK(out == make_expected(from, to, 5));
+
+        std::vector<char> buffer(subset.output_size(message.size()) - 1);
+        CHECK(subset.apply(message, buffer) == 0);
+    }
+
+    // Not a subset
+    CHECK_THROWS_AS(
+        channel_subset(from, static_cast<int>(channel::m)),
+        std::invalid_argument);
+
+    {
+        const channel_subset subset(from, static_cast<int>(channel::Lq));
+
+        std::string out;
+        CHECK(!subset.apply(std::string_view{}, out));
+        CHECK(!subset.apply(message.substr(1), out));
+
+        // Length field does not match the input mask
+        auto bad = message;
+        const int dim = 3;
+        std::memcpy(bad.data() + subset.input_item_size() + 4, &dim, 4);
+        CHECK(!subset.apply(bad, out));
+
+        // Message for the output mask
+        const auto other = make_message(static_cast<int>(channel::Lq), 5);
+        CHECK(!subset.apply(other, out));
+    }
+}
+
+TEST_CASE("get_channel_subset", "[subset]")
+{
+    using namespace shadowmocap;
+
+    const int from = channel::Lq | channel::c;
+
+    const int lq = static_cast<int>(channel::Lq);
+    const int c = static_cast<int>(channel::c);
+
+    const auto& a = get_channel_subset(from, c);
+    const auto& b = get_channel_subset(from, c);
+    const auto& d = get_channel_subset(from, lq);
+
+    CHECK(&a == &b);
+    CHECK(&a != &d);
+    CHECK(a.to() == c);
+    CHECK(d.to() == lq);
+
+    CHECK_THROWS_AS(get_channel_subset(lq, c), std::invalid_argument);
+}
@@ -0,0 +1,328 @@
+#include <shadowmocap/synchronizer.hpp>
+
+#include "support.hpp"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using clock_type = shadowmocap::synchronizer::clock_type;
+using namespace std::chrono_literals;
+
+constexpr auto kPeriod = 10'000us;
+
+// Two nodes. Lq turns about z by angle, c.x is value, and the time channel
+// is time in seconds.
+std::string make_frame(int mask, float angle, float value, float time)
+{
+    using namespace shadowmocap;
+
+    const message_layout layout(mask);
+
+    std::string message;
+    for (int key = 1; key <= 2; ++key) {
+        std::vector<float> values(layout.dimension());
+        if (layout.contains(channel::Lq)) {
+            values[layout.offset(channel::Lq)] = std::cos(angle / 2);
+            values[layout.offset(channel::Lq) + 3] = std::sin(angle / 2);
+        }
+
+        if (layout.contains(channel::c)) {
+            values[layout.offset(channel::c)] = value;
+        }
+
+        for (auto c : {channel::timestamp, channel::systime}) {
+            if (layout.contains(c)) {
+                values[layout.offset(c)] = time;
+            }
+        }
+
+        append_item(message, key, values);
+    }
+
+    return message;
+}
+
+float get_value(const std::string& message, int mask, shadowmocap::channel c)
+{
+    const shadowmocap::message_layout layout(mask);
+
+    float value = 0;
+    std::memcpy(
+        &value, message.data() + 8 + layout.offset(c) * sizeof(float),
+        sizeof(value));
+
+    return value;
+}
+
+float get_angle(const std::string& message, int mask)
+{
+    using namespace shadowmocap;
+
+    const message_layout layout(mask);
+
+    float q[4];
+    std::memcpy(
+        q, message.data() + 8 + layout.offset(channel::Lq) * sizeof(float),
+        sizeof(q));
+
+    return 2 * std::atan2(q[3], q[0]);
+}
+
+} // namespace
+
+TEST_CASE("synchronizer", "[synchronizer]")
+{
+    using namespace shadowmocap;
+
+    const int mask = channel::Lq | channel::c | channel::timestamp;
+
+    sync_options options;
+    options.latency = 15ms;
+
+    synchronizer sync(options);
+    REQUIRE(sync.add(mask) == 0);
+    REQUIRE(sync.add(mask) == 1);
+    REQUIRE(sync.add(mask) == 2);
+    REQUIRE(sync.size() == 3);
+
+    const clock_type::time_point start{1h};
+
+    // Stream 0 and 1 run at the same rate on unrelated clocks. Stream 1
+    // starts a quarter period later. Stream 2 never sends anything.
+    const float base[2] = {0, 10};
+    const int phase[2] = {0, 1};
+
+    auto t = start;
+    for (int i = 0; i < 100; ++i) {
+        for (std::size_t k = 0; k < 2; ++k) {
+            const float n = static_cast<float>(i) + phase[k] * 0.25f;
+            const float time = base[k] + n * 0.01f;
+            sync.push(
+                k, make_frame(mask, n * 0.01f, n, time),
+                t + phase[k] * kPeriod / 4);
+        }
+
+        t += kPeriod;
+
+        // Sample half way between frames.
+        const auto& frame = sync.sample(t - kPeriod / 2);
+        REQUIRE(frame.streams.size() == 3);
+        REQUIRE(frame.streams[2].state == sync_state::empty);
+        REQUIRE(frame.streams[2].message.empty());
+
+        if (i < 2) {
+            continue;
+        }
+
+        // Every stream is sampled at the same time on its own clock, the
+        // latency and half a period before now.
+        REQUIRE(frame.time == t - kPeriod / 2 - options.latency);
+
+        const float expected = static_cast<float>(i) - 1;
+        for (std::size_t k = 0; k < 2; ++k) {
+            const auto& stream = frame.streams[k];
+            REQUIRE(stream.state == sync_state::interpolated);
+            REQUIRE(stream.lag == clock_type::duration{});
+
+            REQUIRE(std::abs(get_value(stream.message, mask, channel::c) -
+                             expected) < 1e-2f);
+            REQUIRE(std::abs(get_angle(stream.message, mask) -
+                             expected * 0.01f) < 1e-4f);
+            REQUIRE(std::abs(get_value(stream.message, mask,
+                                       channel::timestamp) -
+                             (base[k] + expected * 0.01f)) < 1e-3f);
+        }
+    }
+
+    // Stream 1 stops. It is held and then stale once the sample time passes
+    // its last frame.
+    for (int i = 100; i < 120; ++i) {
+        sync.push(0, make_frame(mask, i * 0.01f, i, i * 0.01f), t);
+        t += kPeriod;
+
+        const auto& frame = sync.sample(t - kPeriod / 2);
+        REQUIRE(frame.streams[0].state == sync_state::interpolated);
+
+        if (i == 100) {
+            continue;
+        }
+
+        const auto& stream = frame.streams[1];
+        REQUIRE(stream.state != sync_state::interpolated);
+        REQUIRE(get_value(stream.message, mask, channel::c) == 99.25f);
+
+        if (stream.lag > options.max_hold) {
+            REQUIRE(stream.state == sync_state::stale);
+        } else {
+            REQUIRE(stream.state == sync_state::held);
+            REQUIRE(stream.lag > clock_type::duration{});
+        }
+    }
+
+    REQUIRE(sync.sample(t).streams[1].state == sync_state::stale);
+}
+
+TEST_CASE("synchronizer_slerp", "[synchronizer]")
+{
+    using namespace shadowmocap;
+
+    const int mask = channel::Lq | channel::timestamp;
+
+    sync_options options;
+    options.latency = 0ms;
+
+    synchronizer sync(options);
+    sync.add(mask);
+
+    // Quarter turn about z. A linear blend of the quaternions would not be
+    // unit length.
+    const float kPi = 3.14159265f;
+
+    const clock_type::time_point start{1h};
+    sync.push(0, make_frame(mask, 0, 0, 0), start);
+    sync.push(0, make_frame(mask, kPi / 2, 0, 0.01f), start + kPeriod);
+
+    for (int i = 0; i <= 4; ++i) {
+        const auto& frame = sync.sample(start + i * kPeriod / 4);
+        const auto& stream = frame.streams[0];
+
+        if (i < 4) {
+            REQUIRE(stream.state == sync_state::interpolated);
+        } else {
+            REQUIRE(stream.state == sync_state::held);
+        }
+
+        REQUIRE(std::abs(get_angle(stream.message, mask) - i * kPi / 8) <
+                1e-4f);
+
+        float q[4];
+        std::memcpy(q, stream.message.data() + 8, sizeof(q));
+        REQUIRE(
+            std::abs(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3] -
+                     1) < 1e-5f);
+    }
+
+    // Source restarts, the history starts over.
+    sync.push(0, make_frame(mask, 0, 0, 0), start + 5 * kPeriod);
+    REQUIRE(sync.sample(start + 5 * kPeriod).streams[0].state ==
+            sync_state::held);
+}
+
+TEST_CASE("synchronizer_systime", "[synchronizer]")
+{
+    using namespace shadowmocap;
+
+    const int mask = channel::c | channel::systime;
+
+    // Same systime clock, but stream 1 always arrives 4 ms later.
+    for (auto time_channel : {channel::systime, channel::timestamp}) {
+        sync_options options;
+        options.time_channel = time_channel;
+
+        synchronizer sync(options);
+        sync.add(mask);
+        sync.add(mask);
+
+        const clock_type::time_point start{1h};
+
+        auto t = start;
+        const sync_frame* frame = nullptr;
+        for (int i = 0; i < 20; ++i) {
+            const auto time = 10 + i * 0.01f;
+            sync.push(0, make_frame(mask, 0, i, time), t);
+            sync.push(1, make_frame(mask, 0, i, time), t + 4ms);
+            t += kPeriod;
+
+            frame = &sync.sample(t);
+        }
+
+        const auto a = get_value(frame->streams[0].message, mask, channel::c);
+        const auto b = get_value(frame->streams[1].message, mask, channel::c);
+
+        if (time_channel == channel::systime) {
+            // Aligned on the shared clock.
+            REQUIRE(std::abs(a - b) < 1e-3f);
+        } else {
+            // No time channel, aligned on arrival.
+            REQUIRE(std::abs(a - b - 0.4f) < 1e-3f);
+        }
+    }
+}
+
+TEST_CASE("synchronizer_threads", "[synchronizer]")
+{
+    using namespace shadowmocap;
+
+    const int mask = channel::Lq | channel::c | channel::timestamp;
+    constexpr std::size_t kNumStream = 8;
+    constexpr int kNumFrame = 2000;
+
+    sync_options options;
+    options.latency = 0ms;
+
+    synchronizer sync(options);
+    for (std::size_t i = 0; i < kNumStream; ++i) {
+        sync.add(mask);
+    }
+
+    std::atomic<std::size_t> num_done{0};
+    std::vector<std::thread> producers;
+    for (std::size_t k = 0; k < kNumStream; ++k) {
+        producers.emplace_back([&sync, &num_done, mask, k] {
+            for (int i = 0; i < kNumFrame; ++i) {
+                sync.push(
+                    k, make_frame(mask, 0, i, i * 0.01f), clock_type::now());
+            }
+
+            ++num_done;
+        });
+    }
+
+    // Every sample is a whole frame of each stream.
+    while (num_done.load() < kNumStream) {
+        const auto& frame = sync.sample(clock_type::now());
+        for (const auto& stream : frame.streams) {
+            if (stream.state == sync_state::empty) {
+                continue;
+            }
+
+            const auto value = get_value(stream.message, mask, channel::c);
+            REQUIRE(value >= 0);
+            REQUIRE(value <= kNumFrame - 1);
+        }
+    }
+
+    for (auto& thread : producers) {
+        thread.join();
+    }
+
+    // Newest frame of every stream made it through.
+    const auto& frame = sync.sample(clock_type::now() + 1h);
+    for (const auto& stream : frame.streams) {
+        REQUIRE(stream.state == sync_state::stale);
+        REQUIRE(get_value(stream.message, mask, channel::c) == kNumFrame - 1);
+    }
+}
+
+TEST_CASE("synchronizer_options", "[synchronizer]")
+{
+    using namespace shadowmocap;
+
+    sync_options options;
+    options.time_channel = channel::dt;
+    REQUIRE_THROWS_AS(synchronizer(options), std::invalid_argument);
+
+    options = sync_options{};
+    options.capacity = 0;
+    REQUIRE_THROWS_AS(synchronizer(options), std::invalid_argument);
+}
@@ -0,0 +1,168 @@
+#include <shadowmocap/soa.hpp>
+#include <shadowmocap/triple_buffer.hpp>
+
+#include "support.hpp"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <asio/co_spawn.hpp>
+#include <asio/detached.hpp>
+#include <asio/io_context.hpp>
+
+#include <array>
+#include <cstdint>
+#include <exception>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+TEST_CASE("triple_buffer", "[triple_buffer]")
+{
+    using namespace shadowmocap;
+
+    triple_buffer<int> latest(-1);
+    REQUIRE(!latest.update());
+    REQUIRE(latest.frame() == 0);
+    REQUIRE(latest.read_buffer() == -1);
+
+    latest.write_buffer() = 1;
+    latest.publish();
+
+    REQUIRE(latest.update());
+    REQUIRE(latest.read_buffer() == 1);
+    REQUIRE(latest.frame() == 1);
+    REQUIRE(!latest.update());
+
+    // Skip to the newest frame.
+    for (int i = 2; i <= 4; ++i) {
+        latest.write_buffer() = i;
+        latest.publish();
+    }
+
+    REQUIRE(latest.update());
+    REQUIRE(latest.read_buffer() == 4);
+    REQUIRE(latest.frame() == 4);
+    REQUIRE(!latest.update());
+    REQUIRE(latest.read_buffer() == 4);
+}
+
+// Build with ENABLE_TSAN to check for data races.
+TEST_CASE("triple_buffer threads", "[triple_buffer]")
+{
+    using namespace shadowmocap;
+
+    constexpr std::uint64_t kNumFrame = 200000;
+
+    // Large enough that a torn read would show up as mixed values.
+    using frame_type = std::array<std::uint64_t, 64>;
+
+    triple_buffer<frame_type> latest;
+
+    std::thread producer([&latest] {
+        for (std::uint64_t i = 1; i <= kNumFrame; ++i) {
+            latest.write_buffer().fill(i);
+            latest.publish();
+        }
+    });
+
+    std::uint64_t last = 0;
+    std::uint64_t count = 0;
+    bool ok = true;
+    while (last < kNumFrame) {
+        if (!latest.update()) {
+            continue;
+        }
+
+        const auto& frame = latest.read_buffer();
+        for (auto value : frame) {
+            ok = ok && (value == latest.frame());
+        }
+
+        ok = ok && (latest.frame() > last);
+        last = latest.frame();
+        ++count;
+    }
+
+    producer.join();
+
+    REQUIRE(ok);
+    REQUIRE(count > 0);
+    REQUIRE(count <= kNumFrame);
+}
+
+TEST_CASE("read_latest", "[triple_buffer]")
+{
+    using namespace shadowmocap;
+
+    constexpr int kNumFrame = 50;
+
+    asio::io_context ioc;
+
+    tcp::acceptor acceptor{
+        ioc, tcp::endpoint{asio::ip::make_address("127.0.0.1"), 0}};
+
+    // Node list, frames of one Lq item, and then a message that does not
+    // match the channel layout.
+    auto server = [&]() -> asio::awaitable<void> {
+        auto socket = co_await acceptor.async_accept(asio::use_awaitable);
+
+        co_await write_message(
+            socket,
+            "<?xml version=\"1.0\"?><node id=\"default\" key=\"0\">"
+            "<node id=\"A\" key=\"1\"/></node>");
+
+        for (int i = 1; i <= kNumFrame; ++i) {
+            const auto value = static_cast<float>(i);
+            const float values[4] = {value, value, value, value};
+
+            std::string message;
+            append_item(message, 1, values);
+
+            co_await write_message(socket, message);
+        }
+
+        co_await write_message(socket, "not a frame");
+
+        // Until the client hangs up.
+        co_await read_message(socket);
+    };
+
+    co_spawn(ioc, server(), asio::detached);
+
+    triple_buffer<soa_frame> latest{soa_frame{static_cast<int>(channel::Lq)}};
+    std::string name;
+    bool length_error = false;
+
+    auto client = [&]() -> asio::awaitable<void> {
+        tcp::socket socket{ioc};
+        co_await socket.async_connect(
+            acceptor.local_endpoint(), asio::use_awaitable);
+
+        datastream stream{std::move(socket)};
+
+        try {
+            co_await read_latest(stream, latest);
+        } catch (const std::length_error&) {
+            length_error = true;
+        }
+
+        name = stream.nodes_.name(1);
+    };
+
+    co_spawn(ioc, client(), [](std::exception_ptr) {});
+
+    ioc.run();
+
+    REQUIRE(length_error);
+    REQUIRE(name == "A");
+
+    // Every frame was published, the newest one is in the read buffer.
+    REQUIRE(latest.update());
+    REQUIRE(latest.frame() == kNumFrame);
+
+    const auto& frame = latest.read_buffer();
+    REQUIRE(frame.size() == 1);
+    REQUIRE(frame.keys()[0] == 1);
+    REQUIRE(frame.values(channel::Lq, 0)[0] == kNumFrame);
+    REQUIRE(frame.values(channel::Lq, 3)[0] == kNumFrame);
+}